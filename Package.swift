@@ -21,6 +21,12 @@ let cFlags = [PackageDescription.CSetting.unsafeFlags(["-O3", "-Wall", "-Werror"
 /// Conditional support for Apache Arrow Parquet files
 let enableParquet = ProcessInfo.processInfo.environment["ENABLE_PARQUET"] == "TRUE"
 
+/// Conditional support for zstd and brotli response compression. Requires `libzstd-dev` and `libbrotli-dev`
+let enableZstdBrotli = ProcessInfo.processInfo.environment["ENABLE_ZSTD_BROTLI"] == "TRUE"
+
+/// Conditional support for io_uring to read local files on Linux. Requires `liburing-dev`
+let enableIoUring = ProcessInfo.processInfo.environment["ENABLE_IO_URING"] == "TRUE"
+
 let package = Package(
     name: "OpenMeteoApi",
     platforms: [
@@ -63,9 +69,14 @@ let package = Package(
                 "CBz2lib"
             ] + (enableParquet ? [
                 .product(name: "SwiftArrowParquet", package: "SwiftArrowParquet")
+            ] : []) + (enableZstdBrotli ? [
+                "CZstd",
+                "CBrotli"
+            ] : []) + (enableIoUring ? [
+                "CLiburing"
             ] : []),
             cSettings: cFlags,
-            swiftSettings: swiftFlags + (enableParquet ? [.define("ENABLE_PARQUET")] : [])
+            swiftSettings: swiftFlags + (enableParquet ? [.define("ENABLE_PARQUET")] : []) + (enableZstdBrotli ? [.define("ENABLE_ZSTD_BROTLI")] : []) + (enableIoUring ? [.define("ENABLE_IO_URING")] : [])
             //plugins: [.plugin(name: "SwiftLintBuildToolPlugin", package: "SwiftLintPlugins")]
         ),
         .systemLibrary(
@@ -78,6 +89,21 @@ let package = Package(
             pkgConfig: "bz2",
             providers: [.brew(["bzip2"]), .apt(["libbz2-dev"])]
         ),
+        .systemLibrary(
+            name: "CZstd",
+            pkgConfig: "libzstd",
+            providers: [.brew(["zstd"]), .apt(["libzstd-dev"])]
+        ),
+        .systemLibrary(
+            name: "CBrotli",
+            pkgConfig: "libbrotlienc",
+            providers: [.brew(["brotli"]), .apt(["libbrotli-dev"])]
+        ),
+        .systemLibrary(
+            name: "CLiburing",
+            pkgConfig: "liburing",
+            providers: [.apt(["liburing-dev"])]
+        ),
         .target(
             name: "CHelper",
             cSettings: cFlags,
@@ -92,8 +118,15 @@ let package = Package(
             dependencies: [
                 .target(name: "App"),
                 .product(name: "Numerics", package: "swift-numerics"),
-                .product(name: "VaporTesting", package: "vapor")
-            ]
+                .product(name: "VaporTesting", package: "vapor"),
+                "CZlib"
+            ] + (enableZstdBrotli ? [
+                "CZstd",
+                "CBrotli"
+            ] : []) + (enableIoUring ? [
+                "CLiburing"
+            ] : []),
+            swiftSettings: (enableZstdBrotli ? [.define("ENABLE_ZSTD_BROTLI")] : []) + (enableIoUring ? [.define("ENABLE_IO_URING")] : [])
         ),
     ]
 )
@@ -30,7 +30,7 @@ struct CmipController {
                 let readers: [ForecastapiResult<Cmip6Domain>.PerModel] = try await domains.asyncCompactMap { domain in
                     let reader: any Cmip6Readerable = try await {
                         if biasCorrection {
-                            guard let reader = try await Cmip6BiasCorrectorEra5Seamless(domain: domain, lat: coordinates.latitude, lon: coordinates.longitude, elevation: coordinates.elevation, mode: params.cell_selection ?? .land, options: options) else {
+                            guard let reader = try await Cmip6BiasCorrectorEra5Seamless(domain: domain, lat: coordinates.latitude, lon: coordinates.longitude, elevation: coordinates.elevation, mode: params.cell_selection ?? .land, options: options, method: params.bias_correction_method ?? .linear_seasonal) else {
                                 throw ForecastapiError.noDataAvilableForThisLocation
                             }
                             return Cmip6ReaderPostBiasCorrected(reader: reader, domain: domain)
@@ -216,6 +216,14 @@ extension Sequence where Element == Float {
     }
 }
 
+/// Bias correction method of the climate API. Selected with `&bias_correction_method=`
+enum Cmip6BiasCorrectionMethod: String, Codable {
+    /// Linear seasonal weights of the control and reference period
+    case linear_seasonal
+    /// Quantile delta mapping with CDFs precomputed by `generate-cmip6-cdf`
+    case quantile_delta_mapping
+}
+
 /// Apply bias correction to raw variables
 struct Cmip6BiasCorrectorEra5Seamless: GenericReaderProtocol {
     typealias MixingVar = Cmip6VariableOrDerived
@@ -243,6 +251,8 @@ struct Cmip6BiasCorrectorEra5Seamless: GenericReaderProtocol {
     /// era5 land reader
     let readerEra5Land: GenericReader<CdsDomain, Era5Variable>?
 
+    let method: Cmip6BiasCorrectionMethod
+
     func getStatic(type: ReaderStaticVariable) async throws -> Float? {
         if let result = try await readerEra5.getStatic(type: type) {
             return result
@@ -289,30 +299,66 @@ struct Cmip6BiasCorrectorEra5Seamless: GenericReaderProtocol {
         return (BiasCorrectionSeasonalLinear(meansPerYear: weights), readerEra5.modelElevation.numeric)
     }
 
-    func get(variable: Cmip6VariableOrDerived, time: TimerangeDtAndSettings) async throws -> DataAndUnit {
+    /// Precomputed quantile delta mapping CDFs generated by `generate-cmip6-cdf`. Nil if no table is available for this variable or grid cell
+    func getQuantileMappingTable(for variable: Cmip6VariableOrDerived) async throws -> Cmip6QuantileMappingTable? {
         let client = reader.reader.httpClient
         let logger = reader.reader.logger
-        let raw = try await reader.get(variable: variable, time: time)
-        var data = raw.data
-
-        guard let controlWeightFile = try await reader.domain.openBiasCorrectionFile(for: variable.rawValue, client: client, logger: logger) else {
-            throw ForecastapiError.generic(message: "Could not read reference weight file \(variable) for domain \(reader.domain)")
+        guard let tableFile = try await reader.domain.openQuantileMappingFile(for: variable.rawValue, client: client, logger: logger) else {
+            return nil
         }
-        let nTime = Int(controlWeightFile.getDimensions().last!)
-        var weights = [Float](repeating: .nan, count: nTime)
-        try await controlWeightFile.read3D(
-            into: &weights,
+        let nTable = Int(tableFile.getDimensions().last!)
+        guard nTable == Cmip6QuantileMappingTable.count(domain: reader.domain) else {
+            return nil
+        }
+        var table = [Float](repeating: .nan, count: nTable)
+        try await tableFile.read3D(
+            into: &table,
             ny: reader.domain.grid.ny,
             nx: reader.domain.grid.nx,
-            nTime: nTime,
+            nTime: nTable,
             nMembers: 1,
             location: reader.reader.position..<reader.reader.position + 1,
             level: 0,
-            timeOffsets: (file: 0..<nTime, array: 0..<nTime)
+            timeOffsets: (file: 0..<nTable, array: 0..<nTable)
         )
-        let controlWeights = BiasCorrectionSeasonalLinear(meansPerYear: weights)
-        let referenceWeights = try await getEra5BiasCorrectionWeights(for: variable)
-        referenceWeights.weights.applyOffset(on: &data, otherWeights: controlWeights, time: time.time, type: variable.biasCorrectionType)
+        return Cmip6QuantileMappingTable(table: table[...], domain: reader.domain)
+    }
+
+    func get(variable: Cmip6VariableOrDerived, time: TimerangeDtAndSettings) async throws -> DataAndUnit {
+        let client = reader.reader.httpClient
+        let logger = reader.reader.logger
+        let raw = try await reader.get(variable: variable, time: time)
+        var data = raw.data
+        let modelElevation: Float
+
+        switch method {
+        case .quantile_delta_mapping:
+            guard let table = try await getQuantileMappingTable(for: variable) else {
+                throw ForecastapiError.generic(message: "Quantile delta mapping is not available for variable \(variable) and model \(reader.domain)")
+            }
+            data = table.apply(raw.data[...], time: time.time, type: variable.biasCorrectionType)
+            modelElevation = table.referenceElevation
+        case .linear_seasonal:
+            guard let controlWeightFile = try await reader.domain.openBiasCorrectionFile(for: variable.rawValue, client: client, logger: logger) else {
+                throw ForecastapiError.generic(message: "Could not read reference weight file \(variable) for domain \(reader.domain)")
+            }
+            let nTime = Int(controlWeightFile.getDimensions().last!)
+            var weights = [Float](repeating: .nan, count: nTime)
+            try await controlWeightFile.read3D(
+                into: &weights,
+                ny: reader.domain.grid.ny,
+                nx: reader.domain.grid.nx,
+                nTime: nTime,
+                nMembers: 1,
+                location: reader.reader.position..<reader.reader.position + 1,
+                level: 0,
+                timeOffsets: (file: 0..<nTime, array: 0..<nTime)
+            )
+            let controlWeights = BiasCorrectionSeasonalLinear(meansPerYear: weights)
+            let referenceWeights = try await getEra5BiasCorrectionWeights(for: variable)
+            referenceWeights.weights.applyOffset(on: &data, otherWeights: controlWeights, time: time.time, type: variable.biasCorrectionType)
+            modelElevation = referenceWeights.modelElevation
+        }
         if let bounds = variable.biasCorrectionType.bounds {
             for i in data.indices {
                 data[i] = Swift.min(Swift.max(data[i], bounds.lowerBound), bounds.upperBound)
@@ -320,7 +366,6 @@ struct Cmip6BiasCorrectorEra5Seamless: GenericReaderProtocol {
         }
         if case let .raw(raw) = variable {
             let isElevationCorrectable = raw == .temperature_2m_max || raw == .temperature_2m_min || raw == .temperature_2m_mean
-            let modelElevation = referenceWeights.modelElevation
             if isElevationCorrectable && raw.unit == .celsius && !modelElevation.isNaN && !targetElevation.isNaN && targetElevation != modelElevation {
                 for i in data.indices {
                     // correct temperature by 0.65° per 100 m elevation
@@ -341,7 +386,7 @@ struct Cmip6BiasCorrectorEra5Seamless: GenericReaderProtocol {
         }
     }
 
-    init?(domain: Cmip6Domain, lat: Float, lon: Float, elevation: Float, mode: GridSelectionMode, options: GenericReaderOptions) async throws {
+    init?(domain: Cmip6Domain, lat: Float, lon: Float, elevation: Float, mode: GridSelectionMode, options: GenericReaderOptions, method: Cmip6BiasCorrectionMethod = .linear_seasonal) async throws {
         guard let reader = try await GenericReader<Cmip6Domain, Cmip6Variable>(domain: domain, lat: lat, lon: lon, elevation: elevation, mode: mode, options: options) else {
             return nil
         }
@@ -355,6 +400,7 @@ struct Cmip6BiasCorrectorEra5Seamless: GenericReaderProtocol {
         /// No data on sea for ERA5-Land
         self.readerEra5Land = readerEra5Land.modelElevation.isSea ? nil : readerEra5Land
         self.readerEra5 = readerEra5
+        self.method = method
     }
 }
 
@@ -281,6 +281,15 @@ extension GenericDomain {
     func openBiasCorrectionFile(for variable: String, client: HTTPClient, logger: Logger) async throws -> (any OmFileReaderArrayProtocol<Float>)? {
         return try await RemoteOmFileManager.instance.get(file: getBiasCorrectionFile(for: variable), client: client, logger: logger)
     }
+
+    /// Get the file path to precomputed quantile delta mapping CDFs. See `Cmip6QuantileMappingTable`
+    func getQuantileMappingFile(for variable: String) -> OmFileManagerReadable {
+        return .domainChunk(domain: domainRegistry, variable: variable, type: .quantile_mapping_cdf, chunk: nil, ensembleMember: 0, previousDay: 0)
+    }
+
+    func openQuantileMappingFile(for variable: String, client: HTTPClient, logger: Logger) async throws -> (any OmFileReaderArrayProtocol<Float>)? {
+        return try await RemoteOmFileManager.instance.get(file: getQuantileMappingFile(for: variable), client: client, logger: logger)
+    }
 }
 
 protocol GenericVariableBiasCorrectable {
@@ -0,0 +1,156 @@
+import Foundation
+import OmFileFormat
+import Vapor
+
+/**
+ Precompute quantile delta mapping CDFs for each CMIP6 grid cell. CDFs only depend on the full reference and control time-series and never change.
+ The API then only reads one table per grid cell instead of two long time-series.
+
+ For each grid cell the reference is taken from ERA5 daily aggregates at the closest land grid cell with similar elevation.
+ Tables are written to `<domain>/<variable>/quantile_mapping_cdf.om` with dimensions `[ny, nx, table]`. See `Cmip6QuantileMappingTable` for the layout.
+ If a table file exists, `Cmip6BiasCorrectorEra5Seamless` uses quantile delta mapping instead of linear seasonal bias correction.
+
+ Example:
+ `openmeteo-api generate-cmip6-cdf MRI_AGCM3_2_S temperature_2m_max,precipitation_sum --concurrency 16`
+ */
+struct Cmip6QuantileMappingCommand: AsyncCommand {
+    var help: String {
+        return "Precompute quantile delta mapping CDFs for CMIP6 bias correction"
+    }
+
+    struct Signature: CommandSignature {
+        @Argument(name: "domain", help: "CMIP6 domain. E.g. 'MRI_AGCM3_2_S'")
+        var domain: String
+
+        @Argument(name: "variables", help: "Variables separated by comma. E.g. 'temperature_2m_max,precipitation_sum'")
+        var variables: String
+
+        @Option(name: "concurrency", short: "c", help: "Number of grid cells to process in parallel. Default: number of cores")
+        var concurrency: Int?
+
+        @Flag(name: "force", help: "Overwrite existing tables")
+        var force: Bool
+    }
+
+    func run(using context: CommandContext, signature: Signature) async throws {
+        let logger = context.application.logger
+        let httpClient = context.application.http.client.shared
+        let domain = try Cmip6Domain.load(rawValue: signature.domain)
+        let variables = try Cmip6VariableOrDerived.load(commaSeparated: [signature.variables])
+        let concurrency = max(1, signature.concurrency ?? System.coreCount)
+        let nTable = Cmip6QuantileMappingTable.count(domain: domain)
+        let splitter = OmFileSplitter(domain: domain.domainRegistry, nMembers: 1, nx: domain.grid.nx, ny: domain.grid.ny, nTimePerFile: nTable, hasYearlyFiles: false, masterTimeRange: nil, chunknLocations: 1)
+
+        for variable in variables {
+            guard let referenceVariable = ForecastVariableDaily(rawValue: variable.rawValue) else {
+                logger.warning("Skipping \(variable), because no ERA5 reference is available")
+                continue
+            }
+            let file = domain.getQuantileMappingFile(for: variable.rawValue)
+            if file.exists() && !signature.force {
+                logger.info("Skipping \(variable), because \(file.getFilePath()) exists")
+                continue
+            }
+            let start = DispatchTime.now()
+            let progress = TransferAmountTracker(logger: logger, totalSize: domain.grid.count * nTable * MemoryLayout<Float>.size, name: "Generate \(variable)")
+            try await splitter.writeLocationTable(file: file, compression: .fpx_xor2d, scalefactor: 1) { yRange, xRange in
+                let gridpoints = yRange.flatMap { y in xRange.map { x in Int(y) * domain.grid.nx + Int(x) } }
+                let tables = try await gridpoints.mapConcurrent(nConcurrent: concurrency) { gridpoint in
+                    try await Self.calculate(domain: domain, variable: variable, referenceVariable: referenceVariable, gridpoint: gridpoint, logger: logger, httpClient: httpClient)
+                }
+                progress.add(gridpoints.count * nTable * MemoryLayout<Float>.size)
+                return ArraySlice(tables.joined())
+            }
+            progress.finish()
+            logger.info("Generated \(file.getFilePath()) in \(start.timeElapsedPretty())")
+        }
+    }
+
+    /// Read the entire control and reference time-series of one grid cell and return its table. Grid cells without data are filled with NaN
+    static func calculate(domain: Cmip6Domain, variable: Cmip6VariableOrDerived, referenceVariable: ForecastVariableDaily, gridpoint: Int, logger: Logger, httpClient: HTTPClient) async throws -> [Float] {
+        let options = try GenericReaderOptions(logger: logger, httpClient: httpClient)
+        let empty = [Float](repeating: .nan, count: Cmip6QuantileMappingTable.count(domain: domain))
+        let controlReader = try await GenericReader<Cmip6Domain, Cmip6Variable>(domain: domain, position: gridpoint, options: options)
+        let control = try await Cmip6ReaderPreBiasCorrection(reader: controlReader, domain: domain).get(variable: variable, time: Cmip6QuantileMappingTable.controlTime(domain: domain).toSettings())
+
+        let coordinates = domain.grid.getCoordinates(gridpoint: gridpoint)
+        let era5 = try await Era5Factory.makeReader(domain: .era5, lat: coordinates.latitude, lon: coordinates.longitude, elevation: controlReader.modelElevation.numeric, mode: .land, options: options)
+        let referenceReader = GenericReaderMulti<ForecastVariable, MultiDomains>(domain: .era5, reader: [era5])
+        let units = ApiUnits(temperature_unit: .celsius, windspeed_unit: .ms, wind_speed_unit: nil, precipitation_unit: .mm, length_unit: .metric)
+        guard let reference = try await referenceReader.getDaily(variable: referenceVariable, params: units, time: Cmip6QuantileMappingTable.referenceTime.toSettings()) else {
+            return empty
+        }
+        let table = Cmip6QuantileMappingTable(reference: reference.data, control: control.data, referenceElevation: era5.modelElevation.numeric, domain: domain, type: variable.biasCorrectionType)
+        return table.table
+    }
+}
+
+/**
+ Precomputed quantile delta mapping CDFs of one CMIP6 grid cell.
+
+ Layout of `table`: reference elevation, reference CDF table, control CDF table. CDF tables start with bins min, bins max, first year and number of year bins followed by the CDF. See `CdfMonthly10YearSliding.table`.
+ Around 25 KB per grid cell.
+ */
+struct Cmip6QuantileMappingTable {
+    /// CDF of ERA5 daily aggregates
+    let reference: CdfMonthly10YearSliding
+
+    /// CDF of the entire control and forecast time-series of the climate model
+    let control: CdfMonthly10YearSliding
+
+    /// Elevation of the ERA5 grid cell. Used to correct temperature to the target elevation
+    let referenceElevation: Float
+
+    static var nQuantiles: Int { 100 }
+
+    /// Same period as used for linear seasonal bias correction weights
+    static var referenceTime: TimerangeDt {
+        return TimerangeDt(start: Timestamp(1960, 1, 1), to: Timestamp(2023, 1, 1), dtSeconds: 24 * 3600)
+    }
+
+    /// All CMIP6 domains have a master time range
+    static func controlTime(domain: Cmip6Domain) -> TimerangeDt {
+        return TimerangeDt(range: domain.masterTimeRange!, dtSeconds: domain.dtSeconds)
+    }
+
+    /// Number of values in `table` for a domain
+    static func count(domain: Cmip6Domain) -> Int {
+        let nYearsReference = CdfMonthly10YearSliding.years(time: referenceTime).nYears
+        let nYearsControl = CdfMonthly10YearSliding.years(time: controlTime(domain: domain)).nYears
+        return 1 + CdfMonthly10YearSliding.tableCount(nYears: nYearsReference, nQuantiles: nQuantiles) + CdfMonthly10YearSliding.tableCount(nYears: nYearsControl, nQuantiles: nQuantiles)
+    }
+
+    /// Calculate CDFs from the full reference and control time-series
+    init(reference: [Float], control: [Float], referenceElevation: Float, domain: Cmip6Domain, type: QuantileDeltaMappingBiasCorrection.ChangeType) {
+        let binsReference = QuantileDeltaMappingBiasCorrection.calculateBins(reference, nQuantiles: Self.nQuantiles, min: type.isRelativeChange ? 0 : nil)
+        self.reference = CdfMonthly10YearSliding(vector: reference[...], time: Self.referenceTime, bins: binsReference)
+        let binsControl = QuantileDeltaMappingBiasCorrection.calculateBins(control, nQuantiles: Self.nQuantiles, min: type.isRelativeChange ? 0 : nil)
+        self.control = CdfMonthly10YearSliding(vector: control[...], time: Self.controlTime(domain: domain), bins: binsControl)
+        self.referenceElevation = referenceElevation
+    }
+
+    /// Restore from a table read from file. Returns nil for grid cells without data
+    init?(table: ArraySlice<Float>, domain: Cmip6Domain) {
+        guard table.count == Self.count(domain: domain) else {
+            return nil
+        }
+        let nYearsReference = CdfMonthly10YearSliding.years(time: Self.referenceTime).nYears
+        let referenceEnd = table.startIndex + 1 + CdfMonthly10YearSliding.tableCount(nYears: nYearsReference, nQuantiles: Self.nQuantiles)
+        guard let reference = CdfMonthly10YearSliding(table: table[table.startIndex + 1 ..< referenceEnd], nQuantiles: Self.nQuantiles),
+              let control = CdfMonthly10YearSliding(table: table[referenceEnd...], nQuantiles: Self.nQuantiles) else {
+            return nil
+        }
+        self.reference = reference
+        self.control = control
+        self.referenceElevation = table[table.startIndex]
+    }
+
+    var table: [Float] {
+        return [referenceElevation] + reference.table + control.table
+    }
+
+    /// Bias correct any part of the control and forecast time-series
+    func apply(_ data: ArraySlice<Float>, time: TimerangeDt, type: QuantileDeltaMappingBiasCorrection.ChangeType) -> [Float] {
+        return QuantileDeltaMappingBiasCorrection.quantileDeltaMappingMonthly(reference: reference, referenceEnd: Self.referenceTime.range.upperBound, control: control, forecast: data, forecastTime: time, type: type)
+    }
+}
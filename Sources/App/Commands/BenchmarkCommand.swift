@@ -1,6 +1,7 @@
 import Foundation
 import Vapor
 import OmFileFormat
+import FlatBuffers
 
 fileprivate extension String {
     func pad(_ n: Int) -> String {
@@ -11,7 +12,7 @@ fileprivate extension String {
     }
 }
 
-final class BenchmarkCommand: Command {
+final class BenchmarkCommand: AsyncCommand {
     var help: String { "Benchmark Open-Meteo core functions like data manipulation and compression" }
 
     struct Signature: CommandSignature {
@@ -20,7 +21,7 @@ final class BenchmarkCommand: Command {
     }
 
     /// `swift run -c release openmeteo-api benchmark`
-    func run(using context: CommandContext, signature: Signature) throws {
+    func run(using context: CommandContext, signature: Signature) async throws {
         let run = BenchmarkRun(timePerTest: signature.time ?? 5)
 
         print("Open-Meteo Benchmark")
@@ -30,7 +31,7 @@ final class BenchmarkCommand: Command {
         print("| \("Test".pad(80)) | \("Mean".pad(8)) | \("Min".pad(8)) | \("Max".pad(8)) | \("Runs".pad(8)) | \("Diff to Apple M1".pad(20)) |")
         print("|\(String.dash(80 + 2))|\(String.dash(8 + 2))|\(String.dash(8 + 2))|\(String.dash(8 + 2))|\(String.dash(8 + 2))|\(String.dash(20 + 2))|")
 
-        run.measure("Solar Position Calculation for 50 years, hourly", 625) {
+        await run.measure("Solar Position Calculation for 50 years, hourly", 625) {
             _ = SolarPositionAlgorithm.sunPosition(timerange: TimerangeDt(start: Timestamp(1950, 1, 1), to: Timestamp(2000, 1, 1), dtSeconds: 3600))
         }
 
@@ -69,15 +70,283 @@ final class BenchmarkCommand: Command {
         }*/
 
         let exradTime = TimerangeDt(start: Timestamp(1900, 1, 1), to: Timestamp(2000, 1, 1), dtSeconds: 3600)
-        let exrad = run.measure("Calculate extra terrestrial radiation (100 years, hourly)", 47) {
+        let exrad = await run.measure("Calculate extra terrestrial radiation (100 years, hourly)", 47) {
             return Zensun.extraTerrestrialRadiationBackwards(latitude: 52, longitude: 7, timerange: exradTime)
         }
 
-        _ = run.measure("Interpolate radiation to 15 minutes", 246) {
+        _ = await run.measure("Interpolate radiation to 15 minutes", 246) {
             let dtNew = exradTime.dtSeconds / 4
             let timeNew = exradTime.range.add(-exradTime.dtSeconds + dtNew).range(dtSeconds: dtNew)
             return exrad.interpolate(type: .solar_backwards_averaged, timeOld: exradTime, timeNew: timeNew, latitude: 52, longitude: 7, scalefactor: 100)
         }
+
+        let derivedTime = TimerangeDt(start: Timestamp(2010, 1, 1), to: Timestamp(2020, 1, 1), dtSeconds: 3600)
+        let derivedExrad = Array(exrad[0..<derivedTime.count])
+        let raw = Dictionary(uniqueKeysWithValues: BenchmarkRawVariable.allCases.enumerated().map { (j, variable) in
+            (variable.rawValue, (0..<derivedTime.count).map { i -> Float in
+                let x = Float(i)
+                switch variable {
+                case .temperature_2m, .temperature_850hPa:
+                    return sin(x * .pi / 12) * 8 + 10 - Float(j)
+                case .relative_humidity_2m, .relative_humidity_850hPa:
+                    return cos(x * .pi / 12) * 30 + 60
+                case .direct_radiation, .diffuse_radiation:
+                    return max(sin(x * .pi / 12) * 400, 0)
+                default:
+                    return sin(x * .pi / 7 + Float(j)) * 10
+                }
+            })
+        })
+        let kernels: [DerivedKernel<BenchmarkRawVariable>] = [
+            .windSpeed(u: .wind_u_component_10m, v: .wind_v_component_10m),
+            .windDirection(u: .wind_u_component_10m, v: .wind_v_component_10m),
+            .windSpeed(u: .wind_u_component_80m, v: .wind_v_component_80m),
+            .windDirection(u: .wind_u_component_80m, v: .wind_v_component_80m),
+            .windSpeed(u: .wind_u_component_120m, v: .wind_v_component_120m),
+            .windDirection(u: .wind_u_component_120m, v: .wind_v_component_120m),
+            .windSpeed(u: .wind_u_component_180m, v: .wind_v_component_180m),
+            .windDirection(u: .wind_u_component_180m, v: .wind_v_component_180m),
+            .windSpeed(u: .wind_u_component_850hPa, v: .wind_v_component_850hPa),
+            .windDirection(u: .wind_u_component_850hPa, v: .wind_v_component_850hPa),
+            .windSpeed(u: .wind_u_component_700hPa, v: .wind_v_component_700hPa),
+            .windDirection(u: .wind_u_component_700hPa, v: .wind_v_component_700hPa),
+            .windSpeed(u: .wind_u_component_500hPa, v: .wind_v_component_500hPa),
+            .windDirection(u: .wind_u_component_500hPa, v: .wind_v_component_500hPa),
+            .apparentTemperature(temperature: .temperature_2m, relativeHumidity: .relative_humidity_2m, windU: .wind_u_component_10m, windV: .wind_v_component_10m, shortwave: [.direct_radiation, .diffuse_radiation]),
+            .vapourPressureDeficit(temperature: .temperature_2m, relativeHumidity: .relative_humidity_2m),
+            .et0Evapotranspiration(temperature: .temperature_2m, relativeHumidity: .relative_humidity_2m, windU: .wind_u_component_10m, windV: .wind_v_component_10m, shortwave: [.direct_radiation, .diffuse_radiation], extraTerrestrialRadiation: derivedExrad, elevation: 100, dtSeconds: 3600),
+            .dewpoint(temperature: .temperature_2m, relativeHumidity: .relative_humidity_2m),
+            .wetBulbTemperature(temperature: .temperature_2m, relativeHumidity: .relative_humidity_2m),
+            .dewpoint(temperature: .temperature_850hPa, relativeHumidity: .relative_humidity_850hPa)
+        ]
+        await run.measure("Derived variables, 20 variables chained (10 years, hourly)", nil) {
+            func get(_ variable: BenchmarkRawVariable) -> [Float] {
+                return raw[variable.rawValue]!
+            }
+            var results = [[Float]]()
+            for level in ["10m", "80m", "120m", "180m", "850hPa", "700hPa", "500hPa"] {
+                let u = raw["wind_u_component_\(level)"]!
+                let v = raw["wind_v_component_\(level)"]!
+                results.append(zip(u, v).map(Meteorology.windspeed))
+                results.append(Meteorology.windirectionFast(u: u, v: v))
+            }
+            let temperature = get(.temperature_2m)
+            let rh = get(.relative_humidity_2m)
+            let windspeed = zip(get(.wind_u_component_10m), get(.wind_v_component_10m)).map(Meteorology.windspeed)
+            let swrad = zip(get(.direct_radiation), get(.diffuse_radiation)).map(+)
+            results.append(Meteorology.apparentTemperature(temperature_2m: temperature, relativehumidity_2m: rh, windspeed_10m: windspeed, shortwave_radiation: swrad))
+            let dewpoint = zip(temperature, rh).map(Meteorology.dewpoint)
+            results.append(zip(temperature, dewpoint).map(Meteorology.vaporPressureDeficit))
+            results.append(derivedExrad.indices.map { i in
+                Meteorology.et0Evapotranspiration(temperature2mCelsius: temperature[i], windspeed10mMeterPerSecond: windspeed[i], dewpointCelsius: dewpoint[i], shortwaveRadiationWatts: swrad[i], elevation: 100, extraTerrestrialRadiation: derivedExrad[i], dtSeconds: 3600)
+            })
+            results.append(dewpoint)
+            results.append(zip(temperature, rh).map(Meteorology.wetBulbTemperature))
+            results.append(zip(get(.temperature_850hPa), get(.relative_humidity_850hPa)).map(Meteorology.dewpoint))
+            return results
+        }
+        await run.measure("Derived variables, 20 variables fused kernels (10 years, hourly)", nil) {
+            return DerivedKernel.evaluate(kernels, raw: raw)
+        }
+
+        let (bboxNy, bboxNx, bboxNTime) = (200, 200, 384)
+        let bboxFile = "\(OpenMeteo.tempDirectory)benchmark-bounding-box.om"
+        try FileManager.default.createDirectory(atPath: OpenMeteo.tempDirectory, withIntermediateDirectories: true)
+        try FileManager.default.removeItemIfExists(at: bboxFile)
+        defer { try? FileManager.default.removeItem(atPath: bboxFile) }
+        try (0..<bboxNy * bboxNx * bboxNTime).map { i -> Float in
+            return sin(Float(i % bboxNTime) * .pi / 12) * 10 + Float(i / bboxNTime % 1000) * 0.01
+        }.writeOmFile(file: bboxFile, dimensions: [bboxNy, bboxNx, bboxNTime], chunks: [1, 12, bboxNTime]).close()
+        guard let bboxReader = try await OmFileReader(mmapFile: bboxFile).asArray(of: Float.self) else {
+            fatalError("Could not open \(bboxFile)")
+        }
+        let bboxY = 70..<120
+        let bboxX = 30..<80
+        let bboxTime = (file: 0..<bboxNTime, array: 0..<bboxNTime)
+        try await run.measure("Bounding box 50x50, 10 variables, one read per location", nil) {
+            var out = [Float](repeating: .nan, count: bboxNTime)
+            for _ in 0..<10 {
+                for y in bboxY {
+                    for x in bboxX {
+                        try await bboxReader.read3D(into: &out, ny: bboxNy, nx: bboxNx, nTime: bboxNTime, nMembers: 1, location: y * bboxNx + x ..< y * bboxNx + x + 1, level: 0, timeOffsets: bboxTime)
+                    }
+                }
+            }
+            return out
+        }
+        try await run.measure("Bounding box 50x50, 10 variables, one block read", nil) {
+            var out = [Float](repeating: .nan, count: bboxY.count * bboxX.count * bboxNTime)
+            for _ in 0..<10 {
+                try await bboxReader.read3D(into: &out, ny: bboxNy, nx: bboxNx, nTime: bboxNTime, nMembers: 1, y: bboxY, x: bboxX, level: 0, timeOffsets: bboxTime)
+            }
+            return out
+        }
+
+        let climateTime = TimerangeDt(start: Timestamp(1950, 1, 1), to: Timestamp(2100, 1, 1), dtSeconds: 86400)
+        let referenceTime = TimerangeDt(start: Timestamp(1950, 1, 1), to: Timestamp(2020, 1, 1), dtSeconds: 86400)
+        let climate = (0..<climateTime.count).map { i -> Float in
+            return sin(Float(i) / 365.25 * 2 * .pi) * 10 + Float(i) / 20_000 + sin(Float(i) * 0.7) * 3
+        }
+        let reference = climate[0..<referenceTime.count].map { $0 + 1.5 }
+        await run.measure("Quantile delta mapping for 150 years, daily", nil) {
+            return QuantileDeltaMappingBiasCorrection.quantileDeltaMappingMonthly(reference: ArraySlice(reference), referenceTime: referenceTime, controlAndForecast: ArraySlice(climate), controlAndForecastTime: climateTime, type: .absoluteChage(bounds: nil))
+        }
+
+        for (name, grid) in [("ICON global", IconDomains.icon.grid), ("ERA5-Land", CdsDomain.era5_land.grid)] {
+            let index = await run.measure("Build elevation index (\(name), \(grid.nx)x\(grid.ny))", nil) {
+                let elevation = (0..<grid.count).map { i -> Float in
+                    let value = sin(Float(i % grid.nx) * 0.01) * 2000 + cos(Float(i / grid.nx) * 0.02) * 1500
+                    return value < 0 ? -999 : value
+                }
+                return ElevationIndex(elevation: elevation, nx: grid.nx, ny: grid.ny)
+            }
+            let points = (0..<100_000).map { i in
+                (lat: Float(i % 1701) * 0.1 - 85, lon: Float(i % 3593) * 0.1 - 179.5, elevation: Float(i % 3000))
+            }
+            await run.measure("Resolve 100k grid points with elevation index (\(name))", nil) {
+                var found = 0
+                for point in points {
+                    if index.findPoint(grid: grid, lat: point.lat, lon: point.lon, elevation: point.elevation, mode: .land) != nil {
+                        found += 1
+                    }
+                }
+                return found
+            }
+        }
+
+        let solarTime = TimerangeDt(start: Timestamp(2024, 6, 1), nTime: 6, dtSeconds: 3600)
+        for (name, grid) in [("HRRR CONUS", GfsDomain.hrrr_conus.grid), ("UKMO 2 km", UkmoDomain.uk_deterministic_2km.grid)] {
+            await run.measure("Solar factor \(name) 6 steps, projection per grid point", nil) {
+                return Zensun.calculateRadiationBackwardsAveraged(grid: BenchmarkUncachedGrid(grid: grid), locationRange: 0..<grid.count, timerange: solarTime)
+            }
+            await run.measure("Solar factor \(name) 6 steps, coordinate lookup table", nil) {
+                return Zensun.calculateRadiationBackwardsAveraged(grid: grid, locationRange: 0..<grid.count, timerange: solarTime)
+            }
+        }
+
+        /// 1 GB in memory block cache at 50% load. Random reads from all cores.
+        /// No reference numbers yet. Gains from huge pages and interleaving depend on the host and have to be measured there
+        let cacheBlockSize = 64 * 1024
+        let cacheBlockCount = 16 * 1024
+        let cacheKeys = (0..<UInt64(cacheBlockCount / 2)).map { $0 &* 0x9E37_79B9_7F4A_7C15 }
+        let nThreads = ProcessInfo.processInfo.activeProcessorCount
+        for (name, placement) in [
+            ("4 KB pages", AtomicBlockCachePlacement()),
+            ("transparent huge pages", AtomicBlockCachePlacement(hugePages: .transparent)),
+            ("explicit huge pages", AtomicBlockCachePlacement(hugePages: .explicit)),
+            ("transparent huge pages, NUMA interleave", AtomicBlockCachePlacement(hugePages: .transparent, numaInterleave: true))
+        ] {
+            let cache: AtomicBlockCache<MmapFile>
+            do {
+                cache = try AtomicBlockCache(blockSize: cacheBlockSize, blockCount: cacheBlockCount, placement: placement)
+            } catch {
+                print("| \("Block cache 1 GB, \(name)".pad(80)) | skipped: \(error)")
+                continue
+            }
+            let block = [UInt8](repeating: 1, count: cacheBlockSize)
+            for key in cacheKeys {
+                cache.set(key: key, value: block)
+            }
+            await run.measure("Block cache 1 GB, 1M random reads, \(nThreads) threads, \(name)", nil) {
+                DispatchQueue.concurrentPerform(iterations: nThreads) { thread in
+                    var random = UInt64(thread + 1) &* 0x2545_F491_4F6C_DD1D
+                    var sum: UInt64 = 0
+                    for _ in 0 ..< 1_000_000 / nThreads {
+                        random ^= random << 13
+                        random ^= random >> 7
+                        random ^= random << 17
+                        if let data = cache.get(key: cacheKeys[Int(random % UInt64(cacheKeys.count))]) {
+                            sum &+= UInt64(data[Int((random >> 32) % UInt64(cacheBlockSize))])
+                        }
+                    }
+                    precondition(sum > 0, "No block found in cache")
+                }
+            }
+        }
+
+        /// Lookups of 20 open files from 64 concurrent tasks. Files are registered as missing, so no data is read
+        let fileManager = RemoteOmFileManager()
+        let registryLogger = Logger(label: "benchmark")
+        let registryFiles = (0..<20).map { OmFileManagerReadable.staticFile(domain: .dwd_icon, variable: "benchmark\($0)") }
+        for file in registryFiles {
+            _ = try await fileManager.cache.get(key: file, forceNew: false, provider: { nil })
+        }
+        let nLookupTasks = 64
+        try await run.measure("Open file lookup, \(nLookupTasks) tasks with 10k lookups each, registry", nil) {
+            try await withThrowingTaskGroup(of: Void.self) { group in
+                for t in 0..<nLookupTasks {
+                    group.addTask {
+                        for i in 0..<10_000 {
+                            _ = try await fileManager.get(file: registryFiles[(t + i) % registryFiles.count], client: .shared, logger: registryLogger)
+                        }
+                    }
+                }
+                try await group.waitForAll()
+            }
+        }
+        try await run.measure("Open file lookup, \(nLookupTasks) tasks with 10k lookups each, cache actor", nil) {
+            try await withThrowingTaskGroup(of: Void.self) { group in
+                for t in 0..<nLookupTasks {
+                    group.addTask {
+                        for i in 0..<10_000 {
+                            _ = try await fileManager.cache.get(key: registryFiles[(t + i) % registryFiles.count], forceNew: false, provider: { nil })
+                        }
+                    }
+                }
+                try await group.waitForAll()
+            }
+        }
+
+        /// 10k coordinates with repeated locations like multi-location API calls
+        let timezoneCoordinates = (0..<10_000).map { i in
+            (latitude: Float(i % 1_500) * 0.1 - 60, longitude: Float(i % 3_500) * 0.1 - 170)
+        }
+        try await run.measure("Timezone lookup 10k coordinates, database and TimeZone per coordinate", nil) {
+            return try timezoneCoordinates.map { coordinate in
+                guard let identifier = TimezoneWithOffset.timezoneDatabase.simple(latitude: coordinate.latitude, longitude: coordinate.longitude) else {
+                    throw ForecastapiError.invalidTimezone
+                }
+                return TimezoneWithOffset(timezone: try TimeZone.initWithFallback(identifier))
+            }
+        }
+        try await run.measure("Timezone lookup 10k coordinates, batched with empty cache", nil) {
+            return try TimezoneCache(capacity: 100_000).resolve(coordinates: timezoneCoordinates)
+        }
+        try await run.measure("Timezone lookup 10k coordinates, batched with warm cache", nil) {
+            return try TimezoneCache.instance.resolve(coordinates: timezoneCoordinates)
+        }
+
+        /// 20 hourly variables for 16 days and 10 daily variables, similar to a large forecast call
+        let hourlyColumns = (0..<20).map { i in
+            ApiColumn<ForecastapiResult<MultiDomains>.SurfacePressureAndHeightVariable>(variable: .surface(.init(.temperature_2m, i)), unit: .celsius, variables: [.float((0..<384).map { Float($0 + i) })])
+        }
+        let dailyColumns = (0..<10).map { i in
+            ApiColumn<ForecastVariableDaily>(variable: .temperature_2m_max, unit: .celsius, variables: [.float((0..<16).map { Float($0 + i) })])
+        }
+        let hourlySection = ApiSection(name: "hourly", time: TimerangeDt(start: Timestamp(2024, 1, 1), nTime: 384, dtSeconds: 3600), columns: hourlyColumns)
+        let dailySection = ApiSection(name: "daily", time: TimerangeDt(start: Timestamp(2024, 1, 1), nTime: 16, dtSeconds: 86400), columns: dailyColumns)
+        let flatbuffersModel = ForecastapiResult<MultiDomains>.PerModel(model: .best_match, latitude: 52.52, longitude: 13.41, elevation: 38, prefetch: {}, current: nil, hourly: { hourlySection }, daily: { dailySection }, sixHourly: nil, minutely15: nil)
+        let flatbuffersTimezone = TimezoneWithOffset(utcOffsetSeconds: 3600, identifier: "Europe/Berlin", abbreviation: "CET")
+        /// The SDK builder is reused with `clear()` like the previous response path, so only encoding and the copy into the response buffer are compared
+        try await run.measure("FlatBuffers 1000 locations, 20 hourly variables 16 days, SDK builder", nil) {
+            var buffer = ByteBufferAllocator().buffer(capacity: 4096)
+            var fbb = FlatBufferBuilder(initialSize: 4096)
+            for locationId in 0..<1000 {
+                try await flatbuffersModel.writeToFlatbuffer(&fbb, timezone: flatbuffersTimezone, fixedGenerationTime: 1, locationId: locationId)
+                buffer.writeBytes(fbb.buffer.unsafeRawBufferPointer)
+                fbb.clear()
+                buffer.moveWriterIndex(to: 0)
+            }
+            return buffer
+        }
+        try await run.measure("FlatBuffers 1000 locations, 20 hourly variables 16 days, direct encoder", nil) {
+            var buffer = ByteBufferAllocator().buffer(capacity: 4096)
+            for locationId in 0..<1000 {
+                try await flatbuffersModel.writeToFlatbuffer(&buffer, timezone: flatbuffersTimezone, fixedGenerationTime: 1, locationId: locationId)
+                buffer.moveWriterIndex(to: 0)
+            }
+            return buffer
+        }
     }
 }
 
@@ -85,10 +354,10 @@ struct BenchmarkRun {
     var timePerTest: Int
 
     @discardableResult
-    func measure<T>(_ section: String, _ baseLineMeanMs: Double, fn: () throws -> T) rethrows -> T {
+    func measure<T>(_ section: String, _ baseLineMeanMs: Double?, fn: () async throws -> T) async rethrows -> T {
         print("| \(section.pad(80)) | ", terminator: "")
         // Do not measure first execution
-        var result = try fn()
+        var result = try await fn()
 
         let start = DispatchTime.now()
         let end = start.uptimeNanoseconds + UInt64(timePerTest) * 1_000_000_000
@@ -98,7 +367,7 @@ struct BenchmarkRun {
 
         repeat {
             let s = DispatchTime.now()
-            result = try fn()
+            result = try await fn()
             count += 1
             let elapsed = Double((DispatchTime.now().uptimeNanoseconds - s.uptimeNanoseconds)) / 1_000_000_000
             if elapsed < min {
@@ -110,10 +379,65 @@ struct BenchmarkRun {
         } while DispatchTime.now().uptimeNanoseconds <= end
         let elapsed = Double((DispatchTime.now().uptimeNanoseconds - start.uptimeNanoseconds)) / 1_000_000_000
         let mean = elapsed / Double(count)
-        let diff = mean - baseLineMeanMs / 1000
-        let factor = round((mean) / (baseLineMeanMs / 1000) * 100) / 100
-        let b = "\(diff > 0 ? "+" : "")\(diff.asSecondsPrettyPrint) (x\(factor))"
+        let b: String
+        if let baseLineMeanMs {
+            let diff = mean - baseLineMeanMs / 1000
+            let factor = round((mean) / (baseLineMeanMs / 1000) * 100) / 100
+            b = "\(diff > 0 ? "+" : "")\(diff.asSecondsPrettyPrint) (x\(factor))"
+        } else {
+            // No M1 baseline recorded yet
+            b = "-"
+        }
         print("\(mean.asSecondsPrettyPrint.pad(8)) | \(min.asSecondsPrettyPrint.pad(8)) | \(max.asSecondsPrettyPrint.pad(8)) | \(String(count).pad(8)) | \(b.pad(20)) |")
         return result
     }
 }
+
+/// Raw variables for the derived variable benchmark
+fileprivate enum BenchmarkRawVariable: String, CaseIterable, RawRepresentableString {
+    case temperature_2m
+    case relative_humidity_2m
+    case direct_radiation
+    case diffuse_radiation
+    case temperature_850hPa
+    case relative_humidity_850hPa
+    case wind_u_component_10m
+    case wind_v_component_10m
+    case wind_u_component_80m
+    case wind_v_component_80m
+    case wind_u_component_120m
+    case wind_v_component_120m
+    case wind_u_component_180m
+    case wind_v_component_180m
+    case wind_u_component_850hPa
+    case wind_v_component_850hPa
+    case wind_u_component_700hPa
+    case wind_v_component_700hPa
+    case wind_u_component_500hPa
+    case wind_v_component_500hPa
+}
+
+/// Resolves coordinates with the inverse projection for every grid point as before coordinate lookup tables
+fileprivate struct BenchmarkUncachedGrid: Gridable {
+    let grid: any Gridable
+
+    var nx: Int { grid.nx }
+    var ny: Int { grid.ny }
+    var searchRadius: Int { grid.searchRadius }
+
+    func findPoint(lat: Float, lon: Float) -> Int? {
+        return grid.findPoint(lat: lat, lon: lon)
+    }
+
+    func findPointInterpolated(lat: Float, lon: Float) -> GridPoint2DFraction? {
+        return grid.findPointInterpolated(lat: lat, lon: lon)
+    }
+
+    func findBox(boundingBox bb: BoundingBoxWGS84) -> (any Sequence<Int>)? {
+        return grid.findBox(boundingBox: bb)
+    }
+
+    func getCoordinates(gridpoint: Int) -> (latitude: Float, longitude: Float) {
+        return grid.getCoordinates(gridpoint: gridpoint)
+    }
+}
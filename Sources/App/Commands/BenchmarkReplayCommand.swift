@@ -0,0 +1,297 @@
+import Foundation
+import Vapor
+import CHelper
+import NIOConcurrencyHelpers
+
+/**
+ Replay a log of API requests in-process against the Vapor application and report end-to-end latency and throughput.
+
+ The request log is a JSONL file with one object per line. Only `url` is required and may be a full URL or a path with query string:
+ `{"url": "/v1/forecast?latitude=47.1&longitude=8.4&hourly=temperature_2m", "method": "GET"}`
+ Lines that cannot be decoded are skipped and reported.
+
+ Requests do not pass through the network stack. Data is read from `DATA_DIRECTORY`, which should point to a synthetic local dataset to get reproducible numbers:
+ `DATA_DIRECTORY=/tmp/synthetic/ openmeteo-api benchmark-replay requests.jsonl --concurrency 16`
+
+ Arrival models:
+ - closed (default): `concurrency` workers send the next request as soon as the previous response body is completely received
+ - open: requests are started at a fixed `rate` regardless of completion. Latency is measured from the scheduled start to avoid coordinated omission
+
+ Float array allocations per request and RSS are reported as well. Run again with `BUFFER_POOL=false` to compare with allocations without `FloatBufferPool`.
+ */
+struct BenchmarkReplayCommand: AsyncCommand {
+    var help: String { "Replay a JSONL request log in-process and report latency percentiles as JSON" }
+
+    struct Signature: CommandSignature {
+        @Argument(name: "file", help: "JSONL request log. Each line requires a `url` attribute")
+        var file: String
+
+        @Option(name: "concurrency", short: "c", help: "Number of concurrent workers in closed-loop mode. Default 8")
+        var concurrency: Int?
+
+        @Option(name: "arrival", help: "Arrival model `closed` or `open`. Default closed")
+        var arrival: String?
+
+        @Option(name: "rate", help: "Requests per second in open-loop mode. Default 100")
+        var rate: Double?
+
+        @Option(name: "requests", short: "n", help: "Total number of requests. The log is repeated if required. Default: number of lines in the log")
+        var requests: Int?
+
+        @Option(name: "warmup", help: "Number of requests to execute before measuring. Default 0")
+        var warmup: Int?
+
+        @Option(name: "output", short: "o", help: "Write the JSON report to a file instead of stdout")
+        var output: String?
+    }
+
+    enum ArrivalModel: String {
+        case closed
+        case open
+    }
+
+    struct Entry: Decodable {
+        let url: String
+        let method: String?
+        let body: String?
+    }
+
+    /// Result of a single replayed request
+    struct Sample {
+        let latencyNanoseconds: Int
+        let status: UInt
+        let bytes: Int
+    }
+
+    struct Report: Encodable {
+        let arrival: String
+        let concurrency: Int?
+        let target_rate: Double?
+        let requests: Int
+        let skipped_lines: Int
+        let errors: Int
+        let status_codes: [String: Int]
+        let duration_seconds: Double
+        let requests_per_second: Double
+        let bytes_per_second: Double
+        let latency_ms: Latency
+        let heap_allocated_bytes_delta: Int
+        let heap_mapped_bytes: Int
+        let block_cache_hits: Int
+        let block_cache_misses: Int
+        let block_cache_hit_rate: Double?
+        /// Float arrays allocated per request while streaming. Compare with `BUFFER_POOL=false`
+        let float_buffer_allocations_per_request: Double
+        let float_buffer_reuses_per_request: Double
+        let resident_bytes_before: Int?
+        let resident_bytes_after: Int?
+    }
+
+    struct Latency: Encodable {
+        let mean: Double
+        let min: Double
+        let p50: Double
+        let p90: Double
+        let p99: Double
+        let p999: Double
+        let max: Double
+    }
+
+    func run(using context: CommandContext, signature: Signature) async throws {
+        let logger = context.application.logger
+        guard let arrival = ArrivalModel(rawValue: signature.arrival ?? "closed") else {
+            throw BenchmarkReplayError.invalidArrivalModel(signature.arrival ?? "")
+        }
+        let (entries, skipped) = try Self.readLog(file: signature.file)
+        guard !entries.isEmpty else {
+            throw BenchmarkReplayError.emptyRequestLog(signature.file)
+        }
+        let count = signature.requests ?? entries.count
+        let concurrency = max(1, signature.concurrency ?? 8)
+        let rate = signature.rate ?? 100
+        let app = context.application
+        logger.info("Replaying \(count) requests from \(entries.count) log entries (\(skipped) skipped), arrival model \(arrival)")
+
+        if let warmup = signature.warmup, warmup > 0 {
+            _ = try await Self.closedLoop(app: app, entries: entries, count: warmup, concurrency: concurrency)
+        }
+
+        var mallocBefore = chelper_malloc_stats()
+        chelper_get_malloc_stats(&mallocBefore)
+        let hitsBefore = RequestMetrics.total(.block_cache_hit)
+        let missesBefore = RequestMetrics.total(.block_cache_miss)
+        let allocationsBefore = RequestMetrics.total(.float_buffer_allocations)
+        let reusesBefore = RequestMetrics.total(.float_buffer_reuses)
+        let residentBefore = Self.residentBytes()
+
+        let start = DispatchTime.now()
+        let samples: [Sample]
+        switch arrival {
+        case .closed:
+            samples = try await Self.closedLoop(app: app, entries: entries, count: count, concurrency: concurrency)
+        case .open:
+            samples = try await Self.openLoop(app: app, entries: entries, count: count, rate: rate)
+        }
+        let duration = Double(DispatchTime.now().uptimeNanoseconds - start.uptimeNanoseconds) / 1_000_000_000
+
+        var mallocAfter = chelper_malloc_stats()
+        chelper_get_malloc_stats(&mallocAfter)
+        let hits = RequestMetrics.total(.block_cache_hit) - hitsBefore
+        let misses = RequestMetrics.total(.block_cache_miss) - missesBefore
+        let allocations = RequestMetrics.total(.float_buffer_allocations) - allocationsBefore
+        let reuses = RequestMetrics.total(.float_buffer_reuses) - reusesBefore
+
+        var statusCodes = [String: Int]()
+        for sample in samples {
+            statusCodes["\(sample.status)", default: 0] += 1
+        }
+        let report = Report(
+            arrival: arrival.rawValue,
+            concurrency: arrival == .closed ? concurrency : nil,
+            target_rate: arrival == .open ? rate : nil,
+            requests: samples.count,
+            skipped_lines: skipped,
+            errors: samples.filter { $0.status >= 400 }.count,
+            status_codes: statusCodes,
+            duration_seconds: duration,
+            requests_per_second: Double(samples.count) / duration,
+            bytes_per_second: Double(samples.reduce(0, { $0 + $1.bytes })) / duration,
+            latency_ms: Self.latency(samples),
+            heap_allocated_bytes_delta: mallocAfter.uordblks - mallocBefore.uordblks,
+            heap_mapped_bytes: mallocAfter.hblkhd,
+            block_cache_hits: hits,
+            block_cache_misses: misses,
+            block_cache_hit_rate: hits + misses > 0 ? Double(hits) / Double(hits + misses) : nil,
+            float_buffer_allocations_per_request: Double(allocations) / Double(max(1, samples.count)),
+            float_buffer_reuses_per_request: Double(reuses) / Double(max(1, samples.count)),
+            resident_bytes_before: residentBefore,
+            resident_bytes_after: Self.residentBytes()
+        )
+        let encoder = JSONEncoder()
+        encoder.outputFormatting = [.prettyPrinted, .sortedKeys]
+        let json = try encoder.encode(report)
+        if let output = signature.output {
+            try json.write(to: URL(fileURLWithPath: output))
+            logger.info("Report written to \(output)")
+        } else {
+            print(String(decoding: json, as: UTF8.self))
+        }
+    }
+
+    /// Resident set size of this process from `/proc/self/statm`. Nil on other platforms
+    static func residentBytes() -> Int? {
+        guard let statm = try? String(contentsOfFile: "/proc/self/statm", encoding: .utf8) else {
+            return nil
+        }
+        let fields = statm.split(separator: " ")
+        guard fields.count > 1, let pages = Int(fields[1]) else {
+            return nil
+        }
+        return pages * Int(getpagesize())
+    }
+
+    /// Read all valid entries from a JSONL file. Returns the number of skipped lines as well
+    static func readLog(file: String) throws -> (entries: [Entry], skipped: Int) {
+        let decoder = JSONDecoder()
+        var entries = [Entry]()
+        var skipped = 0
+        for line in try String(contentsOfFile: file, encoding: .utf8).split(whereSeparator: \.isNewline) {
+            guard let entry = try? decoder.decode(Entry.self, from: Data(line.utf8)) else {
+                skipped += 1
+                continue
+            }
+            entries.append(entry)
+        }
+        return (entries, skipped)
+    }
+
+    /// Each worker starts the next request after the previous one completed
+    static func closedLoop(app: Application, entries: [Entry], count: Int, concurrency: Int) async throws -> [Sample] {
+        let next = NIOLockedValueBox<Int>(0)
+        return try await withThrowingTaskGroup(of: [Sample].self) { group in
+            for _ in 0..<min(concurrency, count) {
+                group.addTask {
+                    var samples = [Sample]()
+                    while true {
+                        let i = next.withLockedValue {
+                            defer { $0 += 1 }
+                            return $0
+                        }
+                        guard i < count else {
+                            return samples
+                        }
+                        let start = DispatchTime.now().uptimeNanoseconds
+                        samples.append(try await replay(app: app, entry: entries[i % entries.count], scheduledStart: start))
+                    }
+                }
+            }
+            return try await group.reduce(into: [Sample](), { $0.append(contentsOf: $1) })
+        }
+    }
+
+    /// Start requests at a fixed rate independent of completion
+    static func openLoop(app: Application, entries: [Entry], count: Int, rate: Double) async throws -> [Sample] {
+        let intervalNanoseconds = 1_000_000_000 / rate
+        let start = DispatchTime.now().uptimeNanoseconds
+        return try await withThrowingTaskGroup(of: Sample.self) { group in
+            for i in 0..<count {
+                let scheduledStart = start + UInt64(Double(i) * intervalNanoseconds)
+                let now = DispatchTime.now().uptimeNanoseconds
+                if scheduledStart > now {
+                    try await Task.sleep(nanoseconds: scheduledStart - now)
+                }
+                group.addTask {
+                    try await replay(app: app, entry: entries[i % entries.count], scheduledStart: scheduledStart)
+                }
+            }
+            return try await group.reduce(into: [Sample](), { $0.append($1) })
+        }
+    }
+
+    /// Execute one request through the application responder and wait until the entire body is received
+    static func replay(app: Application, entry: Entry, scheduledStart: UInt64) async throws -> Sample {
+        let eventLoop = app.eventLoopGroup.next()
+        let uri = URI(string: entry.url)
+        let path = uri.query.map { "\(uri.path)?\($0)" } ?? uri.path
+        let request = Request(
+            application: app,
+            method: HTTPMethod(rawValue: entry.method ?? "GET"),
+            url: URI(string: path),
+            headers: ["host": "localhost"],
+            collectedBody: entry.body.map { ByteBuffer(string: $0) },
+            on: eventLoop
+        )
+        /// Sample every replayed request to count block cache hits
+        let response = try await RequestMetrics.$isSampled.withValue(true) {
+            try await app.responder.current.respond(to: request).get()
+        }
+        let body = try await response.body.collect(on: eventLoop).get()
+        let latency = Int(DispatchTime.now().uptimeNanoseconds - scheduledStart)
+        return Sample(latencyNanoseconds: latency, status: response.status.code, bytes: body?.readableBytes ?? 0)
+    }
+
+    /// Latency statistics in milliseconds
+    static func latency(_ samples: [Sample]) -> Latency {
+        let sorted = samples.map { Double($0.latencyNanoseconds) / 1_000_000 }.sorted()
+        guard !sorted.isEmpty else {
+            return Latency(mean: 0, min: 0, p50: 0, p90: 0, p99: 0, p999: 0, max: 0)
+        }
+        func percentile(_ p: Double) -> Double {
+            return sorted[min(sorted.count - 1, Int((Double(sorted.count) * p).rounded(.up)) - 1)]
+        }
+        return Latency(
+            mean: sorted.reduce(0, +) / Double(sorted.count),
+            min: sorted[0],
+            p50: percentile(0.5),
+            p90: percentile(0.9),
+            p99: percentile(0.99),
+            p999: percentile(0.999),
+            max: sorted[sorted.count - 1]
+        )
+    }
+}
+
+enum BenchmarkReplayError: Error {
+    case invalidArrivalModel(String)
+    case emptyRequestLog(String)
+}
@@ -29,6 +29,12 @@ struct MergeYearlyCommand: AsyncCommand {
         
         @Flag(name: "allow-missing", help: "Allow partial years (missing chunks)")
         var allowMissing: Bool
+
+        @Option(name: "daily-aggregates", help: "Also write UTC daily aggregates from yearly files. Coma separated list of max,min,mean,sum")
+        var dailyAggregates: String?
+
+        @Option(name: "concurrency", short: "c", help: "Number of parallel workers reading chunk files. Default: number of cores")
+        var concurrency: Int?
     }
 
     func run(using context: CommandContext, signature: Signature) async throws {
@@ -38,12 +44,17 @@ struct MergeYearlyCommand: AsyncCommand {
         guard let domain = registry.getDomain() else {
             fatalError("Did not get domain object")
         }
+        let dailyAggregates = try signature.dailyAggregates.map(DailyAggregationPrecomputed.load) ?? []
 
-        let variables: [String] = try signature.variables.map({ $0.split(separator: ",").map(String.init) }) ?? FileManager.default.contentsOfDirectory(atPath: registry.directory).filter { !$0.contains(".") && $0 != "static" }
+        /// Daily aggregates are stored in directories like `temperature_2m_daily_max` and are not merged again
+        let variables: [String] = try signature.variables.map({ $0.split(separator: ",").map(String.init) }) ?? FileManager.default.contentsOfDirectory(atPath: registry.directory).filter { !$0.contains(".") && $0 != "static" && !$0.contains("_daily_") }
 
         for year in years {
             for variable in variables {
-                try await Self.generateYearlyFile(logger: logger, domain: domain, year: year, variable: variable, force: signature.force, allowMissing: signature.allowMissing)
+                try await Self.generateYearlyFile(logger: logger, domain: domain, year: year, variable: variable, force: signature.force, allowMissing: signature.allowMissing, concurrency: signature.concurrency ?? System.coreCount)
+                if !dailyAggregates.isEmpty {
+                    try await Self.generateDailyAggregateFiles(logger: logger, domain: domain, year: year, variable: variable, aggregations: dailyAggregates, force: signature.force)
+                }
             }
         }
 
@@ -66,7 +77,10 @@ struct MergeYearlyCommand: AsyncCommand {
     }
 
     /// Generate a yearly file for a specified domain, variable and year
-    static func generateYearlyFile(logger: Logger, domain: GenericDomain, year: Int, variable: String, force: Bool, allowMissing: Bool) async throws {
+    ///
+    /// The output is split into tiles of one row, a multiple of 6 columns and the entire year. Tiles are read from all chunk files in parallel by `concurrency` workers into reusable arenas.
+    /// Tiles are handed to the single file writer in order while the next batch is being read. Afterwards the file is verified with the same parallel reader.
+    static func generateYearlyFile(logger: Logger, domain: GenericDomain, year: Int, variable: String, force: Bool, allowMissing: Bool, concurrency: Int = 1) async throws {
         let registry = domain.domainRegistry
         logger.info("Processing variable \(variable) for year \(year)")
         let yearlyFilePath = "\(registry.directory)\(variable)/year_\(year).om"
@@ -86,7 +100,7 @@ struct MergeYearlyCommand: AsyncCommand {
         let nt = UInt64(yearTime.count)
         let indexTime = yearTime.toIndexTime()
         let chunkRange = indexTime.divideRoundedUp(divisor: omFileLength)
-        let chunkFiles = try await chunkRange.asyncCompactMap { chunkIndex -> (file: OmFileReaderArray<MmapFile, Float>, indexTime: Range<Int>)? in
+        let chunkFiles = try await chunkRange.asyncCompactMap { chunkIndex -> YearlyMergeSource? in
             let file = "\(registry.directory)/\(variable)/chunk_\(chunkIndex).om"
             guard fileManager.fileExists(atPath: file) else {
                 logger.info("Chunk file \(variable)/chunk_\(chunkIndex).om does not exist. Skipping.")
@@ -95,8 +109,11 @@ struct MergeYearlyCommand: AsyncCommand {
             guard let reader = try await OmFileReader(mmapFile: file).asArray(of: Float.self) else {
                 return nil
             }
-            let indexTime = chunkIndex * omFileLength ..< (chunkIndex + 1) * omFileLength
-            return (reader, indexTime)
+            let chunkTime = chunkIndex * omFileLength ..< (chunkIndex + 1) * omFileLength
+            guard let offsets = indexTime.intersect(fileTime: chunkTime) else {
+                return nil
+            }
+            return YearlyMergeSource(file: reader, offsets: offsets)
         }
         guard allowMissing || chunkFiles.count == chunkRange.count else {
             throw MergeYearlyError.notAllChunksAvailable
@@ -117,117 +134,241 @@ struct MergeYearlyCommand: AsyncCommand {
             add_offset: chunkFiles.last!.file.addOffset
         )
 
+        let tiles = YearlyMergeTile.tiles(ny: ny, nx: nx, nt: nt, xMultiple: chunksOut[1])
+        let workers = max(1, concurrency)
+        let start = DispatchTime.now()
         let progress = TransferAmountTracker(logger: logger, totalSize: 4 * Int(dimensionsOut.reduce(1, *)), name: "Convert")
-        for yStart in stride(from: 0, to: ny, by: UInt64.Stride(chunksOut[0])) {
-            for xStart in stride(from: 0, to: nx, by: UInt64.Stride(chunksOut[1])) {
-                for tStart in stride(from: 0, to: nt, by: UInt64.Stride(chunksOut[2])) {
-                    let yRange = yStart ..< min(yStart + chunksOut[0], ny)
-                    let xRange = xStart ..< min(xStart + chunksOut[1], nx)
-                    let tRange = tStart ..< min(tStart + chunksOut[2], nt)
-                    let chunkIndexTime = Int(tRange.lowerBound) + indexTime.lowerBound ..< Int(tRange.upperBound) + indexTime.lowerBound
-
-                    var data = [Float](repeating: .nan, count: yRange.count * xRange.count * tRange.count)
-                    // print("chunk y=\(yRange) x=\(xRange) t=\(tRange)")
-                    for chunk in chunkFiles {
-                        guard let offsets = chunkIndexTime.intersect(fileTime: chunk.indexTime) else {
-                            continue
-                        }
-                        switch chunk.file.getDimensions().count {
-                        case 2:
-                            // legacy 2D case
-                            for (row, y) in yRange.enumerated() {
-                                try await chunk.file.read(
-                                    into: &data,
-                                    range: [y * nx + xRange.startIndex ..< y * nx + xRange.endIndex, offsets.file.toUInt64()],
-                                    intoCubeOffset: [UInt64(row * xRange.count), UInt64(offsets.array.lowerBound)],
-                                    intoCubeDimension: [UInt64(yRange.count * xRange.count), UInt64(tRange.count)]
-                                )
-                            }
-                        case 3:
-                            try await chunk.file.read(
-                                into: &data,
-                                range: [yRange, xRange, offsets.file.toUInt64()],
-                                intoCubeOffset: [0, 0, UInt64(offsets.array.lowerBound)],
-                                intoCubeDimension: [UInt64(yRange.count), UInt64(xRange.count), UInt64(tRange.count)]
-                            )
-                        default:
-                            throw MergeYearlyError.unexpectedDimensionsCount
-                        }
-                    }
-                    try writer.writeData(
-                        array: data,
-                        arrayDimensions: [UInt64(yRange.count), UInt64(xRange.count), UInt64(tRange.count)],
-                        arrayOffset: nil,
-                        arrayCount: nil
-                    )
-                    progress.add(data.count * 4)
-                }
-            }
+        try await YearlyMergeTile.readOrdered(tiles: tiles, sources: chunkFiles, nx: nx, concurrency: workers) { tile, arena in
+            /// Arenas may be wider than the last tile in a row
+            try writer.writeData(
+                array: arena.data,
+                arrayDimensions: [1, UInt64(arena.data.count) / nt, nt],
+                arrayOffset: [0, 0, 0],
+                arrayCount: [1, UInt64(tile.x.count), nt]
+            )
+            progress.add(tile.count * 4)
         }
         progress.finish()
-        let variable = try fileWriter.write(
+        let variableOut = try fileWriter.write(
             array: try writer.finalise(),
             name: "",
             children: []
         )
-        try fileWriter.writeTrailer(rootVariable: variable)
+        try fileWriter.writeTrailer(rootVariable: variableOut)
         try writeFn.close()
+        let seconds = Double(DispatchTime.now().uptimeNanoseconds - start.uptimeNanoseconds) / 1_000_000_000
+        let megabytes = Double(4 * dimensionsOut.reduce(1, *)) / 1024 / 1024
+        logger.info("Merged \(variable) \(year) with \(workers) workers in \(start.timeElapsedPretty()) (\(Int(megabytes / seconds)) MB/s)")
 
         /// Read data again to ensure the written data matches exactly
         guard let verify = try await OmFileReader(mmapFile: temporary).asArray(of: Float.self) else {
             throw MergeYearlyError.couldNotReadData
         }
         let progressVerify = TransferAmountTracker(logger: logger, totalSize: 4 * Int(dimensionsOut.reduce(1, *)), name: "Verify")
-        for yStart in stride(from: 0, to: ny, by: UInt64.Stride(chunksOut[0])) {
-            for xStart in stride(from: 0, to: nx, by: UInt64.Stride(chunksOut[1])) {
-                for tStart in stride(from: 0, to: nt, by: UInt64.Stride(chunksOut[2])) {
-                    let yRange = yStart ..< min(yStart + chunksOut[0], ny)
-                    let xRange = xStart ..< min(xStart + chunksOut[1], nx)
-                    let tRange = tStart ..< min(tStart + chunksOut[2], nt)
-                    let chunkIndexTime = Int(tRange.lowerBound) + indexTime.lowerBound ..< Int(tRange.upperBound) + indexTime.lowerBound
+        try await YearlyMergeTile.readOrdered(tiles: tiles, sources: chunkFiles, nx: nx, concurrency: workers) { tile, arena in
+            let verifyData = try await verify.read(range: [tile.y, tile.x, 0..<nt])
+            guard Array(arena.data[0..<tile.count]).isSimilar(verifyData) else {
+                logger.error("Data does not match \(tile.y) \(tile.x)")
+                throw MergeYearlyError.validationFailed
+            }
+            progressVerify.add(tile.count * 4)
+        }
+        progressVerify.finish()
+        try FileManager.default.moveFileOverwrite(from: temporary, to: yearlyFilePath)
+    }
+}
 
-                    var data = [Float](repeating: .nan, count: yRange.count * xRange.count * tRange.count)
-                    for chunk in chunkFiles {
-                        guard let offsets = chunkIndexTime.intersect(fileTime: chunk.indexTime) else {
-                            continue
-                        }
-                        switch chunk.file.getDimensions().count {
-                        case 2:
-                            // legacy 2D case
-                            for (row, y) in yRange.enumerated() {
-                                try await chunk.file.read(
-                                    into: &data,
-                                    range: [y * nx + xRange.startIndex ..< y * nx + xRange.endIndex, offsets.file.toUInt64()],
-                                    intoCubeOffset: [UInt64(row * xRange.count), UInt64(offsets.array.lowerBound)],
-                                    intoCubeDimension: [UInt64(yRange.count * xRange.count), UInt64(tRange.count)]
-                                )
-                            }
-                        case 3:
-                            try await chunk.file.read(
-                                into: &data,
-                                range: [yRange, xRange, offsets.file.toUInt64()],
-                                intoCubeOffset: [0, 0, UInt64(offsets.array.lowerBound)],
-                                intoCubeDimension: [UInt64(yRange.count), UInt64(xRange.count), UInt64(tRange.count)]
-                            )
-                        default:
-                            throw MergeYearlyError.unexpectedDimensionsCount
+extension MergeYearlyCommand {
+    /// Aggregate UTC days from a yearly file and store each aggregation as a yearly file with daily resolution. E.g. `temperature_2m_daily_max/year_2020.om`
+    /// Only aggregations requested by daily API variables are written. Max and min are values of the hourly series and keep its compression.
+    /// Means and sums are stored lossless, so the API returns the same values as aggregating hourly data.
+    static func generateDailyAggregateFiles(logger: Logger, domain: GenericDomain, year: Int, variable: String, aggregations: [DailyAggregationPrecomputed], force: Bool) async throws {
+        guard domain.dtSeconds == 3600 else {
+            throw MergeYearlyError.dailyAggregatesRequireHourlyData
+        }
+        let registry = domain.domainRegistry
+        let served = DailyAggregationPrecomputed.served(variable: variable)
+        let aggregations = aggregations.filter {
+            served.contains($0) && (force || !FileManager.default.fileExists(atPath: "\(registry.directory)\($0.omFileName(variable))/year_\(year).om"))
+        }
+        if aggregations.isEmpty {
+            logger.info("Daily aggregates for \(variable) and year \(year) already exist or are not used by the API. Skipping.")
+            return
+        }
+        logger.info("Generating daily aggregates \(aggregations.map(\.rawValue)) for variable \(variable) for year \(year)")
+        let yearlyFilePath = "\(registry.directory)\(variable)/year_\(year).om"
+        guard let reader = try await OmFileReader(mmapFile: yearlyFilePath).asArray(of: Float.self) else {
+            throw MergeYearlyError.couldNotReadData
+        }
+        let dimensions = reader.getDimensions()
+        guard dimensions.count == 3 else {
+            throw MergeYearlyError.unexpectedDimensionsCount
+        }
+        let ny = dimensions[0]
+        let nx = dimensions[1]
+        let nDays = dimensions[2] / 24
+
+        struct DailyWriter {
+            let aggregation: DailyAggregationPrecomputed
+            let path: String
+            let writeFn: FileHandle
+            let fileWriter: OmFileWriter<FileHandle>
+            let writer: OmFileWriterArray<Float, FileHandle>
+        }
+        let writers = try aggregations.map { aggregation -> DailyWriter in
+            let directory = "\(registry.directory)\(aggregation.omFileName(variable))"
+            try FileManager.default.createDirectory(atPath: directory, withIntermediateDirectories: true)
+            let path = "\(directory)/year_\(year).om"
+            let writeFn = try FileHandle.createNewFile(file: "\(path)~")
+            let fileWriter = OmFileWriter(fn: writeFn, initialCapacity: 1024 * 1024 * 10)
+            let writer = try fileWriter.prepareArray(
+                type: Float.self,
+                dimensions: [ny, nx, nDays],
+                chunkDimensions: [1, 6, nDays],
+                compression: aggregation.commutesWithScaling ? reader.compression : .fpx_xor2d,
+                scale_factor: aggregation.commutesWithScaling ? reader.scaleFactor : 1,
+                add_offset: aggregation.commutesWithScaling ? reader.addOffset : 0
+            )
+            return DailyWriter(aggregation: aggregation, path: path, writeFn: writeFn, fileWriter: fileWriter, writer: writer)
+        }
+
+        /// Process 36 locations at once. Multiple of the output chunk size of 6
+        let processX: UInt64 = 36
+        var daily = [Float](repeating: .nan, count: Int(processX * nDays))
+        let progress = TransferAmountTracker(logger: logger, totalSize: 4 * Int(ny * nx * nDays * 24), name: "Daily aggregates")
+        for y in 0..<ny {
+            for xStart in stride(from: 0, to: nx, by: UInt64.Stride(processX)) {
+                let xRange = xStart ..< min(xStart + processX, nx)
+                let hourly = try await reader.read(range: [y ..< y + 1, xRange, 0 ..< nDays * 24])
+                for writer in writers {
+                    for l in 0 ..< xRange.count {
+                        for d in 0 ..< Int(nDays) {
+                            let start = l * Int(nDays) * 24 + d * 24
+                            daily[l * Int(nDays) + d] = writer.aggregation.aggregate(hourly[start ..< start + 24])
                         }
                     }
-                    let verifyData = try await verify.read(range: [yRange, xRange, tRange])
-                    guard data.isSimilar(verifyData) else {
-                        logger.error("Data does not match \(yRange) \(xRange) \(tRange)")
-                        throw MergeYearlyError.validationFailed
+                    try writer.writer.writeData(
+                        array: Array(daily[0 ..< xRange.count * Int(nDays)]),
+                        arrayDimensions: [1, UInt64(xRange.count), nDays]
+                    )
+                }
+                progress.add(hourly.count * 4)
+            }
+        }
+        progress.finish()
+        for writer in writers {
+            let root = try writer.fileWriter.write(array: try writer.writer.finalise(), name: "", children: [])
+            try writer.fileWriter.writeTrailer(rootVariable: root)
+            try writer.writeFn.close()
+            try FileManager.default.moveFileOverwrite(from: "\(writer.path)~", to: writer.path)
+        }
+    }
+}
+
+/// Chunk file and its time offsets relative to the yearly file
+struct YearlyMergeSource: Sendable {
+    let file: OmFileReaderArray<MmapFile, Float>
+    let offsets: (file: CountableRange<Int>, array: CountableRange<Int>)
+}
+
+/// Reusable buffer for one tile. Only accessed by one task at a time
+final class YearlyMergeArena: @unchecked Sendable {
+    var data: [Float]
+
+    init(count: Int) {
+        data = [Float](repeating: .nan, count: count)
+    }
+}
+
+/// Part of a yearly file that is processed at once: One row, a range of columns and the entire year
+struct YearlyMergeTile: Sendable {
+    let y: Range<UInt64>
+    let x: Range<UInt64>
+    let nt: UInt64
+
+    var count: Int {
+        return x.count * Int(nt)
+    }
+
+    /// Split the grid into tiles of around 8 MB. The x width is a multiple of the output chunk size, so tiles cover entire chunks and are written in file order
+    static func tiles(ny: UInt64, nx: UInt64, nt: UInt64, xMultiple: UInt64) -> [YearlyMergeTile] {
+        let width = min(nx, max(xMultiple, 2 * 1024 * 1024 / nt / xMultiple * xMultiple))
+        return (0..<ny).flatMap { y in
+            stride(from: 0, to: nx, by: Int(width)).map { x in
+                YearlyMergeTile(y: y ..< y + 1, x: x ..< min(x + width, nx), nt: nt)
+            }
+        }
+    }
+
+    /// Read this tile from all chunk files. Arena layout is `[arenaNx, nt]` and only the first `x.count` columns are used
+    func read(sources: [YearlyMergeSource], nx: UInt64, arenaNx: UInt64, into arena: YearlyMergeArena) async throws {
+        for i in arena.data.indices {
+            arena.data[i] = .nan
+        }
+        for source in sources {
+            switch source.file.getDimensions().count {
+            case 2:
+                // legacy 2D case
+                let start = y.lowerBound * nx + x.lowerBound
+                try await source.file.read(
+                    into: &arena.data,
+                    range: [start ..< start + UInt64(x.count), source.offsets.file.toUInt64()],
+                    intoCubeOffset: [0, UInt64(source.offsets.array.lowerBound)],
+                    intoCubeDimension: [arenaNx, nt]
+                )
+            case 3:
+                try await source.file.read(
+                    into: &arena.data,
+                    range: [y, x, source.offsets.file.toUInt64()],
+                    intoCubeOffset: [0, 0, UInt64(source.offsets.array.lowerBound)],
+                    intoCubeDimension: [1, arenaNx, nt]
+                )
+            default:
+                throw MergeYearlyError.unexpectedDimensionsCount
+            }
+        }
+    }
+
+    /**
+     Read all tiles with `concurrency` parallel workers and call `consume` for each tile in order.
+     Two sets of arenas are used alternately: While one batch is consumed, the next batch is read.
+     */
+    static func readOrdered(tiles: [YearlyMergeTile], sources: [YearlyMergeSource], nx: UInt64, concurrency: Int, consume: (YearlyMergeTile, YearlyMergeArena) async throws -> Void) async throws {
+        guard let nt = tiles.first?.nt else {
+            return
+        }
+        let arenaNx = UInt64(tiles.map { $0.x.count }.max() ?? 0)
+        let arenaSets = (0..<2).map { _ in (0..<concurrency).map { _ in YearlyMergeArena(count: Int(arenaNx * nt)) } }
+        var previous: (tiles: ArraySlice<YearlyMergeTile>, arenas: [YearlyMergeArena])?
+        for (batchIndex, batchStart) in stride(from: 0, to: tiles.count, by: concurrency).enumerated() {
+            let batch = tiles[batchStart ..< min(batchStart + concurrency, tiles.count)]
+            let arenas = arenaSets[batchIndex % 2]
+            async let reading: Void = withThrowingTaskGroup(of: Void.self) { group in
+                for (tile, arena) in zip(batch, arenas) {
+                    group.addTask {
+                        try await tile.read(sources: sources, nx: nx, arenaNx: arenaNx, into: arena)
                     }
-                    progressVerify.add(data.count * 4)
+                }
+                try await group.waitForAll()
+            }
+            if let previous {
+                for (tile, arena) in zip(previous.tiles, previous.arenas) {
+                    try await consume(tile, arena)
                 }
             }
+            try await reading
+            previous = (batch, arenas)
+        }
+        if let previous {
+            for (tile, arena) in zip(previous.tiles, previous.arenas) {
+                try await consume(tile, arena)
+            }
         }
-        progressVerify.finish()
-        try FileManager.default.moveFileOverwrite(from: temporary, to: yearlyFilePath)
     }
 }
 
 enum MergeYearlyError: Error {
+    case dailyAggregatesRequireHourlyData
     case notAllChunksAvailable
     case unexpectedDimensionsCount
     case validationFailed
@@ -0,0 +1,290 @@
+import Foundation
+import OmFileFormat
+import Vapor
+
+/**
+ Generate a synthetic dataset for an existing domain to run readers, API benchmarks and sync tests without downloading data.
+
+ Files are written to `DATA_DIRECTORY` with the same layout as downloaders generate them:
+ - static `HSURF.om` elevation with sea grid cells set to `-999` (this is also the land-sea mask used by readers) and `soil_type.om`
+ - time-series chunk files via `OmFileSplitter`. Ensemble members are stored as 4D chunk files
+ - yearly files for fully covered years with `--yearly`, using the same code as `merge-yearly`
+ - a master file if the domain defines a `masterTimeRange`
+ - `meta.json` with the end of the generated time range
+
+ Values follow `mean + diurnal + seasonal + lapse rate + noise`, are deterministic for a given seed and clamped to `--min` and `--max`.
+
+ Example:
+ `DATA_DIRECTORY=/tmp/synthetic/ openmeteo-api generate-synthetic era5 temperature_2m,precipitation --start 2022-01-01 --end 2023-12-31 --yearly`
+ */
+struct SyntheticDataCommand: AsyncCommand {
+    var help: String {
+        return "Generate a synthetic dataset for performance testing"
+    }
+
+    struct Signature: CommandSignature {
+        @Argument(name: "domain", help: "Domain to generate data for. E.g. 'era5'")
+        var domain: String
+
+        @Argument(name: "variables", help: "Variables separated by comma. E.g. 'temperature_2m,relative_humidity_2m'")
+        var variables: String
+
+        @Option(name: "start", help: "Start date in ISO format. Default 7 days ago")
+        var startDate: String?
+
+        @Option(name: "end", help: "End date in ISO format (inclusive). Default in 7 days")
+        var endDate: String?
+
+        @Option(name: "members", help: "Number of ensemble members. Default 1")
+        var members: Int?
+
+        @Option(name: "bounding-box", help: "Only fill grid cells within 'lat_min,lon_min,lat_max,lon_max'. Other cells are NaN. Reduces file size for large grids")
+        var boundingBox: String?
+
+        @Option(name: "mean", help: "Mean value. Default 10")
+        var mean: Float?
+
+        @Option(name: "diurnal-amplitude", help: "Amplitude of the daily cycle. Default 5")
+        var diurnalAmplitude: Float?
+
+        @Option(name: "seasonal-amplitude", help: "Amplitude of the annual cycle. Inverted on the southern hemisphere. Default 10")
+        var seasonalAmplitude: Float?
+
+        @Option(name: "lapse-rate", help: "Change per metre elevation. Default -0.0065")
+        var lapseRate: Float?
+
+        @Option(name: "noise", help: "Amplitude of uniform random noise. Default 1")
+        var noise: Float?
+
+        @Option(name: "min", help: "Clamp values to this minimum. E.g. 0 for precipitation")
+        var min: Float?
+
+        @Option(name: "max", help: "Clamp values to this maximum")
+        var max: Float?
+
+        @Option(name: "scalefactor", help: "Scalefactor for compression. Default 20")
+        var scalefactor: Float?
+
+        @Option(name: "seed", help: "Random seed. Default 0")
+        var seed: Int?
+
+        @Flag(name: "yearly", help: "Merge fully covered years into yearly files")
+        var yearly: Bool
+
+        @Flag(name: "force", help: "Overwrite existing static files")
+        var force: Bool
+    }
+
+    func run(using context: CommandContext, signature: Signature) async throws {
+        let logger = context.application.logger
+        let registry = try DomainRegistry.load(rawValue: signature.domain)
+        guard let domain = registry.getDomain() else {
+            fatalError("Did not get domain object")
+        }
+        let grid = domain.grid
+        let dtSeconds = domain.dtSeconds
+        let nMembers = max(1, signature.members ?? 1)
+        if signature.yearly && nMembers > 1 {
+            throw SyntheticDataError.yearlyFilesRequireSingleMember
+        }
+        let start = try signature.startDate.map { try IsoDate(fromIsoString: $0).toTimestamp() } ?? Timestamp.now().with(hour: 0).add(days: -7)
+        let end = try signature.endDate.map { try IsoDate(fromIsoString: $0).toTimestamp().add(days: 1) } ?? Timestamp.now().with(hour: 0).add(days: 8)
+        guard start < end else {
+            throw SyntheticDataError.invalidTimeRange
+        }
+        let time = TimerangeDt(start: start, to: end, dtSeconds: dtSeconds)
+        let field = SyntheticField(
+            mean: signature.mean ?? 10,
+            diurnalAmplitude: signature.diurnalAmplitude ?? 5,
+            seasonalAmplitude: signature.seasonalAmplitude ?? 10,
+            lapseRate: signature.lapseRate ?? -0.0065,
+            noise: signature.noise ?? 1,
+            min: signature.min ?? -.infinity,
+            max: signature.max ?? .infinity,
+            seed: UInt64(signature.seed ?? 0)
+        )
+        let scalefactor = signature.scalefactor ?? 20
+
+        logger.info("Generating synthetic data for \(registry) grid \(grid.nx)x\(grid.ny), \(nMembers) members, \(time.prettyString())")
+        let mask = try signature.boundingBox.map { try Self.boundingBoxMask(grid: grid, boundingBox: $0) }
+        let elevation = SyntheticField.elevation(grid: grid)
+        try Self.writeStaticFiles(domain: domain, elevation: elevation, force: signature.force, logger: logger)
+
+        let coordinates = (0..<grid.count).map(grid.getCoordinates)
+        let om = OmFileSplitter(domain, nMembers: nMembers)
+        for variable in signature.variables.split(separator: ",").map(String.init) {
+            let progress = TransferAmountTracker(logger: logger, totalSize: grid.count * time.count * nMembers * MemoryLayout<Float>.size, name: "Generate \(variable)")
+            try await om.updateFromTimeOrientedStreaming3D(variable: variable, time: time, scalefactor: scalefactor, onlyGeneratePreviousDays: false) { yRange, xRange, memberRange in
+                var data = [Float](repeating: .nan, count: yRange.count * xRange.count * memberRange.count * time.count)
+                var i = 0
+                for y in yRange {
+                    for x in xRange {
+                        let location = Int(y) * grid.nx + Int(x)
+                        for member in memberRange {
+                            defer { i += 1 }
+                            if let mask, !mask[location] {
+                                continue
+                            }
+                            field.fill(&data[i * time.count ..< (i + 1) * time.count], location: location, coordinates: coordinates[location], elevation: elevation[location], member: Int(member), time: time)
+                        }
+                    }
+                }
+                progress.add(data.count * MemoryLayout<Float>.size)
+                return data[...]
+            }
+            progress.finish()
+
+            if let masterTimeRange = domain.masterTimeRange {
+                try Self.writeMasterFile(domain: domain, variable: variable, time: TimerangeDt(range: masterTimeRange, dtSeconds: dtSeconds), nMembers: nMembers, scalefactor: scalefactor, field: field, coordinates: coordinates, elevation: elevation, mask: mask)
+            }
+
+            if signature.yearly {
+                let firstYear = time.range.lowerBound.toComponents().year
+                let lastYear = time.range.upperBound.add(-1 * dtSeconds).toComponents().year
+                for year in firstYear...lastYear where Timestamp(year, 1, 1) >= time.range.lowerBound && Timestamp(year + 1, 1, 1) <= time.range.upperBound {
+                    try await MergeYearlyCommand.generateYearlyFile(logger: logger, domain: domain, year: year, variable: variable, force: true, allowMissing: false)
+                }
+            }
+        }
+        try ModelUpdateMetaJson.update(domain: domain, run: time.range.lowerBound, end: time.range.upperBound)
+        logger.info("Finished synthetic dataset in \(OpenMeteo.dataDirectory)")
+    }
+
+    /// Parse `lat_min,lon_min,lat_max,lon_max` and mark all grid cells inside
+    static func boundingBoxMask(grid: Gridable, boundingBox: String) throws -> [Bool] {
+        let parts = boundingBox.split(separator: ",").compactMap { Float($0) }
+        guard parts.count == 4 else {
+            throw SyntheticDataError.invalidBoundingBox(boundingBox)
+        }
+        var mask = [Bool](repeating: false, count: grid.count)
+        let bb = BoundingBoxWGS84(latitude: parts[0]..<parts[2], longitude: parts[1]..<parts[3])
+        guard let cells = grid.findBox(boundingBox: bb) else {
+            throw SyntheticDataError.invalidBoundingBox(boundingBox)
+        }
+        for cell in cells {
+            mask[cell] = true
+        }
+        return mask
+    }
+
+    /// Write elevation and soil type files. Existing files are kept unless `force` is set
+    static func writeStaticFiles(domain: GenericDomain, elevation: [Float], force: Bool, logger: Logger) throws {
+        let elevationFile = domain.surfaceElevationFileOm
+        if force || !elevationFile.exists() {
+            try elevationFile.createDirectory()
+            try FileManager.default.removeItemIfExists(at: elevationFile.getFilePath())
+            try elevation.writeOmFile2D(file: elevationFile.getFilePath(), grid: domain.grid)
+        }
+        let soilTypeFile = domain.soilTypeFileOm
+        if force || !soilTypeFile.exists() {
+            /// Soil types 1-9 in patches, sea is 0
+            let soilType = elevation.enumerated().map { (i, value) -> Float in
+                return value <= -999 ? 0 : Float(1 + ((i / 7) % 9))
+            }
+            try soilTypeFile.createDirectory()
+            try FileManager.default.removeItemIfExists(at: soilTypeFile.getFilePath())
+            try soilType.writeOmFile2D(file: soilTypeFile.getFilePath(), grid: domain.grid)
+        }
+        logger.info("Static files written")
+    }
+
+    /// Write one master file covering `time`. Chunks follow yearly files
+    static func writeMasterFile(domain: GenericDomain, variable: String, time: TimerangeDt, nMembers: Int, scalefactor: Float, field: SyntheticField, coordinates: [(latitude: Float, longitude: Float)], elevation: [Float], mask: [Bool]?) throws {
+        let grid = domain.grid
+        let file = OmFileManagerReadable.domainChunk(domain: domain.domainRegistry, variable: variable, type: .master, chunk: 0, ensembleMember: 0, previousDay: 0)
+        try file.createDirectory()
+        let temporary = "\(file.getFilePath())~"
+        try FileManager.default.removeItemIfExists(at: temporary)
+        let fn = try FileHandle.createNewFile(file: temporary)
+        let fileWriter = OmFileWriter(fn: fn, initialCapacity: 1024 * 1024)
+        let nt = UInt64(time.count)
+        let writer = try fileWriter.prepareArray(
+            type: Float.self,
+            dimensions: nMembers <= 1 ? [UInt64(grid.ny), UInt64(grid.nx), nt] : [UInt64(grid.ny), UInt64(grid.nx), UInt64(nMembers), nt],
+            chunkDimensions: nMembers <= 1 ? [1, 6, min(nt, 21 * 24)] : [1, 6, 1, min(nt, 21 * 24)],
+            compression: .pfor_delta2d_int16,
+            scale_factor: scalefactor,
+            add_offset: 0
+        )
+        /// One row at a time to keep memory low
+        var data = [Float](repeating: .nan, count: grid.nx * nMembers * time.count)
+        for y in 0..<grid.ny {
+            for x in 0..<grid.nx {
+                let location = y * grid.nx + x
+                for member in 0..<nMembers {
+                    let i = x * nMembers + member
+                    if let mask, !mask[location] {
+                        for j in i * time.count ..< (i + 1) * time.count {
+                            data[j] = .nan
+                        }
+                        continue
+                    }
+                    field.fill(&data[i * time.count ..< (i + 1) * time.count], location: location, coordinates: coordinates[location], elevation: elevation[location], member: member, time: time)
+                }
+            }
+            try writer.writeData(
+                array: data,
+                arrayDimensions: nMembers <= 1 ? [1, UInt64(grid.nx), nt] : [1, UInt64(grid.nx), UInt64(nMembers), nt]
+            )
+        }
+        let root = try fileWriter.write(array: try writer.finalise(), name: "", children: [])
+        try fileWriter.writeTrailer(rootVariable: root)
+        try fn.close()
+        try FileManager.default.moveFileOverwrite(from: temporary, to: file.getFilePath())
+    }
+}
+
+/// Deterministic synthetic time-series with daily and annual cycle
+struct SyntheticField: Sendable {
+    let mean: Float
+    let diurnalAmplitude: Float
+    let seasonalAmplitude: Float
+    let lapseRate: Float
+    let noise: Float
+    let min: Float
+    let max: Float
+    let seed: UInt64
+
+    /// Smooth terrain with mountains up to around 3500 m. Negative values are sea and set to `-999`
+    static func elevation(grid: Gridable) -> [Float] {
+        return (0..<grid.count).map { i -> Float in
+            let x = Float(i % grid.nx)
+            let y = Float(i / grid.nx)
+            let value = sin(x * 0.01) * 2000 + cos(y * 0.02) * 1500 + sin((x + y) * 0.1) * 100
+            return value < 0 ? -999 : value
+        }
+    }
+
+    /// Fill one time-series for a location and member
+    func fill(_ out: inout ArraySlice<Float>, location: Int, coordinates: (latitude: Float, longitude: Float), elevation: Float, member: Int, time: TimerangeDt) {
+        let hemisphere: Float = coordinates.latitude < 0 ? -1 : 1
+        let height = elevation <= -999 ? 0 : elevation
+        let base = mean + lapseRate * height
+        for (t, timestamp) in time.enumerated() {
+            let localHour = Float(timestamp.timeIntervalSince1970 % 86400) / 3600 + coordinates.longitude / 15
+            /// Minimum in the early morning, maximum in the afternoon
+            let diurnal = -cos((localHour - 3) / 24 * 2 * .pi) * diurnalAmplitude
+            /// Minimum in mid January on the northern hemisphere
+            let dayOfYear = Float(timestamp.timeIntervalSince1970 % (365 * 86400 + 6 * 3600)) / 86400
+            let seasonal = -cos((dayOfYear - 15) / 365.25 * 2 * .pi) * seasonalAmplitude * hemisphere
+            let random = Self.random(seed: seed, location: location, member: member, time: timestamp.timeIntervalSince1970) * noise
+            out[out.startIndex + t] = Swift.min(Swift.max(base + diurnal + seasonal + random, min), max)
+        }
+    }
+
+    /// Uniform random number in `-1...1` using splitmix64 on all inputs
+    @inline(__always)
+    static func random(seed: UInt64, location: Int, member: Int, time: Int) -> Float {
+        var z = seed &+ UInt64(bitPattern: Int64(location)) &* 0x9E3779B97F4A7C15 &+ UInt64(member) &* 0xBF58476D1CE4E5B9 &+ UInt64(bitPattern: Int64(time)) &* 0x94D049BB133111EB
+        z = (z ^ (z >> 30)) &* 0xBF58476D1CE4E5B9
+        z = (z ^ (z >> 27)) &* 0x94D049BB133111EB
+        z = z ^ (z >> 31)
+        return Float(z >> 40) / Float(1 << 23) - 1
+    }
+}
+
+enum SyntheticDataError: Error {
+    case invalidTimeRange
+    case invalidBoundingBox(String)
+    case yearlyFilesRequireSingleMember
+}
@@ -1381,7 +1381,7 @@ extension ForecastVariable {
 }
 
 /// Available daily aggregations
-enum ForecastVariableDaily: String, DailyVariableCalculatable, RawRepresentableString {
+enum ForecastVariableDaily: String, DailyVariableCalculatable, RawRepresentableString, CaseIterable {
     case apparent_temperature_max
     case apparent_temperature_mean
     case apparent_temperature_min
@@ -0,0 +1,178 @@
+import Foundation
+import Vapor
+
+/**
+ Serve spatial fields for map rendering directly from `data_spatial` time step files.
+
+ Example:
+ `/v1/map?domain=dwd_icon_d2&variables=temperature_2m&time=2025-01-01T12:00&bounding_box=45,5,50,10&step=2&format=bin`
+
+ - `run` defaults to the latest completed run. `time` defaults to the first valid time of the run
+ - `bounding_box` defaults to the entire grid. `step` reads every n-th row and column
+ - `format=json` returns coordinates and values. `format=bin` returns little endian float32 grids in the order of variables, then time. Dimensions are returned in `X-Grid-Ny` and `X-Grid-Nx` headers
+ */
+struct MapController: RouteCollection {
+    /// Limit values per response to keep memory and response size bounded
+    static let maxValues = 16 * 1024 * 1024
+
+    /// Maximum number of time steps per request
+    static let maxTimes = 48
+
+    func boot(routes: RoutesBuilder) throws {
+        routes.grouped("v1").getAndPost("map", use: self.query)
+    }
+
+    enum Format: String, CaseIterable {
+        case json
+        case bin
+    }
+
+    struct Params: Content {
+        let domain: String
+        let variables: [String]
+        let time: [String]?
+        let run: String?
+        let realm: SpatialRealm?
+        let bounding_box: [String]?
+        let step: Int?
+        let format: String?
+    }
+
+    struct JsonResponse: Encodable {
+        let domain: String
+        let run: String
+        let ny: Int
+        let nx: Int
+        let latitude: [Float]
+        let longitude: [Float]
+        let times: [String]
+        /// Values per variable and time step. NaN is encoded as null
+        let variables: [String: [[Float?]]]
+    }
+
+    func query(_ req: Request) async throws -> Response {
+        let params = req.method == .POST ? try req.content.decode(Params.self) : try req.query.decode(Params.self)
+        let logger = req.logger
+        let httpClient = req.application.http.client.shared
+
+        let registry = try DomainRegistry.load(rawValue: params.domain)
+        guard let domain = registry.getDomain() else {
+            throw ForecastapiError.generic(message: "Domain \(params.domain) not available")
+        }
+        let format = try Format.load(rawValueOptional: params.format) ?? .json
+        let variables = params.variables.flatMap { $0.split(separator: ",").map(String.init) }.reduce(into: [String]()) {
+            if !$0.contains($1) {
+                $0.append($1)
+            }
+        }
+        guard !variables.isEmpty else {
+            throw ForecastapiError.generic(message: "Parameter 'variables' is required")
+        }
+
+        /// Meta data of the run with available variables and time steps
+        let meta: DataSpatialJson
+        if let run = params.run {
+            let run = try IsoDateTime(fromIsoString: run).toTimestamp()
+            let realm = params.realm.map { "_\($0.rawValue)" } ?? ""
+            guard let directory = registry.directorySpatial, let runMeta = try? DataSpatialJson.readFrom(path: "\(directory)\(run.format_directoriesYYYYMMddhhmm)/meta\(realm).json") else {
+                throw ForecastapiError.generic(message: "Run \(run.iso8601_YYYY_MM_dd_HH_mm) not available for domain \(registry.rawValue)")
+            }
+            meta = runMeta
+        } else {
+            guard let latest = try await SpatialFieldReader.latestRun(domain: registry, realm: params.realm, logger: logger, httpClient: httpClient) else {
+                throw ForecastapiError.generic(message: "No spatial data available for domain \(registry.rawValue)")
+            }
+            meta = latest
+        }
+        let run = Timestamp(Int(meta.reference_time.timeIntervalSince1970))
+        for variable in variables where !meta.variables.contains(variable) {
+            throw ForecastapiError.generic(message: "Variable \(variable) not available. Available variables: \(meta.variables.joined(separator: ","))")
+        }
+
+        let times: [Timestamp]
+        if let time = params.time, !time.isEmpty {
+            times = try IsoDateTime.load(commaSeparated: time).map { $0.toTimestamp() }
+        } else {
+            guard let first = meta.valid_times.first else {
+                throw ForecastapiError.generic(message: "Run has no time steps")
+            }
+            times = [try IsoDateTime(fromIsoString: String(first.dropLast(first.hasSuffix("Z") ? 1 : 0))).toTimestamp()]
+        }
+        guard times.count <= Self.maxTimes else {
+            throw ForecastapiError.generic(message: "At most \(Self.maxTimes) time steps can be requested")
+        }
+        for time in times where !meta.valid_times.contains(time.iso8601_YYYY_MM_dd_HH_mmZ) {
+            throw ForecastapiError.generic(message: "Time \(time.iso8601_YYYY_MM_dd_HH_mm) not available for run \(run.iso8601_YYYY_MM_dd_HH_mm)")
+        }
+
+        let grid = domain.grid
+        let step = params.step ?? 1
+        guard step >= 1 else {
+            throw ForecastapiError.generic(message: "Parameter 'step' must be 1 or larger")
+        }
+        let selection: SpatialFieldReader.Selection
+        if let bbox = try BoundingBoxWGS84.load(commaSeparated: params.bounding_box ?? []) {
+            guard let box = grid.findBox(boundingBox: bbox) else {
+                throw ForecastapiError.generic(message: "Bounding box calls not supported for grid of domain \(registry.rawValue)")
+            }
+            guard let slice = box as? GridSliceXy else {
+                /// Grids return an empty array if the box does not intersect the domain
+                if box.first(where: { _ in true }) == nil {
+                    throw ForecastapiError.generic(message: "Bounding box outside of domain \(registry.rawValue)")
+                }
+                throw ForecastapiError.generic(message: "Bounding box calls not supported for grid of domain \(registry.rawValue)")
+            }
+            selection = .init(y: slice.yRange, x: slice.xRange, step: step)
+        } else {
+            selection = .init(y: 0..<grid.ny, x: 0..<grid.nx, step: step)
+        }
+        guard selection.ny > 0 && selection.nx > 0 else {
+            throw ForecastapiError.generic(message: "Bounding box is smaller than one grid cell of domain \(registry.rawValue)")
+        }
+        guard selection.ny * selection.nx * variables.count * times.count <= Self.maxValues else {
+            throw ForecastapiError.generic(message: "Too many values requested. Reduce the area or time steps, or increase 'step'")
+        }
+
+        let reader = SpatialFieldReader(domain: registry, grid: grid, run: run, realm: params.realm, logger: logger, httpClient: httpClient)
+        let fields = try await variables.asyncMap { variable in
+            try await times.asyncMap { time in
+                guard let field = try await reader.read(variable: variable, time: time, selection: selection) else {
+                    throw ForecastapiError.generic(message: "Spatial file for \(variable) at \(time.iso8601_YYYY_MM_dd_HH_mm) not found")
+                }
+                return field
+            }
+        }
+
+        switch format {
+        case .bin:
+            var buffer = ByteBufferAllocator().buffer(capacity: selection.ny * selection.nx * variables.count * times.count * MemoryLayout<Float>.size)
+            for field in fields.joined() {
+                for value in field {
+                    buffer.writeInteger(value.bitPattern, endianness: .little)
+                }
+            }
+            var headers = HTTPHeaders()
+            headers.add(name: .contentType, value: "application/octet-stream")
+            headers.add(name: "X-Grid-Ny", value: "\(selection.ny)")
+            headers.add(name: "X-Grid-Nx", value: "\(selection.nx)")
+            headers.add(name: "X-Variables", value: variables.joined(separator: ","))
+            headers.add(name: "X-Times", value: times.map(\.iso8601_YYYY_MM_dd_HH_mm).joined(separator: ","))
+            return Response(status: .ok, headers: headers, body: .init(buffer: buffer))
+        case .json:
+            let coordinates = grid.getCoordinates(gridpoints: selection.gridpoints(nx: grid.nx))
+            let json = JsonResponse(
+                domain: registry.rawValue,
+                run: run.iso8601_YYYY_MM_dd_HH_mm,
+                ny: selection.ny,
+                nx: selection.nx,
+                latitude: coordinates.latitude,
+                longitude: coordinates.longitude,
+                times: times.map(\.iso8601_YYYY_MM_dd_HH_mm),
+                variables: Dictionary(uniqueKeysWithValues: zip(variables, fields.map { $0.map { $0.map { $0.isNaN ? nil : $0 } } }))
+            )
+            var headers = HTTPHeaders()
+            headers.add(name: .contentType, value: "application/json")
+            return Response(status: .ok, headers: headers, body: .init(data: try JSONEncoder().encode(json)))
+        }
+    }
+}
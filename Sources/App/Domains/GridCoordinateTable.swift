@@ -0,0 +1,63 @@
+import Foundation
+import NIOConcurrencyHelpers
+
+/**
+ Latitude and longitude of all grid points of a projected grid.
+
+ `ProjectionGrid.getCoordinates` runs the inverse projection with several trigonometric functions per call. Solar conversions need coordinates for every grid point at every time step.
+ A table is built once per grid on first bulk access and shared by all callers. It uses 8 bytes per grid point, e.g. 15 MB for HRRR.
+ Single point lookups for API calls do not build a table.
+ */
+final class GridCoordinateTable: Sendable {
+    let latitude: [Float]
+    let longitude: [Float]
+
+    /// Tables by grid description
+    private static let tables = NIOLockedValueBox<[String: GridCoordinateTable]>(.init())
+
+    /// True north directions by grid description
+    private static let trueNorth = NIOLockedValueBox<[String: [Float]]>(.init())
+
+    init(count: Int, coordinates: (_ gridpoint: Int) -> (latitude: Float, longitude: Float)) {
+        var latitude = [Float](repeating: .nan, count: count)
+        var longitude = [Float](repeating: .nan, count: count)
+        for gridpoint in 0..<count {
+            (latitude[gridpoint], longitude[gridpoint]) = coordinates(gridpoint)
+        }
+        self.latitude = latitude
+        self.longitude = longitude
+    }
+
+    /// Return the table for a grid or build it. Concurrent first accesses may build the same table more than once. The last one wins.
+    static func get(key: String, count: Int, coordinates: (_ gridpoint: Int) -> (latitude: Float, longitude: Float)) -> GridCoordinateTable {
+        if let table = tables.withLockedValue({ $0[key] }) {
+            return table
+        }
+        let table = GridCoordinateTable(count: count, coordinates: coordinates)
+        tables.withLockedValue({ $0[key] = table })
+        return table
+    }
+
+    /// Return cached true north directions of a grid or compute them
+    static func trueNorthDirection(key: String, compute: () -> [Float]) -> [Float] {
+        if let direction = trueNorth.withLockedValue({ $0[key] }) {
+            return direction
+        }
+        let direction = compute()
+        trueNorth.withLockedValue({ $0[key] = direction })
+        return direction
+    }
+
+    /// Coordinates for a selection of grid points
+    func getCoordinates<S: Sequence>(gridpoints: S) -> (latitude: [Float], longitude: [Float]) where S.Element == Int {
+        var lat = [Float]()
+        var lon = [Float]()
+        lat.reserveCapacity(gridpoints.underestimatedCount)
+        lon.reserveCapacity(gridpoints.underestimatedCount)
+        for gridpoint in gridpoints {
+            lat.append(latitude[gridpoint])
+            lon.append(longitude[gridpoint])
+        }
+        return (lat, lon)
+    }
+}
@@ -12,6 +12,8 @@ public protocol Gridable: Sendable {
     func findPointInterpolated(lat: Float, lon: Float) -> GridPoint2DFraction?
     func findBox(boundingBox bb: BoundingBoxWGS84) -> (any Sequence<Int>)?
     func getCoordinates(gridpoint: Int) -> (latitude: Float, longitude: Float)
+    /// Coordinates of multiple grid points. Use in loops over many grid points or time steps. Projected grids use a lookup table
+    func getCoordinates<S: Sequence>(gridpoints: S) -> (latitude: [Float], longitude: [Float]) where S.Element == Int
 }
 
 public struct GridPoint2DFraction {
@@ -61,6 +63,19 @@ extension Gridable {
         return nx * ny
     }
 
+    func getCoordinates<S: Sequence>(gridpoints: S) -> (latitude: [Float], longitude: [Float]) where S.Element == Int {
+        var latitude = [Float]()
+        var longitude = [Float]()
+        latitude.reserveCapacity(gridpoints.underestimatedCount)
+        longitude.reserveCapacity(gridpoints.underestimatedCount)
+        for gridpoint in gridpoints {
+            let (lat, lon) = getCoordinates(gridpoint: gridpoint)
+            latitude.append(lat)
+            longitude.append(lon)
+        }
+        return (latitude, longitude)
+    }
+
     func findPoint(lat: Float, lon: Float, elevation: Float, elevationFile: (any OmFileReaderArrayProtocol<Float>)?, mode: GridSelectionMode) async throws -> (gridpoint: Int, gridElevation: ElevationOrSea)? {
         guard let elevationFile = elevationFile else {
             guard let point = findPoint(lat: lat, lon: lon) else {
@@ -224,3 +239,34 @@ public struct BoundingBoxWGS84 {
     let latitude: Range<Float>
     let longitude: Range<Float>
 }
+
+extension BoundingBoxWGS84 {
+    /// Parse a bounding box parameter. Format: lat1, lon1, lat2, lon2. Returns nil if empty
+    static func load(commaSeparated: [String]) throws -> BoundingBoxWGS84? {
+        let coordinates = try Float.load(commaSeparated: commaSeparated)
+        guard coordinates.count > 0 else {
+            return nil
+        }
+        guard coordinates.count == 4 else {
+            throw ForecastapiError.generic(message: "Parameter bounding_box must have 4 values")
+        }
+        let lat1 = coordinates[0]
+        let lon1 = coordinates[1]
+        let lat2 = coordinates[2]
+        let lon2 = coordinates[3]
+
+        guard lat1 < lat2 else {
+            throw ForecastapiError.generic(message: "The first latitude must be smaller than the second latitude")
+        }
+        guard (-90...90).contains(lat1), (-90...90).contains(lat2) else {
+            throw ForecastapiError.generic(message: "Latitudes must be between -90 and 90")
+        }
+        guard lon1 < lon2 else {
+            throw ForecastapiError.generic(message: "The first longitude must be smaller than the second longitude")
+        }
+        guard (-180...180).contains(lon1), (-180...180).contains(lon2) else {
+            throw ForecastapiError.generic(message: "Longitudes must be between -180 and 180")
+        }
+        return BoundingBoxWGS84(latitude: lat1..<lat2, longitude: lon1..<lon2)
+    }
+}
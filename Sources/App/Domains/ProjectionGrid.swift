@@ -84,17 +84,34 @@ struct ProjectionGrid<Projection: Projectable>: Gridable {
         return (lat, (lon + 180).truncatingRemainder(dividingBy: 360) - 180 )
     }
 
+    /// Coordinates from a lookup table that is built once per grid
+    func getCoordinates<S: Sequence>(gridpoints: S) -> (latitude: [Float], longitude: [Float]) where S.Element == Int {
+        return coordinateTable.getCoordinates(gridpoints: gridpoints)
+    }
+
+    /// Identifies grids with the same projection parameters and dimensions
+    var coordinateTableKey: String {
+        return "\(projection) nx=\(nx) ny=\(ny) origin=\(origin) dx=\(dx) dy=\(dy)"
+    }
+
+    /// Latitude and longitude of all grid points. Built on first access
+    var coordinateTable: GridCoordinateTable {
+        return GridCoordinateTable.get(key: coordinateTableKey, count: count) { getCoordinates(gridpoint: $0) }
+    }
+
     /// Get angle towards true north. 0 = points towards north pole (e.g. no correction necessary), range -180;180
+    /// Computed once per grid
     func getTrueNorthDirection() -> [Float] {
-        let pos = projection.forward(latitude: 90, longitude: 0)
-        let northPoleX = (pos.x - origin.x) / dx
-        let northPoleY = (pos.y - origin.y) / dy
-        let trueNorthDirection = (0..<count).map { gridpoint in
-            let x = Float(gridpoint % nx)
-            let y = Float(gridpoint / nx)
-            return atan2(northPoleX - x, northPoleY - y).radiansToDegrees
+        return GridCoordinateTable.trueNorthDirection(key: coordinateTableKey) {
+            let pos = projection.forward(latitude: 90, longitude: 0)
+            let northPoleX = (pos.x - origin.x) / dx
+            let northPoleY = (pos.y - origin.y) / dy
+            return (0..<count).map { gridpoint in
+                let x = Float(gridpoint % nx)
+                let y = Float(gridpoint / nx)
+                return atan2(northPoleX - x, northPoleY - y).radiansToDegrees
+            }
         }
-        return trueNorthDirection
     }
 
     func findBox(boundingBox bb: BoundingBoxWGS84) -> (any Sequence<Int>)? {
@@ -47,7 +47,7 @@ enum CerraVariableDerived: String, RawRepresentableString, GenericVariableMixabl
     }
 }
 
-struct CerraReader: GenericReaderDerivedSimple, GenericReaderProtocol {
+struct CerraReader: GenericReaderDerivedSimple, GenericReaderProtocol, GenericReaderDailyAggregateProvider {
     let reader: GenericReaderCached<CdsDomain, CerraVariable>
 
     let options: GenericReaderOptions
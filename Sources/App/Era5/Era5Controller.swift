@@ -123,7 +123,7 @@ enum Era5Factory {
     }
 }
 
-struct Era5Reader<Reader: GenericReaderProtocol>: GenericReaderDerivedSimple, GenericReaderProtocol where Reader.MixingVar == Era5Variable {
+struct Era5Reader<Reader: GenericReaderProtocol>: GenericReaderDerivedSimple, GenericReaderProtocol, GenericReaderDailyAggregateProvider where Reader.MixingVar == Era5Variable {
     let reader: Reader
 
     let options: GenericReaderOptions
@@ -50,12 +50,21 @@ enum QuantileDeltaMappingBiasCorrection {
         let binsControl = calculateBins(controlAndForecast, nQuantiles: nQuantiles, min: type.isRelativeChange ? 0 : nil)
         let cdfControl = CdfMonthly10YearSliding(vector: controlAndForecast, time: controlAndForecastTime, bins: binsControl)
 
+        return quantileDeltaMappingMonthly(reference: cdfRefernce, referenceEnd: referenceTime.range.upperBound, control: cdfControl, forecast: controlAndForecast, forecastTime: controlAndForecastTime, type: type)
+    }
+
+    /// Apply quantile delta mapping with CDFs that have been calculated before. E.g. read from `Cmip6QuantileMappingTable`
+    /// `control` must be calculated over the entire control and forecast timespan. `forecast` can be any part of it.
+    static func quantileDeltaMappingMonthly(reference cdfRefernce: CdfMonthly10YearSliding, referenceEnd: Timestamp, control cdfControl: CdfMonthly10YearSliding, forecast controlAndForecast: ArraySlice<Float>, forecastTime controlAndForecastTime: TimerangeDt, type: ChangeType) -> [Float] {
+        let binsRefernce = cdfRefernce.bins
+        let binsControl = cdfControl.bins
+
         // Apply
         let binsForecast = binsControl
         let cdfForecast = cdfControl
 
         // Limit time to 5 years before end of reference time. CDFs are averaged over 10 years and this makes sure, that the forecast CDF does not take any future signals into the reference.
-        let maxReferenceTime = Timestamp(referenceTime.range.upperBound.timeIntervalSince1970 - Timestamp.secondsPerAverageYear * CdfMonthly10YearSliding.yearsToAggregate / 2)
+        let maxReferenceTime = Timestamp(referenceEnd.timeIntervalSince1970 - Timestamp.secondsPerAverageYear * CdfMonthly10YearSliding.yearsToAggregate / 2)
 
         switch type {
         case .absoluteChage:
@@ -170,17 +179,15 @@ enum QuantileDeltaMappingBiasCorrection {
     static func interpolate<Cdf: MonthlyBinable>(_ xData: Bins, _ yData: Cdf, x: Float, time: Timestamp, extrapolate: Bool) -> Float {
         // assert(xData.count == yData.count)
         let size = xData.count
+        let position = yData.position(time: time)
 
-        var i = 0  // find left end of interval for interpolation
-        if x >= xData[xData.index(xData.startIndex, offsetBy: size - 2)] {
-            i = size - 2  // special case: beyond right end
-        } else {
-            while x > xData[xData.index(xData.startIndex, offsetBy: i + 1)] { i += 1 }
-        }
-        let xL = xData[xData.index(xData.startIndex, offsetBy: i)]
-        var yL = yData.get(bin: i, time: time)
-        let xR = xData[xData.index(xData.startIndex, offsetBy: i + 1)]
-        var yR = yData.get(bin: i + 1, time: time) // points on either side (unless beyond ends)
+        // find left end of interval for interpolation
+        // special case: beyond right end
+        let i = x >= xData[size - 2] ? size - 2 : firstIndex(upTo: size - 2, where: { !(x > xData[$0 + 1]) })
+        let xL = xData[i]
+        var yL = yData.get(bin: i, position: position)
+        let xR = xData[i + 1]
+        var yR = yData.get(bin: i + 1, position: position) // points on either side (unless beyond ends)
 
         if !extrapolate {  // if beyond ends of array and not extrapolating
             if x < xL { yR = yL }
@@ -194,17 +201,15 @@ enum QuantileDeltaMappingBiasCorrection {
     static func interpolate<Cdf: MonthlyBinable>(_ xData: Cdf, _ yData: Bins, x: Float, time: Timestamp, extrapolate: Bool) -> Float {
         // assert(xData.count == yData.count)
         let size = xData.nBins
+        let position = xData.position(time: time)
 
-        var i = 0  // find left end of interval for interpolation
-        if x >= xData.get(bin: size - 2, time: time) {
-            i = size - 2  // special case: beyond right end
-        } else {
-            while x > xData.get(bin: i + 1, time: time) { i += 1 }
-        }
-        let xL = xData.get(bin: i, time: time)
-        var yL = yData[yData.index(yData.startIndex, offsetBy: i)]
-        let xR = xData.get(bin: i + 1, time: time)
-        var yR = yData[yData.index(yData.startIndex, offsetBy: i + 1)] // points on either side (unless beyond ends)
+        // find left end of interval for interpolation
+        // special case: beyond right end
+        let i = x >= xData.get(bin: size - 2, position: position) ? size - 2 : firstIndex(upTo: size - 2, where: { !(x > xData.get(bin: $0 + 1, position: position)) })
+        let xL = xData.get(bin: i, position: position)
+        var yL = yData[i]
+        let xR = xData.get(bin: i + 1, position: position)
+        var yR = yData[i + 1] // points on either side (unless beyond ends)
 
         if !extrapolate {  // if beyond ends of array and not extrapolating
             if x < xL { yR = yL }
@@ -213,6 +218,23 @@ enum QuantileDeltaMappingBiasCorrection {
         let dydx = xR - xL == 0 ? 0 : (yR - yL) / (xR - xL)  // gradient
         return yL + dydx * (x - xL)       // linear interpolation
     }
+
+    /// Binary search for the first index in `0..<count` where `predicate` is true. Returns `count` if none matches.
+    /// Same result as a linear scan, because CDFs and bins are monotonic
+    @inline(__always)
+    static func firstIndex(upTo count: Int, where predicate: (Int) -> Bool) -> Int {
+        var low = 0
+        var high = count
+        while low < high {
+            let mid = (low + high) / 2
+            if predicate(mid) {
+                high = mid
+            } else {
+                low = mid + 1
+            }
+        }
+        return low
+    }
 }
 
 extension RandomAccessCollection where Element == Float {
@@ -346,10 +368,96 @@ struct BiasCorrectionSeasonalLinear {
 }*/
 
 protocol MonthlyBinable {
-    func get(bin: Int, time t: Timestamp) -> Float
+    /// Month and year bins of a timestamp. Calculated once per timestamp and reused for all quantiles
+    func position(time t: Timestamp) -> CdfTimePosition
+    func get(bin: Int, position: CdfTimePosition) -> Float
     var nBins: Int { get }
 }
 
+extension MonthlyBinable {
+    func get(bin: Int, time t: Timestamp) -> Float {
+        return get(bin: bin, position: position(time: t))
+    }
+}
+
+/// Position of a timestamp in month and year bins including the fraction to the next bin
+struct CdfTimePosition {
+    let monthBin: Int
+    let monthFraction: Float
+    let yearBin: Int
+    let yearFraction: Float
+
+    /// Month bins only
+    init(time t: Timestamp, nMonths: Int) {
+        monthBin = t.secondInAverageYear / (Timestamp.secondsPerAverageYear / nMonths)
+        monthFraction = Float(t.secondInAverageYear).truncatingRemainder(dividingBy: Float(Timestamp.secondsPerAverageYear / nMonths)) / Float(Timestamp.secondsPerAverageYear / nMonths)
+        yearBin = 0
+        yearFraction = 0
+    }
+
+    /// Month bins and sliding year bins
+    init(time t: Timestamp, nMonths: Int, yearMin: Int, yearsToAggregate: Int) {
+        monthBin = t.secondInAverageYear / (Timestamp.secondsPerAverageYear / nMonths)
+        monthFraction = Float(t.secondInAverageYear).truncatingRemainder(dividingBy: Float(Timestamp.secondsPerAverageYear / nMonths)) / Float(Timestamp.secondsPerAverageYear / nMonths)
+        let fractionalYear = (Float(t.timeIntervalSince1970) / Float(Timestamp.secondsPerAverageYear) - Float(yearMin) - Float(yearsToAggregate) / 2) / Float(yearsToAggregate)
+        yearFraction = fractionalYear - floor(fractionalYear)
+        yearBin = Int(floor(fractionalYear))
+    }
+}
+
+extension Bins {
+    /// Highest bin index `i` with `self[i] <= value` or -1 if value is below all bins. Same result as scanning all bins in reverse.
+    /// The index is calculated directly and only corrected for floating point rounding. `value` must not be NaN
+    @inline(__always)
+    func lowerBin(for value: Float) -> Int {
+        let step = (max - min) / Float(nQuantiles)
+        guard step > 0 else {
+            return value >= min ? nQuantiles - 1 : -1
+        }
+        let estimate = ((value - min) / step).rounded(.down)
+        var i = estimate < -1 ? -1 : estimate > Float(nQuantiles - 1) ? nQuantiles - 1 : Int(estimate)
+        while i + 1 < nQuantiles && value >= self[i + 1] {
+            i += 1
+        }
+        while i >= 0 && value < self[i] {
+            i -= 1
+        }
+        return i
+    }
+
+    /// Fraction of bin `i` that is above `value`
+    @inline(__always)
+    func upperFraction(value: Float, bin i: Int) -> Float {
+        return (self[i + 1] - value) / (self[i + 1] - self[i])
+    }
+
+    /// Add a value to a cumulative histogram at `offset`. `full` holds weights for bin `i + 1` and all higher bins and is prefix summed afterwards. `partial` is only added to bin `i`
+    @inline(__always)
+    static func accumulate(full: inout [Float], partial: inout [Float], offset: Int, lowerBin i: Int, nQuantiles: Int, fullWeight: Float, partialWeight: Float) {
+        if i < 0 {
+            full[offset] += fullWeight
+            return
+        }
+        partial[offset + i] += partialWeight
+        if i + 1 < nQuantiles {
+            full[offset + i + 1] += fullWeight
+        }
+    }
+
+    /// Turn `full` and `partial` into a cumulative histogram for each block of `nQuantiles`
+    static func prefixSum(full: [Float], partial: [Float], nQuantiles: Int) -> [Float] {
+        var cdf = [Float](repeating: 0, count: full.count)
+        for block in stride(from: 0, to: full.count, by: nQuantiles) {
+            var sum: Float = 0
+            for i in block ..< block + nQuantiles {
+                sum += full[i]
+                cdf[i] = sum + partial[i]
+            }
+        }
+        return cdf
+    }
+}
+
 /// Calculate CDF for each month individually
 struct CdfMonthly: MonthlyBinable {
     let cdf: [Float]
@@ -367,26 +475,23 @@ struct CdfMonthly: MonthlyBinable {
     /// input temperature and time axis
     init<T: Sequence>(vector: T, time: TimerangeDt, bins: Bins) where T.Element == Float {
         let count = bins.nQuantiles
-        var cdf = [Float](repeating: 0, count: count * Self.monthsToAggregate)
+        var full = [Float](repeating: 0, count: count * Self.monthsToAggregate)
+        var partial = [Float](repeating: 0, count: count * Self.monthsToAggregate)
         for (t, value) in zip(time, vector) {
-            let monthBin = t.secondInAverageYear / (Timestamp.secondsPerAverageYear / Self.monthsToAggregate)
-            let fraction = Float(t.secondInAverageYear).truncatingRemainder(dividingBy: Float(Timestamp.secondsPerAverageYear / Self.monthsToAggregate)) / Float(Timestamp.secondsPerAverageYear / Self.monthsToAggregate)
-            for (i, bin) in bins.enumerated().reversed() {
-                if value >= bin && value < bins[i + 1] {
-                    // value exactly inside a bin, adjust weight
-                    let interBinFraction = (bins[i + 1] - value) / (bins[i + 1] - bin)
-                    let weigthted = Interpolations.linearWeighted(value: fraction, fraction: interBinFraction)
-                    assert(interBinFraction >= 0 && interBinFraction <= 1)
-                    cdf[monthBin * count + i] += weigthted.a
-                    cdf[((monthBin + 1) % Self.monthsToAggregate) * count + i] += weigthted.b
-                } else if value < bin {
-                    cdf[monthBin * count + i] += 1 - fraction
-                    cdf[((monthBin + 1) % Self.monthsToAggregate) * count + i] += fraction
-                } else {
-                    break
-                }
+            if value.isNaN {
+                continue
             }
+            let position = CdfTimePosition(time: t, nMonths: Self.monthsToAggregate)
+            let fraction = position.monthFraction
+            let i = bins.lowerBin(for: value)
+            /// The bin containing the value is weighted by the fraction inside the bin. Values at or above `bins.max` get zero weight, as in the previous loop over all bins
+            let interBinFraction: Float? = i >= 0 && value < bins[i + 1] ? bins.upperFraction(value: value, bin: i) : nil
+            assert(interBinFraction.map { $0 >= 0 && $0 <= 1 } ?? true)
+            let weigthted = Interpolations.linearWeighted(value: fraction, fraction: interBinFraction ?? 0)
+            Bins.accumulate(full: &full, partial: &partial, offset: position.monthBin * count, lowerBin: i, nQuantiles: count, fullWeight: 1 - fraction, partialWeight: interBinFraction == nil ? 0 : weigthted.a)
+            Bins.accumulate(full: &full, partial: &partial, offset: ((position.monthBin + 1) % Self.monthsToAggregate) * count, lowerBin: i, nQuantiles: count, fullWeight: fraction, partialWeight: interBinFraction == nil ? 0 : weigthted.b)
         }
+        var cdf = Bins.prefixSum(full: full, partial: partial, nQuantiles: count)
         /// normalise to 1
         for j in 0..<cdf.count / bins.count {
             // last value is always count... could also scale to something between bin min/max to make it compressible more easily
@@ -402,13 +507,14 @@ struct CdfMonthly: MonthlyBinable {
         self.bins = bins
     }
 
-    /// linear interpolate between 2 months CDF
-    func get(bin: Int, time t: Timestamp) -> Float {
-        let monthBin = t.secondInAverageYear / (Timestamp.secondsPerAverageYear / Self.monthsToAggregate)
-        let fraction = Float(t.secondInAverageYear).truncatingRemainder(dividingBy: Float(Timestamp.secondsPerAverageYear / Self.monthsToAggregate)) / Float(Timestamp.secondsPerAverageYear / Self.monthsToAggregate)
+    func position(time t: Timestamp) -> CdfTimePosition {
+        return CdfTimePosition(time: t, nMonths: Self.monthsToAggregate)
+    }
 
+    /// linear interpolate between 2 months CDF
+    func get(bin: Int, position: CdfTimePosition) -> Float {
         let binLength = cdf.count / Self.monthsToAggregate
-        return Interpolations.linear(a: cdf[binLength * monthBin + bin], b: cdf[binLength * ((monthBin + 1) % Self.monthsToAggregate) + bin], fraction: fraction)
+        return Interpolations.linear(a: cdf[binLength * position.monthBin + bin], b: cdf[binLength * ((position.monthBin + 1) % Self.monthsToAggregate) + bin], fraction: position.monthFraction)
     }
 }
 
@@ -429,66 +535,105 @@ struct CdfMonthly10YearSliding: MonthlyBinable {
     static var yearsToAggregate: Int { 10 }
 
     /// input temperature and time axis
+    /// Each value is located with a single bin lookup and added to a histogram. A prefix sum per year and month bin generates the CDF
     init(vector: ArraySlice<Float>, time: TimerangeDt, bins: Bins) {
         // print(time.prettyString())
-        self.yearMin = Int(round(Float(time.range.lowerBound.timeIntervalSince1970) / Float(Timestamp.secondsPerAverageYear)))
-        let yearMax = Int(round(Float(time.range.upperBound.timeIntervalSince1970) / Float(Timestamp.secondsPerAverageYear)))
-
-        let nYears = (yearMax - yearMin + 1) / Self.yearsToAggregate
+        let (yearMin, nYears) = Self.years(time: time)
         // print("n Years \(nYears) yearMin=\(years.lowerBound) yearMax=\(years.upperBound)")
 
         let nQuantiles = bins.nQuantiles
-        var cdf = Array3D(repeating: 0, dim0: nYears, dim1: Self.nMonths, dim2: nQuantiles)
+        let nMonths = Self.nMonths
+        var full = [Float](repeating: 0, count: nYears * nMonths * nQuantiles)
+        var partial = [Float](repeating: 0, count: nYears * nMonths * nQuantiles)
         for (t, value) in zip(time, vector) {
-            let monthBin = t.secondInAverageYear / (Timestamp.secondsPerAverageYear / Self.nMonths)
-            let monthFraction = Float(t.secondInAverageYear).truncatingRemainder(dividingBy: Float(Timestamp.secondsPerAverageYear / Self.nMonths)) / Float(Timestamp.secondsPerAverageYear / Self.nMonths)
-
-            // let fractionalYear = Float(t.timeIntervalSince1970 / 3600) / (24 * 365.25 * Float(Self.yearsPerBin)) - Float(yearMin)
-            let fractionalYear = (Float(t.timeIntervalSince1970) / Float(Timestamp.secondsPerAverageYear) - Float(yearMin) - Float(Self.yearsToAggregate) / 2) / Float(Self.yearsToAggregate)
-            let yearFraction = fractionalYear - floor(fractionalYear)
-            let yearBin = Int(floor(fractionalYear))
-
-            for (i, bin) in bins.enumerated().reversed() {
-                let binFraction = value < bin ? 1 : (bins[i + 1] - value) / (bins[i + 1] - bin)
-                assert(binFraction >= -0.0001 && binFraction <= 1.0001)
-
-                if yearBin >= 0 {
-                    cdf[yearBin, monthBin, i] += (1 - yearFraction) * (1 - monthFraction) * binFraction
-                    cdf[yearBin, (monthBin + 1) % Self.nMonths, i] += (1 - yearFraction) * monthFraction * binFraction
-                }
-                if yearBin < nYears - 1 {
-                    cdf[yearBin + 1, monthBin, i] += yearFraction * (1 - monthFraction) * binFraction
-                    cdf[yearBin + 1, (monthBin + 1) % Self.nMonths, i] += yearFraction * monthFraction * binFraction
-                }
-
-                if value >= bin {
-                    break
-                }
+            let position = CdfTimePosition(time: t, nMonths: nMonths, yearMin: yearMin, yearsToAggregate: Self.yearsToAggregate)
+            let monthBin = position.monthBin
+            let nextMonthBin = (monthBin + 1) % nMonths
+            let yearBin = position.yearBin
+            /// NaN values propagate into all bins
+            let i = value.isNaN ? -1 : bins.lowerBin(for: value)
+            let binFraction: Float = value.isNaN ? .nan : i >= 0 ? bins.upperFraction(value: value, bin: i) : 1
+            assert(value.isNaN || (binFraction >= -0.0001 && binFraction <= 1.0001) || i == nQuantiles - 1)
+
+            /// Values below the first bin count fully in all bins
+            let fullFraction: Float = i < 0 ? binFraction : 1
+            let monthFraction = position.monthFraction
+
+            if yearBin >= 0 {
+                let w = 1 - position.yearFraction
+                Bins.accumulate(full: &full, partial: &partial, offset: (yearBin * nMonths + monthBin) * nQuantiles, lowerBin: i, nQuantiles: nQuantiles, fullWeight: w * (1 - monthFraction) * fullFraction, partialWeight: w * (1 - monthFraction) * binFraction)
+                Bins.accumulate(full: &full, partial: &partial, offset: (yearBin * nMonths + nextMonthBin) * nQuantiles, lowerBin: i, nQuantiles: nQuantiles, fullWeight: w * monthFraction * fullFraction, partialWeight: w * monthFraction * binFraction)
+            }
+            if yearBin < nYears - 1 {
+                let w = position.yearFraction
+                Bins.accumulate(full: &full, partial: &partial, offset: ((yearBin + 1) * nMonths + monthBin) * nQuantiles, lowerBin: i, nQuantiles: nQuantiles, fullWeight: w * (1 - monthFraction) * fullFraction, partialWeight: w * (1 - monthFraction) * binFraction)
+                Bins.accumulate(full: &full, partial: &partial, offset: ((yearBin + 1) * nMonths + nextMonthBin) * nQuantiles, lowerBin: i, nQuantiles: nQuantiles, fullWeight: w * monthFraction * fullFraction, partialWeight: w * monthFraction * binFraction)
             }
         }
+        var cdf = Bins.prefixSum(full: full, partial: partial, nQuantiles: nQuantiles)
         /// normalise to 1
         for y in 0..<nYears {
-            for m in 0..<Self.nMonths {
+            for m in 0..<nMonths {
                 // last value is always count... could also scale to something between bin min/max to make it compressible more easily
-                let count = cdf[y, m, nQuantiles - 1]
+                let offset = (y * nMonths + m) * nQuantiles
+                let count = cdf[offset + nQuantiles - 1]
                 for b in 0..<nQuantiles - 1 {
-                    cdf[y, m, b] /= count
+                    cdf[offset + b] /= count
                 }
             }
         }
-        self.cdf = cdf.data
+        self.cdf = cdf
         self.bins = bins
         self.nYears = nYears
+        self.yearMin = yearMin
     }
 
-    /// linear interpolate between 2 months CDF
-    func get(bin: Int, time t: Timestamp) -> Float {
-        let monthBin = t.secondInAverageYear / (Timestamp.secondsPerAverageYear / Self.nMonths)
-        let fraction = Float(t.secondInAverageYear).truncatingRemainder(dividingBy: Float(Timestamp.secondsPerAverageYear / Self.nMonths)) / Float(Timestamp.secondsPerAverageYear / Self.nMonths)
+    /// Restore a CDF from `table`. Returns nil if the table is empty, e.g. for grid cells without data
+    init?(table: ArraySlice<Float>, nQuantiles: Int) {
+        let header = table.startIndex
+        guard table.count > Self.tableHeader, !table[header].isNaN, !table[header + 3].isNaN else {
+            return nil
+        }
+        let nYears = Int(table[header + 3])
+        guard nYears >= 1, table.count == Self.tableCount(nYears: nYears, nQuantiles: nQuantiles) else {
+            return nil
+        }
+        self.bins = Bins(min: table[header], max: table[header + 1], nQuantiles: nQuantiles)
+        self.yearMin = Int(table[header + 2])
+        self.nYears = nYears
+        self.cdf = Array(table[(header + Self.tableHeader)...])
+    }
+
+    /// Number of values in front of the CDF in `table`: bins min, bins max, first year and number of year bins
+    static var tableHeader: Int { 4 }
+
+    /// Bins and CDF as a flat array to store them in a file
+    var table: [Float] {
+        return [bins.min, bins.max, Float(yearMin), Float(nYears)] + cdf
+    }
 
-        let fractionalYear = (Float(t.timeIntervalSince1970) / Float(Timestamp.secondsPerAverageYear) - Float(yearMin) - Float(Self.yearsToAggregate) / 2) / Float(Self.yearsToAggregate)
-        let yearFraction = fractionalYear - floor(fractionalYear)
-        let yearBin = Int(floor(fractionalYear))
+    /// Length of `table` for a given number of year bins
+    static func tableCount(nYears: Int, nQuantiles: Int) -> Int {
+        return tableHeader + nYears * nMonths * nQuantiles
+    }
+
+    /// First year relative to 1970 and number of sliding year bins for a time range
+    static func years(time: TimerangeDt) -> (yearMin: Int, nYears: Int) {
+        let yearMin = Int(round(Float(time.range.lowerBound.timeIntervalSince1970) / Float(Timestamp.secondsPerAverageYear)))
+        let yearMax = Int(round(Float(time.range.upperBound.timeIntervalSince1970) / Float(Timestamp.secondsPerAverageYear)))
+        return (yearMin, (yearMax - yearMin + 1) / Self.yearsToAggregate)
+    }
+
+    func position(time t: Timestamp) -> CdfTimePosition {
+        return CdfTimePosition(time: t, nMonths: Self.nMonths, yearMin: yearMin, yearsToAggregate: Self.yearsToAggregate)
+    }
+
+    /// linear interpolate between 2 months CDF
+    func get(bin: Int, position: CdfTimePosition) -> Float {
+        let monthBin = position.monthBin
+        let fraction = position.monthFraction
+        let yearBin = position.yearBin
+        let yearFraction = position.yearFraction
 
         if yearBin < 0 {
             return Interpolations.linear(
@@ -0,0 +1,162 @@
+import Foundation
+import CHelper
+
+/**
+ A derived variable evaluated in one pass over its raw inputs.
+
+ Chains like `windspeed -> apparent temperature` previously allocated one array per step and read memory several times.
+ A kernel lists the raw inputs it needs and computes the result without intermediate arrays. Results are identical to the chained `Meteorology` functions.
+
+ Each requested variable evaluates its own kernel. Raw inputs shared by several variables are read again, but are served from `GenericReaderCached` in API readers.
+ */
+struct DerivedKernel<Raw: RawRepresentableString> {
+    /// Raw variables required by `evaluate` in this order
+    let inputs: [Raw]
+
+    let unit: SiUnit
+
+    /// Compute the derived variable from raw inputs in the order of `inputs`. All inputs have the same length
+    let evaluate: @Sendable (_ inputs: [[Float]]) -> [Float]
+}
+
+extension DerivedKernel {
+    /// Wind speed from u/v components. Evaluated with 8-wide SIMD vectors
+    static func windSpeed(u: Raw, v: Raw) -> Self {
+        return DerivedKernel(inputs: [u, v], unit: .metrePerSecond) { inputs in
+            return DerivedKernels.windSpeed(u: inputs[0], v: inputs[1])
+        }
+    }
+
+    /// Wind direction from u/v components
+    static func windDirection(u: Raw, v: Raw) -> Self {
+        return DerivedKernel(inputs: [u, v], unit: .degreeDirection) { inputs in
+            return Meteorology.windirectionFast(u: inputs[0], v: inputs[1])
+        }
+    }
+
+    /// Dewpoint from temperature and relative humidity
+    static func dewpoint(temperature: Raw, relativeHumidity: Raw, unit: SiUnit = .celsius) -> Self {
+        return DerivedKernel(inputs: [temperature, relativeHumidity], unit: unit) { inputs in
+            return DerivedKernels.map(inputs[0], inputs[1], Meteorology.dewpoint)
+        }
+    }
+
+    /// Vapour pressure deficit from temperature and relative humidity. The dewpoint is not stored
+    static func vapourPressureDeficit(temperature: Raw, relativeHumidity: Raw) -> Self {
+        return DerivedKernel(inputs: [temperature, relativeHumidity], unit: .kilopascal) { inputs in
+            return DerivedKernels.map(inputs[0], inputs[1]) { t, rh in
+                Meteorology.vaporPressureDeficit(temperature2mCelsius: t, dewpointCelsius: Meteorology.dewpoint(temperature: t, relativeHumidity: rh))
+            }
+        }
+    }
+
+    /// Wet bulb temperature from temperature and relative humidity
+    static func wetBulbTemperature(temperature: Raw, relativeHumidity: Raw, unit: SiUnit = .celsius) -> Self {
+        return DerivedKernel(inputs: [temperature, relativeHumidity], unit: unit) { inputs in
+            return DerivedKernels.map(inputs[0], inputs[1], Meteorology.wetBulbTemperature)
+        }
+    }
+
+    /// Apparent temperature from temperature, relative humidity, 10 m wind components and the sum of all `shortwave` radiation components
+    static func apparentTemperature(temperature: Raw, relativeHumidity: Raw, windU: Raw, windV: Raw, shortwave: [Raw]) -> Self {
+        return DerivedKernel(inputs: [temperature, relativeHumidity, windU, windV] + shortwave, unit: .celsius) { inputs in
+            let (t, rh, u, v) = (inputs[0], inputs[1], inputs[2], inputs[3])
+            let radiation = inputs[4...]
+            return (0..<t.count).map { i in
+                let swrad = DerivedKernels.sum(radiation, at: i)
+                return Meteorology.apparentTemperature(temperature_2m: t[i], relativehumidity_2m: rh[i], windspeed_10m: Meteorology.windspeed(u: u[i], v: v[i]), shortwave_radiation: swrad)
+            }
+        }
+    }
+
+    /// FAO reference evapotranspiration. `extraTerrestrialRadiation` must have the same length as the inputs
+    static func et0Evapotranspiration(temperature: Raw, relativeHumidity: Raw, windU: Raw, windV: Raw, shortwave: [Raw], extraTerrestrialRadiation: [Float], elevation: Float, dtSeconds: Int) -> Self {
+        return DerivedKernel(inputs: [temperature, relativeHumidity, windU, windV] + shortwave, unit: .millimetre) { inputs in
+            let (t, rh, u, v) = (inputs[0], inputs[1], inputs[2], inputs[3])
+            let radiation = inputs[4...]
+            return (0..<t.count).map { i in
+                let swrad = DerivedKernels.sum(radiation, at: i)
+                let dewpoint = Meteorology.dewpoint(temperature: t[i], relativeHumidity: rh[i])
+                return Meteorology.et0Evapotranspiration(temperature2mCelsius: t[i], windspeed10mMeterPerSecond: Meteorology.windspeed(u: u[i], v: v[i]), dewpointCelsius: dewpoint, shortwaveRadiationWatts: swrad, elevation: elevation, extraTerrestrialRadiation: extraTerrestrialRadiation[i], dtSeconds: dtSeconds)
+            }
+        }
+    }
+}
+
+/// Single pass array kernels used by `DerivedKernel`
+enum DerivedKernels {
+    /// `sqrt(u * u + v * v)` on 8-wide SIMD vectors. Identical to `Meteorology.windspeed` as square root is exactly rounded
+    static func windSpeed(u: [Float], v: [Float]) -> [Float] {
+        precondition(u.count == v.count, "Invalid array dimensions u\(u.count) \(v.count)")
+        let n = u.count
+        return [Float](unsafeUninitializedCapacity: n) { out, initializedCount in
+            u.withUnsafeBufferPointer { u in
+                v.withUnsafeBufferPointer { v in
+                    let nVector = n / 8 * 8
+                    for i in stride(from: 0, to: nVector, by: 8) {
+                        let uu = SIMD8<Float>(u[i ..< i + 8])
+                        let vv = SIMD8<Float>(v[i ..< i + 8])
+                        let speed = (uu * uu + vv * vv).squareRoot()
+                        for j in 0..<8 {
+                            out[i + j] = speed[j]
+                        }
+                    }
+                    for i in nVector ..< n {
+                        out[i] = Meteorology.windspeed(u: u[i], v: v[i])
+                    }
+                }
+            }
+            initializedCount = n
+        }
+    }
+
+    /// Combine two arrays element wise without intermediate arrays
+    @inline(__always)
+    static func map(_ a: [Float], _ b: [Float], _ fn: (Float, Float) -> Float) -> [Float] {
+        precondition(a.count == b.count, "Invalid array dimensions \(a.count) \(b.count)")
+        return [Float](unsafeUninitializedCapacity: a.count) { out, initializedCount in
+            for i in 0..<a.count {
+                out[i] = fn(a[i], b[i])
+            }
+            initializedCount = a.count
+        }
+    }
+
+    /// Sum of all arrays at position `i`. Summation order is the same as chained `zip(a, b).map(+)`
+    @inline(__always)
+    static func sum(_ arrays: ArraySlice<[Float]>, at i: Int) -> Float {
+        var sum = arrays[arrays.startIndex][i]
+        for array in arrays.dropFirst() {
+            sum += array[i]
+        }
+        return sum
+    }
+}
+
+extension DerivedKernel {
+    /// Evaluate kernels with raw inputs keyed by `rawValue`
+    static func evaluate(_ kernels: [Self], raw: [String: [Float]]) -> [DataAndUnit] {
+        return kernels.map { kernel in
+            DataAndUnit(kernel.evaluate(kernel.inputs.map { raw[$0.rawValue]! }), kernel.unit)
+        }
+    }
+}
+
+extension GenericReaderDerived {
+    /// Evaluate a fused kernel on raw inputs of this reader
+    func get(kernel: DerivedKernel<ReaderNext.MixingVar>, time: TimerangeDtAndSettings) async throws -> DataAndUnit {
+        var inputs = [[Float]]()
+        inputs.reserveCapacity(kernel.inputs.count)
+        for input in kernel.inputs {
+            inputs.append(try await get(raw: input, time: time).data)
+        }
+        return DataAndUnit(kernel.evaluate(inputs), kernel.unit)
+    }
+
+    /// Prefetch all raw inputs of a fused kernel
+    func prefetchData(kernel: DerivedKernel<ReaderNext.MixingVar>, time: TimerangeDtAndSettings) async throws {
+        for input in kernel.inputs {
+            try await prefetchData(raw: input, time: time)
+        }
+    }
+}
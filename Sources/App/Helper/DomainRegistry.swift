@@ -395,7 +395,9 @@ extension DomainRegistry {
     }
     
     /// Upload all data to a specified S3 bucket
-    func syncToS3(logger: Logger, bucket: String, variables: [GenericVariable]?) throws {
+    /// Files enqueued during conversion are awaited first. With the native S3 client only missing or modified files are uploaded afterwards
+    func syncToS3(logger: Logger, bucket: String, variables: [GenericVariable]?) async throws {
+        await S3UploadQueue.shared.wait()
         let dir = rawValue
         if let variables {
             let vDirectories = variables.map { $0.omFileName.file } + ["static"]
@@ -411,10 +413,12 @@ extension DomainRegistry {
                         // do not upload data from past days yet
                         continue
                     }
-                    try Process.awsSync(
+                    try await S3Client.sync(
                         src: src,
-                        dest: "s3://\(bucket)/data/\(dir)/\(variable)",
-                        profile: profile
+                        bucket: bucket,
+                        prefix: "data/\(dir)/\(variable)",
+                        profile: profile,
+                        logger: logger
                     )
                 }
             }
@@ -425,19 +429,37 @@ extension DomainRegistry {
                 let exclude = bucket == "openmeteo" ? ["*~", "*_previous_day*"] : ["*~"]
                 logger.info("AWS upload to bucket \(bucket)")
                 let startTimeAws = DispatchTime.now()
-                try Process.awsSync(
+                try await S3Client.sync(
                     src: src,
-                    dest: "s3://\(bucket)/data/\(dir)",
+                    bucket: bucket,
+                    prefix: "data/\(dir)",
                     exclude: exclude,
-                    profile: profile
+                    profile: profile,
+                    logger: logger
                 )
                 logger.info("AWS upload completed in \(startTimeAws.timeElapsedPretty())")
             }
         }
     }
     
+    /// Upload time-series files in the background as soon as they are written. Only used with the native S3 client, otherwise `syncToS3` uploads all files after conversion
+    func enqueueUploadToS3(bucket: String, files: [OmFileManagerReadable]) async throws {
+        for (bucket, profile) in parseBucket(bucket) {
+            guard S3Client.load(profile: profile) != nil else {
+                continue
+            }
+            for file in files {
+                let key = "data/\(file.getRelativeFilePath())"
+                if key.contains("_previous_day") && bucket == "openmeteo" {
+                    continue
+                }
+                try await S3UploadQueue.shared.copy(src: file.getFilePath(), bucket: bucket, key: key, profile: profile)
+            }
+        }
+    }
+    
     /// Upload time-series optimised per RUN files to S3 `/data_run/<domain>/<run>/<variable>.om`
-    func syncToS3PerRun(logger: Logger, bucket: String, run: Timestamp) throws {
+    func syncToS3PerRun(logger: Logger, bucket: String, run: Timestamp) async throws {
         let dir = rawValue
         guard let directory = OpenMeteo.dataRunDirectory else {
             return
@@ -445,22 +467,26 @@ extension DomainRegistry {
         let timeFormatted = run.format_directoriesYYYYMMddhhmm
         for (bucket, profile) in parseBucket(bucket) {
             let src = "\(directory)\(dir)/\(timeFormatted)/"
-            let dest = "s3://\(bucket)/data_run/\(dir)/\(timeFormatted)/"
+            let dest = "data_run/\(dir)/\(timeFormatted)/"
             if !FileManager.default.fileExists(atPath: src) {
                 continue
             }
             let startTimeAws = DispatchTime.now()
             logger.info("AWS upload to bucket \(bucket)")
-            try Process.awsSync(
+            try await S3Client.sync(
                 src: src,
-                dest: dest,
+                bucket: bucket,
+                prefix: dest,
                 exclude: ["*~", "meta.json"],
-                profile: profile
+                profile: profile,
+                logger: logger
             )
-            try Process.awsCopy(
+            try await S3Client.copy(
                 src: "\(src)meta.json",
-                dest: "\(dest)meta.json",
-                profile: profile
+                bucket: bucket,
+                key: "\(dest)meta.json",
+                profile: profile,
+                logger: logger
             )
             logger.info("AWS upload completed in \(startTimeAws.timeElapsedPretty())")
         }
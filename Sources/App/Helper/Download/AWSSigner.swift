@@ -17,7 +17,7 @@ extension CharacterSet {
 }
 
 /// Sign AWS URLs with AWS4-HMAC-SHA256
-public struct AWSSigner {
+public struct AWSSigner: Sendable {
     public let accessKey: String
     public let secretKey: String
     public let region: String
@@ -30,24 +30,27 @@ public struct AWSSigner {
         self.service = service
     }
 
-    public func sign(request: inout HTTPClientRequest, body: Data?, now: Date = Date()) throws {
+    public func sign(request: inout HTTPClientRequest, body: ByteBuffer?, now: Date = Date()) throws {
         guard let components = URLComponents(string: request.url),
-              let host = components.encodedHost else {
+              let encodedHost = components.encodedHost else {
             throw SigningError.invalidURL
         }
+        /// Non-default ports are part of the host header, e.g. for local S3 compatible endpoints
+        let host = components.port.map { "\(encodedHost):\($0)" } ?? encodedHost
 
         let method = request.method.rawValue
         let path = components.percentEncodedPath.isEmpty ? "/" : components.percentEncodedPath
         
+        /// Parameters without value like `?uploads` are signed as `uploads=`
         let canonicalQueryString = components.queryItems?
-            .map({ "\($0.name)\($0.value.map{"=\($0.addingPercentEncoding(withAllowedCharacters: .awsUriAllowed)!)"} ?? "")" })
+            .map({ "\($0.name.addingPercentEncoding(withAllowedCharacters: .awsUriAllowed)!)=\(($0.value ?? "").addingPercentEncoding(withAllowedCharacters: .awsUriAllowed)!)" })
             .sorted()
             .joined(separator: "&") ?? ""
 
         let amzDate = now.iso8601DateTime
         let dateStamp = now.shortDate
 
-        let payloadHash = (body ?? Data()).sha256Hex
+        let payloadHash = body?.withUnsafeReadableBytes { $0.sha256Hex } ?? Data().sha256Hex
         
         request.headers.add(name: "Host", value: host)
         request.headers.add(name: "x-amz-content-sha256", value: payloadHash)
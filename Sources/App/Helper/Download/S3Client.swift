@@ -0,0 +1,446 @@
+import Foundation
+import AsyncHTTPClient
+import Vapor
+
+/**
+ Upload files to S3 in-process with SigV4 signed requests instead of spawning the `aws` CLI.
+
+ Files larger than `partSize` are uploaded as multipart uploads with `nConcurrent` parts in parallel. Every request sends `Content-MD5`, so S3 rejects corrupted bodies. Failed requests are retried with exponential back off.
+
+ Credentials are read from `AWS_ACCESS_KEY_ID`, `AWS_SECRET_ACCESS_KEY` and `AWS_SESSION_TOKEN` or from `~/.aws/credentials` for a given profile.
+ The region is read from `AWS_REGION` or `~/.aws/config`. `AWS_ENDPOINT_URL` or `endpoint_url` in the profile select an S3 compatible endpoint like `http://127.0.0.1:9000` with path style URLs.
+ */
+struct S3Client: Sendable {
+    let signer: AWSSigner
+    let sessionToken: String?
+    /// Custom endpoint without trailing slash. If nil, AWS virtual hosted URLs are used
+    let endpoint: String?
+    let client: HTTPClient
+    /// Files larger than this are uploaded in parts. S3 requires at least 5 MB for all but the last part
+    let partSize: Int
+    /// Number of parts uploaded in parallel for one file
+    let nConcurrent: Int
+    let maxAttempts: Int
+    let backOff: ExponentialBackOff
+
+    init(signer: AWSSigner, sessionToken: String? = nil, endpoint: String? = nil, client: HTTPClient = .shared, partSize: Int = 32 * 1024 * 1024, nConcurrent: Int = 8, maxAttempts: Int = 6, backOff: ExponentialBackOff = .init()) {
+        self.signer = signer
+        self.sessionToken = sessionToken
+        self.endpoint = endpoint
+        self.client = client
+        self.partSize = partSize
+        self.nConcurrent = nConcurrent
+        self.maxAttempts = maxAttempts
+        self.backOff = backOff
+    }
+
+    enum S3Error: Error {
+        case unexpectedStatus(status: HTTPResponseStatus, message: String)
+        case missingETag(part: Int)
+        case missingUploadId
+        case completeMultipartFailed(message: String)
+    }
+
+    struct Object {
+        let key: String
+        let size: Int
+        let lastModified: Date
+    }
+
+    /// Load credentials from the environment or an AWS CLI profile. Returns nil if no credentials are configured
+    static func load(profile: String?) -> S3Client? {
+        let home = FileManager.default.homeDirectoryForCurrentUser.path
+        let credentials = Environment.get("AWS_SHARED_CREDENTIALS_FILE") ?? "\(home)/.aws/credentials"
+        let config = Environment.get("AWS_CONFIG_FILE") ?? "\(home)/.aws/config"
+        let section = profile ?? Environment.get("AWS_PROFILE") ?? "default"
+        let profileCredentials = readIni(path: credentials)[section] ?? [:]
+        let profileConfig = readIni(path: config)[section == "default" ? section : "profile \(section)"] ?? [:]
+
+        let useEnvironment = profile == nil && Environment.get("AWS_ACCESS_KEY_ID") != nil
+        guard let accessKey = useEnvironment ? Environment.get("AWS_ACCESS_KEY_ID") : profileCredentials["aws_access_key_id"],
+              let secretKey = useEnvironment ? Environment.get("AWS_SECRET_ACCESS_KEY") : profileCredentials["aws_secret_access_key"] else {
+            return nil
+        }
+        let sessionToken = useEnvironment ? Environment.get("AWS_SESSION_TOKEN") : profileCredentials["aws_session_token"]
+        let region = Environment.get("AWS_REGION") ?? Environment.get("AWS_DEFAULT_REGION") ?? profileConfig["region"] ?? "us-east-1"
+        let endpoint = (Environment.get("AWS_ENDPOINT_URL_S3") ?? Environment.get("AWS_ENDPOINT_URL") ?? profileConfig["endpoint_url"]).map {
+            $0.hasSuffix("/") ? String($0.dropLast()) : $0
+        }
+        let signer = AWSSigner(accessKey: accessKey, secretKey: secretKey, region: region, service: "s3")
+        return S3Client(signer: signer, sessionToken: sessionToken, endpoint: endpoint)
+    }
+
+    /// Parse sections of an AWS ini file like `~/.aws/credentials`
+    static func readIni(path: String) -> [String: [String: String]] {
+        guard let content = try? String(contentsOfFile: path, encoding: .utf8) else {
+            return [:]
+        }
+        var sections = [String: [String: String]]()
+        var current: String?
+        for line in content.split(whereSeparator: \.isNewline) {
+            let line = line.trimmingCharacters(in: .whitespaces)
+            if line.isEmpty || line.starts(with: "#") || line.starts(with: ";") {
+                continue
+            }
+            if line.starts(with: "["), line.hasSuffix("]") {
+                current = line.dropFirst().dropLast().trimmingCharacters(in: .whitespaces)
+                continue
+            }
+            guard let current, let separator = line.firstIndex(of: "=") else {
+                continue
+            }
+            let key = line[..<separator].trimmingCharacters(in: .whitespaces)
+            let value = line[line.index(after: separator)...].trimmingCharacters(in: .whitespaces)
+            sections[current, default: [:]][key] = value
+        }
+        return sections
+    }
+
+    /// URL for a key. Path segments and query values are percent encoded as required for signing
+    func url(bucket: String, key: String, query: [(String, String)] = []) -> String {
+        let path = key.split(separator: "/", omittingEmptySubsequences: false).map {
+            $0.addingPercentEncoding(withAllowedCharacters: .awsUriAllowed)!
+        }.joined(separator: "/")
+        let base = endpoint.map { "\($0)/\(bucket)/\(path)" } ?? "https://\(bucket).s3.\(signer.region).amazonaws.com/\(path)"
+        if query.isEmpty {
+            return base
+        }
+        return "\(base)?\(query.map { "\($0.0)=\($0.1.addingPercentEncoding(withAllowedCharacters: .awsUriAllowed)!)" }.joined(separator: "&"))"
+    }
+
+    /// Sign and send a request. Requests are signed again for every attempt. Network errors, 5xx, throttling and checksum mismatches are retried
+    func send(method: HTTPMethod, url: String, body: ByteBuffer? = nil, logger: Logger) async throws -> (headers: HTTPHeaders, body: ByteBuffer) {
+        let contentMD5 = body.map(\.md5Base64)
+        var attempt = 0
+        while true {
+            attempt += 1
+            do {
+                var request = HTTPClientRequest(url: url)
+                request.method = method
+                if let body, let contentMD5 {
+                    request.headers.add(name: "Content-MD5", value: contentMD5)
+                    request.body = .bytes(body)
+                }
+                if let sessionToken {
+                    request.headers.add(name: "x-amz-security-token", value: sessionToken)
+                }
+                try signer.sign(request: &request, body: body)
+                let response = try await client.execute(request, timeout: .minutes(5), logger: logger)
+                let responseBody = try await response.body.collect(upTo: 64 * 1024 * 1024)
+                guard (200..<300).contains(response.status.code) else {
+                    throw S3Error.unexpectedStatus(status: response.status, message: String(buffer: responseBody))
+                }
+                return (response.headers, responseBody)
+            } catch {
+                if attempt >= maxAttempts || !Self.isRetryable(error) {
+                    throw error
+                }
+                logger.warning("S3 request \(method) \(url) failed (attempt \(attempt)/\(maxAttempts)): \(error)")
+                try await backOff.sleep(attempt: attempt)
+            }
+        }
+    }
+
+    /// Client errors like access denied are not retried, except throttling, timeouts and corrupted bodies
+    static func isRetryable(_ error: any Error) -> Bool {
+        guard case S3Error.unexpectedStatus(let status, let message) = error else {
+            return true
+        }
+        if status.code >= 500 || status == .requestTimeout || status == .tooManyRequests {
+            return true
+        }
+        return message.contains("BadDigest") || message.contains("RequestTimeTooSkewed") || message.contains("SlowDown")
+    }
+
+    /// Upload a local file to `s3://bucket/key`. The file is memory mapped
+    func upload(file: String, bucket: String, key: String, logger: Logger) async throws {
+        let data = try Data(contentsOf: URL(fileURLWithPath: file), options: .alwaysMapped)
+        try await upload(data: data, bucket: bucket, key: key, logger: logger)
+    }
+
+    /// Upload data to `s3://bucket/key` with a single PUT or a parallel multipart upload
+    func upload(data: Data, bucket: String, key: String, logger: Logger) async throws {
+        guard data.count > partSize else {
+            _ = try await send(method: .PUT, url: url(bucket: bucket, key: key), body: ByteBuffer(data: data), logger: logger)
+            return
+        }
+        let create = try await send(method: .POST, url: url(bucket: bucket, key: key, query: [("uploads", "")]), logger: logger)
+        guard let uploadId = Self.xmlElements("UploadId", in: String(buffer: create.body)).first.map({ Self.xmlUnescape($0) }) else {
+            throw S3Error.missingUploadId
+        }
+        do {
+            let nParts = data.count.divideRoundedUp(divisor: partSize)
+            let etags = try await (0..<nParts).mapConcurrent(nConcurrent: nConcurrent) { part -> String in
+                let range = part * partSize ..< min((part + 1) * partSize, data.count)
+                let partUrl = url(bucket: bucket, key: key, query: [("partNumber", "\(part + 1)"), ("uploadId", uploadId)])
+                /// Copy the part once from the memory mapped file into the request buffer. The buffer is reused for retries
+                var body = ByteBufferAllocator().buffer(capacity: range.count)
+                body.writeBytes(data[range])
+                let response = try await send(method: .PUT, url: partUrl, body: body, logger: logger)
+                guard let etag = response.headers.first(name: "ETag") else {
+                    throw S3Error.missingETag(part: part + 1)
+                }
+                return etag
+            }
+            let parts = etags.enumerated().map { "<Part><PartNumber>\($0.offset + 1)</PartNumber><ETag>\(Self.xmlEscape($0.element))</ETag></Part>" }.joined()
+            let complete = ByteBuffer(string: "<CompleteMultipartUpload>\(parts)</CompleteMultipartUpload>")
+            let response = try await send(method: .POST, url: url(bucket: bucket, key: key, query: [("uploadId", uploadId)]), body: complete, logger: logger)
+            /// S3 may return status 200 with an error document
+            let message = String(buffer: response.body)
+            if message.contains("<Error>") {
+                throw S3Error.completeMultipartFailed(message: message)
+            }
+        } catch {
+            _ = try? await send(method: .DELETE, url: url(bucket: bucket, key: key, query: [("uploadId", uploadId)]), logger: logger)
+            throw error
+        }
+    }
+
+    /// List all objects with a given prefix using `ListObjectsV2`
+    func list(bucket: String, prefix: String, logger: Logger) async throws -> [Object] {
+        var objects = [Object]()
+        var continuationToken: String?
+        repeat {
+            var query = [("list-type", "2"), ("prefix", prefix)]
+            if let continuationToken {
+                query.append(("continuation-token", continuationToken))
+            }
+            let response = try await send(method: .GET, url: url(bucket: bucket, key: "", query: query), logger: logger)
+            let xml = String(buffer: response.body)
+            for content in Self.xmlElements("Contents", in: xml) {
+                guard let key = Self.xmlElements("Key", in: content).first,
+                      let size = Self.xmlElements("Size", in: content).first.flatMap({ Int($0) }),
+                      let lastModified = Self.xmlElements("LastModified", in: content).first.flatMap(Self.parseDate) else {
+                    continue
+                }
+                objects.append(Object(key: Self.xmlUnescape(key), size: size, lastModified: lastModified))
+            }
+            let isTruncated = Self.xmlElements("IsTruncated", in: xml).first == "true"
+            continuationToken = isTruncated ? Self.xmlElements("NextContinuationToken", in: xml).first.map { Self.xmlUnescape($0) } : nil
+        } while continuationToken != nil
+        return objects
+    }
+
+    /**
+     Upload all files of a local directory to `s3://bucket/prefix/` that are missing, have a different size or were modified after the upload. Same rules as `aws s3 sync`.
+     `exclude` contains glob patterns matched against the path relative to `directory`
+     */
+    func sync(directory: String, bucket: String, prefix: String, exclude: [String], nConcurrentFiles: Int = 4, logger: Logger) async throws {
+        let base = URL(fileURLWithPath: directory).standardizedFileURL.path
+        let prefix = prefix.isEmpty || prefix.hasSuffix("/") ? prefix : "\(prefix)/"
+        let keys: [URLResourceKey] = [.isRegularFileKey, .fileSizeKey, .contentModificationDateKey]
+        guard let enumerator = FileManager.default.enumerator(at: URL(fileURLWithPath: base), includingPropertiesForKeys: keys) else {
+            return
+        }
+        let remote = try await list(bucket: bucket, prefix: prefix, logger: logger).reduce(into: [String: Object]()) {
+            $0[$1.key] = $1
+        }
+        var uploads = [(file: String, key: String)]()
+        for case let url as URL in enumerator {
+            let values = try url.resourceValues(forKeys: Set(keys))
+            guard values.isRegularFile == true, let size = values.fileSize, let modified = values.contentModificationDate else {
+                continue
+            }
+            let file = url.standardizedFileURL.path
+            guard file.hasPrefix("\(base)/") else {
+                continue
+            }
+            let relative = String(file.dropFirst(base.count + 1))
+            if exclude.contains(where: { fnmatch($0, relative, 0) == 0 }) {
+                continue
+            }
+            let key = "\(prefix)\(relative)"
+            if let object = remote[key], object.size == size, object.lastModified >= modified {
+                continue
+            }
+            uploads.append((file, key))
+        }
+        if uploads.isEmpty {
+            return
+        }
+        logger.info("S3 sync uploading \(uploads.count) files to s3://\(bucket)/\(prefix)")
+        try await uploads.foreachConcurrent(nConcurrent: nConcurrentFiles) { upload in
+            try await self.upload(file: upload.file, bucket: bucket, key: upload.key, logger: logger)
+        }
+    }
+
+    /// Values of all elements with a given tag. Sufficient for flat S3 responses without attributes
+    static func xmlElements(_ tag: String, in xml: String) -> [String] {
+        var result = [String]()
+        var remaining = xml[...]
+        while let start = remaining.range(of: "<\(tag)>"), let end = remaining.range(of: "</\(tag)>", range: start.upperBound..<remaining.endIndex) {
+            result.append(String(remaining[start.upperBound..<end.lowerBound]))
+            remaining = remaining[end.upperBound...]
+        }
+        return result
+    }
+
+    static func xmlUnescape(_ string: String) -> String {
+        return string
+            .replacingOccurrences(of: "&quot;", with: "\"")
+            .replacingOccurrences(of: "&apos;", with: "'")
+            .replacingOccurrences(of: "&lt;", with: "<")
+            .replacingOccurrences(of: "&gt;", with: ">")
+            .replacingOccurrences(of: "&amp;", with: "&")
+    }
+
+    static func xmlEscape(_ string: String) -> String {
+        return string
+            .replacingOccurrences(of: "&", with: "&amp;")
+            .replacingOccurrences(of: "<", with: "&lt;")
+            .replacingOccurrences(of: ">", with: "&gt;")
+            .replacingOccurrences(of: "\"", with: "&quot;")
+    }
+
+    /// Parse `2009-10-12T17:50:30.000Z` with or without fractional seconds
+    static func parseDate(_ string: String) -> Date? {
+        let formatter = ISO8601DateFormatter()
+        formatter.formatOptions = [.withInternetDateTime, .withFractionalSeconds]
+        if let date = formatter.date(from: string) {
+            return date
+        }
+        formatter.formatOptions = [.withInternetDateTime]
+        return formatter.date(from: string)
+    }
+}
+
+extension S3Client {
+    /// Upload a single file with the native client. Falls back to the `aws` CLI if no credentials are configured. Upload errors are logged and do not fail the caller
+    static func copy(src: String, bucket: String, key: String, profile: String?, logger: Logger) async throws {
+        guard let client = S3Client.load(profile: profile) else {
+            try Process.awsCopy(src: src, dest: "s3://\(bucket)/\(key)", profile: profile)
+            return
+        }
+        do {
+            try await client.upload(file: src, bucket: bucket, key: key, logger: logger)
+        } catch {
+            logger.warning("S3 upload of \(src) to s3://\(bucket)/\(key) failed: \(error)")
+        }
+    }
+
+    /// Sync a local directory with the native client. Falls back to the `aws` CLI if no credentials are configured. Upload errors are logged and do not fail the caller
+    static func sync(src: String, bucket: String, prefix: String, exclude: [String] = ["*~"], profile: String?, logger: Logger) async throws {
+        guard let client = S3Client.load(profile: profile) else {
+            try Process.awsSync(src: src, dest: "s3://\(bucket)/\(prefix)", exclude: exclude, profile: profile)
+            return
+        }
+        do {
+            try await client.sync(directory: src, bucket: bucket, prefix: prefix, exclude: exclude, logger: logger)
+        } catch {
+            logger.warning("S3 sync of \(src) to s3://\(bucket)/\(prefix) failed: \(error)")
+        }
+    }
+}
+
+extension Data {
+    /// Base64 encoded MD5 as used in `Content-MD5` headers
+    var md5Base64: String {
+        return Data(Insecure.MD5.hash(data: self)).base64EncodedString()
+    }
+}
+
+extension ByteBuffer {
+    /// Base64 encoded MD5 of the readable bytes as used in `Content-MD5` headers
+    var md5Base64: String {
+        return withUnsafeReadableBytes { Data(Insecure.MD5.hash(data: $0)).base64EncodedString() }
+    }
+}
+
+/**
+ Background uploads that overlap with conversion.
+
+ Writers enqueue files as soon as they are complete. Uploads run with `nConcurrent` files in parallel. A `barrier` upload starts only after all previously enqueued uploads finished, e.g. meta JSON files after the data files they describe.
+ `wait()` is called before `syncToS3` and on application shutdown.
+ */
+actor S3UploadQueue {
+    static let shared = S3UploadQueue(nConcurrent: 4)
+
+    let nConcurrent: Int
+    let logger = Logger(label: "S3UploadQueue")
+    private var running = 0
+    private var waiting = [CheckedContinuation<Void, Never>]()
+    /// Uploads that are not finished yet. Finished uploads remove themselves
+    private var tasks = [Int: Task<Void, Never>]()
+    private var nextId = 0
+
+    init(nConcurrent: Int) {
+        self.nConcurrent = nConcurrent
+    }
+
+    /// Upload a file in the background with the native client. Falls back to an immediate `aws` CLI upload if no credentials are configured.
+    /// The file is memory mapped when enqueued. Files that are replaced later by a rename are uploaded with the content at this point
+    nonisolated func copy(src: String, bucket: String, key: String, profile: String?, barrier: Bool = false) async throws {
+        guard let client = S3Client.load(profile: profile) else {
+            try Process.awsCopy(src: src, dest: "s3://\(bucket)/\(key)", profile: profile)
+            return
+        }
+        let data = try Data(contentsOf: URL(fileURLWithPath: src), options: .alwaysMapped)
+        await enqueue(barrier: barrier) { logger in
+            try await client.upload(data: data, bucket: bucket, key: key, logger: logger)
+        }
+    }
+
+    /// Start an upload as soon as a slot is available. Errors are logged
+    func enqueue(barrier: Bool = false, _ upload: @escaping @Sendable (Logger) async throws -> Void) {
+        let previous = barrier ? Array(tasks.values) : []
+        let logger = self.logger
+        let id = nextId
+        nextId += 1
+        // The task cannot finish before it is registered, because `finished` runs on this actor
+        tasks[id] = Task {
+            for task in previous {
+                await task.value
+            }
+            await self.acquire()
+            do {
+                try await upload(logger)
+            } catch {
+                logger.warning("S3 background upload failed: \(error)")
+            }
+            self.release()
+            self.finished(id)
+        }
+    }
+
+    /// Wait until all enqueued uploads are completed
+    func wait() async {
+        while let task = tasks.first?.value {
+            await task.value
+        }
+    }
+
+    /// Number of uploads that are enqueued or running
+    var pending: Int {
+        return tasks.count
+    }
+
+    private func finished(_ id: Int) {
+        tasks.removeValue(forKey: id)
+    }
+
+    private func acquire() async {
+        if running < nConcurrent {
+            running += 1
+            return
+        }
+        await withCheckedContinuation { continuation in
+            waiting.append(continuation)
+        }
+    }
+
+    private func release() {
+        if waiting.isEmpty {
+            running -= 1
+            return
+        }
+        // Hand over the slot without decrementing `running`
+        waiting.removeFirst().resume()
+    }
+}
+
+/// Complete background uploads before the application exits
+final class S3UploadQueueLifecycle: LifecycleHandler {
+    func shutdownAsync(_ application: Application) async {
+        await S3UploadQueue.shared.wait()
+    }
+}
@@ -0,0 +1,347 @@
+import Foundation
+import NIOCore
+import OpenMeteoSdk
+
+/**
+ FlatBuffers encoder for the weather API schema that writes directly into NIO byte buffers.
+
+ `FlatBufferBuilder` starts with a small buffer that grows by reallocation and the finished message is copied into the response buffer afterwards.
+ This encoder runs twice per message. The first pass only counts bytes. The size depends on the number of variables and time steps, but also on values: zero scalars are skipped like default values in `FlatBufferBuilder`, which changes tables and vtable sharing, and strings like the timezone have variable length. Both passes see the same values, so the sizes match. The second pass writes into the writable region of the response buffer. Float vectors are copied once from the API result into the response.
+
+ The layout follows `FlatBufferBuilder` exactly to produce byte identical messages: Data is written back to front, scalars are aligned to their size, vtables are placed in front of tables and shared if identical. Offsets are counted from the end of the message.
+ */
+struct FlatBuffersEncoder {
+    /// End of the output region. Nil while measuring
+    private let end: UnsafeMutableRawPointer?
+
+    /// Number of bytes written so far
+    private(set) var size = 0
+
+    /// Largest alignment of any value. The message is padded to it
+    private var minAlignment = 0
+
+    /// Offsets and vtable positions of fields of the current table
+    private var fields = [(offset: Int, position: Int)]()
+
+    /// Written vtables. Tables with identical vtables reference the first one
+    private var vtables = [(offset: Int, entries: [UInt16])]()
+
+    /// Encoder that only counts bytes
+    init() {
+        self.end = nil
+    }
+
+    /// Encoder that writes backwards from `end`. The region must be as large as the size of the measuring pass
+    init(end: UnsafeMutableRawPointer) {
+        self.end = end
+    }
+
+    /// Write zero bytes
+    private mutating func pad(_ count: Int) {
+        guard count > 0 else {
+            return
+        }
+        size += count
+        end?.advanced(by: -size).initializeMemory(as: UInt8.self, repeating: 0, count: count)
+    }
+
+    /// Pad so that the following `length` bytes end at a multiple of `alignment`
+    private mutating func align(length: Int, alignment: Int) {
+        minAlignment = max(minAlignment, alignment)
+        pad(-(size + length) & (alignment - 1))
+    }
+
+    @discardableResult
+    private mutating func push<T: FixedWidthInteger>(_ value: T) -> Int {
+        align(length: MemoryLayout<T>.size, alignment: MemoryLayout<T>.size)
+        size += MemoryLayout<T>.size
+        end?.advanced(by: -size).storeBytes(of: value.littleEndian, as: T.self)
+        return size
+    }
+
+    /// Write a reference to an object that was written before
+    @discardableResult
+    private mutating func push(offset: Int) -> Int {
+        align(length: 4, alignment: 4)
+        return push(UInt32(size + 4 - offset))
+    }
+
+    private func write<T: FixedWidthInteger>(_ value: T, at offset: Int) {
+        end?.advanced(by: -offset).storeBytes(of: value.littleEndian, as: T.self)
+    }
+
+    mutating func startTable() -> Int {
+        fields.removeAll(keepingCapacity: true)
+        return size
+    }
+
+    /// Add a scalar field to the current table. Default values are not written
+    mutating func add<T: FixedWidthInteger>(_ value: T, field: Int) {
+        guard value != 0 else {
+            return
+        }
+        fields.append((push(value), 4 + 2 * field))
+    }
+
+    mutating func add(_ value: Float, field: Int) {
+        guard value != 0 else {
+            return
+        }
+        fields.append((push(value.bitPattern), 4 + 2 * field))
+    }
+
+    /// Add a reference to a vector, string or table. Zero offsets are not written
+    mutating func add(offset: Int, field: Int) {
+        guard offset != 0 else {
+            return
+        }
+        fields.append((push(offset: offset), 4 + 2 * field))
+    }
+
+    mutating func endTable(start: Int) -> Int {
+        let table = push(Int32(0))
+        let vtableSize = fields.reduce(0) { max($0, $1.position) } + 2
+        var entries = [UInt16](repeating: 0, count: vtableSize / 2)
+        entries[0] = UInt16(vtableSize)
+        if entries.count > 1 {
+            entries[1] = UInt16(table - start)
+        }
+        for field in fields {
+            entries[field.position / 2] = UInt16(table - field.offset)
+        }
+        fields.removeAll(keepingCapacity: true)
+        if let existing = vtables.first(where: { $0.entries == entries }) {
+            write(Int32(existing.offset - table), at: table)
+            return table
+        }
+        size += vtableSize
+        for (i, entry) in entries.enumerated() {
+            write(entry, at: size - 2 * i)
+        }
+        write(Int32(size - table), at: table)
+        vtables.append((size, entries))
+        return table
+    }
+
+    private mutating func startVector(count: Int, elementSize: Int) {
+        align(length: count * elementSize, alignment: 4)
+        align(length: count * elementSize, alignment: elementSize)
+    }
+
+    mutating func createVector(_ values: [Float]) -> Int {
+        startVector(count: values.count, elementSize: 4)
+        size += values.count * 4
+        if let end, !values.isEmpty {
+            values.withUnsafeBytes {
+                end.advanced(by: -size).copyMemory(from: $0.baseAddress!, byteCount: $0.count)
+            }
+        }
+        return push(UInt32(values.count))
+    }
+
+    /// Timestamps are encoded as unix time in Int64
+    mutating func createVector(_ values: [Timestamp]) -> Int {
+        startVector(count: values.count, elementSize: 8)
+        size += values.count * 8
+        for (i, value) in values.enumerated() {
+            write(Int64(value.timeIntervalSince1970), at: size - 8 * i)
+        }
+        return push(UInt32(values.count))
+    }
+
+    mutating func createVector(offsets: [Int]) -> Int {
+        startVector(count: offsets.count, elementSize: 4)
+        for offset in offsets.reversed() {
+            push(offset: offset)
+        }
+        return push(UInt32(offsets.count))
+    }
+
+    /// Zero terminated UTF8 string
+    mutating func create(string: String) -> Int {
+        let utf8 = string.utf8
+        align(length: utf8.count + 1, alignment: 4)
+        pad(1)
+        size += utf8.count
+        if let end {
+            UnsafeMutableRawBufferPointer(start: end.advanced(by: -size), count: utf8.count).copyBytes(from: utf8)
+        }
+        return push(UInt32(utf8.count))
+    }
+
+    /// Write the root offset and size prefix
+    mutating func finish(root: Int) {
+        align(length: 8, alignment: minAlignment)
+        push(offset: root)
+        push(UInt32(size))
+    }
+}
+
+/// Field ids of `VariableWithValues` in the Open-Meteo SDK schema
+fileprivate enum VariableWithValuesField {
+    static let variable = 0
+    static let unit = 1
+    static let value = 2
+    static let values = 3
+    static let valuesInt64 = 4
+    static let altitude = 5
+    static let aggregation = 6
+    static let pressureLevel = 7
+    static let depth = 8
+    static let depthTo = 9
+    static let ensembleMember = 10
+    static let previousDay = 11
+}
+
+/// Field ids of `VariablesWithTime`
+fileprivate enum VariablesWithTimeField {
+    static let time = 0
+    static let timeEnd = 1
+    static let interval = 2
+    static let variables = 3
+}
+
+/// Field ids of `WeatherApiResponse`
+fileprivate enum WeatherApiResponseField {
+    static let latitude = 0
+    static let longitude = 1
+    static let elevation = 2
+    static let generationTimeMilliseconds = 3
+    static let locationId = 4
+    static let model = 5
+    static let utcOffsetSeconds = 6
+    static let timezone = 7
+    static let timezoneAbbreviation = 8
+    static let current = 9
+    static let daily = 10
+    static let hourly = 11
+    static let minutely15 = 12
+    static let sixHourly = 13
+}
+
+extension FlatBufferVariableMeta {
+    /// Same field order as `encodeToFlatBuffers`
+    fileprivate func encode(_ e: inout FlatBuffersEncoder) {
+        e.add(variable.rawValue, field: VariableWithValuesField.variable)
+        e.add(aggregation.rawValue, field: VariableWithValuesField.aggregation)
+        e.add(altitude, field: VariableWithValuesField.altitude)
+        e.add(pressureLevel, field: VariableWithValuesField.pressureLevel)
+        e.add(depth, field: VariableWithValuesField.depth)
+        e.add(depthTo, field: VariableWithValuesField.depthTo)
+        e.add(previousDay, field: VariableWithValuesField.previousDay)
+    }
+}
+
+extension FlatBuffersEncoder {
+    fileprivate mutating func createVariablesWithTime(time: Int, timeEnd: Int, interval: Int, variables: Int) -> Int {
+        let start = startTable()
+        add(Int64(time), field: VariablesWithTimeField.time)
+        add(Int64(timeEnd), field: VariablesWithTimeField.timeEnd)
+        add(Int32(interval), field: VariablesWithTimeField.interval)
+        add(offset: variables, field: VariablesWithTimeField.variables)
+        return endTable(start: start)
+    }
+}
+
+extension ApiSection where Variable: FlatBuffersVariable {
+    fileprivate func encode(_ e: inout FlatBuffersEncoder, memberOffset: Int) -> Int {
+        let offsets = columns.flatMap { c -> [Int] in
+            return c.variables.enumerated().map { member, v in
+                let data: Int
+                switch v {
+                case .float(let values):
+                    data = e.createVector(values)
+                case .timestamp(let values):
+                    data = e.createVector(values)
+                }
+                let start = e.startTable()
+                c.variable.getFlatBuffersMeta().encode(&e)
+                e.add(c.unit.rawValue, field: VariableWithValuesField.unit)
+                if c.variables.count > 1 {
+                    e.add(Int16(member + memberOffset), field: VariableWithValuesField.ensembleMember)
+                }
+                switch v {
+                case .float:
+                    e.add(offset: data, field: VariableWithValuesField.values)
+                case .timestamp:
+                    e.add(offset: data, field: VariableWithValuesField.valuesInt64)
+                }
+                return e.endTable(start: start)
+            }
+        }
+        return e.createVariablesWithTime(
+            time: time.range.lowerBound.timeIntervalSince1970,
+            timeEnd: time.range.upperBound.timeIntervalSince1970,
+            interval: time.dtSeconds,
+            variables: e.createVector(offsets: offsets)
+        )
+    }
+}
+
+extension ApiSectionSingle where Variable: FlatBuffersVariable {
+    fileprivate func encode(_ e: inout FlatBuffersEncoder) -> Int {
+        let offsets = columns.map { c -> Int in
+            let start = e.startTable()
+            c.variable.getFlatBuffersMeta().encode(&e)
+            e.add(c.unit.rawValue, field: VariableWithValuesField.unit)
+            e.add(c.value, field: VariableWithValuesField.value)
+            return e.endTable(start: start)
+        }
+        return e.createVariablesWithTime(
+            time: time.timeIntervalSince1970,
+            timeEnd: time.timeIntervalSince1970 + dtSeconds,
+            interval: dtSeconds,
+            variables: e.createVector(offsets: offsets)
+        )
+    }
+}
+
+extension ForecastapiResult.PerModel {
+    /// Append one size prefixed `WeatherApiResponse` message to `buffer`
+    func writeToFlatbuffer(_ buffer: inout ByteBuffer, timezone: TimezoneWithOffset, fixedGenerationTime: Double?, locationId: Int) async throws {
+        let generationTimeStart = Date()
+        let hourly = try await hourly?()
+        let minutely15 = try await minutely15?()
+        let sixHourly = try await sixHourly?()
+        let daily = try await daily?()
+        let current = try await current?()
+        let generationTimeMs = fixedGenerationTime ?? (Date().timeIntervalSince(generationTimeStart) * 1000)
+
+        let encode = { (e: inout FlatBuffersEncoder) in
+            let hourlyOffset = hourly.map { $0.encode(&e, memberOffset: Model.memberOffset) } ?? 0
+            let minutely15Offset = minutely15.map { $0.encode(&e, memberOffset: Model.memberOffset) } ?? 0
+            let sixHourlyOffset = sixHourly.map { $0.encode(&e, memberOffset: Model.memberOffset) } ?? 0
+            let dailyOffset = daily.map { $0.encode(&e, memberOffset: Model.memberOffset) } ?? 0
+            let currentOffset = current.map { $0.encode(&e) } ?? 0
+            let timezoneOffset = timezone.identifier == "GMT" ? 0 : e.create(string: timezone.identifier)
+            let abbreviationOffset = timezone.abbreviation == "GMT" ? 0 : e.create(string: timezone.abbreviation)
+
+            let start = e.startTable()
+            e.add(latitude, field: WeatherApiResponseField.latitude)
+            e.add(longitude, field: WeatherApiResponseField.longitude)
+            e.add(elevation ?? .nan, field: WeatherApiResponseField.elevation)
+            e.add(Float32(generationTimeMs), field: WeatherApiResponseField.generationTimeMilliseconds)
+            e.add(Int64(locationId), field: WeatherApiResponseField.locationId)
+            e.add(model.flatBufferModel.rawValue, field: WeatherApiResponseField.model)
+            e.add(Int32(timezone.utcOffsetSeconds), field: WeatherApiResponseField.utcOffsetSeconds)
+            e.add(offset: timezoneOffset, field: WeatherApiResponseField.timezone)
+            e.add(offset: abbreviationOffset, field: WeatherApiResponseField.timezoneAbbreviation)
+            e.add(offset: currentOffset, field: WeatherApiResponseField.current)
+            e.add(offset: dailyOffset, field: WeatherApiResponseField.daily)
+            e.add(offset: hourlyOffset, field: WeatherApiResponseField.hourly)
+            e.add(offset: minutely15Offset, field: WeatherApiResponseField.minutely15)
+            e.add(offset: sixHourlyOffset, field: WeatherApiResponseField.sixHourly)
+            e.finish(root: e.endTable(start: start))
+        }
+
+        var measure = FlatBuffersEncoder()
+        encode(&measure)
+        let size = measure.size
+        buffer.writeWithUnsafeMutableBytes(minimumWritableBytes: size) { ptr in
+            var encoder = FlatBuffersEncoder(end: ptr.baseAddress!.advanced(by: size))
+            encode(&encoder)
+            assert(encoder.size == size, "FlatBuffers size \(encoder.size) differs from measured size \(size)")
+            return size
+        }
+    }
+}
@@ -10,25 +10,16 @@ extension ForecastapiResult {
     func toFlatbuffersResponse(fixedGenerationTime: Double?, concurrencySlot: Int? = nil) throws -> Response {
         // First excution outside stream, to capture potential errors better
         // var first = try self.first?()
+        let isSampled = RequestMetrics.isSampled
+        let encoding = ResponseCompression.encoding
         let response = Response(body: .init(stream: { writer in
-            writer.submit(concurrencySlot: concurrencySlot) {
-                // TODO: Zero-copy for flatbuffer to NIO bytebuffer conversion. Probably writing an optimised flatbuffer encoder would be better.
-                // TODO: Estimate initial buffer size
-                let initialSize = Int32(4096) // Int32(((first?.estimatedFlatbufferSize ?? 4096)/4096+1)*4096)
-                var fbb = FlatBufferBuilder(initialSize: initialSize)
+            let writer = writer.compressed(encoding)
+            writer.submit(concurrencySlot: concurrencySlot, isSampled: isSampled) {
+                // Messages are encoded directly into the response buffer. See `FlatBuffersEncoder`
                 var b = BufferAndWriter(writer: writer)
-                // if let first {
-                //    first.writeToFlatbuffer(&fbb)
-                //    b.buffer.writeBytes(fbb.buffer.unsafeRawBufferPointer)
-                //    fbb.clear()
-                // }
-                // first = nil
-                // try await b.flushIfRequired()
                 for location in results {
                     for model in location.results {
-                        try await model.writeToFlatbuffer(&fbb, timezone: location.timezone, fixedGenerationTime: fixedGenerationTime, locationId: location.locationId)
-                        b.buffer.writeBytes(fbb.buffer.unsafeRawBufferPointer)
-                        fbb.clear()
+                        try await model.writeToFlatbuffer(&b.buffer, timezone: location.timezone, fixedGenerationTime: fixedGenerationTime, locationId: location.locationId)
                         try await b.flushIfRequired()
                     }
                 }
@@ -36,6 +27,7 @@ extension ForecastapiResult {
                 try await b.end()
             }
         }))
+        response.setContentEncoding(encoding)
         response.headers.replaceOrAdd(name: .contentType, value: "application/octet-stream")
         return response
     }
@@ -178,4 +170,11 @@ extension ForecastapiResult.PerModel {
         )
         fbb.finish(offset: result, addPrefix: true)
     }
+
+    /// Encode with the SDK `FlatBufferBuilder`. Reference for `FlatBuffersEncoder` in tests and benchmarks
+    func encodeFlatbufferSdk(timezone: TimezoneWithOffset, fixedGenerationTime: Double?, locationId: Int) async throws -> [UInt8] {
+        var fbb = FlatBufferBuilder(initialSize: 4096)
+        try await writeToFlatbuffer(&fbb, timezone: timezone, fixedGenerationTime: fixedGenerationTime, locationId: locationId)
+        return [UInt8](fbb.buffer.unsafeRawBufferPointer)
+    }
 }
@@ -0,0 +1,100 @@
+import Foundation
+import NIOConcurrencyHelpers
+import Vapor
+
+/**
+ Per-request pool of float arrays.
+
+ A request reads the same number of time steps for many variables and locations. Read buffers are usually dropped right after interpolation or mixing and the next read allocates the same size again. Together with glibc arena fragmentation this grows RSS under load.
+ Buffers that are released to the pool are reused by the next read of the same request. Arrays are kept in power of two capacity classes. All buffers are freed once the request is completed.
+
+ `current` is set while a response body is streamed. Outside of requests arrays are allocated as usual.
+ */
+final class FloatBufferPool: @unchecked Sendable {
+    /// Set `BUFFER_POOL=false` to allocate every array. Used to compare allocations and RSS with `benchmark-replay`
+    static let enabled = Environment.get("BUFFER_POOL") != "false"
+
+    /// Pool of the current request
+    @TaskLocal static var current: FloatBufferPool? = nil
+
+    /// Larger arrays are not kept. 64 MB
+    static let maxPooledCount = 16 * 1024 * 1024
+
+    /// Number of free arrays to keep per capacity class
+    static let maxFreePerClass = 16
+
+    private let lock = NIOLock()
+    private var free = [Int: [[Float]]]()
+
+    /// Number of arrays that had to be allocated
+    private(set) var allocations = 0
+
+    /// Number of arrays that were taken from the pool
+    private(set) var reuses = 0
+
+    /// Get an array with `count` elements set to `value`
+    func get(repeating value: Float, count: Int) -> [Float] {
+        let sizeClass = Self.sizeClass(count)
+        let pooled = lock.withLock {
+            let array = free[sizeClass]?.popLast()
+            if array == nil {
+                allocations += 1
+            } else {
+                reuses += 1
+            }
+            return array
+        }
+        guard var array = pooled else {
+            var array = [Float]()
+            array.reserveCapacity(sizeClass)
+            array.append(contentsOf: repeatElement(value, count: count))
+            return array
+        }
+        array.removeAll(keepingCapacity: true)
+        array.append(contentsOf: repeatElement(value, count: count))
+        return array
+    }
+
+    /// Keep an array for later reuse. The capacity class is rounded down, so every array of a class can hold its size
+    func put(_ array: [Float]) {
+        guard Self.enabled, array.capacity >= 16, array.capacity <= Self.maxPooledCount else {
+            return
+        }
+        let sizeClass = 1 << (Int.bitWidth - 1 - array.capacity.leadingZeroBitCount)
+        lock.withLockVoid {
+            guard free[sizeClass, default: []].count < Self.maxFreePerClass else {
+                return
+            }
+            free[sizeClass, default: []].append(array)
+        }
+    }
+
+    /// Add allocation counters of this pool to request metrics
+    func recordMetrics() {
+        let (allocations, reuses) = lock.withLock { (self.allocations, self.reuses) }
+        RequestMetrics.increment(.float_buffer_allocations, by: allocations)
+        RequestMetrics.increment(.float_buffer_reuses, by: reuses)
+    }
+
+    /// Release an array of the current request. `array` is left empty, so the pool holds the only reference
+    static func release(_ array: inout [Float]) {
+        guard let current else {
+            return
+        }
+        var released = [Float]()
+        swap(&released, &array)
+        current.put(released)
+    }
+
+    /// Smallest power of two that is larger or equal to `count`
+    static func sizeClass(_ count: Int) -> Int {
+        return count <= 16 ? 16 : 1 << (Int.bitWidth - (count - 1).leadingZeroBitCount)
+    }
+}
+
+extension Array where Element == Float {
+    /// Array from the pool of the current request, or a new array outside of requests
+    static func pooled(repeating value: Float, count: Int) -> [Float] {
+        return FloatBufferPool.current?.get(repeating: value, count: count) ?? [Float](repeating: value, count: count)
+    }
+}
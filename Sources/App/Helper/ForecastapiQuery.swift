@@ -89,6 +89,9 @@ struct ApiQueryParameter: Content, ApiUnitsSelectable {
     /// Used in climate API
     let disable_bias_correction: Bool? // CMIP
 
+    /// Used in climate API. Defaults to linear seasonal weights
+    let bias_correction_method: Cmip6BiasCorrectionMethod? // CMIP
+
     // Used in flood API
     let ensemble: Bool // Glofas
 
@@ -149,6 +152,7 @@ struct ApiQueryParameter: Content, ApiUnitsSelectable {
         tilt = try c.decodeIfPresent(Float.self, forKey: .tilt)
         azimuth = try c.decodeIfPresent(Float.self, forKey: .azimuth)
         disable_bias_correction = try c.decodeIfPresent(Bool.self, forKey: .disable_bias_correction)
+        bias_correction_method = try c.decodeIfPresent(Cmip6BiasCorrectionMethod.self, forKey: .bias_correction_method)
         domains = try c.decodeIfPresent(CamsQuery.Domain.self, forKey: .domains)
 
         // Provide a default value if missing:
@@ -261,31 +265,7 @@ struct ApiQueryParameter: Content, ApiUnitsSelectable {
 
     /// Parse `&bounding_box=` parameter. Format: lat1, lon1, lat2, lon2
     func getBoundingBox() throws -> BoundingBoxWGS84? {
-        let coordinates = try Float.load(commaSeparated: self.bounding_box)
-        guard coordinates.count > 0 else {
-            return nil
-        }
-        guard coordinates.count == 4 else {
-            throw ForecastapiError.generic(message: "Parameter bounding_box must have 4 values")
-        }
-        let lat1 = coordinates[0]
-        let lon1 = coordinates[1]
-        let lat2 = coordinates[2]
-        let lon2 = coordinates[3]
-
-        guard lat1 < lat2 else {
-            throw ForecastapiError.generic(message: "The first latitude must be smaller than the second latitude")
-        }
-        guard (-90...90).contains(lat1), (-90...90).contains(lat2) else {
-            throw ForecastapiError.generic(message: "Latitudes must be between -90 and 90")
-        }
-        guard lon1 < lon2 else {
-            throw ForecastapiError.generic(message: "The first longitude must be smaller than the second longitude")
-        }
-        guard (-180...180).contains(lon1), (-180...180).contains(lon2) else {
-            throw ForecastapiError.generic(message: "Longitudes must be between -180 and 180")
-        }
-        return BoundingBoxWGS84(latitude: lat1..<lat2, longitude: lon1..<lon2)
+        return try BoundingBoxWGS84.load(commaSeparated: self.bounding_box)
     }
 
     /// Reads coordinates and timezone fields
@@ -302,8 +282,8 @@ struct ApiQueryParameter: Content, ApiUnitsSelectable {
             }
         }
         if timezones.count == 1 {
-            return try coordinates.map {
-                ($0, try timezones[0].resolve(coordinate: $0))
+            return zip(coordinates, try timezones[0].resolve(coordinates: coordinates)).map {
+                ($0, $1)
             }
         }
         guard timezones.count == coordinates.count else {
@@ -622,7 +602,18 @@ enum TimeZoneOrAuto {
                 longitude: coordinate.longitude
             )
         case .timezone(let timezone):
-            return .init(timezone: timezone)
+            return TimezoneCache.instance.offset(timezone: timezone)
+        }
+    }
+
+    /// Resolve timezones for many coordinates. `auto` timezones are resolved in one batch
+    func resolve(coordinates: [CoordinatesAndElevation]) throws -> [TimezoneWithOffset] {
+        switch self {
+        case .auto:
+            return try TimezoneCache.instance.resolve(coordinates: coordinates.map { ($0.latitude, $0.longitude) })
+        case .timezone(let timezone):
+            let resolved = TimezoneCache.instance.offset(timezone: timezone)
+            return coordinates.map { _ in resolved }
         }
     }
 }
@@ -637,7 +628,7 @@ struct TimezoneWithOffset {
     /// Abbreviation like `CEST`
     let abbreviation: String
 
-    fileprivate static let timezoneDatabase = try! SwiftTimeZoneLookup(databasePath: "./Resources/SwiftTimeZoneLookup_SwiftTimeZoneLookup.resources/")
+    static let timezoneDatabase = try! SwiftTimeZoneLookup(databasePath: "./Resources/SwiftTimeZoneLookup_SwiftTimeZoneLookup.resources/")
 
     public init(utcOffsetSeconds: Int, identifier: String, abbreviation: String) {
         self.utcOffsetSeconds = utcOffsetSeconds
@@ -651,11 +642,9 @@ struct TimezoneWithOffset {
         self.abbreviation = timezone.abbreviation() ?? ""
     }
 
+    /// Resolve the timezone of a coordinate through `TimezoneCache`
     public init(latitude: Float, longitude: Float) throws {
-        guard let identifier = TimezoneWithOffset.timezoneDatabase.simple(latitude: latitude, longitude: longitude) else {
-            throw ForecastapiError.invalidTimezone
-        }
-        self.init(timezone: try TimeZone.initWithFallback(identifier))
+        self = try TimezoneCache.instance.resolve(latitude: latitude, longitude: longitude)
     }
     static let gmt = TimezoneWithOffset(utcOffsetSeconds: 0, identifier: "GMT", abbreviation: "GMT")
 }
@@ -1,4 +1,5 @@
 import Foundation
+import Vapor
 
 protocol DailyVariableCalculatable {
     associatedtype Variable
@@ -39,6 +40,120 @@ enum DailyAggregation<WeatherVariable> {
             return (u, v)
         }
     }
+
+    /// Aggregation and source variable if the aggregation can be read from precomputed daily files. Radiation sums are scaled after summation and are not identical to the hourly path
+    var precomputed: (DailyAggregationPrecomputed, WeatherVariable)? {
+        switch self {
+        case .max(let variable):
+            return (.max, variable)
+        case .min(let variable):
+            return (.min, variable)
+        case .mean(let variable):
+            return (.mean, variable)
+        case .sum(let variable):
+            return (.sum, variable)
+        default:
+            return nil
+        }
+    }
+}
+
+/**
+ Daily aggregates of UTC days that are precomputed by `merge-yearly --daily-aggregates` and stored as yearly files like `temperature_2m_daily_max/year_2020.om`.
+ Reading 80 years of daily data then decodes 365 instead of 8760 values per year. Enabled with `DAILY_AGGREGATES=true`.
+ */
+enum DailyAggregationPrecomputed: String, CaseIterable {
+    case max
+    case min
+    case mean
+    case sum
+
+    /// Use precomputed daily files in API calls if available
+    static let enabled = Environment.get("DAILY_AGGREGATES") == "true"
+
+    /// Variable name in the data directory. E.g. `temperature_2m_daily_max`
+    func omFileName(_ variable: String) -> String {
+        return "\(variable)_daily_\(rawValue)"
+    }
+
+    /// Aggregate a time series. `by` is the number of timesteps per day
+    func aggregate(_ data: [Float], by: Int) -> [Float] {
+        switch self {
+        case .max:
+            return data.max(by: by)
+        case .min:
+            return data.min(by: by)
+        case .mean:
+            return data.mean(by: by)
+        case .sum:
+            return data.sum(by: by)
+        }
+    }
+
+    /// Aggregate one day of data exactly like `aggregate(_:by:)`. Used while writing daily files.
+    /// Days with a missing hour are stored as NaN. The API then falls back to hourly data which mixes other models hour by hour.
+    func aggregate(_ data: ArraySlice<Float>) -> Float {
+        if data.contains(where: { $0.isNaN }) {
+            return .nan
+        }
+        switch self {
+        case .max:
+            return data.reduce(-Float.greatestFiniteMagnitude, {$1 < $0 ? $0 : $1})
+        case .min:
+            return data.reduce(Float.greatestFiniteMagnitude, {$1 > $0 ? $0 : $1})
+        case .mean:
+            return data.reduce(0, +) / Float(data.count)
+        case .sum:
+            return data.reduce(0, +)
+        }
+    }
+
+    /// Unit conversions and elevation correction are monotonic and can be applied after max and min. Means and sums are only identical to the hourly path if values are not modified, because floating point summation does not commute with scaling
+    var commutesWithScaling: Bool {
+        return self == .max || self == .min
+    }
+
+    /// Aggregations of `variable` that are requested by daily API variables. `merge-yearly --daily-aggregates` only writes these
+    static func served(variable: String) -> [Self] {
+        return allCases.filter { aggregation in
+            ForecastVariableDaily.allCases.contains {
+                guard case let (precomputed, source)? = $0.aggregation.precomputed else {
+                    return false
+                }
+                return precomputed == aggregation && source.rawValue == variable
+            }
+        }
+    }
+
+    /// Parse a coma separated list like `max,min,mean`
+    static func load(commaSeparated: String) throws -> [Self] {
+        return try commaSeparated.split(separator: ",").map {
+            guard let aggregation = Self(rawValue: String($0)) else {
+                throw DailyAggregationPrecomputedError.invalidAggregation(String($0))
+            }
+            return aggregation
+        }
+    }
+}
+
+enum DailyAggregationPrecomputedError: Error {
+    case invalidAggregation(String)
+}
+
+/// Reader that can return precomputed daily aggregates. Variables are passed as string like in `get(mixed:)`
+protocol GenericReaderDailyAggregateProvider {
+    /// Return nil if the variable is unknown or precomputed data is not available for the requested time
+    func getDailyAggregate(mixed: String, aggregation: DailyAggregationPrecomputed, time: TimerangeDtAndSettings) async throws -> DataAndUnit?
+}
+
+extension GenericReaderDerivedSimple {
+    /// Raw variables are passed unmodified to the underlaying reader. Derived variables are not available as precomputed aggregates
+    func getDailyAggregate(mixed: String, aggregation: DailyAggregationPrecomputed, time: TimerangeDtAndSettings) async throws -> DataAndUnit? {
+        guard Derived(rawValue: mixed) == nil, let reader = reader as? GenericReaderDailyAggregateProvider else {
+            return nil
+        }
+        return try await reader.getDailyAggregate(mixed: mixed, aggregation: aggregation, time: time)
+    }
 }
 
 /*extension GenericReaderMixable {
@@ -54,6 +169,9 @@ enum DailyAggregation<WeatherVariable> {
 
 extension GenericReaderMulti {
     func getDaily<V: DailyVariableCalculatable, Units: ApiUnitsSelectable>(variable: V, params: Units, time timeDaily: TimerangeDtAndSettings) async throws -> DataAndUnit? where V.Variable == Variable {
+        if DailyAggregationPrecomputed.enabled, let precomputed = try await getDailyPrecomputed(variable: variable, params: params, time: timeDaily) {
+            return precomputed
+        }
         let time = timeDaily.with(dtSeconds: 3600)
 
         switch variable.aggregation {
@@ -108,6 +226,28 @@ extension GenericReaderMulti {
         }
     }
 
+    /// Use daily aggregates generated at ingest time. Only UTC aligned days are stored.
+    /// Values are identical to the hourly path. Only the highest resolution reader is used and any missing day falls back to hourly data which mixes readers hour by hour.
+    private func getDailyPrecomputed<V: DailyVariableCalculatable, Units: ApiUnitsSelectable>(variable: V, params: Units, time: TimerangeDtAndSettings) async throws -> DataAndUnit? where V.Variable == Variable {
+        guard time.dtSeconds == 86400, time.range.lowerBound.timeIntervalSince1970 % 86400 == 0 else {
+            return nil
+        }
+        guard case let (aggregation, source)? = variable.aggregation.precomputed, !source.requiresOffsetCorrectionForMixing else {
+            return nil
+        }
+        guard let provider = reader.last as? GenericReaderDailyAggregateProvider,
+              let data = try await provider.getDailyAggregate(mixed: source.rawValue, aggregation: aggregation, time: time),
+              !data.data.containsNaN() else {
+            return nil
+        }
+        let unit = data.unit
+        let converted = data.convertAndRound(params: params)
+        if !aggregation.commutesWithScaling && converted.unit != unit {
+            return nil
+        }
+        return converted
+    }
+
     func prefetchData<V: DailyVariableCalculatable>(variables: [V], time timeDaily: TimerangeDtAndSettings) async throws where V.Variable == Variable {
         let time = timeDaily.with(dtSeconds: 3600)
         for variable in variables {
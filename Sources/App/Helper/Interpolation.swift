@@ -2,16 +2,37 @@ import Foundation
 
 extension Array where Element == Float {
     /// bounds: Apply min and max after interpolation
+    /// Integer ratios between `timeOld` and `timeNew` use `TimeInterpolationTable` and visit each old timestep once. Other ratios fall back to per timestep interpolation.
     func interpolate(type: ReaderInterpolation, timeOld: TimerangeDt, timeNew: TimerangeDt, latitude: Float, longitude: Float, scalefactor: Float) -> [Float] {
+        let dtOld = timeOld.dtSeconds
+        let indexOffset = timeOld.range.lowerBound.timeIntervalSince1970 / dtOld
         switch type {
         case .linear:
-            return interpolateLinear(timeOld: timeOld, timeNew: timeNew, scalefactor: scalefactor)
+            guard let table = TimeInterpolationTable(timeNew: timeNew, dtOld: dtOld, shift: 0), table.leading == 0 else {
+                return interpolateLinear(timeOld: timeOld, timeNew: timeNew, scalefactor: scalefactor)
+            }
+            return interpolateLinear(table: table, indexOffset: indexOffset, scalefactor: scalefactor)
         case .linearDegrees:
-            return interpolateLinearDegrees(timeOld: timeOld, timeNew: timeNew, scalefactor: scalefactor)
+            guard let table = TimeInterpolationTable(timeNew: timeNew, dtOld: dtOld, shift: 0), table.leading == 0 else {
+                return interpolateLinearDegrees(timeOld: timeOld, timeNew: timeNew, scalefactor: scalefactor)
+            }
+            return interpolateLinearDegrees(table: table, indexOffset: indexOffset, scalefactor: scalefactor)
         case .hermite(let bounds):
-            return interpolateHermite(timeOld: timeOld, timeNew: timeNew, scalefactor: scalefactor, bounds: bounds)
+            guard let table = TimeInterpolationTable(timeNew: timeNew, dtOld: dtOld, shift: 0), table.leading == 0 else {
+                return interpolateHermite(timeOld: timeOld, timeNew: timeNew, scalefactor: scalefactor, bounds: bounds)
+            }
+            return interpolateHermite(table: table, indexOffset: indexOffset, scalefactor: scalefactor, bounds: bounds)
         case .solar_backwards_averaged, .solar_backwards_missing_not_averaged:
-            return interpolateSolarBackwards(timeOld: timeOld, timeNew: timeNew, latitude: latitude, longitude: longitude, scalefactor: scalefactor)
+            let position = RegularGrid(nx: 1, ny: 1, latMin: latitude, lonMin: longitude, dx: 1, dy: 1)
+            let solarLow = Zensun.calculateRadiationBackwardsAveraged(grid: position, locationRange: 0..<1, timerange: timeOld).data
+            let solar = Zensun.calculateRadiationBackwardsAveraged(grid: position, locationRange: 0..<1, timerange: timeNew).data
+            // time need to be shifted by dtOld/2 because those are averages over time
+            let dt = timeNew.dtSeconds
+            let shift = dtOld - dt - dtOld / 2 + dt / 2 - timeOld.range.lowerBound.timeIntervalSince1970
+            guard let table = TimeInterpolationTable(timeNew: timeNew, dtOld: dtOld, shift: shift) else {
+                return interpolateSolarBackwards(timeOld: timeOld, timeNew: timeNew, solarLow: solarLow, solar: solar, scalefactor: scalefactor)
+            }
+            return interpolateSolarBackwards(table: table, solarLow: solarLow, solar: solar, scalefactor: scalefactor)
         case .backwards_sum:
             return backwardsSum(timeOld: timeOld, timeNew: timeNew, scalefactor: scalefactor)
         case .backwards:
@@ -19,77 +40,113 @@ extension Array where Element == Float {
         }
     }
 
-    func interpolateSolarBackwards(timeOld timeLow: TimerangeDt, timeNew time: TimerangeDt, latitude: Float, longitude: Float, scalefactor: Float) -> [Float] {
-        /// Like regular hermite, but interpolated via clearsky index kt derived with solar factor
-        let position = RegularGrid(nx: 1, ny: 1, latMin: latitude, lonMin: longitude, dx: 1, dy: 1)
-        let solarLow = Zensun.calculateRadiationBackwardsAveraged(grid: position, locationRange: 0..<1, timerange: timeLow).data
-        let solar = Zensun.calculateRadiationBackwardsAveraged(grid: position, locationRange: 0..<1, timerange: time).data
+    func interpolateSolarBackwards(timeOld: TimerangeDt, timeNew: TimerangeDt, latitude: Float, longitude: Float, scalefactor: Float) -> [Float] {
+        return interpolate(type: .solar_backwards_averaged, timeOld: timeOld, timeNew: timeNew, latitude: latitude, longitude: longitude, scalefactor: scalefactor)
+    }
 
+    /// Like regular hermite, but interpolated via clearsky index kt derived with solar factor
+    /// `solarLow` and `solar` are the backwards averaged solar factors for `timeLow` and `time`
+    func interpolateSolarBackwards(timeOld timeLow: TimerangeDt, timeNew time: TimerangeDt, solarLow: [Float], solar: [Float], scalefactor: Float) -> [Float] {
         let dt = time.dtSeconds
         let dtOld = timeLow.dtSeconds
         let tStart = timeLow.range.lowerBound.timeIntervalSince1970
 
         return time.enumerated().map { i, t in
             // time need to be shifted by dtOld/2 because those are averages over time
-            let (index, fraction) = (t.timeIntervalSince1970 - tStart + dtOld - dt - dtOld / 2 + dt / 2).moduloFraction(dtOld)
-            if index < 0 {
-                return .nan
-            }
-
-            let indexB = Swift.max(index, 0)
-            let indexA = Swift.max(index - 1, 0)
-            let indexC = Swift.min(index + 1, self.count - 1)
-            let indexD = Swift.min(index + 2, self.count - 1)
+            let shifted = t.timeIntervalSince1970 - tStart + dtOld - dt - dtOld / 2 + dt / 2
+            return interpolateSolarBackwards(shifted: shifted, dtOld: dtOld, solar: solar[i], solarLow: solarLow, scalefactor: scalefactor)
+        }
+    }
 
-            if self[indexB].isNaN {
-                return .nan
+    /// Same as `interpolateSolarBackwards`, but visits each old timestep only once. Requires `table` with `shift = dtOld - dt - dtOld / 2 + dt / 2 - tStart`
+    func interpolateSolarBackwards(table: TimeInterpolationTable, solarLow: [Float], solar: [Float], scalefactor: Float) -> [Float] {
+        return [Float](unsafeUninitializedCapacity: table.count) { out, initializedCount in
+            for k in 0 ..< table.leading {
+                out[k] = interpolateSolarBackwards(shifted: table.shifted(k), dtOld: table.dtOld, solar: solar[k], solarLow: solarLow, scalefactor: scalefactor)
             }
-            if solar[i] == 0 {
-                return 0 // Night
+            table.forEachRow { index, range, fractions in
+                if self[index].isNaN {
+                    for k in range {
+                        out[k] = .nan
+                    }
+                    return
+                }
+                let kt = solarClearness(index: index, solarLow: solarLow)
+                for (k, fraction) in zip(range, fractions) {
+                    if solar[k] == 0 {
+                        out[k] = 0 // Night
+                        continue
+                    }
+                    let h = kt.interpolate(fraction) * solar[k]
+                    /// adjust it to scalefactor, otherwise interpolated values show more level of detail
+                    out[k] = roundf(h * scalefactor) / scalefactor
+                }
             }
+            initializedCount = table.count
+        }
+    }
 
-            let A = self[indexA]
-            let B = self[indexB]
-            let C = self[indexC]
-            let D = self[indexD]
-
-            let solA = solarLow[indexA]
-            let solB = solarLow[indexB]
-            let solC = solarLow[indexC]
-            let solD = solarLow[indexD]
+    /// Interpolate one timestep at `shifted` seconds after the first old timestep
+    @inline(__always)
+    fileprivate func interpolateSolarBackwards(shifted: Int, dtOld: Int, solar: Float, solarLow: [Float], scalefactor: Float) -> Float {
+        let (index, fraction) = shifted.moduloFraction(dtOld)
+        if index < 0 {
+            return .nan
+        }
+        if self[index].isNaN {
+            return .nan
+        }
+        if solar == 0 {
+            return 0 // Night
+        }
+        let h = solarClearness(index: index, solarLow: solarLow).interpolate(fraction) * solar
+        /// adjust it to scalefactor, otherwise interpolated values show more level of detail
+        return roundf(h * scalefactor) / scalefactor
+    }
 
-            var ktA = solA <= 0.005 ? .nan : Swift.min(A / solA, 1100)
-            var ktB = solB <= 0.005 ? .nan : Swift.min(B / solB, 1100)
-            var ktC = solC <= 0.005 ? .nan : Swift.min(C / solC, 1100)
-            var ktD = solD <= 0.005 ? .nan : Swift.min(D / solD, 1100)
+    /// Hermite coefficients of the clearness index kt around `index`. Missing kt values at night are filled from neighbours
+    @inline(__always)
+    fileprivate func solarClearness(index: Int, solarLow: [Float]) -> HermiteCoefficients {
+        let indexB = Swift.max(index, 0)
+        let indexA = Swift.max(index - 1, 0)
+        let indexC = Swift.min(index + 1, self.count - 1)
+        let indexD = Swift.min(index + 2, self.count - 1)
 
-            if ktA.isNaN {
-                ktA = !ktB.isNaN ? ktB : !ktC.isNaN ? ktC : ktD
-            }
-            if ktB.isNaN {
-                ktB = !ktA.isNaN ? ktA : !ktC.isNaN ? ktC : ktD
-            }
-            if ktC.isNaN {
-                ktC = !ktB.isNaN ? ktB : !ktD.isNaN ? ktD : ktA
-            }
-            if ktD.isNaN {
-                ktD = !ktC.isNaN ? ktC : !ktB.isNaN ? ktB : ktA
-            }
+        let A = self[indexA]
+        let B = self[indexB]
+        let C = self[indexC]
+        let D = self[indexD]
 
-            // no interpolation
-            // return (fraction < 0.5 ? ktB : ktC) * solar[i]
+        let solA = solarLow[indexA]
+        let solB = solarLow[indexB]
+        let solC = solarLow[indexC]
+        let solD = solarLow[indexD]
 
-            // linear interpolation
-            // return (ktB * (1-fraction) + ktC * fraction) * solar[i]
+        var ktA = solA <= 0.005 ? .nan : Swift.min(A / solA, 1100)
+        var ktB = solB <= 0.005 ? .nan : Swift.min(B / solB, 1100)
+        var ktC = solC <= 0.005 ? .nan : Swift.min(C / solC, 1100)
+        var ktD = solD <= 0.005 ? .nan : Swift.min(D / solD, 1100)
 
-            let a = -ktA / 2.0 + (3.0 * ktB) / 2.0 - (3.0 * ktC) / 2.0 + ktD / 2.0
-            let b = ktA - (5.0 * ktB) / 2.0 + 2.0 * ktC - ktD / 2.0
-            let c = -ktA / 2.0 + ktC / 2.0
-            let d = ktB
-            let h = (a * fraction * fraction * fraction + b * fraction * fraction + c * fraction + d) * solar[i]
-            /// adjust it to scalefactor, otherwise interpolated values show more level of detail
-            return roundf(h * scalefactor) / scalefactor
+        if ktA.isNaN {
+            ktA = !ktB.isNaN ? ktB : !ktC.isNaN ? ktC : ktD
         }
+        if ktB.isNaN {
+            ktB = !ktA.isNaN ? ktA : !ktC.isNaN ? ktC : ktD
+        }
+        if ktC.isNaN {
+            ktC = !ktB.isNaN ? ktB : !ktD.isNaN ? ktD : ktA
+        }
+        if ktD.isNaN {
+            ktD = !ktC.isNaN ? ktC : !ktB.isNaN ? ktB : ktA
+        }
+
+        // no interpolation
+        // return (fraction < 0.5 ? ktB : ktC) * solar[i]
+
+        // linear interpolation
+        // return (ktB * (1-fraction) + ktC * fraction) * solar[i]
+
+        return HermiteCoefficients(A: ktA, B: ktB, C: ktC, D: ktD)
     }
 
     /// Take the next value and devide it by dt. Used for precipitation, snow, etc
@@ -117,10 +174,7 @@ extension Array where Element == Float {
         return time.map { t in
             let index = t.timeIntervalSince1970 / timeLow.dtSeconds - timeLow.range.lowerBound.timeIntervalSince1970 / timeLow.dtSeconds
             let fraction = Float(t.timeIntervalSince1970 % timeLow.dtSeconds) / Float(timeLow.dtSeconds)
-            let A = self[index]
-            let B = index + 1 >= self.count ? A : self[index + 1]
-            let A2 = (abs(B - A) > 180 && A < B) ? A + 360 : A
-            let B2 = (abs(B - A) > 180 && A > B) ? B + 360 : B
+            let (A2, B2) = linearDegreesNeighbours(index: index)
             let h = A2 * (1 - fraction) + B2 * fraction
             let h2 = h.truncatingRemainder(dividingBy: 360)
             /// adjust it to scalefactor, otherwise interpolated values show more level of detail
@@ -128,6 +182,30 @@ extension Array where Element == Float {
         }
     }
 
+    func interpolateLinearDegrees(table: TimeInterpolationTable, indexOffset: Int, scalefactor: Float) -> [Float] {
+        return [Float](unsafeUninitializedCapacity: table.count) { out, initializedCount in
+            table.forEachRow { index, range, fractions in
+                let (A2, B2) = linearDegreesNeighbours(index: index - indexOffset)
+                for (k, fraction) in zip(range, fractions) {
+                    let h = A2 * (1 - fraction) + B2 * fraction
+                    let h2 = h.truncatingRemainder(dividingBy: 360)
+                    out[k] = roundf(h2 * scalefactor) / scalefactor
+                }
+            }
+            initializedCount = table.count
+        }
+    }
+
+    /// Neighbours of `index` shifted by 360° to interpolate along the shorter arc
+    @inline(__always)
+    fileprivate func linearDegreesNeighbours(index: Int) -> (Float, Float) {
+        let A = self[index]
+        let B = index + 1 >= self.count ? A : self[index + 1]
+        let A2 = (abs(B - A) > 180 && A < B) ? A + 360 : A
+        let B2 = (abs(B - A) > 180 && A > B) ? B + 360 : B
+        return (A2, B2)
+    }
+
     func interpolateLinear(timeOld timeLow: TimerangeDt, timeNew time: TimerangeDt, scalefactor: Float) -> [Float] {
         return time.map { t in
             let index = t.timeIntervalSince1970 / timeLow.dtSeconds - timeLow.range.lowerBound.timeIntervalSince1970 / timeLow.dtSeconds
@@ -140,20 +218,26 @@ extension Array where Element == Float {
         }
     }
 
+    func interpolateLinear(table: TimeInterpolationTable, indexOffset: Int, scalefactor: Float) -> [Float] {
+        return [Float](unsafeUninitializedCapacity: table.count) { out, initializedCount in
+            table.forEachRow { index, range, fractions in
+                let index = index - indexOffset
+                let A = self[index]
+                let B = index + 1 >= self.count ? A : self[index + 1]
+                for (k, fraction) in zip(range, fractions) {
+                    let h = A * (1 - fraction) + B * fraction
+                    out[k] = roundf(h * scalefactor) / scalefactor
+                }
+            }
+            initializedCount = table.count
+        }
+    }
+
     func interpolateHermite(timeOld timeLow: TimerangeDt, timeNew time: TimerangeDt, scalefactor: Float, bounds: ClosedRange<Float>?) -> [Float] {
         return time.map { t in
             let index = t.timeIntervalSince1970 / timeLow.dtSeconds - timeLow.range.lowerBound.timeIntervalSince1970 / timeLow.dtSeconds
             let fraction = Float(t.timeIntervalSince1970 % timeLow.dtSeconds) / Float(timeLow.dtSeconds)
-
-            let B = self[index]
-            let A = index - 1 < 0 ? B : self[index - 1].isNaN ? B : self[index - 1]
-            let C = index + 1 >= self.count ? B : self[index + 1].isNaN ? B : self[index + 1]
-            let D = index + 2 >= self.count ? C : self[index + 2].isNaN ? B : self[index + 2]
-            let a = -A / 2.0 + (3.0 * B) / 2.0 - (3.0 * C) / 2.0 + D / 2.0
-            let b = A - (5.0 * B) / 2.0 + 2.0 * C - D / 2.0
-            let c = -A / 2.0 + C / 2.0
-            let d = B
-            let h = a * fraction * fraction * fraction + b * fraction * fraction + c * fraction + d
+            let h = hermiteNeighbours(index: index).interpolate(fraction)
             /// adjust it to scalefactor, otherwise interpolated values show more level of detail
             let hScaled = roundf(h * scalefactor) / scalefactor
             if let bounds = bounds {
@@ -162,4 +246,122 @@ extension Array where Element == Float {
             return hScaled
         }
     }
+
+    func interpolateHermite(table: TimeInterpolationTable, indexOffset: Int, scalefactor: Float, bounds: ClosedRange<Float>?) -> [Float] {
+        // Infinite bounds leave values and NaN unchanged
+        let lower = bounds?.lowerBound ?? -.infinity
+        let upper = bounds?.upperBound ?? .infinity
+        return [Float](unsafeUninitializedCapacity: table.count) { out, initializedCount in
+            table.forEachRow { index, range, fractions in
+                let coefficients = hermiteNeighbours(index: index - indexOffset)
+                for (k, fraction) in zip(range, fractions) {
+                    let hScaled = roundf(coefficients.interpolate(fraction) * scalefactor) / scalefactor
+                    out[k] = Swift.min(Swift.max(hScaled, lower), upper)
+                }
+            }
+            initializedCount = table.count
+        }
+    }
+
+    /// Hermite coefficients around `index`. Missing neighbours are replaced by `B`
+    @inline(__always)
+    fileprivate func hermiteNeighbours(index: Int) -> HermiteCoefficients {
+        let B = self[index]
+        let A = index - 1 < 0 ? B : self[index - 1].isNaN ? B : self[index - 1]
+        let C = index + 1 >= self.count ? B : self[index + 1].isNaN ? B : self[index + 1]
+        let D = index + 2 >= self.count ? C : self[index + 2].isNaN ? B : self[index + 2]
+        return HermiteCoefficients(A: A, B: B, C: C, D: D)
+    }
+}
+
+/// Cubic hermite spline through `B` and `C` using `A` and `D` as outer points
+struct HermiteCoefficients {
+    let a: Float
+    let b: Float
+    let c: Float
+    let d: Float
+
+    @inline(__always)
+    init(A: Float, B: Float, C: Float, D: Float) {
+        a = -A / 2.0 + (3.0 * B) / 2.0 - (3.0 * C) / 2.0 + D / 2.0
+        b = A - (5.0 * B) / 2.0 + 2.0 * C - D / 2.0
+        c = -A / 2.0 + C / 2.0
+        d = B
+    }
+
+    /// Value at `fraction` between `B` and `C`
+    @inline(__always)
+    func interpolate(_ fraction: Float) -> Float {
+        return a * fraction * fraction * fraction + b * fraction * fraction + c * fraction + d
+    }
+}
+
+/**
+ Position of new timesteps in the old time axis if `dtOld` is a multiple of `dtNew`.
+
+ Fractions repeat every old timestep and only depend on `dtOld`, `dtNew` and the offset of the first new timestep to the `dtNew` grid. They are calculated once per table instead of for each timestep.
+ Kernels iterate rows of one old timestep: neighbours and spline coefficients are loaded once and the inner loop over fractions does not gather or branch on indices.
+ */
+struct TimeInterpolationTable {
+    /// Number of leading new timesteps with a negative shifted time. They are not visited by `forEachRow`
+    let leading: Int
+
+    /// Old index of the first new timestep after `leading`
+    let startIndex: Int
+
+    /// Position of the first new timestep after `leading` in `fractions`
+    let startPhase: Int
+
+    /// Fraction of each new timestep within one old timestep. Count is `dtOld / dtNew`
+    let fractions: [Float]
+
+    /// Number of new timesteps
+    let count: Int
+
+    /// Shifted time of the first new timestep
+    let first: Int
+
+    let dtOld: Int
+    let dtNew: Int
+
+    /// `shift` in seconds is added to each new timestamp before it is divided by `dtOld`. Returns nil if `dtOld` is not a multiple of `dtNew`
+    init?(timeNew: TimerangeDt, dtOld: Int, shift: Int) {
+        let dtNew = timeNew.dtSeconds
+        guard dtNew > 0, dtOld > dtNew, dtOld % dtNew == 0 else {
+            return nil
+        }
+        let first = timeNew.range.lowerBound.timeIntervalSince1970 + shift
+        let leading = first < 0 ? Swift.min((-first).divideRoundedUp(divisor: dtNew), timeNew.count) : 0
+        let firstPositive = first + leading * dtNew
+        let offset = firstPositive % dtNew
+        self.leading = leading
+        self.startIndex = firstPositive / dtOld
+        self.startPhase = (firstPositive % dtOld - offset) / dtNew
+        self.fractions = (0 ..< dtOld / dtNew).map { Float(offset + $0 * dtNew) / Float(dtOld) }
+        self.count = timeNew.count
+        self.first = first
+        self.dtOld = dtOld
+        self.dtNew = dtNew
+    }
+
+    /// Shifted time of new timestep `k`
+    @inline(__always)
+    func shifted(_ k: Int) -> Int {
+        return first + k * dtNew
+    }
+
+    /// Call `body` once for each old index with the range of new timesteps and their fractions. Skips `leading` timesteps
+    @inline(__always)
+    func forEachRow(_ body: (_ index: Int, _ range: Range<Int>, _ fractions: ArraySlice<Float>) -> Void) {
+        var k = leading
+        var index = startIndex
+        var phase = startPhase
+        while k < count {
+            let n = Swift.min(fractions.count - phase, count - k)
+            body(index, k ..< k + n, fractions[phase ..< phase + n])
+            k += n
+            index += 1
+            phase = 0
+        }
+    }
 }
@@ -9,6 +9,7 @@ enum OmFileManagerType: String {
     case year
     case master
     case linear_bias_seasonal
+    case quantile_mapping_cdf
 }
 
 enum OmFileManagerReadable: Hashable {
@@ -19,6 +20,9 @@ enum OmFileManagerReadable: Hashable {
     /// Full forecast run horizon per run per variable. `data_run/<model>/<run>/<variable>.om`
     case run(domain: DomainRegistry, variable: String, run: Timestamp)
 
+    /// One variable of a spatial time step file. `data_spatial/<model>/<run>/<time><_realm>.om`
+    case spatial(domain: DomainRegistry, run: Timestamp, time: Timestamp, realm: String?, variable: String)
+
     /// Assemble the full file system path
     func getFilePath() -> String {
         return "\(getDataDirectoryPath())\(getRelativeFilePath())"
@@ -44,6 +48,9 @@ enum OmFileManagerReadable: Hashable {
             return "\(domain.rawValue)/static/meta.json"
         case .run(domain: let domain, variable: let variable, run: let run):
             return "\(domain.rawValue)/\(run.format_directoriesYYYYMMddhhmm)/\(variable).om"
+        case .spatial(domain: let domain, run: let run, time: let time, realm: let realm, variable: _):
+            let realm = realm.map { "_\($0)" } ?? ""
+            return "\(domain.rawValue)/\(run.format_directoriesYYYYMMddhhmm)/\(time.iso8601_YYYY_MM_dd_HHmm)\(realm).om"
         }
     }
     
@@ -58,7 +65,25 @@ enum OmFileManagerReadable: Hashable {
             return OpenMeteo.dataDirectory
         case .run(_, _, _):
             return OpenMeteo.dataRunDirectory ?? OpenMeteo.dataDirectory
+        case .spatial:
+            return OpenMeteo.dataSpatialDirectory ?? OpenMeteo.dataDirectory
+        }
+    }
+
+    /// Directory to open files for API calls. Only spatial files are read outside of `./data/`
+    var localDirectory: String {
+        if case .spatial = self {
+            return getDataDirectoryPath()
+        }
+        return OpenMeteo.dataDirectory
+    }
+
+    /// Remote http directory for files which are not available locally
+    var remoteDirectory: String? {
+        if case .spatial = self {
+            return OpenMeteo.remoteDataSpatialDirectory
         }
+        return OpenMeteo.remoteDataDirectory
     }
 
     func createDirectory() throws {
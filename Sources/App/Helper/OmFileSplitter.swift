@@ -136,18 +136,33 @@ struct OmFileSplitter {
     }
 
     func read(variable: String, location: Range<Int>, level: Int, time: TimerangeDtAndSettings, logger: Logger, httpClient: HTTPClient) async throws -> [Float] {
+        return try await read(variable: variable, nLocations: location.count, time: time, logger: logger, httpClient: httpClient) { reader, out, nTime, offsets in
+            try await reader.read3D(into: &out, ny: ny, nx: nx, nTime: nTime, nMembers: nMembers, location: location, level: level, timeOffsets: offsets)
+        }
+    }
+
+    /// Read a block of grid rows `y` and columns `x` for all time steps. Returns dimensions `[y.count, x.count, nTime]`.
+    /// Used by bounding box queries to read all grid points with one call per file instead of one call per location
+    func read(variable: String, y: Range<Int>, x: Range<Int>, level: Int, time: TimerangeDtAndSettings, logger: Logger, httpClient: HTTPClient) async throws -> [Float] {
+        return try await read(variable: variable, nLocations: y.count * x.count, time: time, logger: logger, httpClient: httpClient) { reader, out, nTime, offsets in
+            try await reader.read3D(into: &out, ny: ny, nx: nx, nTime: nTime, nMembers: nMembers, y: y, x: x, level: level, timeOffsets: offsets)
+        }
+    }
+
+    /// Iterate master, yearly and chunk files that cover `time` and let `read3D` fill `nLocations` time series
+    private func read(variable: String, nLocations: Int, time: TimerangeDtAndSettings, logger: Logger, httpClient: HTTPClient, read3D: (_ reader: any OmFileReaderArrayProtocol<Float>, _ into: inout [Float], _ nTime: Int, _ timeOffsets: (file: CountableRange<Int>, array: CountableRange<Int>)) async throws -> Void) async throws -> [Float] {
         let indexTime = time.time.toIndexTime()
         let nTime = indexTime.count
         var start = indexTime.lowerBound
         /// If yearly files are present, the start parameter is moved to read fewer files later
-        var out = [Float](repeating: .nan, count: nTime * location.count)
+        var out = [Float].pooled(repeating: .nan, count: nTime * nLocations)
 
         if let masterTimeRange {
             let fileTime = TimerangeDt(range: masterTimeRange, dtSeconds: time.dtSeconds).toIndexTime()
             let file = OmFileManagerReadable.domainChunk(domain: domain, variable: variable, type: .master, chunk: 0, ensembleMember: time.ensembleMember, previousDay: time.previousDay)
             if let offsets = indexTime.intersect(fileTime: fileTime) {
                 try await RemoteOmFileManager.instance.with(file: file, client: httpClient, logger: logger) { reader in
-                    try await reader.read3D(into: &out, ny: ny, nx: nx, nTime: nTime, nMembers: nMembers, location: location, level: level, timeOffsets: offsets)
+                    try await read3D(reader, &out, nTime, offsets)
                     start = fileTime.upperBound
                 }
             }
@@ -166,7 +181,7 @@ struct OmFileSplitter {
                 }
                 let file = OmFileManagerReadable.domainChunk(domain: domain, variable: variable, type: .year, chunk: year, ensembleMember: time.ensembleMember, previousDay: time.previousDay)
                 try await RemoteOmFileManager.instance.with(file: file, client: httpClient, logger: logger) { reader in
-                    try await reader.read3D(into: &out, ny: ny, nx: nx, nTime: nTime, nMembers: nMembers, location: location, level: level, timeOffsets: offsets)
+                    try await read3D(reader, &out, nTime, offsets)
                     start = fileTime.upperBound
                 }
             }
@@ -183,7 +198,7 @@ struct OmFileSplitter {
             }
             let file = OmFileManagerReadable.domainChunk(domain: domain, variable: variable, type: .chunk, chunk: timeChunk, ensembleMember: time.ensembleMember, previousDay: time.previousDay)
             try await RemoteOmFileManager.instance.with(file: file, client: httpClient, logger: logger) { reader in
-                try await reader.read3D(into: &out, ny: ny, nx: nx, nTime: nTime, nMembers: nMembers, location: location, level: level, timeOffsets: (offsets.file, offsets.array.add(delta)))
+                try await read3D(reader, &out, nTime, (offsets.file, offsets.array.add(delta)))
             }
         }
         return out
@@ -212,11 +227,38 @@ struct OmFileSplitter {
         }
     }
 
+    /**
+     Tile of `[y, x]` locations to convert at once with about 2 million values, e.g. 8 MB.
+
+     Time-series files use chunks `[1, chunknLocations]`, which have to be written in order. A tile therefore spans either full rows or parts of a single row.
+     Tiles are aligned to the `[32, x]` chunks of spatial files from `OmSpatialTimestepWriter`. Full row tiles use multiples of 32 rows or a divisor of 32, so no tile shares a spatial chunk row with the next band.
+     Tiles of a single row are aligned to spatial chunk columns. Every spatial chunk is decompressed once per row it contains instead of multiple times for overlapping tiles.
+     */
+    static func processChunks(ny: Int, nx: Int, chunknLocations: Int, valuesPerLocation: Int) -> (y: Int, x: Int) {
+        let nLocations = max(1, 2 * 1024 * 1024 / valuesPerLocation)
+        let spatial = OmSpatialTimestepWriter.chunks(ny: ny, nx: nx)
+        if nLocations >= nx {
+            let rows = min(ny, nLocations / nx)
+            if rows >= spatial.y {
+                return (rows / spatial.y * spatial.y, nx)
+            }
+            return ((1...rows).last(where: { spatial.y % $0 == 0 }) ?? 1, nx)
+        }
+        let x = max(1, nLocations / chunknLocations) * chunknLocations
+        var alignment = chunknLocations
+        while alignment % spatial.x != 0 {
+            alignment += chunknLocations
+        }
+        return (1, x >= alignment ? x / alignment * alignment : x)
+    }
+
     /**
      Write new data to archived storage and combine it with existing data.
      `supplyChunk` should provide data for a couple of thousands locations at once. Upates are done streamlingly to low memory usage
+     Returns all files that have been written
      */
-    func updateFromTimeOrientedStreaming3D(variable: String, time: TimerangeDt, scalefactor: Float, compression: OmCompressionType = .pfor_delta2d_int16, onlyGeneratePreviousDays: Bool, supplyChunk: (_ y: Range<UInt64>, _ x: Range<UInt64>, _ member: Range<UInt64>) async throws -> ArraySlice<Float>) async throws {
+    @discardableResult
+    func updateFromTimeOrientedStreaming3D(variable: String, time: TimerangeDt, scalefactor: Float, compression: OmCompressionType = .pfor_delta2d_int16, onlyGeneratePreviousDays: Bool, supplyChunk: (_ y: Range<UInt64>, _ x: Range<UInt64>, _ member: Range<UInt64>) async throws -> ArraySlice<Float>) async throws -> [OmFileManagerReadable] {
         let indexTime = time.toIndexTime()
         let indextimeChunked = indexTime.divideRoundedUp(divisor: nTimePerFile)
 
@@ -225,7 +267,7 @@ struct OmFileSplitter {
         /// `1..<n` for all previous days
         let previousDaysRange: Range<Int> = onlyGeneratePreviousDays ? (1..<max(1, min(8, time.range.count / 86400))) : (0..<1)
         if previousDaysRange.isEmpty {
-            return
+            return []
         }
 
         struct WriterPerStep {
@@ -234,6 +276,7 @@ struct OmFileSplitter {
             let write: OmFileWriterArray<Float, FileHandle>
             let writeFn: FileHandle
             let offsets: (file: CountableRange<Int>, array: CountableRange<Int>)
+            let file: OmFileManagerReadable
             let fileName: String
             let skip: Int
         }
@@ -265,15 +308,14 @@ struct OmFileSplitter {
                     scale_factor: scalefactor,
                     add_offset: 0
                 )
-                return WriterPerStep(read: omRead, writeFile: writeFile, write: writer, writeFn: fn, offsets: offsets, fileName: readFile.getFilePath(), skip: skip)
+                return WriterPerStep(read: omRead, writeFile: writeFile, write: writer, writeFn: fn, offsets: offsets, file: readFile, fileName: readFile.getFilePath(), skip: skip)
             }
         }
 
         let nIndexTime = indexTime.count
 
         /// Spatial files use chunks multiple time larger than the final chunk. E.g. [15,526] will be [1,15] in the final time-series file
-        let processChunkX = max(1, min(nx, 2 * 1024 * 1024 / nTimePerFile / nMembers / chunknLocations * chunknLocations))
-        let processChunkY = max(1, min(ny, 2 * 1024 * 1024 / nTimePerFile / nMembers / processChunkX))
+        let (processChunkY, processChunkX) = Self.processChunks(ny: ny, nx: nx, chunknLocations: chunknLocations, valuesPerLocation: nTimePerFile * nMembers)
         // print("Chunks [\(processChunkY),\(processChunkX)] nTimePerFile=\(nTimePerFile) chunknLocations=\(chunknLocations)")
         
         var fileData = [Float](repeating: .nan, count: processChunkY * processChunkX * nTimePerFile * nMembers)
@@ -355,6 +397,7 @@ struct OmFileSplitter {
             // Overwrite existing file, with newly created
             try FileManager.default.moveFileOverwrite(from: "\(writer.fileName)~", to: writer.fileName)
         }
+        return writers.map(\.file)
     }
 }
 
@@ -371,6 +414,46 @@ extension OmFileSplitter {
         }
         return OmFileWriterHelper(dimensions: [domain.grid.ny, domain.grid.nx], chunks: [y, x])
     }
+
+    /**
+     Write a file with `nTimePerFile` values per grid cell like precomputed bias correction tables. Dimensions are `[ny, nx, nTimePerFile]` and chunks `[1, chunknLocations, nTimePerFile]` as for time-series files, therefore `read3D` can be used to read one grid cell.
+     `supplyChunk` is called for consecutive ranges of locations in one row and must return `nTimePerFile` values for each location. An existing file is replaced.
+     */
+    func writeLocationTable(file: OmFileManagerReadable, compression: OmCompressionType, scalefactor: Float, supplyChunk: (_ y: Range<UInt64>, _ x: Range<UInt64>) async throws -> ArraySlice<Float>) async throws {
+        try file.createDirectory()
+        let fileName = file.getFilePath()
+        let tempFile = fileName + "~"
+        try FileManager.default.removeItemIfExists(at: tempFile)
+        let fn = try FileHandle.createNewFile(file: tempFile)
+        let writeFile = OmFileWriter(fn: fn, initialCapacity: 1024 * 1024)
+        let writer = try writeFile.prepareArray(
+            type: Float.self,
+            dimensions: [UInt64(ny), UInt64(nx), UInt64(nTimePerFile)],
+            chunkDimensions: [1, UInt64(chunknLocations), UInt64(nTimePerFile)],
+            compression: compression,
+            scale_factor: scalefactor,
+            add_offset: 0
+        )
+        /// Around 8 MB per call, aligned to full chunks
+        let processChunkX = max(chunknLocations, min(nx, 2 * 1024 * 1024 / nTimePerFile / chunknLocations * chunknLocations))
+        for y in 0..<UInt64(ny) {
+            for xRange in (0..<UInt64(nx)).chunks(ofCount: processChunkX) {
+                let data = try await supplyChunk(y..<y + 1, xRange)
+                guard data.count == xRange.count * nTimePerFile else {
+                    throw OmFileSplitterError.locationTableChunkCountMismatch(count: data.count, expected: xRange.count * nTimePerFile)
+                }
+                try writer.writeData(array: Array(data), arrayDimensions: [1, UInt64(xRange.count), UInt64(nTimePerFile)])
+            }
+        }
+        let root = try writeFile.write(array: writer.finalise(), name: "", children: [])
+        try writeFile.writeTrailer(rootVariable: root)
+        try fn.close()
+        try FileManager.default.moveFileOverwrite(from: tempFile, to: fileName)
+    }
+}
+
+enum OmFileSplitterError: Error {
+    case locationTableChunkCountMismatch(count: Int, expected: Int)
 }
 
 extension Range where Bound == Int {
@@ -415,13 +498,47 @@ extension OmFileReaderArrayProtocol where OmType == Float {
                 intoCubeOffset: [0, UInt64(timeOffsets.array.lowerBound)],
                 intoCubeDimension: [nLocations, UInt64(nTime)]
             )
+        default:
+            let x = location.lowerBound % nx ..< (location.upperBound - 1) % nx + 1
+            let y = location.lowerBound / nx ..< location.lowerBound / nx + 1
+            try await read3D(into: &into, ny: ny, nx: nx, nTime: nTime, nMembers: nMembers, y: y, x: x, level: level, timeOffsets: timeOffsets)
+        }
+    }
+
+    /// Read a block of grid rows `y` and columns `x` into `into` with dimensions `[y.count, x.count, nTime]`.
+    /// Multi dimensional files read the entire block with one call. Legacy 2D files read each row separately unless full rows are requested.
+    func read3D(into: inout [Float], ny: Int, nx: Int, nTime: Int, nMembers: Int, y yRange: Range<Int>, x xRange: Range<Int>, level: Int, timeOffsets: (file: CountableRange<Int>, array: CountableRange<Int>)) async throws {
+        let dimensions = self.getDimensions()
+        switch dimensions.count {
+        case 2:
+            /// Legacy files flatten levels into the location dimension. Only one location can be read at once
+            let isMultiLevel = Int(dimensions[0]) > nx * ny
+            if !isMultiLevel && (xRange.count == nx || yRange.count == 1) {
+                let location = yRange.lowerBound * nx + xRange.lowerBound ..< (yRange.upperBound - 1) * nx + xRange.upperBound
+                try await read3D(into: &into, ny: ny, nx: nx, nTime: nTime, nMembers: nMembers, location: location, level: level, timeOffsets: timeOffsets)
+                return
+            }
+            let nxRead = isMultiLevel ? 1 : xRange.count
+            var part = [Float](repeating: .nan, count: nxRead * nTime)
+            for (i, y) in yRange.enumerated() {
+                for x in stride(from: 0, to: xRange.count, by: nxRead) {
+                    let location = y * nx + xRange.lowerBound + x ..< y * nx + xRange.lowerBound + x + nxRead
+                    try await read3D(into: &part, ny: ny, nx: nx, nTime: nTime, nMembers: nMembers, location: location, level: level, timeOffsets: timeOffsets)
+                    let offset = (i * xRange.count + x) * nTime
+                    for j in 0..<nxRead {
+                        for t in timeOffsets.array {
+                            into[offset + j * nTime + t] = part[j * nTime + t]
+                        }
+                    }
+                }
+            }
         case 3:
             // File uses dimensions [ny,nx,ntime]
             guard ny == dimensions[0], nx == dimensions[1] else {
                 return
             }
-            let x = UInt64(location.lowerBound % nx) ..< UInt64((location.upperBound - 1) % nx) + 1
-            let y = UInt64(location.lowerBound / nx) ..< UInt64(location.lowerBound / nx + 1)
+            let x = xRange.toUInt64()
+            let y = yRange.toUInt64()
             let fileTime = UInt64(timeOffsets.file.lowerBound) ..< UInt64(timeOffsets.file.upperBound)
             let range = [y, x, fileTime]
             do {
@@ -432,8 +549,8 @@ extension OmFileReaderArrayProtocol where OmType == Float {
                     intoCubeDimension: [UInt64(y.count), UInt64(x.count), UInt64(nTime)]
                 )
             } catch OmFileFormatSwiftError.omDecoder(let error) {
-                print("\(error) range=\(range) [ny=\(ny) nx=\(nx) nTime=\(nTime) location=\(location) nMembers=\(nMembers) level=\(level) timeOffsets=\(timeOffsets)]")
-                throw OmFileFormatSwiftError.omDecoder(error: "\(error) range=\(range) [ny=\(ny) nx=\(nx) nTime=\(nTime) location=\(location) nMembers=\(nMembers) level=\(level) timeOffsets=\(timeOffsets)]")
+                print("\(error) range=\(range) [ny=\(ny) nx=\(nx) nTime=\(nTime) y=\(yRange) x=\(xRange) nMembers=\(nMembers) level=\(level) timeOffsets=\(timeOffsets)]")
+                throw OmFileFormatSwiftError.omDecoder(error: "\(error) range=\(range) [ny=\(ny) nx=\(nx) nTime=\(nTime) y=\(yRange) x=\(xRange) nMembers=\(nMembers) level=\(level) timeOffsets=\(timeOffsets)]")
             }
         case 4:
             // File uses dimensions [ny,nx,nLevel,ntime]
@@ -441,8 +558,8 @@ extension OmFileReaderArrayProtocol where OmType == Float {
             guard ny == dimensions[0], nx == dimensions[1], level < dimensions[2] else {
                 return
             }
-            let x = UInt64(location.lowerBound % nx) ..< UInt64((location.upperBound - 1) % nx) + 1
-            let y = UInt64(location.lowerBound / nx) ..< UInt64(location.lowerBound / nx + 1)
+            let x = xRange.toUInt64()
+            let y = yRange.toUInt64()
             let l = UInt64(level) ..< UInt64(level + 1)
             let fileTime = UInt64(timeOffsets.file.lowerBound) ..< UInt64(timeOffsets.file.upperBound)
             let range = [y, x, l, fileTime]
@@ -454,8 +571,8 @@ extension OmFileReaderArrayProtocol where OmType == Float {
                     intoCubeDimension: [UInt64(y.count), UInt64(x.count), 1, UInt64(nTime)]
                 )
             } catch OmFileFormatSwiftError.omDecoder(let error) {
-                print("\(error) range=\(range) [ny=\(ny) nx=\(nx) nTime=\(nTime) location=\(location) nMembers=\(nMembers) level=\(level) timeOffsets=\(timeOffsets)]")
-                throw OmFileFormatSwiftError.omDecoder(error: "\(error) range=\(range) [ny=\(ny) nx=\(nx) nTime=\(nTime) location=\(location) nMembers=\(nMembers) level=\(level) timeOffsets=\(timeOffsets)]")
+                print("\(error) range=\(range) [ny=\(ny) nx=\(nx) nTime=\(nTime) y=\(yRange) x=\(xRange) nMembers=\(nMembers) level=\(level) timeOffsets=\(timeOffsets)]")
+                throw OmFileFormatSwiftError.omDecoder(error: "\(error) range=\(range) [ny=\(ny) nx=\(nx) nTime=\(nTime) y=\(yRange) x=\(xRange) nMembers=\(nMembers) level=\(level) timeOffsets=\(timeOffsets)]")
             }
         default:
             fatalError("ndims not implemented")
@@ -1,6 +1,8 @@
 import Foundation
 import OmFileFormat
 import Synchronization
+import CHelper
+import Logging
 
 /**
  Needs to be some kind of writeable memory region
@@ -33,18 +35,101 @@ extension DataAsClass: AtomicBlockCacheStorable {
     }
 }
 
+/**
+ Memory placement of a block cache. Random block access across a large cache causes many TLB misses with 4 KB pages.
+
+ - `transparent` asks the kernel to back the mapping with transparent huge pages. Only for in memory caches
+ - `explicit` uses reserved huge pages (`vm.nr_hugepages`). Persistent caches must be located on a `hugetlbfs` mount. In memory caches use an anonymous memory file
+ - `numaInterleave` spreads pages evenly across all NUMA nodes, so every socket sees the same average latency. Only for in memory caches and `hugetlbfs`
+ */
+struct AtomicBlockCachePlacement: Sendable {
+    enum HugePages: String {
+        case none
+        case transparent
+        case explicit
+    }
+
+    var hugePages: HugePages = .none
+    var numaInterleave: Bool = false
+
+    /// Cache sizes are rounded up to a multiple of 2 MB for explicit huge pages
+    static let hugePageSize = 2 * 1024 * 1024
+
+    func size(_ size: Int) -> Int {
+        guard hugePages == .explicit else {
+            return size
+        }
+        return size.divideRoundedUp(divisor: Self.hugePageSize) * Self.hugePageSize
+    }
+
+    /**
+     Apply transparent huge pages and NUMA policy to a mapped region. Failures are logged, because the cache works without them.
+
+     Page cache pages of a regular cache file ignore both. They are only applied to in memory caches and to files on `hugetlbfs` with `explicit` huge pages
+     */
+    func apply(to file: MmapFile, inMemory: Bool, explicitHugePages: Bool) {
+        let logger = Logger(label: "AtomicBlockCache")
+        let supportsPolicy = inMemory || explicitHugePages
+        if !supportsPolicy && (hugePages == .transparent || numaInterleave) {
+            logger.warning("CACHE_HUGE_PAGES=transparent and CACHE_NUMA=interleave have no effect on a cache file. Use CACHE_FILE=memory or explicit huge pages on hugetlbfs")
+            return
+        }
+        file.withMutableUnsafeBytes { bytes in
+            guard let address = bytes.baseAddress else {
+                return
+            }
+            if hugePages == .transparent && !explicitHugePages {
+                let error = chelper_madvise_hugepage(address, bytes.count)
+                if error != 0 {
+                    logger.warning("Transparent huge pages not available for block cache. Error \(error)")
+                }
+            }
+            if numaInterleave {
+                let error = chelper_mbind_interleave(address, bytes.count)
+                if error != 0 {
+                    logger.warning("NUMA interleave not available for block cache. Error \(error)")
+                }
+            }
+        }
+    }
+}
+
+enum AtomicBlockCacheError: Error {
+    case memoryFileFailed(errno: Int32)
+}
+
 extension AtomicBlockCache where Backend == MmapFile {
-    init(file: String, blockSize: Int, blockCount: Int) throws {
-        let size = (MemoryLayout<WordPair>.size + blockSize) * blockCount
+    init(file: String, blockSize: Int, blockCount: Int, placement: AtomicBlockCachePlacement = .init()) throws {
+        let size = placement.size((MemoryLayout<WordPair>.size + blockSize) * blockCount)
         if FileManager.default.fileExists(atPath: file) {
             let fn = try FileHandle.openFileReadWrite(file: file)
             if try fn.seekToEnd() == size {
-                self = .init(data: try MmapFile(fn: fn, mode: .readWrite), blockSize: blockSize)
+                let data = try MmapFile(fn: fn, mode: .readWrite)
+                placement.apply(to: data, inMemory: false, explicitHugePages: placement.hugePages == .explicit)
+                self = .init(data: data, blockSize: blockSize)
                 return
             }
         }
         let fn = try FileHandle.createNewFile(file: file, size: size, overwrite: true)
-        self = .init(data: try MmapFile(fn: fn, mode: .readWrite), blockSize: blockSize)
+        let data = try MmapFile(fn: fn, mode: .readWrite)
+        placement.apply(to: data, inMemory: false, explicitHugePages: placement.hugePages == .explicit)
+        self = .init(data: data, blockSize: blockSize)
+    }
+
+    /// Non-persistent cache in an anonymous memory file. Explicit huge pages fall back to regular pages if not enough huge pages are reserved
+    init(blockSize: Int, blockCount: Int, placement: AtomicBlockCachePlacement) throws {
+        let size = placement.size((MemoryLayout<WordPair>.size + blockSize) * blockCount)
+        var hugePagesUsed: Int32 = 0
+        let fd = chelper_memfd_create("om-block-cache", size, placement.hugePages == .explicit ? 1 : 0, &hugePagesUsed)
+        guard fd >= 0 else {
+            throw AtomicBlockCacheError.memoryFileFailed(errno: errno)
+        }
+        if placement.hugePages == .explicit && hugePagesUsed == 0 {
+            Logger(label: "AtomicBlockCache").warning("Not enough explicit huge pages reserved for block cache. Using regular pages")
+        }
+        let data = try MmapFile(fn: FileHandle(fileDescriptor: fd, closeOnDealloc: true), mode: .readWrite)
+        placement.apply(to: data, inMemory: true, explicitHugePages: hugePagesUsed != 0)
+        self = .init(data: data, blockSize: blockSize)
     }
 }
 
@@ -69,6 +154,19 @@ public struct AtomicBlockCache<Backend: AtomicBlockCacheStorable>: Sendable {
     var blockCount: Int {
         return data.count / (blockSize + MemoryLayout<WordPair>.size)
     }
+
+    /// While probing, key slots this far ahead are prefetched. One cache line holds 4 slots
+    static var probePrefetchDistance: Int { 8 }
+
+    /// Prefetch the cache line of a key slot ahead of the probe loop. Called every 4 slots
+    @inline(__always)
+    private static func prefetchSlot(_ bytes: UnsafeMutableRawBufferPointer, lookAhead: UInt64, slot: Int, blockCount: Int) {
+        guard lookAhead & 3 == 0 else {
+            return
+        }
+        let ahead = (slot + probePrefetchDistance) % blockCount
+        chelper_prefetch(bytes.baseAddress?.advanced(by: ahead * MemoryLayout<WordPair>.size))
+    }
     
     @discardableResult
     func set<DataIn: ContiguousBytes & Sendable>(key: UInt64, value: DataIn) -> UnsafeRawBufferPointer {
@@ -84,6 +182,7 @@ public struct AtomicBlockCache<Backend: AtomicBlockCacheStorable>: Sendable {
             let entries = bytes.assumingMemoryBound(to: Atomic<WordPair>.self)
             for lookAhead in 0..<lookAheadCount {
                 let slot = Int((key &+ lookAhead) % UInt64(blockCount))
+                Self.prefetchSlot(bytes, lookAhead: lookAhead, slot: slot, blockCount: blockCount)
                 while true {
                     let entry = entries[slot].load(ordering: .relaxed)
                     guard entry.second == 0 || entry.first == key else {
@@ -135,6 +234,7 @@ public struct AtomicBlockCache<Backend: AtomicBlockCacheStorable>: Sendable {
             let entries = bytes.assumingMemoryBound(to: Atomic<WordPair>.self)
             for lookAhead in 0..<lookAheadCount {
                 let slot = (key &+ lookAhead) % UInt64(blockCount)
+                Self.prefetchSlot(bytes, lookAhead: lookAhead, slot: Int(slot), blockCount: blockCount)
                 while true {
                     let entry = entries[Int(slot)].load(ordering: .relaxed)
                     // check if keys match
@@ -159,6 +259,7 @@ public struct AtomicBlockCache<Backend: AtomicBlockCacheStorable>: Sendable {
             let entries = bytes.assumingMemoryBound(to: Atomic<WordPair>.self)
             for lookAhead in 0..<lookAheadCount {
                 let slot = Int((key &+ lookAhead) % UInt64(blockCount))
+                Self.prefetchSlot(bytes, lookAhead: lookAhead, slot: slot, blockCount: blockCount)
                 while true {
                     let entry = entries[slot].load(ordering: .relaxed)
                     // check if keys match
@@ -14,12 +14,16 @@ struct AtomicCacheCoordinator<Backend: AtomicBlockCacheStorable> {
     
     func get<T: ContiguousBytes & Sendable>(key: UInt64, backendFetch: @Sendable () async throws -> T) async throws -> UnsafeRawBufferPointer {
         if let result = cache.get(key: key) {
+            RequestMetrics.increment(.block_cache_hit)
             return result
         }
+        RequestMetrics.increment(.block_cache_miss)
         // Note: Not 100% sure if there could be a race condition between cache check and calling the actor
-        return try await queue.get(key: key) {
-            let result = try await backendFetch()
-            return cache.set(key: key, value: result)
+        return try await RequestMetrics.measureAsync(.block_fetch) {
+            try await queue.get(key: key) {
+                let result = try await backendFetch()
+                return cache.set(key: key, value: result)
+            }
         }
     }
     
@@ -0,0 +1,74 @@
+import Foundation
+import NIOConcurrencyHelpers
+import Synchronization
+
+/**
+ Read-mostly map of open readers for the hot path in `RemoteOmFileManager.get`. Lookups never suspend and only lock one shard for a dictionary lookup.
+
+ `RemoteOmFileManagerCache` remains the owner of all entries. Resolved entries are published here and removed before they are evicted or replaced.
+ Misses and concurrent opens of the same file are still coalesced inside the actor.
+
+ Lookups only set an access flag. The actor collects flags during revalidation to evict inactive files.
+ */
+final class OmFileReaderRegistry: Sendable {
+    typealias Key = OmFileManagerReadable
+    typealias Value = OmFileLocalOrRemote?
+
+    final class Entry: Sendable {
+        let value: Value
+
+        /// Set on lookup, reset by `wasAccessed`
+        let accessed = Atomic<Bool>(false)
+
+        init(value: Value) {
+            self.value = value
+        }
+    }
+
+    private let shards: [NIOLockedValueBox<[Key: Entry]>]
+
+    /// Number of shards must be a power of two. It should be larger than the number of cores to keep contention low
+    init(nShards: Int = 64) {
+        precondition(nShards > 0 && nShards.nonzeroBitCount == 1, "nShards must be a power of two")
+        shards = (0..<nShards).map { _ in NIOLockedValueBox([:]) }
+    }
+
+    @inline(__always)
+    private func shard(for key: Key) -> NIOLockedValueBox<[Key: Entry]> {
+        return shards[key.hashValue & (shards.count - 1)]
+    }
+
+    /// Returns nil if the file is not open. Returns `.some(nil)` if the file is known to be missing
+    @inline(__always)
+    func get(_ key: Key) -> Value? {
+        guard let entry = shard(for: key).withLockedValue({ $0[key] }) else {
+            return nil
+        }
+        // Only write if required to keep the cache line shared between cores
+        if !entry.accessed.load(ordering: .relaxed) {
+            entry.accessed.store(true, ordering: .relaxed)
+        }
+        return .some(entry.value)
+    }
+
+    func set(_ key: Key, value: Value) {
+        let entry = Entry(value: value)
+        shard(for: key).withLockedValue {
+            $0[key] = entry
+        }
+    }
+
+    func remove(_ key: Key) {
+        shard(for: key).withLockedValue {
+            _ = $0.removeValue(forKey: key)
+        }
+    }
+
+    /// True if the entry was read since the last call
+    func wasAccessed(_ key: Key) -> Bool {
+        guard let entry = shard(for: key).withLockedValue({ $0[key] }) else {
+            return false
+        }
+        return entry.accessed.exchange(false, ordering: .relaxed)
+    }
+}
@@ -0,0 +1,391 @@
+#if ENABLE_IO_URING
+import CLiburing
+import Foundation
+import NIOConcurrencyHelpers
+import OmFileFormat
+import Vapor
+
+enum IoUringError: Error {
+    case setupFailed(errno: Int32)
+    case readFailed(errno: Int32)
+    case unexpectedEndOfFile
+    case openFailed(errno: Int32, file: String)
+}
+
+/**
+ Shared io_uring instance. Reads are submitted from any thread and completed by a dedicated thread, so cooperative executor threads never block on page faults or disk IO.
+
+ All reads of one `submit` call are queued as one batch and submitted with a single system call. The completion thread resumes the waiting task once every read of the batch completed.
+ At most `entries` reads are in flight. Further submissions wait for free slots, so the submission queue never overflows and the completion queue (twice as large) cannot fill up.
+ */
+final class IoUring: @unchecked Sendable {
+    /// Nil if io_uring is not available. E.g. disabled by seccomp in containers or by `kernel.io_uring_disabled`
+    static let shared: IoUring? = {
+        do {
+            return try IoUring(entries: 256)
+        } catch {
+            Logger(label: "IoUring").warning("io_uring not available, falling back to mmap: \(error)")
+            return nil
+        }
+    }()
+
+    /// One read into a buffer
+    struct Read {
+        let fd: Int32
+        let buffer: UnsafeMutableRawBufferPointer
+        let offset: Int
+    }
+
+    /// Results of reads that are submitted together
+    private final class Batch {
+        var results: [Int32]
+        var remaining: Int
+        let continuation: CheckedContinuation<[Int32], Never>
+
+        init(count: Int, continuation: CheckedContinuation<[Int32], Never>) {
+            self.results = .init(repeating: 0, count: count)
+            self.remaining = count
+            self.continuation = continuation
+        }
+    }
+
+    private let ring: UnsafeMutablePointer<io_uring>
+    let entries: Int
+    /// Guards the submission queue, `inflight`, `freeSlots` and `waiting`
+    private let lock = NIOLock()
+    private var inflight = [UInt64: (batch: Batch, index: Int)]()
+    private var nextId: UInt64 = 0
+    /// Number of reads that can be queued without exceeding `entries` in flight
+    private var freeSlots: Int
+    /// Submissions waiting for free slots in FIFO order
+    private var waiting = [(count: Int, continuation: CheckedContinuation<Void, Never>)]()
+
+    init(entries: UInt32) throws {
+        ring = .allocate(capacity: 1)
+        let ret = io_uring_queue_init(entries, ring, 0)
+        guard ret == 0 else {
+            ring.deallocate()
+            throw IoUringError.setupFailed(errno: -ret)
+        }
+        self.entries = Int(entries)
+        self.freeSlots = Int(entries)
+        let thread = Thread { [self] in
+            self.completionLoop()
+        }
+        thread.name = "io_uring completion"
+        thread.start()
+    }
+
+    /// Submit all reads and wait for completion. Returns the number of bytes read or a negative errno for each read.
+    /// Reads are submitted in batches of at most `entries` and wait for free slots if the ring is busy
+    func submit(_ reads: [Read]) async -> [Int32] {
+        if reads.count <= entries {
+            return await submitBatch(reads[...])
+        }
+        var results = [Int32]()
+        results.reserveCapacity(reads.count)
+        for start in stride(from: 0, to: reads.count, by: entries) {
+            results.append(contentsOf: await submitBatch(reads[start ..< min(start + entries, reads.count)]))
+        }
+        return results
+    }
+
+    private func submitBatch(_ reads: ArraySlice<Read>) async -> [Int32] {
+        if reads.isEmpty {
+            return []
+        }
+        await acquire(slots: reads.count)
+        return await withCheckedContinuation { continuation in
+            let batch = Batch(count: reads.count, continuation: continuation)
+            let ret = lock.withLock {
+                for (index, read) in reads.enumerated() {
+                    let id = nextId
+                    nextId &+= 1
+                    inflight[id] = (batch, index)
+                    // Reserved slots guarantee space. Unconsumed entries belong to reads that hold slots as well
+                    guard let sqe = io_uring_get_sqe(ring) else {
+                        fatalError("io_uring submission queue full despite reserved slots")
+                    }
+                    io_uring_prep_read(sqe, read.fd, read.buffer.baseAddress, numericCast(read.buffer.count), numericCast(read.offset))
+                    sqe.pointee.user_data = id
+                }
+                return io_uring_submit(ring)
+            }
+            if ret == -EINTR || ret == -EAGAIN || ret == -EBUSY {
+                // Entries stay queued and are picked up by the next `io_uring_submit`. Retried in `flush` without holding the lock
+                Task { await self.flush() }
+                return
+            }
+            guard ret >= 0 else {
+                // Queued entries reference caller buffers and cannot be withdrawn
+                fatalError("io_uring_submit failed with errno \(-ret)")
+            }
+        }
+    }
+
+    /// Retry submitting queued entries after a transient error. Sleeps between attempts instead of spinning while holding the lock
+    private func flush() async {
+        var attempt = 0
+        while true {
+            let ret = lock.withLock { io_uring_submit(ring) }
+            if ret >= 0 {
+                return
+            }
+            guard ret == -EINTR || ret == -EAGAIN || ret == -EBUSY else {
+                fatalError("io_uring_submit failed with errno \(-ret)")
+            }
+            attempt += 1
+            try? await Task.sleep(for: .microseconds(min(50 * attempt, 1000)))
+        }
+    }
+
+    /// Wait until `count` reads can be queued
+    private func acquire(slots count: Int) async {
+        await withCheckedContinuation { (continuation: CheckedContinuation<Void, Never>) in
+            let ready = lock.withLock {
+                if waiting.isEmpty && freeSlots >= count {
+                    freeSlots -= count
+                    return true
+                }
+                waiting.append((count, continuation))
+                return false
+            }
+            if ready {
+                continuation.resume()
+            }
+        }
+    }
+
+    /// Must be called while holding `lock`. Returns submissions that got their slots and can be resumed after releasing the lock
+    private func releaseSlot() -> [CheckedContinuation<Void, Never>] {
+        freeSlots += 1
+        var ready = [CheckedContinuation<Void, Never>]()
+        while let first = waiting.first, freeSlots >= first.count {
+            freeSlots -= first.count
+            ready.append(waiting.removeFirst().continuation)
+        }
+        return ready
+    }
+
+    /// Must be called while holding `lock`
+    private static func complete(batch: Batch, index: Int, result: Int32) {
+        batch.results[index] = result
+        batch.remaining -= 1
+        if batch.remaining == 0 {
+            batch.continuation.resume(returning: batch.results)
+        }
+    }
+
+    private func completionLoop() {
+        var cqe: UnsafeMutablePointer<io_uring_cqe>? = nil
+        while true {
+            let ret = io_uring_wait_cqe(ring, &cqe)
+            if ret == -EINTR || ret == -EAGAIN {
+                continue
+            }
+            guard ret == 0, let completed = cqe else {
+                Logger(label: "IoUring").error("io_uring_wait_cqe failed with errno \(-ret)")
+                continue
+            }
+            let id = completed.pointee.user_data
+            let result = completed.pointee.res
+            io_uring_cqe_seen(ring, completed)
+            let ready = lock.withLock {
+                guard let entry = inflight.removeValue(forKey: id) else {
+                    return [CheckedContinuation<Void, Never>]()
+                }
+                Self.complete(batch: entry.batch, index: entry.index, result: result)
+                return releaseSlot()
+            }
+            for continuation in ready {
+                continuation.resume()
+            }
+        }
+    }
+}
+
+/**
+ Page aligned buffers for io_uring reads. `O_DIRECT` requires aligned buffers.
+ Buffers are kept in power of two size classes and reused by subsequent reads. Buffers larger than `maxPooledSize` are not pooled
+ */
+final class IoUringBufferPool: @unchecked Sendable {
+    static let shared = IoUringBufferPool()
+
+    static let alignment = 4096
+    static let maxPooledSize = 16 * 1024 * 1024
+    /// Number of free buffers to keep per size class
+    static let maxFreePerClass = 64
+
+    private let lock = NIOLock()
+    private var free = [Int: [UnsafeMutableRawBufferPointer]]()
+
+    /// Get a buffer with at least `byteCount` bytes
+    func get(byteCount: Int) -> UnsafeMutableRawBufferPointer {
+        let size = Self.sizeClass(byteCount)
+        if size <= Self.maxPooledSize, let buffer = lock.withLock({ free[size]?.popLast() }) {
+            return buffer
+        }
+        return .allocate(byteCount: size, alignment: Self.alignment)
+    }
+
+    func put(_ buffer: UnsafeMutableRawBufferPointer) {
+        let size = buffer.count
+        guard size <= Self.maxPooledSize else {
+            buffer.deallocate()
+            return
+        }
+        let pooled = lock.withLock {
+            guard free[size, default: []].count < Self.maxFreePerClass else {
+                return false
+            }
+            free[size, default: []].append(buffer)
+            return true
+        }
+        if !pooled {
+            buffer.deallocate()
+        }
+    }
+
+    private static func sizeClass(_ byteCount: Int) -> Int {
+        var size = alignment
+        while size < byteCount {
+            size *= 2
+        }
+        return size
+    }
+}
+
+/**
+ Read local OM files through io_uring instead of mmap. Reads complete into pooled buffers without blocking executor threads.
+
+ With `O_DIRECT` the page cache is bypassed. Offsets and lengths are widened to 4096 byte boundaries.
+ This avoids caching data twice if local files are also cached in `AtomicBlockCache`.
+ */
+struct OmIoUringReaderBackend: OmFileReaderBackend, Sendable {
+    enum Mode: String {
+        case mmap
+        case io_uring
+        case io_uring_direct
+    }
+
+    /// Reader for local files. `LOCAL_FILE_READER=io_uring` or `io_uring_direct`. Default `mmap`
+    static let mode: Mode = {
+        guard let mode = Environment.get("LOCAL_FILE_READER") else {
+            return .mmap
+        }
+        guard let mode = Mode(rawValue: mode) else {
+            fatalError("LOCAL_FILE_READER must be one of \(Mode.io_uring), \(Mode.io_uring_direct) or \(Mode.mmap)")
+        }
+        return mode
+    }()
+
+    let ring: IoUring
+    /// Keeps the file descriptor open and is used to check for deleted files
+    let file: FileHandle
+    let count: Int
+    let direct: Bool
+    /// Path, size and modification time. A replaced file uses new cache blocks
+    let cacheKey: UInt64
+
+    typealias DataType = Data
+
+    init(ring: IoUring, file: String, direct: Bool) throws {
+        let fd = open(file, O_RDONLY | (direct ? CLIBURING_O_DIRECT : 0))
+        guard fd >= 0 else {
+            throw IoUringError.openFailed(errno: errno, file: file)
+        }
+        self.file = FileHandle(fileDescriptor: fd, closeOnDealloc: true)
+        var stats = stat()
+        guard fstat(fd, &stats) == 0 else {
+            throw IoUringError.openFailed(errno: errno, file: file)
+        }
+        self.count = Int(stats.st_size)
+        self.cacheKey = file.fnv1aHash64 ^ UInt64(truncatingIfNeeded: stats.st_size) ^ UInt64(truncatingIfNeeded: stats.st_mtim.tv_sec) &* 0x9E3779B97F4A7C15
+        self.ring = ring
+        self.direct = direct
+    }
+
+    /// Open a local file. Returns nil if `O_DIRECT` cannot be used, e.g. on tmpfs or some overlay file systems, so the caller falls back to mmap
+    static func openLocal(ring: IoUring, file: String, direct: Bool) throws -> OmIoUringReaderBackend? {
+        do {
+            return try OmIoUringReaderBackend(ring: ring, file: file, direct: direct)
+        } catch IoUringError.openFailed(let code, _) where direct && code != ENOENT {
+            _ = directUnsupportedWarning
+            return nil
+        }
+    }
+
+    /// Logged once to avoid a warning for every opened file
+    private static let directUnsupportedWarning: Void = {
+        Logger(label: "IoUring").warning("Opening local files with O_DIRECT failed, falling back to mmap")
+    }()
+
+    func prefetchData(offset: Int, count: Int) async throws {
+        // Reads are asynchronous. There are no page faults to avoid
+    }
+
+    func getData(offset: Int, count: Int) async throws -> Data {
+        return try await withData(offset: offset, count: count) { Data($0) }
+    }
+
+    func withData<T>(offset: Int, count: Int, fn: @Sendable (UnsafeRawBufferPointer) throws -> T) async throws -> T {
+        let alignment = direct ? IoUringBufferPool.alignment : 1
+        let start = offset / alignment * alignment
+        let end = (offset + count).divideRoundedUp(divisor: alignment) * alignment
+        let buffer = IoUringBufferPool.shared.get(byteCount: end - start)
+        defer { IoUringBufferPool.shared.put(buffer) }
+        let read = try await read(into: UnsafeMutableRawBufferPointer(rebasing: buffer[0 ..< end - start]), offset: start)
+        guard read >= offset + count - start else {
+            throw IoUringError.unexpectedEndOfFile
+        }
+        return try fn(UnsafeRawBufferPointer(rebasing: buffer[offset - start ..< offset - start + count]))
+    }
+
+    /// Large reads are split into segments that are submitted together to use the queue depth of NVMe drives
+    static let segmentSize = 256 * 1024
+
+    /// Read until the buffer is full or the end of file is reached. Returns the number of bytes read
+    private func read(into buffer: UnsafeMutableRawBufferPointer, offset: Int) async throws -> Int {
+        let segments = stride(from: 0, to: buffer.count, by: Self.segmentSize).map { $0 ..< min($0 + Self.segmentSize, buffer.count) }
+        let results = await ring.submit(segments.map {
+            IoUring.Read(fd: file.fileDescriptor, buffer: UnsafeMutableRawBufferPointer(rebasing: buffer[$0]), offset: offset + $0.lowerBound)
+        })
+        for (segment, result) in zip(segments, results) {
+            if result < 0 && result != -EINTR && result != -EAGAIN {
+                throw IoUringError.readFailed(errno: -result)
+            }
+            let done = segment.lowerBound + max(0, Int(result))
+            if done < segment.upperBound {
+                // Interrupted, short read or end of file. Continue sequentially
+                return try await readSequential(into: buffer, offset: offset, from: done)
+            }
+        }
+        return buffer.count
+    }
+
+    private func readSequential(into buffer: UnsafeMutableRawBufferPointer, offset: Int, from: Int) async throws -> Int {
+        var done = from
+        while done < buffer.count {
+            let remaining = UnsafeMutableRawBufferPointer(rebasing: buffer[done...])
+            let result = await ring.submit([.init(fd: file.fileDescriptor, buffer: remaining, offset: offset + done)])[0]
+            if result == -EINTR || result == -EAGAIN {
+                continue
+            }
+            guard result >= 0 else {
+                throw IoUringError.readFailed(errno: -result)
+            }
+            if result == 0 {
+                break
+            }
+            done += Int(result)
+        }
+        return done
+    }
+
+    /// With `O_DIRECT` blocks are cached in `AtomicBlockCache` instead of the page cache
+    func asCachedReader() async throws -> OmFileReader<OmReaderBlockCache<OmIoUringReaderBackend, MmapFile>> {
+        let cacheFn = OmReaderBlockCache(backend: self, cache: OpenMeteo.dataBlockCache, cacheKey: cacheKey)
+        return try await OmFileReader(fn: cacheFn)
+    }
+}
+#endif
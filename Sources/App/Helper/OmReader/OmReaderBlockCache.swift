@@ -39,6 +39,7 @@ struct OmReaderBlockCache<Backend: OmFileReaderBackend, Cache: AtomicBlockCacheS
         
         /// Check if all blocks are available sequentially in cache
         if let ptr = cache.cache.get(key: cacheKey &+ UInt64(blocks.lowerBound), count: UInt64(blocks.count)) {
+            RequestMetrics.increment(.block_cache_hit, by: blocks.count)
             let blockRange = blocks.lowerBound * blockSize ..< blocks.upperBound * blockSize
             let range = dataRange.intersect(fileTime: blockRange)!
             return try fn(UnsafeRawBufferPointer(rebasing: ptr[range.file]))
@@ -69,6 +70,7 @@ struct OmReaderBlockCache<Backend: OmFileReaderBackend, Cache: AtomicBlockCacheS
         
         /// Check if all blocks are available sequentially in cache
         if let ptr = cache.cache.get(key: cacheKey &+ UInt64(blocks.lowerBound), count: UInt64(blocks.count)) {
+            RequestMetrics.increment(.block_cache_hit, by: blocks.count)
             let blockRange = blocks.lowerBound * blockSize ..< blocks.upperBound * blockSize
             let range = dataRange.intersect(fileTime: blockRange)!
             return Data(ptr[range.file])
@@ -6,6 +6,7 @@ import Vapor
  Keep track of local and remote OM files. If a OM file is locally available, use it, otherwise check a remote http endpoint.
  
  Local files use mmap to read data. This should only be used for fast storage. Access to mmap data is synchronous, but uses madvice for better prefetching
+ With `ENABLE_IO_URING` builds and `LOCAL_FILE_READER=io_uring`, local files are read asynchronously with io_uring instead. `io_uring_direct` uses `O_DIRECT` and caches blocks in the block cache
  
  Remote files use HTTP Range requests to get data in chunks of 64kb. Requests to the same 64kb data block are serialised and queued.
  Data blocks are cached in a local cache file. The cache file uses mmap and should reside on a fast local disk.
@@ -16,6 +17,15 @@ import Vapor
  - Remote files are checked every 3 minutes
  - All files are evicted from cache after 15 minutes of inactivity
  
+ With `REMOTE_MANIFEST_REVALIDATION=true` remote files are invalidated by domain manifests instead of individual HEAD requests:
+ - `<domain>/static/meta.json` is fetched once per domain every 10 seconds
+ - If `last_run_modification_time` changed, only files that were written by the new run are removed from cache
+ - Files of domains with a manifest are additionally checked every 30 minutes. Files without manifest every 3 minutes
+ 
+ HEAD requests and manifest fetches run concurrently outside the cache actor and do not block `get`.
+ 
+ Open files are published to `OmFileReaderRegistry`. Reads of open files do not hop to the cache actor. Only misses are resolved in the actor.
+ 
  TODO:
  - Support multiple cache files. Could be useful if multiple NVMe drive are available for caching
  - Support cache tiering for HDD + NVME cache
@@ -44,23 +54,82 @@ final class RemoteOmFileManager: Sendable {
     /// Check if the file is available locally or remotely. `with<R>()` is recommended
     /// Note: If the file is remote, the reader may throw `CurlError.fileModifiedSinceLastDownload` if the file was modified on the remote end
     func get(file: OmFileManagerReadable, client: HTTPClient, logger: Logger, forceNew: Bool = false) async throws -> (any OmFileReaderArrayProtocol<Float>)? {
+        if !forceNew, case .some(let cached) = cache.registry.get(file) {
+            return cached?.toReader()
+        }
         guard let backend = try await cache.get(key: file, forceNew: forceNew, provider: {
-            return try await file.newReader(client: client, logger: logger)
+            return try await RequestMetrics.measureAsync(.file_open) {
+                try await file.newReader(client: client, logger: logger)
+            }
         }) else {
             return nil
         }
         return backend.toReader()
     }
     
+    /// Use domain manifests to invalidate remote files
+    static let manifestRevalidation = Environment.get("REMOTE_MANIFEST_REVALIDATION") == "true"
+    
     /// Called every 10 seconds from a life cycle handler on an available thread
     func backgroundTask(application: Application) async throws {
-        try await cache.revalidate(client: application.http.client.shared, logger: application.logger)
+        let client = application.http.client.shared
+        let logger = application.logger
+        let plan = await cache.prepareRevalidation(manifestMode: Self.manifestRevalidation)
+        guard let remoteDirectory = OpenMeteo.remoteDataDirectory else {
+            await cache.logStatistics(total: plan.total, running: plan.running, logger: logger)
+            return
+        }
+        if Self.manifestRevalidation {
+            let manifests = await plan.domains.mapConcurrent(nConcurrent: 16) { domain in
+                return (domain, await Self.fetchManifest(domain: domain, remoteDirectory: remoteDirectory, client: client, logger: logger))
+            }
+            await cache.applyManifests(manifests)
+        }
+        let modified = await plan.revalidate.mapConcurrent(nConcurrent: 32) { file in
+            return (file.key, await Self.isModified(file: file.key, cacheKey: file.cacheKey, remoteDirectory: remoteDirectory, client: client, logger: logger))
+        }
+        await cache.applyRevalidation(modified: modified.filter { $0.1 }.map { $0.0 })
+        await cache.logStatistics(total: plan.total, running: plan.running, logger: logger)
+    }
+    
+    /// Send a HEAD request and compare the cache key. `cacheKey` is nil if the file did not exist before. Errors are logged and the file is considered unchanged
+    static func isModified(file: OmFileManagerReadable, cacheKey: UInt64?, remoteDirectory: String, client: HTTPClient, logger: Logger) async -> Bool {
+        let remoteFile = "\(file.remoteDirectory ?? remoteDirectory)\(file.getRelativeFilePath())"
+        // Background task, therefore always measured
+        let revalidateStart = DispatchTime.now().uptimeNanoseconds
+        defer { RequestMetrics.record(.file_revalidate, nanoseconds: Int(DispatchTime.now().uptimeNanoseconds - revalidateStart)) }
+        do {
+            let newBackend = try await OmHttpReaderBackend(client: client, logger: logger, url: remoteFile)
+            return newBackend?.cacheKey != cacheKey
+        } catch {
+            logger.warning("OmFileManager: Revalidation of \(remoteFile) failed: \(error)")
+            return false
+        }
+    }
+    
+    /// Download and decode the remote `meta.json` of a domain. Returns nil if the domain has no manifest or the request failed
+    static func fetchManifest(domain: DomainRegistry, remoteDirectory: String, client: HTTPClient, logger: Logger) async -> ModelUpdateMetaJson? {
+        let url = "\(remoteDirectory)\(OmFileManagerReadable.meta(domain: domain).getRelativeFilePath())"
+        do {
+            let response = try await client.executeRetry(HTTPClientRequest(url: url), logger: logger, deadline: .seconds(5), timeoutPerRequest: .seconds(2), backOffSettings: .init(factor: .milliseconds(100), maximum: .milliseconds(500)))
+            let body = try await response.body.collect(upTo: 1024 * 1024)
+            return try JSONDecoder().decode(ModelUpdateMetaJson.self, from: Data(body.readableBytesView))
+        } catch CurlError.fileNotFound {
+            return nil
+        } catch {
+            logger.warning("OmFileManager: Could not get manifest \(url): \(error)")
+            return nil
+        }
     }
 }
 
 enum OmFileLocalOrRemote {
     case local(OmFileReaderArray<MmapFile, Float>)
     case remote(OmFileReaderArray<OmReaderBlockCache<OmHttpReaderBackend, MmapFile>, Float>)
+    #if ENABLE_IO_URING
+    case localIoUring(OmFileReaderArray<OmIoUringReaderBackend, Float>)
+    case localIoUringDirect(OmFileReaderArray<OmReaderBlockCache<OmIoUringReaderBackend, MmapFile>, Float>)
+    #endif
     
     func toReader() -> any OmFileReaderArrayProtocol<Float> {
         switch self {
@@ -68,6 +137,28 @@ enum OmFileLocalOrRemote {
             return local
         case .remote(let remote):
             return remote
+        #if ENABLE_IO_URING
+        case .localIoUring(let local):
+            return local
+        case .localIoUringDirect(let local):
+            return local
+        #endif
+        }
+    }
+    
+    /// True if a local file was deleted or replaced
+    func localFileWasDeleted() -> Bool? {
+        switch self {
+        case .local(let local):
+            return local.fn.file.wasDeleted()
+        case .remote:
+            return nil
+        #if ENABLE_IO_URING
+        case .localIoUring(let local):
+            return local.fn.file.wasDeleted()
+        case .localIoUringDirect(let local):
+            return local.fn.backend.file.wasDeleted()
+        #endif
         }
     }
 }
@@ -77,22 +168,56 @@ extension OmFileManagerReadable {
         /// TODO: for data_run support there needs to be a switch here
         /// Also needs fix in revalidate
         let file = self.getRelativeFilePath()
-        let localFile = "\(OpenMeteo.dataDirectory)\(file)"
+        let localFile = "\(localDirectory)\(file)"
         
         if FileManager.default.fileExists(atPath: localFile) {
-            guard let reader =  try await OmFileReader(fn: try MmapFile(fn: try FileHandle.openFileReading(file: localFile), mode: .readOnly)).asArray(of: Float.self) else {
+            #if ENABLE_IO_URING
+            if OmIoUringReaderBackend.mode != .mmap, let ring = IoUring.shared, let backend = try OmIoUringReaderBackend.openLocal(ring: ring, file: localFile, direct: OmIoUringReaderBackend.mode == .io_uring_direct) {
+                if backend.direct {
+                    guard let reader = try await selectVariable(backend.asCachedReader())?.asArray(of: Float.self) else {
+                        return nil
+                    }
+                    return .localIoUringDirect(reader)
+                }
+                guard let reader = try await selectVariable(OmFileReader(fn: backend))?.asArray(of: Float.self) else {
+                    return nil
+                }
+                return .localIoUring(reader)
+            }
+            #endif
+            guard let reader =  try await selectVariable(OmFileReader(fn: try MmapFile(fn: try FileHandle.openFileReading(file: localFile), mode: .readOnly)))?.asArray(of: Float.self) else {
                 return nil
             }
             return .local(reader)
         }
-        if let remoteDirectory = OpenMeteo.remoteDataDirectory {
+        if let remoteDirectory {
             let remoteFile = "\(remoteDirectory)\(file)"
-            if let remote = try await OmHttpReaderBackend(client: client, logger: logger, url: remoteFile), let reader = try await remote.asCachedReader().asArray(of: Float.self) {
+            if let remote = try await OmHttpReaderBackend(client: client, logger: logger, url: remoteFile), let reader = try await selectVariable(remote.asCachedReader())?.asArray(of: Float.self) {
                 return .remote(reader)
             }
         }
         return nil
     }
+
+    /// Spatial files store multiple variables as children of the root. Other files store one array at the root
+    private func selectVariable<Backend>(_ root: OmFileReader<Backend>) async throws -> OmFileReader<Backend>? {
+        guard case .spatial(domain: _, run: _, time: _, realm: _, variable: let variable) = self else {
+            return root
+        }
+        return try await root.findChild(name: variable)
+    }
+}
+
+extension OmFileReader {
+    /// Find a direct child variable by name
+    func findChild(name: String) async throws -> Self? {
+        for i in 0..<numberOfChildren {
+            if let child = try await getChild(i), child.getName() == name {
+                return child
+            }
+        }
+        return nil
+    }
 }
 
 extension OmFileReaderProtocol {
@@ -113,11 +238,13 @@ final actor RemoteOmFileManagerCache {
         var inactivity = 0
         var localModified = 0
         var remoteModified = 0
+        var manifestModified = 0
         
         func reset() {
             inactivity = 0
             localModified = 0
             remoteModified = 0
+            manifestModified = 0
         }
     }
     
@@ -152,6 +279,9 @@ final actor RemoteOmFileManagerCache {
     var cache = [Key: State]()
     var statistics: Statistics = .init()
     
+    /// Lock-free lookups of cached entries. Updated whenever `cache` changes
+    let registry = OmFileReaderRegistry()
+    
     /**
      Get a resource identified by a key. If the request is currently being requested, enqueue the request
      */
@@ -159,11 +289,13 @@ final actor RemoteOmFileManagerCache {
         guard let state = cache[key], !(forceNew == true && state.isCached) else {
             // Value not cached or needs to be refreshed
             cache[key] = .running([])
+            registry.remove(key)
             do {
                 let data = try await provider()
                 guard case .running(let queued) = cache.updateValue(.cached(.init(value: data)), forKey: key) else {
                     fatalError("State was not .running()")
                 }
+                registry.set(key, value: data)
                 queued.forEach {
                     $0.resume(with: .success(data))
                 }
@@ -190,82 +322,181 @@ final actor RemoteOmFileManagerCache {
         }
     }
     
+    /// Latest manifest of each domain
+    var manifests = [DomainRegistry: ModelUpdateMetaJson]()
+    
+    /// Work for one revalidation tick that is executed outside the actor
+    struct RevalidationPlan: Sendable {
+        /// Domains with remote files or files that were not found
+        let domains: [DomainRegistry]
+        /// Remote files that are due for a HEAD request with their current cache key
+        let revalidate: [(key: Key, cacheKey: UInt64?)]
+        let total: Int
+        let running: Int
+    }
+    
     /**
-     Remove entries that have not been accessed for more than 15 minutes
-     Revalidate entries older than 3 minutes.
+     Remove entries that have not been accessed for more than 15 minutes and check local files.
+     Return remote entries older than 3 minutes for revalidation. In manifest mode, entries of domains with a manifest are only returned after 30 minutes.
      Called every 10 seconds
      */
-    func revalidate(client: HTTPClient, logger: Logger) async throws {
+    func prepareRevalidation(manifestMode: Bool) -> RevalidationPlan {
         var running = 0
         var total = 0
+        var domains = Set<DomainRegistry>()
+        var revalidate = [(key: Key, cacheKey: UInt64?)]()
         statistics.ticks += 1
         
         let removeLastAccessedThan: Timestamp = .now().subtract(minutes: 15)
         let revalidateAfter: Timestamp = .now().subtract(minutes: 3)
+        let revalidateManifestAfter: Timestamp = .now().subtract(minutes: 30)
         for (key, state) in cache {
             total += 1
             guard case .cached(let entry) = state else {
                 running += 1
                 continue
             }
+            if registry.wasAccessed(key) {
+                entry.lastAccessed = .now()
+            }
             // Evict unused entries after 15 minutes
             if entry.lastAccessed < removeLastAccessedThan {
                 statistics.inactivity += 1
-                cache.removeValue(forKey: key)
+                remove(key)
                 continue
             }
             
             // Always check if local files got deleted or overwritten
-            if case .local(let local) = entry.value, local.fn.file.wasDeleted() {
-                statistics.localModified += 1
-                cache.removeValue(forKey: key)
+            if let wasDeleted = entry.value?.localFileWasDeleted() {
+                if wasDeleted {
+                    statistics.localModified += 1
+                    remove(key)
+                }
                 continue
             }
             
             // Always check if a local file is now available
             if entry.value == nil, FileManager.default.fileExists(atPath: key.getFilePath()) {
                 statistics.localModified += 1
-                cache.removeValue(forKey: key)
+                remove(key)
                 continue
             }
             
+            guard OpenMeteo.remoteDataDirectory != nil else {
+                continue
+            }
+            let domain = key.domain
+            domains.insert(domain)
+            
             // Revalidate remote files every 3 minutes
             // File may got added, modified or removed
-            if let remoteDirectory = OpenMeteo.remoteDataDirectory, entry.lastValidated < revalidateAfter {
+            let hasManifest = manifestMode && manifests[domain] != nil
+            if entry.lastValidated < (hasManifest ? revalidateManifestAfter : revalidateAfter) {
                 entry.lastValidated = .now()
-                let remoteFile = "\(remoteDirectory)\(key.getRelativeFilePath())"
-                if let new = try await OmHttpReaderBackend(client: client, logger: logger, url: remoteFile) {
-                    if case .remote(let old) = entry.value {
-                        guard old.fn.cacheKey != new.cacheKey else {
-                            continue // do not update if the existing entry is the same
-                        }
-                        statistics.remoteModified += 1
-                        guard let reader = try await new.asCachedReaderArray() else {
-                            entry.value = nil
-                            continue
-                        }
-                        entry.value = .remote(reader)
-                    } else {
-                        statistics.remoteModified += 1
-                        guard let reader = try await new.asCachedReaderArray() else {
-                            entry.value = nil
-                            continue
-                        }
-                        entry.value = .remote(reader)
-                    }
+                if case .remote(let old) = entry.value {
+                    revalidate.append((key, old.fn.cacheKey))
                 } else {
-                    statistics.remoteModified += 1
-                    entry.value = nil
+                    revalidate.append((key, nil))
                 }
             }
         }
+        return RevalidationPlan(domains: Array(domains), revalidate: revalidate, total: total, running: running)
+    }
+    
+    /// Store new manifests. If the last modification time of a domain changed, remove all files that may have been written by the new run
+    func applyManifests(_ new: [(DomainRegistry, ModelUpdateMetaJson?)]) {
+        for case (let domain, .some(let meta)) in new {
+            guard let previous = manifests.updateValue(meta, forKey: domain),
+                  previous.last_run_modification_time != meta.last_run_modification_time else {
+                continue
+            }
+            for (key, state) in cache where key.domain == domain && key.isModified(by: meta) {
+                guard state.isCached else {
+                    continue
+                }
+                statistics.manifestModified += 1
+                remove(key)
+            }
+        }
+    }
+    
+    /// Remove entries that were modified remotely. The next access opens the new file
+    func applyRevalidation(modified: [Key]) {
+        for key in modified {
+            guard cache[key]?.isCached == true else {
+                continue
+            }
+            statistics.remoteModified += 1
+            remove(key)
+        }
+    }
+    
+    /// Remove a cached entry and stop serving it from the registry
+    private func remove(_ key: Key) {
+        cache.removeValue(forKey: key)
+        registry.remove(key)
+    }
+    
+    func logStatistics(total: Int, running: Int, logger: Logger) {
         if statistics.ticks.isMultiple(of: 10), total > 10 {
-            logger.info("OmFileManager: \(total) open files, \(running) running. Removed since last check: \(statistics.inactivity) inactive, \(statistics.localModified) local modified, \(statistics.remoteModified) remote modified")
+            logger.info("OmFileManager: \(total) open files, \(running) running. Removed since last check: \(statistics.inactivity) inactive, \(statistics.localModified) local modified, \(statistics.remoteModified) remote modified, \(statistics.manifestModified) manifest modified")
             statistics.reset()
         }
     }
 }
 
+extension OmFileManagerReadable {
+    var domain: DomainRegistry {
+        switch self {
+        case .domainChunk(let domain, _, _, _, _, _):
+            return domain
+        case .staticFile(let domain, _, _):
+            return domain
+        case .meta(let domain):
+            return domain
+        case .run(let domain, _, _):
+            return domain
+        case .spatial(domain: let domain, run: _, time: _, realm: _, variable: _):
+            return domain
+        }
+    }
+    
+    /**
+     True if this file may have been written by the run described in `meta`. Files are updated from the run initialisation time onwards.
+     Static files and bias correction files are never modified by model runs.
+     */
+    func isModified(by meta: ModelUpdateMetaJson) -> Bool {
+        let run = Timestamp(meta.last_run_initialisation_time)
+        switch self {
+        case .domainChunk(let domain, _, let type, let chunk, _, _):
+            switch type {
+            case .chunk:
+                guard let chunk, let domain = domain.getDomain() else {
+                    return true
+                }
+                // Compare time steps to prevent overflows for very long chunks
+                return (chunk + 1) * domain.omFileLength > run.timeIntervalSince1970 / domain.dtSeconds
+            case .year:
+                guard let chunk else {
+                    return true
+                }
+                return Timestamp(chunk + 1, 1, 1) > run
+            case .master:
+                return true
+            case .linear_bias_seasonal, .quantile_mapping_cdf:
+                return false
+            }
+        case .staticFile, .meta:
+            return false
+        case .run(_, _, let fileRun):
+            return fileRun == run
+        case .spatial:
+            // Spatial files are written once per run and time step
+            return false
+        }
+    }
+}
+
 extension OmHttpReaderBackend {
     func asCachedReader() async throws -> OmFileReader<OmReaderBlockCache<OmHttpReaderBackend, MmapFile>> {
         let cacheFn = OmReaderBlockCache(backend: self, cache: OpenMeteo.dataBlockCache, cacheKey: self.cacheKey)
@@ -80,12 +80,17 @@ actor OmSpatialTimestepWriter {
         return writer
     }
     
+    /// Chunk dimensions of spatial files. 32 rows and up to 1024 values per chunk
+    static func chunks(ny: Int, nx: Int) -> (y: Int, x: Int) {
+        let y = min(ny, 32)
+        return (y, min(nx, 1024 / y))
+    }
+
     /// Write a single variable to the file
     func write(member: Int, variable: GenericVariable, data: [Float], compressionType: OmCompressionType = .pfor_delta2d_int16) async throws {
         let writer = try getWriter()
         
-        let y = min(domain.grid.ny, 32)
-        let x = min(domain.grid.nx, 1024 / y)
+        let (y, x) = Self.chunks(ny: domain.grid.ny, nx: domain.grid.nx)
         let dimensions = [domain.grid.ny, domain.grid.nx]
         let chunks = [y, x]
         guard dimensions.reduce(1, *) == data.count else {
@@ -172,24 +177,25 @@ actor OmSpatialTimestepWriter {
         }
         
         // Upload to AWS S3
-        // The single OM file will be uploaded + meta JSON files
+        // The single OM file will be uploaded in the background + meta JSON files once all previous files are uploaded
         if let uploadS3Bucket {
             for (bucket, profile) in domain.domainRegistry.parseBucket(uploadS3Bucket) {
-                let destDomain = "s3://\(bucket)/data_spatial/\(domain.domainRegistry.rawValue)/"
+                let destDomain = "data_spatial/\(domain.domainRegistry.rawValue)/"
                 let destRun = "\(destDomain)\(run.format_directoriesYYYYMMddhhmm)/"
                 let destFile = "\(destRun)\(time.iso8601_YYYY_MM_dd_HHmm)\(realm).om"
                 
-                try Process.awsCopy(src: filename, dest: destFile, profile: profile)
+                let queue = S3UploadQueue.shared
+                try await queue.copy(src: filename, bucket: bucket, key: destFile, profile: profile)
                 if uploadMeta {
                     let destMeta = "\(destRun)meta\(realm).json"
-                    try Process.awsCopy(src: metaRunMeta, dest: destMeta, profile: profile)
+                    try await queue.copy(src: metaRunMeta, bucket: bucket, key: destMeta, profile: profile, barrier: true)
                     if canUpdateInProgress {
                         let destInProgress = "\(destDomain)in-progress\(realm).json"
-                        try Process.awsCopy(src: metaInProgress, dest: destInProgress, profile: profile)
+                        try await queue.copy(src: metaInProgress, bucket: bucket, key: destInProgress, profile: profile, barrier: true)
                     }
                     if completed {
                         let destLatest = "\(destDomain)latest\(realm).json"
-                        try Process.awsCopy(src: metaLatest, dest: destLatest, profile: profile)
+                        try await queue.copy(src: metaLatest, bucket: bucket, key: destLatest, profile: profile, barrier: true)
                     }
                 }
             }
@@ -243,7 +249,7 @@ actor OmSpatialMultistepWriter {
     }
 }
 
-fileprivate struct DataSpatialJson: Codable {
+struct DataSpatialJson: Codable {
     let reference_time: Date
     let last_modified_time: Date
     let completed: Bool
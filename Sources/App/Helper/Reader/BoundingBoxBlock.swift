@@ -0,0 +1,144 @@
+import Foundation
+import Vapor
+
+/// Grid slices that cover a rectangular block of rows `yRange` and columns `xRange`
+protocol GridSliceXy {
+    var yRange: Range<Int> { get }
+    var xRange: Range<Int> { get }
+}
+
+extension RegularGridSlice: GridSliceXy {}
+
+extension ProjectionGridSlice: GridSliceXy {}
+
+/**
+ Shared reads for all grid points of a bounding box query.
+
+ Without it, every grid point of a bounding box reads its own time series and a 100x100 box decompresses the same chunks 10,000 times.
+ The box is split into bands of rows with at most `maxValues` values. The first reader that requests a variable in a band reads the whole `[y, x, time]` band with one call per file. All other grid points of the band take their time series from it.
+ A band is released once every grid point of the band has read it. Locations are processed in order, so at most one band per variable is kept at a time.
+ If a single row exceeds `maxValues` or a grid point reads a band again after it was released, the time series is read for this grid point only.
+ */
+final actor BoundingBoxBlock {
+    /// Only readers of this domain use the block. Mixed readers may contain other domains
+    let domain: DomainRegistry
+    let nx: Int
+    let yRange: Range<Int>
+    let xRange: Range<Int>
+
+    /// Largest band that is kept in memory. 32 MB per variable
+    static let maxValues = 8 * 1024 * 1024
+
+    struct Key: Hashable {
+        let variable: String
+        let level: Int
+        let time: TimerangeDtAndSettings
+        /// Rows of the band
+        let y: Range<Int>
+    }
+
+    enum State {
+        case running([CheckedContinuation<[Float], any Error>])
+        /// `served` contains the local index of every grid point that read the band
+        case ready(data: [Float], served: Set<Int>)
+    }
+
+    private var blocks = [Key: State]()
+    /// Bands that were read by all grid points and released
+    private var released = Set<Key>()
+    private var prefetched = Set<Key>()
+
+    init(domain: DomainRegistry, nx: Int, yRange: Range<Int>, xRange: Range<Int>) {
+        self.domain = domain
+        self.nx = nx
+        self.yRange = yRange
+        self.xRange = xRange
+    }
+
+    /// Return a block for grid slices with rows and columns. Returns nil for single grid points or unstructured grids
+    static func from(slice: any Sequence<Int>, domain: DomainRegistry, nx: Int) -> BoundingBoxBlock? {
+        guard let slice = slice as? GridSliceXy, slice.yRange.count * slice.xRange.count > 1 else {
+            return nil
+        }
+        return BoundingBoxBlock(domain: domain, nx: nx, yRange: slice.yRange, xRange: slice.xRange)
+    }
+
+    /// True if `gridpoint` of `domain` is inside this block
+    nonisolated func contains(domain: DomainRegistry, gridpoint: Int) -> Bool {
+        return domain == self.domain && yRange.contains(gridpoint / nx) && xRange.contains(gridpoint % nx)
+    }
+
+    /// Rows of the band that contains row `y`. Nil if one row already exceeds `maxValues`
+    private func band(y: Int, nTime: Int) -> Range<Int>? {
+        let rowValues = xRange.count * max(nTime, 1)
+        guard rowValues <= Self.maxValues else {
+            return nil
+        }
+        let rows = Self.maxValues / rowValues
+        let lower = yRange.lowerBound + (y - yRange.lowerBound) / rows * rows
+        return lower ..< min(lower + rows, yRange.upperBound)
+    }
+
+    /// Read the time series of one grid point. The whole band is read on first access
+    func read(splitter: OmFileSplitter, variable: String, gridpoint: Int, level: Int, time: TimerangeDtAndSettings, logger: Logger, httpClient: HTTPClient) async throws -> [Float] {
+        let y = gridpoint / nx
+        guard let band = band(y: y, nTime: time.time.count) else {
+            return try await splitter.read(variable: variable, location: gridpoint..<gridpoint + 1, level: level, time: time, logger: logger, httpClient: httpClient)
+        }
+        let key = Key(variable: variable, level: level, time: time, y: band)
+        let local = (y - band.lowerBound) * xRange.count + gridpoint % nx - xRange.lowerBound
+        let data: [Float]
+        switch blocks[key] {
+        case .none:
+            guard !released.contains(key) else {
+                return try await splitter.read(variable: variable, location: gridpoint..<gridpoint + 1, level: level, time: time, logger: logger, httpClient: httpClient)
+            }
+            blocks[key] = .running([])
+            do {
+                data = try await splitter.read(variable: variable, y: band, x: xRange, level: level, time: time, logger: logger, httpClient: httpClient)
+            } catch {
+                if case .running(let queued) = blocks.removeValue(forKey: key) {
+                    queued.forEach { $0.resume(throwing: error) }
+                }
+                throw error
+            }
+            guard case .running(let queued) = blocks.updateValue(.ready(data: data, served: []), forKey: key) else {
+                fatalError("State was not .running()")
+            }
+            queued.forEach { $0.resume(returning: data) }
+        case .running(let queued):
+            data = try await withCheckedThrowingContinuation { continuation in
+                blocks[key] = .running(queued + [continuation])
+            }
+        case .ready(data: let ready, served: _):
+            data = ready
+        }
+        release(key: key, local: local)
+        let nTime = data.count / (band.count * xRange.count)
+        return Array(data[local * nTime ..< (local + 1) * nTime])
+    }
+
+    /// Prefetch the whole block once instead of each grid point separately
+    func prefetch(splitter: OmFileSplitter, variable: String, level: Int, time: TimerangeDtAndSettings, logger: Logger, httpClient: HTTPClient) async throws {
+        guard prefetched.insert(Key(variable: variable, level: level, time: time, y: yRange)).inserted else {
+            return
+        }
+        for y in yRange {
+            try await splitter.willNeed(variable: variable, location: y * nx + xRange.lowerBound ..< y * nx + xRange.upperBound, level: level, time: time, logger: logger, httpClient: httpClient)
+        }
+    }
+
+    /// Record the grid point as served and free the band once all grid points of the band read it
+    private func release(key: Key, local: Int) {
+        guard case .ready(data: let data, served: var served) = blocks[key] else {
+            return
+        }
+        served.insert(local)
+        if served.count >= key.y.count * xRange.count {
+            blocks.removeValue(forKey: key)
+            released.insert(key)
+        } else {
+            blocks[key] = .ready(data: data, served: served)
+        }
+    }
+}
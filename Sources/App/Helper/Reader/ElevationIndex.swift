@@ -0,0 +1,219 @@
+import Foundation
+import NIOConcurrencyHelpers
+import OmFileFormat
+import Vapor
+
+/**
+ Compact in-memory copy of a domain elevation file to resolve grid points without reading the elevation `.om` file for every request.
+
+ Elevation is quantised to full metres as `Int16` and stored in tiles of 16x16 grid cells. A 3x3 or 5x5 neighbourhood therefore touches at most 4 tiles and rows inside a tile are contiguous in memory.
+ A land-sea mask is stored as a bitset in the same tiled order. One tile uses 512 bytes for elevation and 32 bytes for the mask. ERA5-Land requires around 13 MB.
+
+ Enabled with `ELEVATION_INDEX=true`. Indices are built lazily once per static domain on first access.
+ */
+final class ElevationIndex: Sendable {
+    /// Tile width and height in grid cells
+    static let tileSize = 16
+
+    /// Marks missing data in `elevation`
+    static let noData = Int16.min
+
+    /// Sea grid cells are marked with `-999` in elevation files
+    static let sea = Int16(-999)
+
+    let nx: Int
+    let ny: Int
+
+    /// Number of tiles in x direction
+    let tilesX: Int
+
+    /// Elevation in metres in tiled order. Sea points are `-999`, missing data `Int16.min`
+    let elevation: [Int16]
+
+    /// One bit per grid cell in tiled order. Set bits mark sea grid cells
+    let seaMask: [UInt64]
+
+    /// Build an index from a `ny * nx` elevation field as stored in `HSURF.om`
+    init(elevation data: [Float], nx: Int, ny: Int) {
+        precondition(data.count == nx * ny, "Elevation field does not match grid dimensions")
+        let tileSize = Self.tileSize
+        let tilesX = nx.divideRoundedUp(divisor: tileSize)
+        let tilesY = ny.divideRoundedUp(divisor: tileSize)
+        let count = tilesX * tilesY * tileSize * tileSize
+        var elevation = [Int16](repeating: Self.noData, count: count)
+        var seaMask = [UInt64](repeating: 0, count: count / 64)
+        for y in 0..<ny {
+            for x in 0..<nx {
+                let value = data[y * nx + x]
+                let cell = Self.offset(x: x, y: y, tilesX: tilesX)
+                if value.isNaN {
+                    continue
+                }
+                if value <= -999 {
+                    elevation[cell] = Self.sea
+                    seaMask[cell / 64] |= 1 << UInt64(cell % 64)
+                    continue
+                }
+                elevation[cell] = Int16(min(max(value.rounded(), -998), Float(Int16.max)))
+            }
+        }
+        self.nx = nx
+        self.ny = ny
+        self.tilesX = tilesX
+        self.elevation = elevation
+        self.seaMask = seaMask
+    }
+
+    /// Position of a grid cell in tiled order
+    @inline(__always)
+    static func offset(x: Int, y: Int, tilesX: Int) -> Int {
+        let tile = (y / tileSize) * tilesX + x / tileSize
+        return tile * tileSize * tileSize + (y % tileSize) * tileSize + x % tileSize
+    }
+
+    @inline(__always)
+    func offset(x: Int, y: Int) -> Int {
+        return Self.offset(x: x, y: y, tilesX: tilesX)
+    }
+
+    @inline(__always)
+    func isSea(offset: Int) -> Bool {
+        return seaMask[offset / 64] & (1 << UInt64(offset % 64)) != 0
+    }
+
+    /// Decode a quantised value
+    @inline(__always)
+    func elevationOrSea(offset: Int) -> ElevationOrSea {
+        let value = elevation[offset]
+        if value == Self.noData {
+            return .noData
+        }
+        if isSea(offset: offset) {
+            return .sea
+        }
+        return .elevation(Float(value))
+    }
+
+    /// Elevation for a single grid point. Equivalent to `Gridable.readElevation`
+    func readElevation(gridpoint: Int) -> ElevationOrSea {
+        return elevationOrSea(offset: offset(x: gridpoint % nx, y: gridpoint / nx))
+    }
+
+    /// Resolve a grid point synchronously. Follows the same rules as `Gridable.findPoint(lat:lon:elevation:elevationFile:mode:)`
+    func findPoint(grid: Gridable, lat: Float, lon: Float, elevation: Float, mode: GridSelectionMode) -> (gridpoint: Int, gridElevation: ElevationOrSea)? {
+        guard let center = grid.findPoint(lat: lat, lon: lon) else {
+            return nil
+        }
+        switch mode {
+        case .land:
+            return findPointTerrainOptimised(center: center, elevation: elevation, searchRadius: grid.searchRadius)
+        case .sea:
+            return findPointInSea(center: center, searchRadius: grid.searchRadius)
+        case .nearest:
+            let value = readElevation(gridpoint: center)
+            if value.hasNoData {
+                return nil
+            }
+            return (center, value)
+        }
+    }
+
+    /// Prefer a sea grid cell in the neighbourhood. Scan order is row major, like the file based implementation
+    func findPointInSea(center: Int, searchRadius: Int) -> (gridpoint: Int, gridElevation: ElevationOrSea)? {
+        let x = center % nx
+        let y = center / nx
+        let centerOffset = offset(x: x, y: y)
+        if isSea(offset: centerOffset) {
+            return (center, .sea)
+        }
+        let xrange = (x - searchRadius..<x + searchRadius + 1).clamped(to: 0..<nx)
+        let yrange = (y - searchRadius..<y + searchRadius + 1).clamped(to: 0..<ny)
+        for yy in yrange {
+            for xx in xrange where isSea(offset: offset(x: xx, y: yy)) {
+                return (yy * nx + xx, .sea)
+            }
+        }
+        let value = elevationOrSea(offset: centerOffset)
+        if value.hasNoData {
+            return nil
+        }
+        return (center, value)
+    }
+
+    /// Select the grid cell with the closest elevation in the neighbourhood
+    func findPointTerrainOptimised(center: Int, elevation target: Float, searchRadius: Int) -> (gridpoint: Int, gridElevation: ElevationOrSea)? {
+        let x = center % nx
+        let y = center / nx
+        let centerOffset = offset(x: x, y: y)
+        let centerValue = elevation[centerOffset]
+        if centerValue != Self.noData, abs(Float(centerValue) - target) <= 100 {
+            return (center, elevationOrSea(offset: centerOffset))
+        }
+        let xrange = (x - searchRadius..<x + searchRadius + 1).clamped(to: 0..<nx)
+        let yrange = (y - searchRadius..<y + searchRadius + 1).clamped(to: 0..<ny)
+
+        var minDelta = Float(10_000)
+        var minPoint = center
+        var minOffset = centerOffset
+        for yy in yrange {
+            for xx in xrange {
+                let cell = offset(x: xx, y: yy)
+                let value = elevation[cell]
+                if value == Self.noData {
+                    continue
+                }
+                let delta = abs(Float(value) - target)
+                if delta < minDelta {
+                    minDelta = delta
+                    minPoint = yy * nx + xx
+                    minOffset = cell
+                }
+            }
+        }
+        /// only sea points or elevation ish hugly off -> just use center
+        if minDelta > 900 {
+            minPoint = center
+            minOffset = centerOffset
+        }
+        let value = elevationOrSea(offset: minOffset)
+        if value.hasNoData {
+            return nil
+        }
+        return (minPoint, value)
+    }
+}
+
+/// Keeps one `ElevationIndex` per static domain
+struct ElevationIndexManager: Sendable {
+    public static let instance = ElevationIndexManager()
+
+    /// Set `ELEVATION_INDEX=true` to resolve grid points from memory
+    static let enabled = Environment.get("ELEVATION_INDEX") == "true"
+
+    private let indices = NIOLockedValueBox<[DomainRegistry: ElevationIndex]>(.init())
+
+    /// Return the index for this domain or build it from the elevation file. Returns nil if disabled or no elevation file is available.
+    /// Concurrent first accesses may build the same index more than once. The last one wins.
+    func get<Domain: GenericDomain>(domain: Domain, httpClient: HTTPClient, logger: Logger) async throws -> ElevationIndex? {
+        guard Self.enabled, let registry = domain.domainRegistryStatic else {
+            return nil
+        }
+        if let index = indices.withLockedValue({ $0[registry] }) {
+            return index
+        }
+        guard let elevationFile = await domain.getStaticFile(type: .elevation, httpClient: httpClient, logger: logger) else {
+            return nil
+        }
+        let grid = domain.grid
+        let dimensions = elevationFile.getDimensions()
+        guard dimensions.count == 2, Int(dimensions[0]) == grid.ny, Int(dimensions[1]) == grid.nx else {
+            logger.warning("Elevation file of domain \(registry) does not match grid dimensions. Elevation index disabled")
+            return nil
+        }
+        let start = DispatchTime.now()
+        let index = ElevationIndex(elevation: try await elevationFile.read(range: nil), nx: grid.nx, ny: grid.ny)
+        logger.info("Built elevation index for \(registry) in \(start.timeElapsedPretty())")
+        indices.withLockedValue({ $0[registry] = index })
+        return index
+    }
+}
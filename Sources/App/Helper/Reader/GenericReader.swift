@@ -96,6 +96,9 @@ struct GenericReader<Domain: GenericDomain, Variable: GenericVariable>: GenericR
     
     let httpClient: HTTPClient
 
+    /// Shared block reads if this grid point is part of a bounding box query
+    let boundingBox: BoundingBoxBlock?
+
     var modelDtSeconds: Int {
         return domain.dtSeconds
     }
@@ -104,7 +107,9 @@ struct GenericReader<Domain: GenericDomain, Variable: GenericVariable>: GenericR
     public init(domain: Domain, position: Int, options: GenericReaderOptions) async throws {
         self.domain = domain
         self.position = position
-        if let elevationFile = await domain.getStaticFile(type: .elevation, httpClient: options.httpClient, logger: options.logger) {
+        if let index = try await ElevationIndexManager.instance.get(domain: domain, httpClient: options.httpClient, logger: options.logger) {
+            self.modelElevation = index.readElevation(gridpoint: position)
+        } else if let elevationFile = await domain.getStaticFile(type: .elevation, httpClient: options.httpClient, logger: options.logger) {
             self.modelElevation = try await domain.grid.readElevation(gridpoint: position, elevationFile: elevationFile)
         } else {
             self.modelElevation = .noData
@@ -116,21 +121,34 @@ struct GenericReader<Domain: GenericDomain, Variable: GenericVariable>: GenericR
         self.omFileSplitter = OmFileSplitter(domain)
         self.logger = options.logger
         self.httpClient = options.httpClient
+        self.boundingBox = options.boundingBox.flatMap { $0.contains(domain: domain.domainRegistry, gridpoint: position) ? $0 : nil }
     }
 
     /// Return nil, if the coordinates are outside the domain grid
     public init?(domain: Domain, lat: Float, lon: Float, elevation: Float, mode: GridSelectionMode, options: GenericReaderOptions) async throws {
         // check if coordinates are in domain, otherwise return nil
-        let elevationFile = await domain.getStaticFile(type: .elevation, httpClient: options.httpClient, logger: options.logger)
-        guard let gridpoint = try await domain.grid.findPoint(lat: lat, lon: lon, elevation: elevation, elevationFile: elevationFile, mode: mode) else {
-            return nil
+        let gridpointStart = RequestMetrics.start()
+        let gridpoint: (gridpoint: Int, gridElevation: ElevationOrSea)
+        if let index = try await ElevationIndexManager.instance.get(domain: domain, httpClient: options.httpClient, logger: options.logger) {
+            guard let point = index.findPoint(grid: domain.grid, lat: lat, lon: lon, elevation: elevation, mode: mode) else {
+                return nil
+            }
+            gridpoint = point
+        } else {
+            let elevationFile = await domain.getStaticFile(type: .elevation, httpClient: options.httpClient, logger: options.logger)
+            guard let point = try await domain.grid.findPoint(lat: lat, lon: lon, elevation: elevation, elevationFile: elevationFile, mode: mode) else {
+                return nil
+            }
+            gridpoint = point
         }
+        RequestMetrics.record(.gridpoint, since: gridpointStart)
         self.domain = domain
         self.position = gridpoint.gridpoint
         self.modelElevation = gridpoint.gridElevation
         self.targetElevation = elevation.isNaN ? gridpoint.gridElevation.numeric : elevation
         self.logger = options.logger
         self.httpClient = options.httpClient
+        self.boundingBox = nil
 
         omFileSplitter = OmFileSplitter(domain)
 
@@ -139,26 +157,44 @@ struct GenericReader<Domain: GenericDomain, Variable: GenericVariable>: GenericR
 
     /// Prefetch data asynchronously. At the time `read` is called, it might already by in the kernel page cache.
     func prefetchData(variable: Variable, time: TimerangeDtAndSettings) async throws {
-        if time.dtSeconds == domain.dtSeconds {
-            try await omFileSplitter.willNeed(variable: variable.omFileName.file, location: position..<position + 1, level: time.ensembleMemberLevel, time: time, logger: logger, httpClient: httpClient)
-            return
-        }
-
         let interpolationType = variable.interpolation
-        let timeRead = time.dtSeconds > domain.dtSeconds ?
-            time.time.forAggregationTo(modelDt: domain.dtSeconds, interpolation: interpolationType) :
-            time.time.forInterpolationTo(modelDt: domain.dtSeconds, interpolation: interpolationType)
+        let timeRead = time.dtSeconds == domain.dtSeconds ? time :
+            time.with(time: time.dtSeconds > domain.dtSeconds ?
+                time.time.forAggregationTo(modelDt: domain.dtSeconds, interpolation: interpolationType) :
+                time.time.forInterpolationTo(modelDt: domain.dtSeconds, interpolation: interpolationType))
 
-        try await omFileSplitter.willNeed(variable: variable.omFileName.file, location: position..<position + 1, level: time.ensembleMemberLevel, time: time.with(time: timeRead), logger: logger, httpClient: httpClient)
+        if let boundingBox {
+            try await boundingBox.prefetch(splitter: omFileSplitter, variable: variable.omFileName.file, level: time.ensembleMemberLevel, time: timeRead, logger: logger, httpClient: httpClient)
+            return
+        }
+        try await omFileSplitter.willNeed(variable: variable.omFileName.file, location: position..<position + 1, level: time.ensembleMemberLevel, time: timeRead, logger: logger, httpClient: httpClient)
     }
 
     /// Read and scale if required
     private func readAndScale(variable: Variable, time: TimerangeDtAndSettings) async throws -> DataAndUnit {
-        var data = try await omFileSplitter.read(variable: variable.omFileName.file, location: position..<position + 1, level: time.ensembleMemberLevel, time: time, logger: logger, httpClient: httpClient)
+        let data = try await RequestMetrics.measureAsync(.decompression) {
+            if let boundingBox {
+                return try await boundingBox.read(splitter: omFileSplitter, variable: variable.omFileName.file, gridpoint: position, level: time.ensembleMemberLevel, time: time, logger: logger, httpClient: httpClient)
+            }
+            return try await omFileSplitter.read(variable: variable.omFileName.file, location: position..<position + 1, level: time.ensembleMemberLevel, time: time, logger: logger, httpClient: httpClient)
+        }
+        return scale(data, variable: variable)
+    }
+
+    /// True if `scale` modifies values
+    private func requiresScaling(variable: Variable) -> Bool {
+        return variable.unit == .pascal || (variable.isElevationCorrectable && variable.unit == .celsius && !modelElevation.numeric.isNaN && !targetElevation.isNaN && targetElevation != modelElevation.numeric)
+    }
 
+    /// Scale pascal to hectopascal and correct temperature by elevation
+    /// `data` is consumed and scaled in place
+    private func scale(_ data: consuming [Float], variable: Variable) -> DataAndUnit {
         /// Scale pascal to hecto pasal. Case in era5
         if variable.unit == .pascal {
-            return DataAndUnit(data.map({ $0 / 100 }), .hectopascal)
+            for i in data.indices {
+                data[i] /= 100
+            }
+            return DataAndUnit(data, .hectopascal)
         }
 
         if variable.isElevationCorrectable && variable.unit == .celsius && !modelElevation.numeric.isNaN && !targetElevation.isNaN && targetElevation != modelElevation.numeric {
@@ -180,15 +216,21 @@ struct GenericReader<Domain: GenericDomain, Variable: GenericVariable>: GenericR
         if time.dtSeconds > domain.dtSeconds {
             // Aggregate data
             let timeRead = time.time.forAggregationTo(modelDt: domain.dtSeconds, interpolation: interpolationType)
-            let read = try await readAndScale(variable: variable, time: time.with(time: timeRead))
-            let aggregated = read.data.aggregate(type: interpolationType, timeOld: timeRead, timeNew: time.time)
+            var read = try await readAndScale(variable: variable, time: time.with(time: timeRead))
+            let aggregated = RequestMetrics.measure(.interpolation) {
+                read.data.aggregate(type: interpolationType, timeOld: timeRead, timeNew: time.time)
+            }
+            FloatBufferPool.release(&read.data)
             return DataAndUnit(aggregated, read.unit)
         }
 
         // Interpolate data
         let timeLow = time.time.forInterpolationTo(modelDt: domain.dtSeconds, interpolation: interpolationType)
-        let read = try await readAndScale(variable: variable, time: time.with(time: timeLow))
-        let interpolated = read.data.interpolate(type: interpolationType, timeOld: timeLow, timeNew: time.time, latitude: modelLat, longitude: modelLon, scalefactor: variable.scalefactor)
+        var read = try await readAndScale(variable: variable, time: time.with(time: timeLow))
+        let interpolated = RequestMetrics.measure(.interpolation) {
+            read.data.interpolate(type: interpolationType, timeOld: timeLow, timeNew: time.time, latitude: modelLat, longitude: modelLon, scalefactor: variable.scalefactor)
+        }
+        FloatBufferPool.release(&read.data)
         return DataAndUnit(interpolated, read.unit)
     }
 
@@ -204,6 +246,52 @@ struct GenericReader<Domain: GenericDomain, Variable: GenericVariable>: GenericR
     }
 }
 
+extension GenericReader: GenericReaderDailyAggregateProvider {
+    /// Read daily aggregates of UTC days from yearly files generated by `merge-yearly --daily-aggregates`.
+    /// Yearly daily files are used from the start of the time range until the first missing year. The remaining days are aggregated from hourly data.
+    /// Means and sums of scaled variables are not returned, because they would differ from aggregating scaled hourly values.
+    func getDailyAggregate(mixed: String, aggregation: DailyAggregationPrecomputed, time: TimerangeDtAndSettings) async throws -> DataAndUnit? {
+        guard let variable = Variable(rawValue: mixed),
+              aggregation.commutesWithScaling || !requiresScaling(variable: variable),
+              domain.hasYearlyFiles,
+              domain.dtSeconds == 3600,
+              time.dtSeconds == 86400,
+              time.range.lowerBound.timeIntervalSince1970 % 86400 == 0 else {
+            return nil
+        }
+        let file = aggregation.omFileName(variable.omFileName.file)
+        let startYear = time.range.lowerBound.toComponents().year
+        /// end year is included in itteration range
+        let endYear = time.range.upperBound.add(-1 * time.dtSeconds).toComponents().year
+        var coveredUntil = time.range.lowerBound
+        for year in startYear ... endYear {
+            let yearlyFile = OmFileManagerReadable.domainChunk(domain: domain.domainRegistry, variable: file, type: .year, chunk: year, ensembleMember: time.ensembleMember, previousDay: time.previousDay)
+            guard try await RemoteOmFileManager.instance.get(file: yearlyFile, client: httpClient, logger: logger) != nil else {
+                break
+            }
+            coveredUntil = min(Timestamp(year + 1, 1, 1), time.range.upperBound)
+        }
+        guard coveredUntil > time.range.lowerBound else {
+            return nil
+        }
+        /// Only yearly files are considered. Master and chunk files do not exist for daily aggregates
+        let splitter = OmFileSplitter(domain: domain.domainRegistry, nMembers: 1, nx: domain.grid.nx, ny: domain.grid.ny, nTimePerFile: domain.omFileLength, hasYearlyFiles: true, masterTimeRange: nil)
+        let timeDaily = time.with(time: TimerangeDt(range: time.range.lowerBound ..< coveredUntil, dtSeconds: 86400))
+        let daily = try await splitter.read(variable: file, location: position..<position + 1, level: time.ensembleMemberLevel, time: timeDaily, logger: logger, httpClient: httpClient)
+        let scaled = scale(daily, variable: variable)
+        guard coveredUntil < time.range.upperBound else {
+            return scaled
+        }
+        let timeHourly = TimerangeDt(range: coveredUntil ..< time.range.upperBound, dtSeconds: 3600)
+        let hourly = try await get(variable: variable, time: time.with(time: timeHourly))
+        /// Missing hours are mixed from other readers by the hourly path
+        guard !hourly.data.containsNaN() else {
+            return nil
+        }
+        return DataAndUnit(scaled.data + aggregation.aggregate(hourly.data, by: 24), scaled.unit)
+    }
+}
+
 extension TimerangeDt {
     /// Expand the time range for interpolation
     func forAggregationTo(modelDt: Int, interpolation: ReaderInterpolation) -> TimerangeDt {
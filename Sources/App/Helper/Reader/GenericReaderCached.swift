@@ -61,3 +61,9 @@ final class GenericReaderCached<Domain: GenericDomain, Variable: GenericVariable
         try await reader.prefetchData(variable: variable, time: time)
     }
 }
+
+extension GenericReaderCached: GenericReaderDailyAggregateProvider {
+    func getDailyAggregate(mixed: String, aggregation: DailyAggregationPrecomputed, time: TimerangeDtAndSettings) async throws -> DataAndUnit? {
+        return try await reader.getDailyAggregate(mixed: mixed, aggregation: aggregation, time: time)
+    }
+}
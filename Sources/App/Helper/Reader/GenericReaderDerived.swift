@@ -27,6 +27,9 @@ struct GenericReaderOptions {
     
     let httpClient: HTTPClient
 
+    /// Set for bounding box queries to read all grid points of a domain as one block
+    var boundingBox: BoundingBoxBlock? = nil
+
     public init(tilt: Float? = nil, azimuth: Float? = nil, logger: Logger, httpClient: HTTPClient) throws {
         /// Tilt of a solar panel for GTI calculation. 0° horizontal, 90° vertical. Throws out of bounds error.
         if let tilt {
@@ -45,6 +48,12 @@ struct GenericReaderOptions {
         self.logger = logger
         self.httpClient = httpClient
     }
+
+    func with(boundingBox: BoundingBoxBlock?) -> GenericReaderOptions {
+        var options = self
+        options.boundingBox = boundingBox
+        return options
+    }
 }
 
 extension GenericReaderDerived {
@@ -86,7 +95,9 @@ extension GenericReaderDerived {
         case .raw(let raw):
             return try await get(raw: raw, time: time)
         case .derived(let derived):
-            return try await get(derived: derived, time: time)
+            return try await RequestMetrics.measureAsync(.derived) {
+                try await get(derived: derived, time: time)
+            }
         }
     }
 
@@ -87,14 +87,16 @@ extension GenericReaderMixerRaw {
         var unit: SiUnit?
         if variable.requiresOffsetCorrectionForMixing {
             for r in reader.reversed() {
-                let d = try await r.get(variable: variable, time: time)
+                var d = try await r.get(variable: variable, time: time)
                 if data == nil {
-                    // first iteration
-                    data = d.data
+                    // first iteration. Take the array from `d` to delta encode it in place
                     unit = d.unit
+                    data = d.data
+                    d.data = []
                     data?.deltaEncode()
                 } else {
                     data?.integrateIfNaNDeltaCoded(d.data)
+                    FloatBufferPool.release(&d.data)
                 }
                 if data?.containsNaN() == false {
                     break
@@ -106,13 +108,14 @@ extension GenericReaderMixerRaw {
         } else {
             // default case, just place new data in 1:1
             for r in reader.reversed() {
-                let d = try await r.get(variable: variable, time: time)
+                var d = try await r.get(variable: variable, time: time)
                 if data == nil {
                     // first iteration
                     data = d.data
                     unit = d.unit
                 } else {
                     data?.integrateIfNaN(d.data)
+                    FloatBufferPool.release(&d.data)
                 }
                 if data?.containsNaN() == false {
                     break
@@ -32,6 +32,10 @@ extension GenericReaderProvider {
                 guard let gridpoionts = grid.findBox(boundingBox: bbox) else {
                     throw ForecastapiError.generic(message: "Bounding box calls not supported for grid of domain \(domain)")
                 }
+                /// Grid points of rectangular slices read each variable once as a `[y, x, time]` block
+                let options = options.with(boundingBox: domain.genericDomain.flatMap {
+                    BoundingBoxBlock.from(slice: gridpoionts, domain: $0.domainRegistry, nx: grid.nx)
+                })
 
                 if dates.count == 0 {
                     let time = try params.getTimerange2(timezone: timezone, current: currentTime, forecastDaysDefault: forecastDayDefault, forecastDaysMax: forecastDaysMax, startEndDate: nil, allowedRange: allowedRange, pastDaysMax: pastDaysMax)
@@ -0,0 +1,114 @@
+import Foundation
+import OmFileFormat
+import Vapor
+
+/// Realms of spatial files that can be requested. Realms are part of file paths and must not be taken from user input directly
+enum SpatialRealm: String, Codable, CaseIterable {
+    case model_level = "model-level"
+    case pressure_level = "pressure-level"
+}
+
+/**
+ Read spatial fields from `data_spatial/<domain>/<run>/<time>.om` files written by `OmSpatialTimestepWriter`.
+
+ Each file holds all variables of one time step with `[32, x]` chunks. Reading a map from these files only decompresses the chunks that cover the requested area.
+ The same map from time oriented files would touch one chunk per location.
+ Files are opened through `RemoteOmFileManager`. Local files are memory mapped and remote files use the shared block cache.
+ */
+struct SpatialFieldReader {
+    let domain: DomainRegistry
+    let grid: any Gridable
+    let run: Timestamp
+    /// E.g. `model-level` for files written at a later stage
+    let realm: SpatialRealm?
+    let logger: Logger
+    let httpClient: HTTPClient
+
+    /// Chunk rows used by `OmSpatialTimestepWriter`
+    static let chunkRows = 32
+
+    /// Rows and columns of a field, optionally downsampled by `step`
+    struct Selection {
+        let y: Range<Int>
+        let x: Range<Int>
+        let step: Int
+
+        var rows: StrideTo<Int> {
+            stride(from: y.lowerBound, to: y.upperBound, by: step)
+        }
+
+        var columns: StrideTo<Int> {
+            stride(from: x.lowerBound, to: x.upperBound, by: step)
+        }
+
+        var ny: Int {
+            (y.count + step - 1) / step
+        }
+
+        var nx: Int {
+            (x.count + step - 1) / step
+        }
+
+        /// Global grid point indices in row major order
+        func gridpoints(nx gridNx: Int) -> [Int] {
+            return rows.flatMap { y in columns.map { x in y * gridNx + x } }
+        }
+    }
+
+    /// Read the latest completed run from `latest.json` locally or from the remote spatial directory
+    static func latestRun(domain: DomainRegistry, realm: SpatialRealm?, logger: Logger, httpClient: HTTPClient) async throws -> DataSpatialJson? {
+        let realm = realm.map { "_\($0.rawValue)" } ?? ""
+        if let directory = domain.directorySpatial, FileManager.default.fileExists(atPath: "\(directory)latest\(realm).json") {
+            return try DataSpatialJson.readFrom(path: "\(directory)latest\(realm).json")
+        }
+        guard let remoteDirectory = OpenMeteo.remoteDataSpatialDirectory else {
+            return nil
+        }
+        let url = "\(remoteDirectory)\(domain.rawValue)/latest\(realm).json"
+        let response = try await httpClient.executeRetry(HTTPClientRequest(url: url), logger: logger, deadline: .seconds(5), timeoutPerRequest: .seconds(2), backOffSettings: .init(factor: .milliseconds(100), maximum: .milliseconds(500)))
+        let body = try await response.body.collect(upTo: 1024 * 1024)
+        return try Data(body.readableBytesView).decodeJson(as: DataSpatialJson.self)
+    }
+
+    /// Read one variable at one time step. Returns nil if the file or variable does not exist.
+    /// Returned values are row major with dimensions `[selection.ny, selection.nx]`
+    func read(variable: String, time: Timestamp, selection: Selection) async throws -> [Float]? {
+        let file = OmFileManagerReadable.spatial(domain: domain, run: run, time: time, realm: realm?.rawValue, variable: variable)
+        return try await RemoteOmFileManager.instance.with(file: file, client: httpClient, logger: logger) { reader in
+            let dimensions = reader.getDimensions()
+            guard dimensions.count == 2, dimensions[0] == grid.ny, dimensions[1] == grid.nx else {
+                throw ForecastapiError.generic(message: "Spatial file for \(variable) has invalid dimensions \(dimensions)")
+            }
+            return try await Self.read(reader: reader, selection: selection)
+        }
+    }
+
+    /// Read selected rows in bands aligned to chunk rows. Each chunk is decompressed only once, while large steps skip entire chunks
+    static func read(reader: any OmFileReaderArrayProtocol<Float>, selection: Selection) async throws -> [Float] {
+        let nxOut = selection.nx
+        guard selection.ny > 0, nxOut > 0 else {
+            return []
+        }
+        let rows = Array(selection.rows)
+        var out = [Float](repeating: .nan, count: rows.count * nxOut)
+        let xRead = selection.x.lowerBound ..< selection.x.lowerBound + (nxOut - 1) * selection.step + 1
+        var i = 0
+        while i < rows.count {
+            let band = rows[i] / chunkRows
+            var j = i + 1
+            while j < rows.count && rows[j] / chunkRows == band {
+                j += 1
+            }
+            let yRead = rows[i] ..< rows[j - 1] + 1
+            let data = try await reader.read(range: [yRead.toUInt64(), xRead.toUInt64()])
+            for (k, row) in rows[i..<j].enumerated() {
+                let offset = (row - yRead.lowerBound) * xRead.count
+                for c in 0..<nxOut {
+                    out[(i + k) * nxOut + c] = data[offset + c * selection.step]
+                }
+            }
+            i = j
+        }
+        return out
+    }
+}
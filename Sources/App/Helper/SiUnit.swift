@@ -42,8 +42,8 @@ protocol ApiUnitsSelectable {
 }
 
 struct DataAndUnit {
-    let data: [Float]
-    let unit: SiUnit
+    var data: [Float]
+    var unit: SiUnit
 
     public init(_ data: [Float], _ unit: SiUnit) {
         self.data = data
@@ -52,10 +52,14 @@ struct DataAndUnit {
 
     /// Convert a given array to target units
     /// Note: Rounding is now done in the writers
-    func convertAndRound<Query: ApiUnitsSelectable>(params: Query) -> DataAndUnit {
-        var data = self.data
-        var unit = self.unit
+    /// `self` is consumed, so data is converted in place unless the array is referenced elsewhere
+    consuming func convertAndRound<Query: ApiUnitsSelectable>(params: Query) -> DataAndUnit {
+        var converted = self
+        converted.convert(params: params)
+        return converted
+    }
 
+    private mutating func convert<Query: ApiUnitsSelectable>(params: Query) {
         let windspeedUnit = params.windspeed_unit ?? params.wind_speed_unit ?? .kmh
         let temperatureUnit = params.temperature_unit
         let precipitationUnit = params.precipitation_unit ?? (params.length_unit == .imperial ? .inch : nil)
@@ -101,6 +105,5 @@ struct DataAndUnit {
             }
             unit = .feet
         }
-        return DataAndUnit(data, unit)
     }
 }
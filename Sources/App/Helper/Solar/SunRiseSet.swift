@@ -114,7 +114,12 @@ extension Zensun {
     public static func calculateBackwardsSunshineDuration(directRadiation: [Float], latitude: Float, longitude: Float, timerange: TimerangeDt) -> [Float] {
         let dt = Float(timerange.dtSeconds)
 
-        return zip(directRadiation, timerange).map { dhi, timestamp in
+        /// DNI is typically limted to 85° zenith. We apply 5° to the parallax in addition to atmospheric refraction
+        /// The parallax is then use to limit integral coefficients to sun rise/set
+        let geometry = SolarGeometryBackwards(timerange: timerange, latitude: latitude, longitude: longitude, alpha: 0.83333 - 5, withDaylightFraction: true)
+
+        return (0..<directRadiation.count).map { t in
+            let dhi = directRadiation[t]
             if dhi.isNaN {
                 return .nan
             }
@@ -122,55 +127,10 @@ extension Zensun {
                 return 0
             }
 
-            /// DNI is typically limted to 85° zenith. We apply 5° to the parallax in addition to atmospheric refraction
-            /// The parallax is then use to limit integral coefficients to sun rise/set
-            let alpha = Float(0.83333 - 5).degreesToRadians
-
-            let decang = timestamp.getSunDeclination()
-            let eqtime = timestamp.getSunEquationOfTime()
-
-            let latsun = decang
-            /// universal time
-            let ut = timestamp.hourWithFraction
-            let t1 = (90 - latsun).degreesToRadians
-
-            let lonsun = -15.0 * (ut - 12.0 + eqtime)
-
-            /// longitude of sun
-            let p1 = lonsun.degreesToRadians
-
-            let ut0 = ut - (Float(timerange.dtSeconds) / 3600)
-            let lonsun0 = -15.0 * (ut0 - 12.0 + eqtime)
-
-            let p10 = lonsun0.degreesToRadians
-
-            let t0 = (90 - latitude).degreesToRadians
-
-            /// longitude of point
-            var p0 = longitude.degreesToRadians
-            if p0 < p1 - .pi {
-                p0 += 2 * .pi
-            }
-            if p0 > p1 + .pi {
-                p0 -= 2 * .pi
-            }
-
-            // limit p1 and p10 to sunrise/set
-            let arg = -(sin(alpha) + cos(t0) * cos(t1)) / (sin(t0) * sin(t1))
-            let carg = arg > 1 || arg < -1 ? .pi : acos(arg)
-            let sunrise = p0 + carg
-            let sunset = p0 - carg
-            let p1_l = min(sunrise, p10)
-            let p10_l = max(sunset, p1)
-
             // limit dt to sunrise/set
-            let dtBound = dt * abs((p1_l - p10_l) / (p10 - p1))
+            let dtBound = dt * geometry.daylightFraction[t]
 
-            // solve integral to get sun elevation dt
-            // integral(cos(t0) cos(t1) + sin(t0) sin(t1) cos(p - p0)) dp = sin(t0) sin(t1) sin(p - p0) + p cos(t0) cos(t1) + constant
-            let left = sin(t0) * sin(t1) * sin(p1_l - p0) + p1_l * cos(t0) * cos(t1)
-            let right = sin(t0) * sin(t1) * sin(p10_l - p0) + p10_l * cos(t0) * cos(t1)
-            let zzBackwards = (left - right) / (p1_l - p10_l)
+            let zzBackwards = geometry.zzBackwards[t]
             let dni = dhi / zzBackwards
             // Prevent possible division by zero
             // See https://github.com/open-meteo/open-meteo/discussions/395
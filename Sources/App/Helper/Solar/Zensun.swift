@@ -14,6 +14,7 @@ public enum Zensun {
     /// This function is performance critical for updates. This explains redundant code.
     public static func calculateRadiationBackwardsAveraged(grid: Gridable, locationRange: some RandomAccessCollection<Int>, timerange: TimerangeDt) -> Array2DFastTime {
         var out = Array2DFastTime(nLocations: locationRange.count, nTime: timerange.count)
+        let coordinates = grid.getCoordinates(gridpoints: locationRange)
 
         for (t, timestamp) in timerange.enumerated() {
             let decang = timestamp.getSunDeclination()
@@ -40,8 +41,9 @@ public enum Zensun {
 
             let p10 = lonsun0.degreesToRadians
 
-            for (i, gridpoint) in locationRange.enumerated() {
-                let (lat, lon) = grid.getCoordinates(gridpoint: gridpoint)
+            for i in 0..<locationRange.count {
+                let lat = coordinates.latitude[i]
+                let lon = coordinates.longitude[i]
                 let t0 = (90 - lat).degreesToRadians                     // colatitude of point
 
                 /// longitude of point
@@ -79,6 +81,7 @@ public enum Zensun {
     public static func calculateSunElevationBackwards(grid: Gridable, timerange: TimerangeDt, yrange: Range<Int>? = nil) -> Array2DFastTime {
         let yrange = yrange ?? 0..<grid.ny
         var out = Array2DFastTime(nLocations: yrange.count * grid.nx, nTime: timerange.count)
+        let coordinates = grid.getCoordinates(gridpoints: yrange.lowerBound * grid.nx ..< yrange.upperBound * grid.nx)
 
         for (t, timestamp) in timerange.enumerated() {
             let decang = timestamp.getSunDeclination()
@@ -100,39 +103,36 @@ public enum Zensun {
 
             let p10 = lonsun0.degreesToRadians
 
-            var l = 0
-            for indexY in yrange {
-                for indexX in 0..<grid.nx {
-                    let (lat, lon) = grid.getCoordinates(gridpoint: indexY * grid.nx + indexX)
-                    let t0 = (90 - lat).degreesToRadians                     // colatitude of point
-
-                    /// longitude of point
-                    var p0 = lon.degreesToRadians
-                    if p0 < p1 - .pi {
-                        p0 += 2 * .pi
-                    }
-                    if p0 > p1 + .pi {
-                        p0 -= 2 * .pi
-                    }
-
-                    // limit p1 and p10 to sunrise/set
-                    let arg = -(sin(alpha) + cos(t0) * cos(t1)) / (sin(t0) * sin(t1))
-                    let carg = arg > 1 || arg < -1 ? .pi : acos(arg)
-                    let sunrise = p0 + carg
-                    let sunset = p0 - carg
-                    let p1_l = min(sunrise, p10)
-                    let p10_l = max(sunset, p1)
-
-                    // solve integral to get sun elevation dt
-                    // integral(cos(t0) cos(t1) + sin(t0) sin(t1) cos(p - p0)) dp = sin(t0) sin(t1) sin(p - p0) + p cos(t0) cos(t1) + constant
-                    let left = sin(t0) * sin(t1) * sin(p1_l - p0) + p1_l * cos(t0) * cos(t1)
-                    let right = sin(t0) * sin(t1) * sin(p10_l - p0) + p10_l * cos(t0) * cos(t1)
-                    /// sun elevation (`zz = sin(alpha)`)
-                    let zz = (left - right) / (p1_l - p10_l)
-
-                    out[l, t] = zz
-                    l += 1
+            for l in 0..<yrange.count * grid.nx {
+                let lat = coordinates.latitude[l]
+                let lon = coordinates.longitude[l]
+                let t0 = (90 - lat).degreesToRadians                     // colatitude of point
+
+                /// longitude of point
+                var p0 = lon.degreesToRadians
+                if p0 < p1 - .pi {
+                    p0 += 2 * .pi
                 }
+                if p0 > p1 + .pi {
+                    p0 -= 2 * .pi
+                }
+
+                // limit p1 and p10 to sunrise/set
+                let arg = -(sin(alpha) + cos(t0) * cos(t1)) / (sin(t0) * sin(t1))
+                let carg = arg > 1 || arg < -1 ? .pi : acos(arg)
+                let sunrise = p0 + carg
+                let sunset = p0 - carg
+                let p1_l = min(sunrise, p10)
+                let p10_l = max(sunset, p1)
+
+                // solve integral to get sun elevation dt
+                // integral(cos(t0) cos(t1) + sin(t0) sin(t1) cos(p - p0)) dp = sin(t0) sin(t1) sin(p - p0) + p cos(t0) cos(t1) + constant
+                let left = sin(t0) * sin(t1) * sin(p1_l - p0) + p1_l * cos(t0) * cos(t1)
+                let right = sin(t0) * sin(t1) * sin(p10_l - p0) + p10_l * cos(t0) * cos(t1)
+                /// sun elevation (`zz = sin(alpha)`)
+                let zz = (left - right) / (p1_l - p10_l)
+
+                out[l, t] = zz
             }
         }
         return out
@@ -162,6 +162,7 @@ public enum Zensun {
         var out = [Float]()
         let yrange = yrange ?? 0..<grid.ny
         out.reserveCapacity(yrange.count * grid.nx * timerange.count)
+        let coordinates = grid.getCoordinates(gridpoints: yrange.lowerBound * grid.nx ..< yrange.upperBound * grid.nx)
 
         for timestamp in timerange {
             let rsun = timestamp.getSunRadius()
@@ -177,17 +178,13 @@ public enum Zensun {
             let lonsun = -15.0 * (ut - 12.0 + eqtime)
             let p1 = lonsun.degreesToRadians
 
-            for indexY in yrange {
-                for indexX in 0..<grid.nx {
-                    let (lat, lon) = grid.getCoordinates(gridpoint: indexY * grid.nx + indexX)
-
-                    let t0 = (90 - lat).degreesToRadians
-                    let p0 = lon.degreesToRadians
-                    /// sun elevation (`zz = sin(alpha)`)
-                    let zz = cos(t0) * cos(t1) + sin(t0) * sin(t1) * cos(p1 - p0)
-                    let solfac = zz / rsun_square
-                    out.append(solfac)
-                }
+            for (lat, lon) in zip(coordinates.latitude, coordinates.longitude) {
+                let t0 = (90 - lat).degreesToRadians
+                let p0 = lon.degreesToRadians
+                /// sun elevation (`zz = sin(alpha)`)
+                let zz = cos(t0) * cos(t1) + sin(t0) * sin(t1) * cos(p1 - p0)
+                let solfac = zz / rsun_square
+                out.append(solfac)
             }
         }
         return out
@@ -211,6 +208,7 @@ public enum Zensun {
     /// 2d field. Calculate scaling factor from backwards to instant radiation factor
     public static func backwardsAveragedToInstantFactor(grid: Gridable, locationRange: Range<Int>, timerange: TimerangeDt) -> Array2DFastTime {
         var out = Array2DFastTime(nLocations: locationRange.count, nTime: timerange.count)
+        let coordinates = grid.getCoordinates(gridpoints: locationRange)
 
         for (t, timestamp) in timerange.enumerated() {
             /// fractional day number with 12am 1jan = 1
@@ -226,8 +224,9 @@ public enum Zensun {
 
             let lonsun = -15.0 * (ut - 12.0 + eqtime)
 
-            for (i, gridpoint) in locationRange.enumerated() {
-                let (latitude, longitude) = grid.getCoordinates(gridpoint: gridpoint)
+            for i in 0..<locationRange.count {
+                let latitude = coordinates.latitude[i]
+                let longitude = coordinates.longitude[i]
                 /// longitude of sun
                 let p1 = lonsun.degreesToRadians
 
@@ -287,9 +286,12 @@ public enum Zensun {
 
         /// At low solar inclination angles (less than 5 watts), reuse clearness factors from other timesteps
         let radMinium = 5 / Zensun.solarConstant
+        let coordinates = grid.getCoordinates(gridpoints: locationRange)
 
-        for (i, gridpoint) in locationRange.enumerated() {
+        for i in 0..<locationRange.count {
             var ktPrevious = Float.nan
+            let latitude = coordinates.latitude[i]
+            let longitude = coordinates.longitude[i]
 
             for (t, timestamp) in timerange.enumerated() {
                 let pos = i * timerange.count + t
@@ -313,7 +315,6 @@ public enum Zensun {
                 let lonsun = -15.0 * (ut - 12.0 + eqtime)
                 let lonsunScan = -15.0 * (utScan - 12.0 + eqtime)
 
-                let (latitude, longitude) = grid.getCoordinates(gridpoint: gridpoint)
                 /// longitude of sun
                 let p1 = lonsun.degreesToRadians
                 let p1Scan = lonsunScan.degreesToRadians
@@ -383,56 +384,8 @@ public enum Zensun {
 
     /// Calculate scaling factor from backwards to instant radiation factor
     public static func backwardsAveragedToInstantFactor(time: TimerangeDt, latitude: Float, longitude: Float) -> [Float] {
-        return time.map { timestamp in
-            /// fractional day number with 12am 1jan = 1
-            let decang = timestamp.getSunDeclination()
-            let eqtime = timestamp.getSunEquationOfTime()
-
-            let alpha = Float(0.83333).degreesToRadians
-
-            let latsun = decang
-            /// universal time
-            let ut = timestamp.hourWithFraction
-            let t1 = (90 - latsun).degreesToRadians
-
-            let lonsun = -15.0 * (ut - 12.0 + eqtime)
-
-            /// longitude of sun
-            let p1 = lonsun.degreesToRadians
-
-            let ut0 = ut - (Float(time.dtSeconds) / 3600)
-            let lonsun0 = -15.0 * (ut0 - 12.0 + eqtime)
-
-            let p10 = lonsun0.degreesToRadians
-
-            let t0 = (90 - latitude).degreesToRadians                     // colatitude of point
-
-            /// longitude of point
-            var p0 = longitude.degreesToRadians
-            if p0 < p1 - .pi {
-                p0 += 2 * .pi
-            }
-            if p0 > p1 + .pi {
-                p0 -= 2 * .pi
-            }
-
-            // limit p1 and p10 to sunrise/set
-            let arg = -(sin(alpha) + cos(t0) * cos(t1)) / (sin(t0) * sin(t1))
-            let carg = arg > 1 || arg < -1 ? .pi : acos(arg)
-            let sunrise = p0 + carg
-            let sunset = p0 - carg
-            let p1_l = min(sunrise, p10)
-            let p10_l = max(sunset, p1)
-
-            // solve integral to get sun elevation dt
-            // integral(cos(t0) cos(t1) + sin(t0) sin(t1) cos(p - p0)) dp = sin(t0) sin(t1) sin(p - p0) + p cos(t0) cos(t1) + constant
-            let left = sin(t0) * sin(t1) * sin(p1_l - p0) + p1_l * cos(t0) * cos(t1)
-            let right = sin(t0) * sin(t1) * sin(p10_l - p0) + p10_l * cos(t0) * cos(t1)
-            /// sun elevation (`zz = sin(alpha)`)
-            let zzBackwards = (left - right) / (p1_l - p10_l)
-
-            /// Instant sun elevation
-            let zzInstant = cos(t0) * cos(t1) + sin(t0) * sin(t1) * cos(p1 - p0)
+        let geometry = SolarGeometryBackwards(timerange: time, latitude: latitude, longitude: longitude, alpha: 0.83333)
+        return zip(geometry.zzBackwards, geometry.zzInstant).map { zzBackwards, zzInstant in
             if zzBackwards <= 0 || zzInstant <= 0 {
                 return 0
             }
@@ -0,0 +1,125 @@
+import Foundation
+import NIOConcurrencyHelpers
+
+/**
+ Caches to resolve `timezone=auto` without a timezone database lookup and Foundation `TimeZone` calls for every location.
+
+ Coordinates are quantised to 0.001° (around 100 m) and mapped to timezone identifiers. Entries are kept in two generations. Once the current generation is full, it replaces the previous one and older entries are dropped. Hits in the previous generation are promoted. This approximates LRU without per-entry bookkeeping.
+
+ `TimezoneWithOffset` is cached by identifier until the next daylight saving transition, so offsets and abbreviations are computed once per identifier and transition.
+ */
+final class TimezoneCache: Sendable {
+    static let instance = TimezoneCache(capacity: 200_000)
+
+    /// Entries per generation
+    let capacity: Int
+
+    private struct Generations {
+        var current = [Int64: String]()
+        var previous = [Int64: String]()
+    }
+
+    private struct Offset {
+        let timezone: TimezoneWithOffset
+        let validUntil: Date
+    }
+
+    private let identifiers = NIOLockedValueBox<Generations>(.init())
+    private let offsets = NIOLockedValueBox<[String: Offset]>(.init())
+
+    init(capacity: Int) {
+        self.capacity = capacity
+    }
+
+    /// Resolve the timezone of a single coordinate
+    func resolve(latitude: Float, longitude: Float) throws -> TimezoneWithOffset {
+        return try resolve(coordinates: [(latitude, longitude)])[0]
+    }
+
+    /// Resolve timezones of many coordinates. Cached identifiers are read with one lock. Each distinct identifier is converted to an offset once
+    func resolve(coordinates: [(latitude: Float, longitude: Float)], now: Date = Date()) throws -> [TimezoneWithOffset] {
+        let keys = coordinates.map { Self.key(latitude: $0.latitude, longitude: $0.longitude) }
+        var found: [String?] = identifiers.withLockedValue { cache in
+            keys.map { key in
+                if let identifier = cache.current[key] {
+                    return identifier
+                }
+                guard let identifier = cache.previous[key] else {
+                    return nil
+                }
+                Self.insert(&cache, key: key, identifier: identifier, capacity: capacity)
+                return identifier
+            }
+        }
+        var missing = [(key: Int64, identifier: String)]()
+        for (i, coordinate) in coordinates.enumerated() where found[i] == nil {
+            guard let identifier = TimezoneWithOffset.timezoneDatabase.simple(latitude: coordinate.latitude, longitude: coordinate.longitude) else {
+                throw ForecastapiError.invalidTimezone
+            }
+            found[i] = identifier
+            missing.append((keys[i], identifier))
+        }
+        if !missing.isEmpty {
+            identifiers.withLockedValue { cache in
+                for (key, identifier) in missing {
+                    Self.insert(&cache, key: key, identifier: identifier, capacity: capacity)
+                }
+            }
+        }
+        var timezones = [String: TimezoneWithOffset]()
+        return try found.map { identifier in
+            let identifier = identifier!
+            if let timezone = timezones[identifier] {
+                return timezone
+            }
+            let timezone = try offset(identifier: identifier, now: now)
+            timezones[identifier] = timezone
+            return timezone
+        }
+    }
+
+    /// Current offset and abbreviation of a timezone identifier. Cached until the next daylight saving transition
+    func offset(identifier: String, now: Date = Date()) throws -> TimezoneWithOffset {
+        if let offset = offsets.withLockedValue({ $0[identifier] }), offset.validUntil > now {
+            return offset.timezone
+        }
+        return try offset(timezone: try TimeZone.initWithFallback(identifier), identifier: identifier, now: now)
+    }
+
+    /// Current offset and abbreviation of a Foundation `TimeZone`. Cached until the next daylight saving transition
+    func offset(timezone: TimeZone, now: Date = Date()) -> TimezoneWithOffset {
+        if let offset = offsets.withLockedValue({ $0[timezone.identifier] }), offset.validUntil > now {
+            return offset.timezone
+        }
+        return offset(timezone: timezone, identifier: timezone.identifier, now: now)
+    }
+
+    /// `identifier` may differ from the timezone identifier if a fallback timezone is used
+    private func offset(timezone: TimeZone, identifier: String, now: Date) -> TimezoneWithOffset {
+        let resolved = TimezoneWithOffset(
+            utcOffsetSeconds: timezone.secondsFromGMT(for: now),
+            identifier: timezone.identifier,
+            abbreviation: timezone.abbreviation(for: now) ?? ""
+        )
+        /// Timezones without daylight saving time are checked again after one day in case rules change
+        let validUntil = timezone.nextDaylightSavingTimeTransition(after: now) ?? now.addingTimeInterval(86400)
+        offsets.withLockedValue({ $0[identifier] = Offset(timezone: resolved, validUntil: validUntil) })
+        return resolved
+    }
+
+    /// Coordinates rounded to 0.001° in one integer
+    static func key(latitude: Float, longitude: Float) -> Int64 {
+        let lat = Int64((latitude * 1000).rounded())
+        let lon = Int64((longitude * 1000).rounded())
+        return lat << 32 | (lon & 0xFFFF_FFFF)
+    }
+
+    private static func insert(_ cache: inout Generations, key: Int64, identifier: String, capacity: Int) {
+        if cache.current.count >= capacity {
+            cache.previous = cache.current
+            cache.current = [:]
+            cache.current.reserveCapacity(capacity)
+        }
+        cache.current[key] = identifier
+    }
+}
@@ -0,0 +1,277 @@
+import Foundation
+import NIOConcurrencyHelpers
+import NIOPosix
+import Synchronization
+import Vapor
+import CHelper
+
+/// Stages of an API request that are measured as latency histograms
+enum RequestStage: String, CaseIterable {
+    /// Route handler until the response head is ready
+    case handler
+    /// Streamed response body including lazy data reads
+    case stream
+    case gridpoint
+    case file_open
+    case file_revalidate
+    /// Fetch of a missing block for the block cache
+    case block_fetch
+    /// Read and decompress a time-series from om files
+    case decompression
+    case interpolation
+    /// Derived variables including the reads of their raw inputs
+    case derived
+    case serialisation
+}
+
+/// Event counters
+enum RequestCounter: String, CaseIterable {
+    case requests
+    case block_cache_hit
+    case block_cache_miss
+    /// Float arrays allocated by `FloatBufferPool`
+    case float_buffer_allocations
+    /// Float arrays reused from `FloatBufferPool`
+    case float_buffer_reuses
+}
+
+/**
+ Low overhead request profiler. Requests are sampled in `RequestMetricsMiddleware` and spans are only recorded for sampled requests.
+ Each thread accumulates into its own histograms which are merged when `/metrics` is scraped.
+
+ Histogram buckets are powers of two in microseconds from 2 µs to around 8 seconds.
+ */
+enum RequestMetrics {
+    static let nBuckets = 24
+
+    /// Set `METRICS_ENABLED=true` to sample requests. `/metrics` additionally requires `METRICS_TOKEN`
+    static let enabled = Environment.get("METRICS_ENABLED") == "true"
+
+    /// Fraction of requests to sample in parts per million. Can be changed at runtime with `POST /metrics/sampling?rate=0.1`
+    static let samplingPpm = Atomic<Int>(Int((Environment.get("METRICS_SAMPLING").flatMap(Double.init) ?? 0.01) * 1_000_000))
+
+    /// Set for the duration of a sampled request
+    @TaskLocal static var isSampled = false
+
+    /// Accumulator of one thread. Only the owning thread writes, the lock is only contended while merging
+    final class ThreadAccumulator: @unchecked Sendable {
+        let lock = NIOLock()
+        var buckets = [Int](repeating: 0, count: RequestStage.allCases.count * RequestMetrics.nBuckets)
+        var sumNanoseconds = [Int](repeating: 0, count: RequestStage.allCases.count)
+        var counters = [Int](repeating: 0, count: RequestCounter.allCases.count)
+    }
+
+    private static let threadLocal = ThreadSpecificVariable<ThreadAccumulator>()
+
+    private static let allThreads = NIOLockedValueBox<[ThreadAccumulator]>([])
+
+    private static var accumulator: ThreadAccumulator {
+        if let accumulator = threadLocal.currentValue {
+            return accumulator
+        }
+        let accumulator = ThreadAccumulator()
+        threadLocal.currentValue = accumulator
+        allThreads.withLockedValue { $0.append(accumulator) }
+        return accumulator
+    }
+
+    /// Decide if a new request should be sampled
+    static func shouldSample() -> Bool {
+        let ppm = samplingPpm.load(ordering: .relaxed)
+        return ppm > 0 && (ppm >= 1_000_000 || Int.random(in: 0..<1_000_000) < ppm)
+    }
+
+    /// Returns a start time if the current request is sampled
+    @inline(__always)
+    static func start() -> UInt64? {
+        return isSampled ? DispatchTime.now().uptimeNanoseconds : nil
+    }
+
+    /// Record a span that was started with `start()`
+    @inline(__always)
+    static func record(_ stage: RequestStage, since start: UInt64?) {
+        guard let start else {
+            return
+        }
+        record(stage, nanoseconds: Int(DispatchTime.now().uptimeNanoseconds - start))
+    }
+
+    static func record(_ stage: RequestStage, nanoseconds: Int) {
+        let micros = Swift.max(1, nanoseconds / 1000)
+        let bucket = Swift.min(nBuckets - 1, Int.bitWidth - micros.leadingZeroBitCount - 1)
+        let stageIndex = RequestStage.allCases.firstIndex(of: stage)!
+        let local = Self.accumulator
+        local.lock.withLockVoid {
+            local.buckets[stageIndex * nBuckets + bucket] += 1
+            local.sumNanoseconds[stageIndex] += nanoseconds
+        }
+    }
+
+    /// Increment a counter for sampled requests
+    @inline(__always)
+    static func increment(_ counter: RequestCounter, by: Int = 1) {
+        guard isSampled else {
+            return
+        }
+        let index = RequestCounter.allCases.firstIndex(of: counter)!
+        let local = Self.accumulator
+        local.lock.withLockVoid {
+            local.counters[index] += by
+        }
+    }
+
+    /// Measure a synchronous span
+    @inline(__always)
+    static func measure<T>(_ stage: RequestStage, _ body: () throws -> T) rethrows -> T {
+        let begin = Self.start()
+        defer { record(stage, since: begin) }
+        return try body()
+    }
+
+    /// Measure an asynchronous span
+    @inline(__always)
+    static func measureAsync<T>(_ stage: RequestStage, _ body: () async throws -> T) async rethrows -> T {
+        let begin = Self.start()
+        defer { record(stage, since: begin) }
+        return try await body()
+    }
+
+    /// Sum of all thread accumulators
+    private static func merged() -> (buckets: [Int], sumNanoseconds: [Int], counters: [Int]) {
+        var buckets = [Int](repeating: 0, count: RequestStage.allCases.count * nBuckets)
+        var sumNanoseconds = [Int](repeating: 0, count: RequestStage.allCases.count)
+        var counters = [Int](repeating: 0, count: RequestCounter.allCases.count)
+        for accumulator in allThreads.withLockedValue({ $0 }) {
+            accumulator.lock.withLockVoid {
+                for i in buckets.indices {
+                    buckets[i] += accumulator.buckets[i]
+                }
+                for i in sumNanoseconds.indices {
+                    sumNanoseconds[i] += accumulator.sumNanoseconds[i]
+                }
+                for i in counters.indices {
+                    counters[i] += accumulator.counters[i]
+                }
+            }
+        }
+        return (buckets, sumNanoseconds, counters)
+    }
+
+    /// Current value of a counter summed over all threads
+    static func total(_ counter: RequestCounter) -> Int {
+        return merged().counters[RequestCounter.allCases.firstIndex(of: counter)!]
+    }
+
+    /// Merge all thread accumulators and format them in the Prometheus text format
+    static func prometheusText() -> String {
+        let stages = RequestStage.allCases
+        let (buckets, sumNanoseconds, counters) = merged()
+
+        var out = "# HELP openmeteo_request_stage_seconds Latency of request stages of sampled requests\n"
+        out += "# TYPE openmeteo_request_stage_seconds histogram\n"
+        for (s, stage) in stages.enumerated() {
+            var cumulative = 0
+            for bucket in 0..<nBuckets - 1 {
+                cumulative += buckets[s * nBuckets + bucket]
+                let le = Double(1 << (bucket + 1)) / 1_000_000
+                out += "openmeteo_request_stage_seconds_bucket{stage=\"\(stage.rawValue)\",le=\"\(le)\"} \(cumulative)\n"
+            }
+            /// Last bucket collects all slower spans
+            cumulative += buckets[s * nBuckets + nBuckets - 1]
+            out += "openmeteo_request_stage_seconds_bucket{stage=\"\(stage.rawValue)\",le=\"+Inf\"} \(cumulative)\n"
+            out += "openmeteo_request_stage_seconds_sum{stage=\"\(stage.rawValue)\"} \(Double(sumNanoseconds[s]) / 1_000_000_000)\n"
+            out += "openmeteo_request_stage_seconds_count{stage=\"\(stage.rawValue)\"} \(cumulative)\n"
+        }
+        for (c, counter) in RequestCounter.allCases.enumerated() {
+            out += "# TYPE openmeteo_\(counter.rawValue)_total counter\n"
+            out += "openmeteo_\(counter.rawValue)_total \(counters[c])\n"
+        }
+        out += "# TYPE openmeteo_metrics_sampling_rate gauge\n"
+        out += "openmeteo_metrics_sampling_rate \(Double(samplingPpm.load(ordering: .relaxed)) / 1_000_000)\n"
+
+        var malloc = chelper_malloc_stats()
+        chelper_get_malloc_stats(&malloc)
+        let mallocStats: [(String, Int)] = [
+            ("arena", malloc.arena),
+            ("mmap", malloc.hblkhd),
+            ("allocated", malloc.uordblks),
+            ("free", malloc.fordblks),
+            ("releasable", malloc.keepcost)
+        ]
+        for (name, value) in mallocStats {
+            out += "# TYPE openmeteo_malloc_\(name)_bytes gauge\n"
+            out += "openmeteo_malloc_\(name)_bytes \(value)\n"
+        }
+        return out
+    }
+}
+
+/// Decide if a request is sampled and measure the route handler
+struct RequestMetricsMiddleware: AsyncMiddleware {
+    func respond(to request: Request, chainingTo next: any AsyncResponder) async throws -> Response {
+        guard RequestMetrics.shouldSample() else {
+            return try await next.respond(to: request)
+        }
+        return try await RequestMetrics.$isSampled.withValue(true) {
+            RequestMetrics.increment(.requests)
+            return try await RequestMetrics.measureAsync(.handler) {
+                try await next.respond(to: request)
+            }
+        }
+    }
+}
+
+/**
+ Internal routes to scrape metrics and adjust sampling at runtime. Routes are only registered if `METRICS_TOKEN` is set and every request must send `Authorization: Bearer <token>`.
+
+ Prometheus scrape config:
+ ```
+ authorization:
+   credentials: <token>
+ ```
+ */
+struct MetricsController: RouteCollection {
+    let token: String?
+
+    init(token: String? = Environment.get("METRICS_TOKEN")) {
+        self.token = token
+    }
+
+    func boot(routes: RoutesBuilder) throws {
+        guard let token, !token.isEmpty else {
+            return
+        }
+        let protected = routes.grouped(MetricsTokenMiddleware(token: token))
+        protected.get("metrics", use: metricsHandler)
+        protected.post("metrics", "sampling", use: samplingHandler)
+    }
+
+    func metricsHandler(_ req: Request) async throws -> Response {
+        let response = Response(body: .init(string: RequestMetrics.prometheusText()))
+        response.headers.replaceOrAdd(name: .contentType, value: "text/plain; version=0.0.4")
+        return response
+    }
+
+    /// `POST /metrics/sampling?rate=0.05` sets the fraction of sampled requests. Returns the current rate
+    func samplingHandler(_ req: Request) async throws -> String {
+        if let rate = try? req.query.get(Double.self, at: "rate") {
+            guard rate >= 0 && rate <= 1 else {
+                throw Abort(.badRequest, reason: "Parameter 'rate' must be between 0 and 1")
+            }
+            RequestMetrics.samplingPpm.store(Int(rate * 1_000_000), ordering: .relaxed)
+        }
+        return "\(Double(RequestMetrics.samplingPpm.load(ordering: .relaxed)) / 1_000_000)"
+    }
+}
+
+/// Reject requests without the metrics bearer token
+struct MetricsTokenMiddleware: AsyncMiddleware {
+    let token: String
+
+    func respond(to request: Request, chainingTo next: any AsyncResponder) async throws -> Response {
+        guard let bearer = request.headers.bearerAuthorization?.token, bearer.utf8.elementsEqual(token.utf8) else {
+            throw Abort(.unauthorized)
+        }
+        return try await next.respond(to: request)
+    }
+}
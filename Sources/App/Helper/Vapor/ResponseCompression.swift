@@ -0,0 +1,352 @@
+import Foundation
+import NIOCore
+import NIOPosix
+import Vapor
+import CZlib
+#if ENABLE_ZSTD_BROTLI
+import CZstd
+import CBrotli
+#endif
+
+/// Content encodings for streamed API responses in order of preference
+enum ContentEncoding: String, CaseIterable, Sendable {
+    #if ENABLE_ZSTD_BROTLI
+    case zstd
+    case br
+    #endif
+    case gzip
+
+    /// Select the preferred encoding of an `Accept-Encoding` header. Encodings with `q=0` are excluded
+    static func negotiate(acceptEncoding: String) -> ContentEncoding? {
+        var accepted = Set<String>()
+        for part in acceptEncoding.split(separator: ",") {
+            let fields = part.split(separator: ";").map { $0.trimmingCharacters(in: .whitespaces) }
+            guard let name = fields.first?.lowercased(), !name.isEmpty else {
+                continue
+            }
+            let quality = fields.dropFirst().first(where: { $0.starts(with: "q=") }).flatMap { Double($0.dropFirst(2)) } ?? 1
+            if quality > 0 {
+                accepted.insert(name)
+            }
+        }
+        return allCases.first(where: { accepted.contains($0.rawValue) })
+    }
+
+    /// Compression level for the current CPU load. Levels are lowered if the 1 minute load average exceeds half of all cores
+    var level: Int32 {
+        var load = [Double](repeating: 0, count: 1)
+        let utilisation = getloadavg(&load, 1) == 1 ? load[0] / Double(System.coreCount) : 0
+        switch self {
+        #if ENABLE_ZSTD_BROTLI
+        case .zstd:
+            return utilisation < 0.5 ? 6 : utilisation < 1 ? 3 : 1
+        case .br:
+            return utilisation < 0.5 ? 5 : utilisation < 1 ? 4 : 2
+        #endif
+        case .gzip:
+            return utilisation < 0.5 ? 6 : utilisation < 1 ? 4 : 1
+        }
+    }
+}
+
+/**
+ Compress streamed API responses on the NIO thread pool instead of the event loop. Vapor response compression is disabled for these responses.
+
+ `ResponseCompressionMiddleware` negotiates the encoding. Writers capture `ResponseCompression.encoding` while the response is created, similar to `RequestMetrics.isSampled`, and wrap their `BodyStreamWriter` with `compressed(_:)`.
+ */
+enum ResponseCompression {
+    /// Set `RESPONSE_COMPRESSION=false` to use the built-in Vapor response compression for all responses
+    static let enabled = Environment.get("RESPONSE_COMPRESSION") != "false"
+
+    /// Negotiated encoding of the current request
+    @TaskLocal static var encoding: ContentEncoding? = nil
+}
+
+/// Negotiate the content encoding of API responses
+struct ResponseCompressionMiddleware: AsyncMiddleware {
+    func respond(to request: Request, chainingTo next: any AsyncResponder) async throws -> Response {
+        guard let acceptEncoding = request.headers.first(name: .acceptEncoding), let encoding = ContentEncoding.negotiate(acceptEncoding: acceptEncoding) else {
+            return try await next.respond(to: request)
+        }
+        return try await ResponseCompression.$encoding.withValue(encoding) {
+            try await next.respond(to: request)
+        }
+    }
+}
+
+extension Response {
+    /// Set headers for a response body that is compressed by `CompressingBodyStreamWriter`
+    func setContentEncoding(_ encoding: ContentEncoding?) {
+        guard let encoding else {
+            return
+        }
+        headers.responseCompression = .disable
+        headers.replaceOrAdd(name: .contentEncoding, value: encoding.rawValue)
+        headers.add(name: .vary, value: "Accept-Encoding")
+    }
+}
+
+extension BodyStreamWriter {
+    /// Compress all data written to this writer if an encoding was negotiated
+    func compressed(_ encoding: ContentEncoding?) -> any BodyStreamWriter {
+        guard let encoding else {
+            return self
+        }
+        return CompressingBodyStreamWriter(downstream: self, encoding: encoding)
+    }
+}
+
+/**
+ Collect streamed data in blocks of 256 KB and compress them on the thread pool. Blocks are written in order.
+
+ gzip and zstd blocks are compressed independently, up to 4 blocks in parallel:
+ - gzip: raw deflate blocks that use the last 32 KB of the previous block as dictionary and end with a sync flush, similar to `pigz`. Together with header and trailer this is one regular gzip stream
+ - zstd: one frame per block. Concatenated frames are a valid zstd stream
+ brotli cannot be split into blocks and is compressed sequentially.
+
+ The producer only waits once more than 4 blocks are in flight. All state is confined to the event loop.
+ */
+final class CompressingBodyStreamWriter: BodyStreamWriter, @unchecked Sendable {
+    let downstream: any BodyStreamWriter
+    let encoding: ContentEncoding
+    let level: Int32
+    let threadPool: NIOThreadPool
+
+    var eventLoop: any EventLoop {
+        return downstream.eventLoop
+    }
+
+    static var blockSize: Int { 256 * 1024 }
+
+    /// Maximum number of blocks that are compressed in parallel for one response
+    static var maxParallel: Int { 4 }
+
+    /// Uncompressed data that does not fill a block yet
+    private var pending: ByteBuffer
+
+    /// Completes once all previous blocks are written
+    private var written: EventLoopFuture<Void>
+
+    private var inflight = CircularBuffer<EventLoopFuture<Void>>()
+
+    /// gzip: last 32 KB of the previous block
+    private var dictionary: ByteBuffer? = nil
+
+    /// gzip: combined CRC and length of all blocks
+    private var crc = crc32(0, nil, 0)
+    private var totalIn = 0
+    private var headerWritten = false
+
+    #if ENABLE_ZSTD_BROTLI
+    private let brotli: BrotliStream?
+    #endif
+
+    init(downstream: any BodyStreamWriter, encoding: ContentEncoding, threadPool: NIOThreadPool = .singleton) {
+        self.downstream = downstream
+        self.encoding = encoding
+        self.level = encoding.level
+        self.threadPool = threadPool
+        self.pending = ByteBufferAllocator().buffer(capacity: Self.blockSize)
+        self.written = downstream.eventLoop.makeSucceededVoidFuture()
+        #if ENABLE_ZSTD_BROTLI
+        self.brotli = encoding == .br ? BrotliStream(quality: level) : nil
+        #endif
+    }
+
+    func write(_ result: BodyStreamResult, promise: EventLoopPromise<Void>?) {
+        guard eventLoop.inEventLoop else {
+            eventLoop.execute {
+                self.write(result, promise: promise)
+            }
+            return
+        }
+        switch result {
+        case .buffer(var buffer):
+            pending.writeBuffer(&buffer)
+            guard pending.readableBytes >= Self.blockSize else {
+                promise?.succeed(())
+                return
+            }
+            let block = pending
+            pending = ByteBufferAllocator().buffer(capacity: Self.blockSize)
+            enqueue(block, last: false)
+            guard inflight.count > Self.maxParallel else {
+                promise?.succeed(())
+                return
+            }
+            inflight.removeFirst().cascade(to: promise)
+        case .end:
+            let block = pending
+            pending = ByteBuffer()
+            enqueue(block, last: true)
+            let downstream = downstream
+            written.flatMap {
+                downstream.write(.end)
+            }.cascade(to: promise)
+        case .error(let error):
+            let downstream = downstream
+            written.whenComplete { _ in
+                downstream.write(.error(error), promise: promise)
+            }
+        }
+    }
+
+    /// Compress a block on the thread pool and write it after all previous blocks
+    private func enqueue(_ block: ByteBuffer, last: Bool) {
+        let level = level
+        let compressed: EventLoopFuture<CompressedBlock>
+        switch encoding {
+        case .gzip:
+            let dictionary = self.dictionary
+            let tail = min(32 * 1024, block.readableBytes)
+            self.dictionary = block.getSlice(at: block.writerIndex - tail, length: tail)
+            compressed = threadPool.runIfActive(eventLoop: eventLoop) {
+                CompressedBlock.deflate(block, dictionary: dictionary, level: level, last: last)
+            }
+        #if ENABLE_ZSTD_BROTLI
+        case .zstd:
+            compressed = threadPool.runIfActive(eventLoop: eventLoop) {
+                CompressedBlock.zstd(block, level: level)
+            }
+        case .br:
+            let brotli = brotli!
+            let threadPool = threadPool
+            let eventLoop = eventLoop
+            compressed = written.flatMap {
+                threadPool.runIfActive(eventLoop: eventLoop) {
+                    CompressedBlock(data: brotli.compress(block, finish: last), crc: 0, count: block.readableBytes)
+                }
+            }
+        #endif
+        }
+        written = written.and(compressed).flatMap { result in
+            self.writeDownstream(result.1, last: last)
+        }
+        inflight.append(written)
+    }
+
+    /// Called in order on the event loop. Adds gzip header and trailer
+    private func writeDownstream(_ compressed: CompressedBlock, last: Bool) -> EventLoopFuture<Void> {
+        guard encoding == .gzip else {
+            return compressed.data.readableBytes > 0 ? downstream.write(.buffer(compressed.data)) : eventLoop.makeSucceededVoidFuture()
+        }
+        var out = ByteBufferAllocator().buffer(capacity: compressed.data.readableBytes + 18)
+        if !headerWritten {
+            headerWritten = true
+            // gzip header: magic, deflate, no flags, no mtime, no extra flags, unix
+            out.writeBytes([0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03])
+        }
+        var data = compressed.data
+        out.writeBuffer(&data)
+        crc = crc32_combine(crc, compressed.crc, .init(compressed.count))
+        totalIn += compressed.count
+        if last {
+            out.writeInteger(UInt32(truncatingIfNeeded: crc), endianness: .little)
+            out.writeInteger(UInt32(truncatingIfNeeded: totalIn), endianness: .little)
+        }
+        return downstream.write(.buffer(out))
+    }
+}
+
+/// Compressed data of one block. `crc` and `count` refer to the uncompressed data and are only used for gzip
+struct CompressedBlock: Sendable {
+    let data: ByteBuffer
+    let crc: UInt
+    let count: Int
+
+    /// Raw deflate without header. Blocks end with a sync flush, the last block finishes the stream
+    static func deflate(_ block: ByteBuffer, dictionary: ByteBuffer?, level: Int32, last: Bool) -> CompressedBlock {
+        let zstream = UnsafeMutablePointer<z_stream>.allocate(capacity: 1)
+        defer { zstream.deallocate() }
+        zstream.initialize(to: z_stream())
+        guard deflateInit2_(zstream, level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY, ZLIB_VERSION, Int32(MemoryLayout<z_stream>.size)) == Z_OK else {
+            fatalError("deflateInit2 failed")
+        }
+        defer { deflateEnd(zstream) }
+        dictionary?.withUnsafeReadableBytes { ptr in
+            _ = deflateSetDictionary(zstream, ptr.bindMemory(to: Bytef.self).baseAddress, uInt(ptr.count))
+        }
+        var out = ByteBufferAllocator().buffer(capacity: Int(deflateBound(zstream, uLong(block.readableBytes))) + 64)
+        let crc = block.withUnsafeReadableBytes { input in
+            zstream.pointee.next_in = UnsafeMutablePointer(mutating: input.bindMemory(to: Bytef.self).baseAddress)
+            zstream.pointee.avail_in = uInt(input.count)
+            while true {
+                out.reserveCapacity(minimumWritableBytes: 64 * 1024)
+                var ret: Int32 = 0
+                out.writeWithUnsafeMutableBytes(minimumWritableBytes: 0) { output in
+                    zstream.pointee.next_out = output.baseAddress?.assumingMemoryBound(to: Bytef.self)
+                    zstream.pointee.avail_out = uInt(output.count)
+                    ret = CZlib.deflate(zstream, last ? Z_FINISH : Z_SYNC_FLUSH)
+                    return output.count - Int(zstream.pointee.avail_out)
+                }
+                guard ret == Z_OK || ret == Z_STREAM_END else {
+                    fatalError("deflate error \(ret)")
+                }
+                // Output is complete once deflate did not use the full output buffer
+                if (last && ret == Z_STREAM_END) || (!last && zstream.pointee.avail_out > 0) {
+                    break
+                }
+            }
+            return CZlib.crc32(0, input.bindMemory(to: Bytef.self).baseAddress, uInt(input.count))
+        }
+        return CompressedBlock(data: out, crc: crc, count: block.readableBytes)
+    }
+
+    #if ENABLE_ZSTD_BROTLI
+    /// Independent zstd frame
+    static func zstd(_ block: ByteBuffer, level: Int32) -> CompressedBlock {
+        var out = ByteBufferAllocator().buffer(capacity: ZSTD_compressBound(block.readableBytes))
+        block.withUnsafeReadableBytes { input in
+            out.writeWithUnsafeMutableBytes(minimumWritableBytes: ZSTD_compressBound(input.count)) { output in
+                let size = ZSTD_compress(output.baseAddress, output.count, input.baseAddress, input.count, level)
+                guard ZSTD_isError(size) == 0 else {
+                    fatalError("ZSTD_compress failed: \(String(cString: ZSTD_getErrorName(size)))")
+                }
+                return size
+            }
+        }
+        return CompressedBlock(data: out, crc: 0, count: block.readableBytes)
+    }
+    #endif
+}
+
+#if ENABLE_ZSTD_BROTLI
+/// Sequential brotli encoder. Calls must be serialised
+final class BrotliStream: @unchecked Sendable {
+    let state: OpaquePointer
+
+    init(quality: Int32) {
+        guard let state = BrotliEncoderCreateInstance(nil, nil, nil) else {
+            fatalError("BrotliEncoderCreateInstance failed")
+        }
+        BrotliEncoderSetParameter(state, BROTLI_PARAM_QUALITY, UInt32(quality))
+        BrotliEncoderSetParameter(state, BROTLI_PARAM_LGWIN, 22)
+        self.state = state
+    }
+
+    /// Compress input and return all available output
+    func compress(_ block: ByteBuffer, finish: Bool) -> ByteBuffer {
+        var out = ByteBufferAllocator().buffer(capacity: block.readableBytes / 4 + 1024)
+        block.withUnsafeReadableBytes { input in
+            var availableIn = input.count
+            var nextIn = input.bindMemory(to: UInt8.self).baseAddress
+            repeat {
+                out.reserveCapacity(minimumWritableBytes: 64 * 1024)
+                out.writeWithUnsafeMutableBytes(minimumWritableBytes: 0) { output in
+                    var availableOut = output.count
+                    var nextOut = output.bindMemory(to: UInt8.self).baseAddress
+                    guard BrotliEncoderCompressStream(state, finish ? BROTLI_OPERATION_FINISH : BROTLI_OPERATION_PROCESS, &availableIn, &nextIn, &availableOut, &nextOut, nil) == BROTLI_TRUE else {
+                        fatalError("BrotliEncoderCompressStream failed")
+                    }
+                    return output.count - availableOut
+                }
+            } while availableIn > 0 || BrotliEncoderHasMoreOutput(state) == BROTLI_TRUE || (finish && BrotliEncoderIsFinished(state) != BROTLI_TRUE)
+        }
+        return out
+    }
+
+    deinit {
+        BrotliEncoderDestroyInstance(state)
+    }
+}
+#endif
@@ -4,8 +4,11 @@ import Vapor
 extension ForecastapiResult {
     /// Streaming CSV format. Once 3kb of text is accumulated, flush to next handler -> response compressor
     func toCsvResponse(concurrencySlot: Int? = nil) throws -> Response {
+        let isSampled = RequestMetrics.isSampled
+        let encoding = ResponseCompression.encoding
         let response = Response(body: .init(stream: { writer in
-            writer.submit(concurrencySlot: concurrencySlot) {
+            let writer = writer.compressed(encoding)
+            writer.submit(concurrencySlot: concurrencySlot, isSampled: isSampled) {
                 var b = BufferAndWriter(writer: writer)
                 let multiLocation = results.count > 1
 
@@ -43,6 +46,7 @@ extension ForecastapiResult {
             }
         }, count: -1))
 
+        response.setContentEncoding(encoding)
         response.headers.replaceOrAdd(name: .contentType, value: "text/csv; charset=utf-8")
         response.headers.replaceOrAdd(name: .contentDisposition, value: "attachment; filename=\"open-meteo-\(results.first?.results.first?.formatedCoordinatesFilename ?? "").csv\"")
         return response
@@ -72,7 +76,8 @@ extension ApiSectionSingle {
         b.buffer.writeString(time)
         for e in columns {
             if e.value.isFinite {
-                b.buffer.writeString(",\(String(format: "%.\(e.unit.significantDigits)f", e.value))")
+                b.buffer.writeString(",")
+                b.buffer.writeFloat(e.value, decimals: e.unit.significantDigits)
             } else {
                 b.buffer.writeString(",NaN")
             }
@@ -108,7 +113,8 @@ extension ApiSectionString {
                 switch e.data {
                 case .float(let a):
                     if a[i].isFinite {
-                        b.buffer.writeString(",\(String(format: "%.\(e.unit.significantDigits)f", a[i]))")
+                        b.buffer.writeString(",")
+                        b.buffer.writeFloat(a[i], decimals: e.unit.significantDigits)
                     } else {
                         b.buffer.writeString(",NaN")
                     }
@@ -2,6 +2,7 @@ import Foundation
 import Vapor
 import FlatBuffers
 import OpenMeteoSdk
+import CHelper
 
 protocol FlatBuffersVariable: RawRepresentableString {
     func getFlatBuffersMeta() -> FlatBufferVariableMeta
@@ -259,7 +260,7 @@ struct ForecastapiResult<Model: ModelFlatbufferSerialisable>: ForecastapiRespond
             case .json:
                 return try toJsonResponse(fixedGenerationTime: fixedGenerationTime, concurrencySlot: concurrencySlot)
             case .xlsx:
-                return try await toXlsxResponse(timestamp: timestamp)
+                return try toXlsxResponse(timestamp: timestamp, concurrencySlot: concurrencySlot)
             case .csv:
                 return try toCsvResponse(concurrencySlot: concurrencySlot)
             case .flatbuffers:
@@ -394,6 +395,25 @@ struct BufferAndWriter {
     }
 }
 
+extension Float {
+    /// Format with a fixed number of decimals like `String(format: "%.2f")` without heap allocations. Returns the number of bytes written. Output is truncated if `buffer` is shorter than 64 bytes
+    @inlinable func formatFixed(decimals: Int, into buffer: UnsafeMutableRawBufferPointer) -> Int {
+        guard let base = buffer.baseAddress, buffer.count > 0 else {
+            return 0
+        }
+        return chelper_format_float(base.assumingMemoryBound(to: CChar.self), buffer.count, self, Int32(decimals))
+    }
+}
+
+extension ByteBuffer {
+    /// Write a float with a fixed number of decimals. Shared by CSV, JSON and XLSX writers
+    @inlinable mutating func writeFloat(_ value: Float, decimals: Int) {
+        writeWithUnsafeMutableBytes(minimumWritableBytes: 64) { ptr in
+            value.formatFixed(decimals: decimals, into: ptr)
+        }
+    }
+}
+
 extension Timestamp {
     func formated(format: Timeformat, utc_offset_seconds: Int, quotedString: Bool) -> String {
         switch format {
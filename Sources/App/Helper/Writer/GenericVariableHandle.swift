@@ -42,7 +42,9 @@ struct GenericVariableHandle: Sendable {
     /// Process concurrently
     static func convert(logger: Logger, domain: GenericDomain, createNetcdf: Bool, run: Timestamp?, handles: [Self], concurrent: Int, writeUpdateJson: Bool, uploadS3Bucket: String?, uploadS3OnlyProbabilities: Bool, compression: OmCompressionType = .pfor_delta2d_int16, generateFullRun: Bool = true) async throws {
         let startTime = DispatchTime.now()
-        try await convertConcurrent(logger: logger, domain: domain, createNetcdf: createNetcdf, run: run, handles: handles, onlyGeneratePreviousDays: false, concurrent: concurrent, compression: compression)
+        /// Upload time-series files while converting. Ensemble domains only upload probabilities in `syncToS3`
+        let uploadChunksS3Bucket = uploadS3OnlyProbabilities ? nil : uploadS3Bucket
+        try await convertConcurrent(logger: logger, domain: domain, createNetcdf: createNetcdf, run: run, handles: handles, onlyGeneratePreviousDays: false, concurrent: concurrent, compression: compression, uploadS3Bucket: uploadChunksS3Bucket)
         logger.info("Convert completed in \(startTime.timeElapsedPretty())")
 
         /// Write new model meta data, but only of it contains temperature_2m, precipitation, 10m wind or pressure. Ignores e.g. upper level runs
@@ -77,7 +79,7 @@ struct GenericVariableHandle: Sendable {
         }
 
         if let uploadS3Bucket = uploadS3Bucket {
-            try domain.domainRegistry.syncToS3(
+            try await domain.domainRegistry.syncToS3(
                 logger: logger,
                 bucket: uploadS3Bucket,
                 variables: uploadS3OnlyProbabilities ? [ProbabilityVariable.precipitation_probability] : nil
@@ -88,12 +90,12 @@ struct GenericVariableHandle: Sendable {
             // if run is nil, do not attempt to generate previous days files
             logger.info("Convert previous day database if required")
             let startTimePreviousDays = DispatchTime.now()
-            try await convertConcurrent(logger: logger, domain: domain, createNetcdf: createNetcdf, run: run, handles: handles, onlyGeneratePreviousDays: true, concurrent: concurrent, compression: compression)
+            try await convertConcurrent(logger: logger, domain: domain, createNetcdf: createNetcdf, run: run, handles: handles, onlyGeneratePreviousDays: true, concurrent: concurrent, compression: compression, uploadS3Bucket: uploadChunksS3Bucket)
             logger.info("Previous day convert in \(startTimePreviousDays.timeElapsedPretty())")
             
             /// Only upload to S3 if not ensemble domain. Ensemble domains set `uploadS3OnlyProbabilities`
             if !uploadS3OnlyProbabilities, let uploadS3Bucket {
-                try domain.domainRegistry.syncToS3(
+                try await domain.domainRegistry.syncToS3(
                     logger: logger,
                     bucket: uploadS3Bucket,
                     variables: nil
@@ -108,7 +110,7 @@ struct GenericVariableHandle: Sendable {
             logger.info("Full run convert in \(startTimeFullRun.timeElapsedPretty())")
             
             if let uploadS3Bucket {
-                try domain.domainRegistry.syncToS3PerRun(
+                try await domain.domainRegistry.syncToS3PerRun(
                     logger: logger,
                     bucket: uploadS3Bucket,
                     run:run
@@ -144,8 +146,7 @@ struct GenericVariableHandle: Sendable {
             let dimensions = nMembers > 1 ? [ny, nx, nMembers, nTime] : [ny, nx, nTime]
             let coordinatesString =  nMembers > 1 ? "lat lon member time" : "lat lon time"
             
-            let processChunkX = max(1, min(nx, 2 * 1024 * 1024 / nTime / nMembers / chunknLocations * chunknLocations))
-            let processChunkY = max(1, min(ny, 2 * 1024 * 1024 / nTime / nMembers / processChunkX))
+            let (processChunkY, processChunkX) = OmFileSplitter.processChunks(ny: ny, nx: nx, chunknLocations: chunknLocations, valuesPerLocation: nTime * nMembers)
             
             let writeFile = OmFileWriter(fn: fn, initialCapacity: 4 * 1024)
             let writer = try writeFile.prepareArray(
@@ -214,22 +215,23 @@ struct GenericVariableHandle: Sendable {
         try FullRunMetaJson.write(domain: domain, run: run, validTimes: validTimes)
     }
 
-    private static func convertConcurrent(logger: Logger, domain: GenericDomain, createNetcdf: Bool, run: Timestamp?, handles: [Self], onlyGeneratePreviousDays: Bool, concurrent: Int, compression: OmCompressionType) async throws {
+    private static func convertConcurrent(logger: Logger, domain: GenericDomain, createNetcdf: Bool, run: Timestamp?, handles: [Self], onlyGeneratePreviousDays: Bool, concurrent: Int, compression: OmCompressionType, uploadS3Bucket: String? = nil) async throws {
         if concurrent > 1 {
             try await handles
                 .filter({ onlyGeneratePreviousDays == false || $0.variable.storePreviousForecast })
                 .groupedPreservedOrder(by: { "\($0.variable.omFileName.file)" })
                 .evenlyChunked(in: concurrent)
                 .foreachConcurrent(nConcurrent: concurrent, body: {
-                    try await convertSerial3D(logger: logger, domain: domain, createNetcdf: createNetcdf, run: run, handles: $0.flatMap { $0.values }, onlyGeneratePreviousDays: onlyGeneratePreviousDays, compression: compression)
+                    try await convertSerial3D(logger: logger, domain: domain, createNetcdf: createNetcdf, run: run, handles: $0.flatMap { $0.values }, onlyGeneratePreviousDays: onlyGeneratePreviousDays, compression: compression, uploadS3Bucket: uploadS3Bucket)
             })
         } else {
-            try await convertSerial3D(logger: logger, domain: domain, createNetcdf: createNetcdf, run: run, handles: handles, onlyGeneratePreviousDays: onlyGeneratePreviousDays, compression: compression)
+            try await convertSerial3D(logger: logger, domain: domain, createNetcdf: createNetcdf, run: run, handles: handles, onlyGeneratePreviousDays: onlyGeneratePreviousDays, compression: compression, uploadS3Bucket: uploadS3Bucket)
         }
     }
 
     /// Process each variable and update time-series optimised files
-    private static func convertSerial3D(logger: Logger, domain: GenericDomain, createNetcdf: Bool, run: Timestamp?, handles: [Self], onlyGeneratePreviousDays: Bool, compression: OmCompressionType) async throws {
+    /// If `uploadS3Bucket` is set, completed files are enqueued for upload while the next variable is converted
+    private static func convertSerial3D(logger: Logger, domain: GenericDomain, createNetcdf: Bool, run: Timestamp?, handles: [Self], onlyGeneratePreviousDays: Bool, compression: OmCompressionType, uploadS3Bucket: String?) async throws {
         let grid = domain.grid
         let nx = grid.nx
         let ny = grid.ny
@@ -293,20 +295,14 @@ struct GenericVariableHandle: Sendable {
                 try ncVariable.setAttribute("add_offset", Float(0))
                 try ncVariable.setAttribute("_FillValue", Int16.max)
                 for reader in handles {
-                    let data = try await reader.reader.read()
-                    let nt = reader.time.count
                     let timeArrayIndex = time.index(of: reader.time.range.lowerBound)!
-                    if nt > 1 {
-                        let fastSpace = Array2DFastTime(data: data, nLocations: grid.count, nTime: nt).transpose().data
-                        try ncVariable.write(
-                            fastSpace.map { $0.isFinite ? Int16($0 * variable.scalefactor) : Int16.max },
-                            offset: [timeArrayIndex, reader.member, 0, 0],
-                            count: [nt, 1, grid.ny, grid.nx]
-                        )
-                    } else {
+                    // Read one time step at a time to avoid a full grid transpose
+                    for t in 0..<reader.time.count {
+                        let yx: [Range<UInt64>] = [0..<UInt64(ny), 0..<UInt64(nx)]
+                        let data = try await reader.reader.read(range: reader.reader.getDimensions().count == 3 ? yx + [UInt64(t)..<UInt64(t + 1)] : yx)
                         try ncVariable.write(
                             data.map { $0.isFinite ? Int16($0 * variable.scalefactor) : Int16.max },
-                            offset: [timeArrayIndex, reader.member, 0, 0],
+                            offset: [timeArrayIndex + t, reader.member, 0, 0],
                             count: [1, 1, grid.ny, grid.nx]
                         )
                     }
@@ -315,10 +311,14 @@ struct GenericVariableHandle: Sendable {
 
             let progress = TransferAmountTracker(logger: logger, totalSize: nx * ny * time.count * nMembers * MemoryLayout<Float>.size, name: "Convert \(variable.rawValue)\(nMembersStr) \(time.prettyString())")
 
-            try await om.updateFromTimeOrientedStreaming3D(variable: variable.omFileName.file, time: time, scalefactor: variable.scalefactor, compression: compression, onlyGeneratePreviousDays: onlyGeneratePreviousDays) { yRange, xRange, memberRange in
+            /// Tiles are read directly from spatial files. The read buffer is reused for all tiles
+            var readTemp = [Float]()
+            let files = try await om.updateFromTimeOrientedStreaming3D(variable: variable.omFileName.file, time: time, scalefactor: variable.scalefactor, compression: compression, onlyGeneratePreviousDays: onlyGeneratePreviousDays) { yRange, xRange, memberRange in
                 let nLoc = yRange.count * xRange.count
                 var data3d = Array3DFastTime(nLocations: nLoc, nLevel: memberRange.count, nTime: time.count)
-                var readTemp = [Float](repeating: .nan, count: nLoc * maxTimeStepsPerFile)
+                if readTemp.count < nLoc * maxTimeStepsPerFile {
+                    readTemp = [Float](repeating: .nan, count: nLoc * maxTimeStepsPerFile)
+                }
                 for reader in handles {
                     let dimensions = reader.reader.getDimensions()
                     let timeArrayIndex = time.index(of: reader.time.range.lowerBound)!
@@ -351,6 +351,9 @@ struct GenericVariableHandle: Sendable {
                 return ArraySlice(data3d.data)
             }
             progress.finish()
+            if let uploadS3Bucket {
+                try await domain.domainRegistry.enqueueUploadToS3(bucket: uploadS3Bucket, files: files)
+            }
         }
     }
 }
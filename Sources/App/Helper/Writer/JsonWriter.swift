@@ -3,7 +3,8 @@ import Vapor
 
 extension BodyStreamWriter {
     /// Execute async code and capture any errors. In case of error, print the error to the output stream
-    func submit(concurrencySlot: Int?, _ task: @Sendable @escaping () async throws -> Void) {
+    /// `isSampled` should be captured while the response is created, because the stream is executed outside of the request task
+    func submit(concurrencySlot: Int?, isSampled: Bool, _ task: @Sendable @escaping () async throws -> Void) {
         _ = eventLoop.makeFutureWithTask {
             if let concurrencySlot {
                 try await apiConcurrencyLimiter.wait(slot: concurrencySlot, maxConcurrent: .max, maxConcurrentHard: .max)
@@ -13,7 +14,14 @@ extension BodyStreamWriter {
                     apiConcurrencyLimiter.release(slot: concurrencySlot)
                 }
             }
-            try await task()
+            try await RequestMetrics.$isSampled.withValue(isSampled) {
+                /// Data is read lazily while streaming. Buffers of all reads are pooled until the response is complete
+                let pool = FloatBufferPool()
+                defer { pool.recordMetrics() }
+                try await FloatBufferPool.$current.withValue(pool) {
+                    try await RequestMetrics.measureAsync(.stream, task)
+                }
+            }
         }
             .flatMapError({ error in
                 return write(.buffer(.init(string: "Unexpected error while streaming data: \(error)")))
@@ -34,8 +42,11 @@ extension ForecastapiResult {
     func toJsonResponse(fixedGenerationTime: Double?, concurrencySlot: Int?) throws -> Response {
         // First excution outside stream, to capture potential errors better
         // var first = try self.first?()
+        let isSampled = RequestMetrics.isSampled
+        let encoding = ResponseCompression.encoding
         let response = Response(body: .init(stream: { writer in
-            writer.submit(concurrencySlot: concurrencySlot) {
+            let writer = writer.compressed(encoding)
+            writer.submit(concurrencySlot: concurrencySlot, isSampled: isSampled) {
                 var b = BufferAndWriter(writer: writer)
                 /// For multiple locations, create an array of results
                 let isMultiPoint = results.count > 1
@@ -59,6 +70,7 @@ extension ForecastapiResult {
                 try await b.end()
             }
         }))
+        response.setContentEncoding(encoding)
         response.headers.replaceOrAdd(name: .contentType, value: "application/json; charset=utf-8")
         return response
     }
@@ -73,6 +85,8 @@ extension ForecastapiResult.PerLocation {
         let sections = try await runAllSections()
         let current = try await first.current?()
         let generationTimeMs = fixedGenerationTime ?? (Date().timeIntervalSince(generationTimeStart) * 1000)
+        let serialisationStart = RequestMetrics.start()
+        defer { RequestMetrics.record(.serialisation, since: serialisationStart) }
 
         b.buffer.writeString("""
         {"latitude":\(first.latitude),"longitude":\(first.longitude),"generationtime_ms":\(generationTimeMs),"utc_offset_seconds":\(utc_offset_seconds),"timezone":"\(timezone.identifier)","timezone_abbreviation":"\(timezone.abbreviation)"
@@ -105,9 +119,13 @@ extension ForecastapiResult.PerLocation {
             b.buffer.writeString(",\"interval\":\(current.dtSeconds)")
             /// Write data
             for e in current.columns {
-                let format = "%.\(e.unit.significantDigits)f"
                 b.buffer.writeString(",")
-                b.buffer.writeString("\"\(e.variable.rawValue)\":\(e.value.isFinite ? String(format: format, e.value) : "null")")
+                b.buffer.writeString("\"\(e.variable.rawValue)\":")
+                if e.value.isFinite {
+                    b.buffer.writeFloat(e.value, decimals: e.unit.significantDigits)
+                } else {
+                    b.buffer.writeString("null")
+                }
             }
             b.buffer.writeString("}")
             try await b.flushIfRequired()
@@ -153,7 +171,6 @@ extension ForecastapiResult.PerLocation {
                 var firstValue = true
                 switch e.data {
                 case .float(let floats):
-                    let format = "%.\(e.unit.significantDigits)f"
                     for v in floats {
                         if firstValue {
                             firstValue = false
@@ -161,7 +178,7 @@ extension ForecastapiResult.PerLocation {
                             b.buffer.writeString(",")
                         }
                         if v.isFinite {
-                            b.buffer.writeString(String(format: format, v))
+                            b.buffer.writeFloat(v, decimals: e.unit.significantDigits)
                         } else {
                             b.buffer.writeString("null")
                         }
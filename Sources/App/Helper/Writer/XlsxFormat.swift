@@ -4,9 +4,21 @@ import NIOCore
 
 /// Create a simple excel sheet with exactly one sheet and the bare minimum to make it work in office applications
 /// Please note that XLSX only support up to 16k columns
+///
+/// Small sheets are kept in memory and written as one ZIP file with `write(timestamp:)`.
+/// With `flushIfRequired(into:timestamp:)` large sheets are streamed as soon as the compressed sheet exceeds `streamingThreshold`. Sizes and CRC of the sheet then follow the data in a data descriptor.
 public final class XlsxWriter {
     let sheet_xml: GzipStream
 
+    /// Compressed size after which the sheet is streamed instead of buffered
+    static var streamingThreshold: Int { 256 * 1024 }
+
+    /// Compressed size that is accumulated before each write once streaming started
+    static var streamingChunk: Int { 64 * 1024 }
+
+    /// ZIP state once the sheet is streamed
+    private var zip: ZipStreamWriter? = nil
+
     static var workbook_xml: ByteBuffer {
         let workbook_xml = try! GzipStream(level: 6, chunkCapacity: 512)
         workbook_xml.write("""
@@ -84,7 +96,9 @@ public final class XlsxWriter {
         if float.isInfinite || float.isNaN {
             sheet_xml.write("<c t=\"e\"><v>#NUM!</v></c>")
         } else {
-            sheet_xml.write("<c><v>\(String(format: "%.\(significantDigits)f", float))</v></c>")
+            sheet_xml.write("<c><v>")
+            sheet_xml.write(float, decimals: significantDigits)
+            sheet_xml.write("</v></c>")
         }
     }
 
@@ -105,6 +119,56 @@ public final class XlsxWriter {
             (path: "xl/worksheets/sheet1.xml", compressed: sheet_xml.finish())
         ], timestamp: timestamp)
     }
+
+    /// Start or continue streaming once enough compressed data is available. Call after each row
+    func flushIfRequired(into b: inout BufferAndWriter, timestamp: Timestamp) async throws {
+        guard sheet_xml.writebuffer.writerIndex > (zip == nil ? Self.streamingThreshold : Self.streamingChunk) else {
+            return
+        }
+        var data = sheet_xml.drain()
+        if zip == nil {
+            var zip = ZipStreamWriter(timestamp: timestamp)
+            for (path, compressed) in Self.staticFiles {
+                zip.write(path: path, compressed: compressed, into: &b.buffer)
+            }
+            zip.startStream(path: "xl/worksheets/sheet1.xml", into: &b.buffer)
+            // Skip gzip header
+            data.moveReaderIndex(forwardBy: 10)
+            self.zip = zip
+        }
+        zip?.writeStream(&data, into: &b.buffer)
+        try await b.flush()
+    }
+
+    /// Finish the sheet and write all remaining data. Small sheets are written as one ZIP file
+    func finish(into b: inout BufferAndWriter, timestamp: Timestamp) async throws {
+        guard var zip else {
+            var data = write(timestamp: timestamp)
+            b.buffer.writeBuffer(&data)
+            try await b.flush()
+            return
+        }
+        sheet_xml.write("</sheetData></worksheet>")
+        let data = sheet_xml.finish()
+        // Gzip trailer contains CRC and uncompressed size
+        let crc: UInt32 = data.getInteger(at: data.writerIndex - 8, endianness: .little)!
+        let size: UInt32 = data.getInteger(at: data.writerIndex - 4, endianness: .little)!
+        var payload = data.getSlice(at: data.readerIndex, length: data.readableBytes - 8)!
+        zip.writeStream(&payload, into: &b.buffer)
+        zip.endStream(crc: crc, uncompressedSize: size, into: &b.buffer)
+        zip.finish(into: &b.buffer)
+        try await b.flush()
+    }
+
+    static var staticFiles: [(path: String, compressed: ByteBuffer)] {
+        return [
+            (path: "[Content_Types].xml", compressed: Self.content_type),
+            (path: "xl/workbook.xml", compressed: Self.workbook_xml),
+            (path: "xl/_rels/workbook.xml.rels", compressed: Self.workbook_xml_rels),
+            (path: "_rels/.rels", compressed: Self.rels),
+            (path: "xl/styles.xml", compressed: Self.styles_xml)
+        ]
+    }
 }
 
 enum ZipStreamError: Error {
@@ -118,6 +182,7 @@ enum ZipStreamError: Error {
 public final class GzipStream {
     var zstream: UnsafeMutablePointer<z_stream>
     var writebuffer: ByteBuffer
+    let chunkCapacity: Int
 
     public init(level: Int32 = 6, chunkCapacity: Int = 4096) throws {
         zstream = UnsafeMutablePointer<z_stream>.allocate(capacity: 1)
@@ -136,6 +201,7 @@ public final class GzipStream {
         guard ret == Z_OK else {
             throw ZipStreamError.deflateInitFailed(code: ret)
         }
+        self.chunkCapacity = chunkCapacity
         self.writebuffer = ByteBufferAllocator().buffer(capacity: chunkCapacity)
         writebuffer.withUnsafeMutableWritableBytes { ptr in
             zstream.pointee.avail_out = UInt32(ptr.count)
@@ -144,6 +210,25 @@ public final class GzipStream {
         }
     }
 
+    /// Write a float with a fixed number of decimals without allocating a string
+    public func write(_ float: Float, decimals: Int) {
+        withUnsafeTemporaryAllocation(byteCount: 64, alignment: 1) { ptr in
+            let count = float.formatFixed(decimals: decimals, into: ptr)
+            compress(data: UnsafeRawBufferPointer(rebasing: ptr[0..<count]), flush: Z_NO_FLUSH)
+        }
+    }
+
+    /// Return all compressed data so far and continue in a new buffer. The first buffer starts with the gzip header
+    public func drain() -> ByteBuffer {
+        let data = writebuffer
+        writebuffer = ByteBufferAllocator().buffer(capacity: chunkCapacity)
+        writebuffer.withUnsafeMutableWritableBytes { ptr in
+            zstream.pointee.avail_out = UInt32(ptr.count)
+            zstream.pointee.next_out = ptr.baseAddress?.assumingMemoryBound(to: Bytef.self)
+        }
+        return data
+    }
+
     public func write(_ str: String) {
         str.withContiguousStorageIfAvailable { body in
             compress(data: UnsafeRawBufferPointer(body), flush: Z_NO_FLUSH)
@@ -215,70 +300,147 @@ public enum ZipWriter {
             $0 + $1.path.count * 2 + $1.compressed.writerIndex - 18 + 30 + 46
         })
         var out = ByteBufferAllocator().buffer(capacity: totalSize)
+        var zip = ZipStreamWriter(timestamp: timestamp)
+        for (path, compressed) in files {
+            zip.write(path: path, compressed: compressed, into: &out)
+        }
+        zip.finish(into: &out)
+        precondition(totalSize == out.writerIndex)
+        return out
+    }
+}
+
+/**
+ Write a ZIP file incrementally into output buffers. Files are either complete gzip buffers or streamed.
+ Streamed files set bit 3 in the local file header and are followed by a data descriptor with CRC and sizes.
+ The central directory is written by `finish`. ZIP64 is not supported.
+ */
+struct ZipStreamWriter {
+    struct Entry {
+        let path: String
+        let bitflag: UInt16
+        let compressionMethod: UInt16
+        var crc: UInt32
+        var compressedSize: Int
+        var uncompressedSize: UInt32
+        let localHeaderOffset: Int
+    }
+
+    let modificationDate: UInt16
+    let modificationTime: UInt16
 
+    /// Total number of bytes written
+    private(set) var offset = 0
+    private var entries = [Entry]()
+
+    init(timestamp: Timestamp) {
         let date = timestamp.toComponents()
-        let modificationDate = UInt16(date.day) | ((UInt16(date.month) << 5)) | ((UInt16(date.year - 1980) << 9))
-        let modificationTime = UInt16(timestamp.second) | ((UInt16(timestamp.minute) << 5)) | ((UInt16(timestamp.hour) << 11))
+        modificationDate = UInt16(date.day) | ((UInt16(date.month) << 5)) | ((UInt16(date.year - 1980) << 9))
+        modificationTime = UInt16(timestamp.second) | ((UInt16(timestamp.minute) << 5)) | ((UInt16(timestamp.hour) << 11))
+    }
 
-        // print local file header and compressed data
-        var localHeaderOffsets = [Int]()
-        localHeaderOffsets.reserveCapacity(files.count)
+    /// Write a complete file. `compressed` must be gzip compressed with correct gzip headers
+    mutating func write(path: String, compressed: ByteBuffer, into out: inout ByteBuffer) {
+        let entry = Entry(
+            path: path,
+            bitflag: 0,
+            compressionMethod: UInt16((compressed.getInteger(at: 2) as UInt8?)!),
+            crc: (compressed.getInteger(at: compressed.writerIndex - 8, endianness: .little) as UInt32?)!,
+            compressedSize: compressed.writerIndex - 10 - 8,
+            uncompressedSize: (compressed.getInteger(at: compressed.writerIndex - 4, endianness: .little) as UInt32?)!,
+            localHeaderOffset: offset
+        )
+        let start = out.writerIndex
+        writeLocalHeader(entry, into: &out)
+        var payload = compressed.getSlice(at: 10, length: compressed.writerIndex - 8 - 10)!
+        out.writeBuffer(&payload) // compressed payload without header
+        offset += out.writerIndex - start
+        entries.append(entry)
+    }
 
-        for (path, compressed) in files {
-            localHeaderOffsets.append(out.writerIndex)
-            out.writeInteger(UInt32(0x04034b50), endianness: .little) // local fileheader signature
-            out.writeInteger(UInt16(0x0014), endianness: .little) // version
-            out.writeInteger(UInt16(0x0000), endianness: .little) // bitflag
-            out.writeData([(compressed.getInteger(at: 2) as UInt8?)!, 0]) // compression method, lzma
-            out.writeInteger(modificationTime, endianness: .little)
-            out.writeInteger(modificationDate, endianness: .little)
-            out.writeInteger((compressed.getInteger(at: compressed.writerIndex - 8) as UInt32?)!) // crc
-            out.writeInteger(UInt32(compressed.writerIndex - 10 - 8), endianness: .little) // compressed size
-            out.writeInteger((compressed.getInteger(at: compressed.writerIndex - 4) as UInt32?)!) // uncompressed size
-            out.writeInteger(UInt16(path.count), endianness: .little) // filename length
-            out.writeInteger(UInt16(0x0000), endianness: .little) // extra field length
-            out.writeString(path) // filename
-            var payload = compressed.getSlice(at: 10, length: compressed.writerIndex - 8 - 10)!
-            out.writeBuffer(&payload) // compressed payload without header
-        }
+    /// Start a deflate compressed file with unknown size
+    mutating func startStream(path: String, into out: inout ByteBuffer) {
+        let entry = Entry(path: path, bitflag: 0x0008, compressionMethod: 8, crc: 0, compressedSize: 0, uncompressedSize: 0, localHeaderOffset: offset)
+        let start = out.writerIndex
+        writeLocalHeader(entry, into: &out)
+        offset += out.writerIndex - start
+        entries.append(entry)
+    }
 
-        let centralDirOffset = out.writerIndex
+    /// Append raw deflate data to the current streamed file
+    mutating func writeStream(_ data: inout ByteBuffer, into out: inout ByteBuffer) {
+        let count = data.readableBytes
+        out.writeBuffer(&data)
+        offset += count
+        entries[entries.count - 1].compressedSize += count
+    }
+
+    /// Write the data descriptor of the current streamed file
+    mutating func endStream(crc: UInt32, uncompressedSize: UInt32, into out: inout ByteBuffer) {
+        entries[entries.count - 1].crc = crc
+        entries[entries.count - 1].uncompressedSize = uncompressedSize
+        let start = out.writerIndex
+        out.writeInteger(UInt32(0x08074b50), endianness: .little) // data descriptor signature
+        out.writeInteger(crc, endianness: .little)
+        out.writeInteger(UInt32(entries[entries.count - 1].compressedSize), endianness: .little)
+        out.writeInteger(uncompressedSize, endianness: .little)
+        offset += out.writerIndex - start
+    }
+
+    private func writeLocalHeader(_ entry: Entry, into out: inout ByteBuffer) {
+        let streamed = entry.bitflag & 0x0008 != 0
+        out.writeInteger(UInt32(0x04034b50), endianness: .little) // local fileheader signature
+        out.writeInteger(UInt16(0x0014), endianness: .little) // version
+        out.writeInteger(entry.bitflag, endianness: .little) // bitflag
+        out.writeInteger(entry.compressionMethod, endianness: .little) // compression method, deflate
+        out.writeInteger(modificationTime, endianness: .little)
+        out.writeInteger(modificationDate, endianness: .little)
+        out.writeInteger(streamed ? 0 : entry.crc, endianness: .little) // crc
+        out.writeInteger(streamed ? 0 : UInt32(entry.compressedSize), endianness: .little) // compressed size
+        out.writeInteger(streamed ? 0 : entry.uncompressedSize, endianness: .little) // uncompressed size
+        out.writeInteger(UInt16(entry.path.count), endianness: .little) // filename length
+        out.writeInteger(UInt16(0x0000), endianness: .little) // extra field length
+        out.writeString(entry.path) // filename
+    }
+
+    /// Write central directory and end of central directory record
+    mutating func finish(into out: inout ByteBuffer) {
+        let start = out.writerIndex
+        let centralDirOffset = offset
 
         // print central directory header
-        for (i, (path, compressed)) in files.enumerated() {
+        for entry in entries {
             out.writeInteger(UInt32(0x02014b50), endianness: .little) // signature
             out.writeInteger(UInt16(0x0000), endianness: .little) // version generated by
             out.writeInteger(UInt16(0x0014), endianness: .little) // version needed
-            out.writeInteger(UInt16(0x0000), endianness: .little) // bit flag
-            out.writeData([(compressed.getInteger(at: 2) as UInt8?)!, 0]) // compression method, lzma
+            out.writeInteger(entry.bitflag, endianness: .little) // bit flag
+            out.writeInteger(entry.compressionMethod, endianness: .little) // compression method, deflate
             out.writeInteger(modificationTime, endianness: .little)
             out.writeInteger(modificationDate, endianness: .little)
-            out.writeInteger((compressed.getInteger(at: compressed.writerIndex - 8) as UInt32?)!) // crc
-            out.writeInteger(UInt32(compressed.writerIndex - 10 - 8), endianness: .little) // compressed size
-            out.writeInteger((compressed.getInteger(at: compressed.writerIndex - 4) as UInt32?)!) // uncompressed size
-            out.writeInteger(UInt16(path.count), endianness: .little) // filename length
+            out.writeInteger(entry.crc, endianness: .little) // crc
+            out.writeInteger(UInt32(entry.compressedSize), endianness: .little) // compressed size
+            out.writeInteger(entry.uncompressedSize, endianness: .little) // uncompressed size
+            out.writeInteger(UInt16(entry.path.count), endianness: .little) // filename length
             out.writeInteger(UInt16(0x0000), endianness: .little) // extra field length
             out.writeInteger(UInt16(0x0000), endianness: .little) // comment length
             out.writeInteger(UInt16(0x0000), endianness: .little) // disk number start
             out.writeInteger(UInt16(0x0000), endianness: .little) // internal attributes
             out.writeInteger(UInt32(0x0000), endianness: .little) // external attributes
-            out.writeInteger(UInt32(localHeaderOffsets[i]), endianness: .little)
-            out.writeString(path) // filename
+            out.writeInteger(UInt32(entry.localHeaderOffset), endianness: .little)
+            out.writeString(entry.path) // filename
         }
 
-        let centralDirSize = out.writerIndex - centralDirOffset
+        let centralDirSize = out.writerIndex - start
 
         // end central directory
         out.writeInteger(UInt32(0x06054b50), endianness: .little) // sig
         out.writeInteger(UInt16(0x0000), endianness: .little) // number of disks
         out.writeInteger(UInt16(0x0000), endianness: .little) // number of disks start
-        out.writeInteger(UInt16(files.count), endianness: .little) // number disk entries
-        out.writeInteger(UInt16(files.count), endianness: .little) // number central directory entries
+        out.writeInteger(UInt16(entries.count), endianness: .little) // number disk entries
+        out.writeInteger(UInt16(entries.count), endianness: .little) // number central directory entries
         out.writeInteger(UInt32(centralDirSize), endianness: .little)
         out.writeInteger(UInt32(centralDirOffset), endianness: .little)
         out.writeInteger(UInt16(0x00), endianness: .little) // zip comment length
-
-        precondition(totalSize == out.writerIndex)
-        return out
+        offset += out.writerIndex - start
     }
 }
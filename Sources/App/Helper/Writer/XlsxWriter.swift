@@ -2,56 +2,63 @@ import Foundation
 import Vapor
 
 extension ForecastapiResult {
-    func toXlsxResponse(timestamp: Timestamp) async throws -> Response {
-        let multiLocation = results.count > 1
+    /// Streaming XLSX format. Small sheets are sent at once, large sheets are streamed while rows are generated. See `XlsxWriter`
+    func toXlsxResponse(timestamp: Timestamp, concurrencySlot: Int? = nil) throws -> Response {
+        let isSampled = RequestMetrics.isSampled
+        let response = Response(body: .init(stream: { writer in
+            writer.submit(concurrencySlot: concurrencySlot, isSampled: isSampled) {
+                var b = BufferAndWriter(writer: writer)
+                let multiLocation = results.count > 1
 
-        let sheet = try XlsxWriter()
-        sheet.startRow()
-        if multiLocation {
-            sheet.write("location_id")
-        }
-        sheet.write("latitude")
-        sheet.write("longitude")
-        sheet.write("elevation")
-        sheet.write("utc_offset_seconds")
-        sheet.write("timezone")
-        sheet.write("timezone_abbreviation")
-        sheet.endRow()
+                let sheet = try XlsxWriter()
+                sheet.startRow()
+                if multiLocation {
+                    sheet.write("location_id")
+                }
+                sheet.write("latitude")
+                sheet.write("longitude")
+                sheet.write("elevation")
+                sheet.write("utc_offset_seconds")
+                sheet.write("timezone")
+                sheet.write("timezone_abbreviation")
+                sheet.endRow()
 
-        for location in results {
-            sheet.startRow()
-            guard let first = location.results.first else {
-                continue
-            }
-            if multiLocation {
-                sheet.write(location.locationId)
+                for location in results {
+                    sheet.startRow()
+                    guard let first = location.results.first else {
+                        continue
+                    }
+                    if multiLocation {
+                        sheet.write(location.locationId)
+                    }
+                    sheet.write(first.latitude, significantDigits: 4)
+                    sheet.write(first.longitude, significantDigits: 4)
+                    sheet.write(first.elevation ?? .nan, significantDigits: 0)
+                    sheet.write(location.utc_offset_seconds)
+                    sheet.write(location.timezone.identifier)
+                    sheet.write(location.timezone.abbreviation)
+                    sheet.endRow()
+                    try await sheet.flushIfRequired(into: &b, timestamp: timestamp)
+                }
+                for location in results {
+                    try await location.current?().writeXlsx(into: sheet, b: &b, timestamp: timestamp, utc_offset_seconds: location.utc_offset_seconds, location_id: multiLocation ? location.locationId : nil)
+                }
+                for location in results {
+                    try await location.minutely15?().writeXlsx(into: sheet, b: &b, timestamp: timestamp, utc_offset_seconds: location.utc_offset_seconds, location_id: multiLocation ? location.locationId : nil)
+                }
+                for location in results {
+                    try await location.hourly?().writeXlsx(into: sheet, b: &b, timestamp: timestamp, utc_offset_seconds: location.utc_offset_seconds, location_id: multiLocation ? location.locationId : nil)
+                }
+                for location in results {
+                    try await location.sixHourly?().writeXlsx(into: sheet, b: &b, timestamp: timestamp, utc_offset_seconds: location.utc_offset_seconds, location_id: multiLocation ? location.locationId : nil)
+                }
+                for location in results {
+                    try await location.daily?().writeXlsx(into: sheet, b: &b, timestamp: timestamp, utc_offset_seconds: location.utc_offset_seconds, location_id: multiLocation ? location.locationId : nil)
+                }
+                try await sheet.finish(into: &b, timestamp: timestamp)
+                try await b.end()
             }
-            sheet.write(first.latitude, significantDigits: 4)
-            sheet.write(first.longitude, significantDigits: 4)
-            sheet.write(first.elevation ?? .nan, significantDigits: 0)
-            sheet.write(location.utc_offset_seconds)
-            sheet.write(location.timezone.identifier)
-            sheet.write(location.timezone.abbreviation)
-            sheet.endRow()
-        }
-        for location in results {
-            try await location.current?().writeXlsx(into: sheet, utc_offset_seconds: location.utc_offset_seconds, location_id: multiLocation ? location.locationId : nil)
-        }
-        for location in results {
-            try await location.minutely15?().writeXlsx(into: sheet, utc_offset_seconds: location.utc_offset_seconds, location_id: multiLocation ? location.locationId : nil)
-        }
-        for location in results {
-            try await location.hourly?().writeXlsx(into: sheet, utc_offset_seconds: location.utc_offset_seconds, location_id: multiLocation ? location.locationId : nil)
-        }
-        for location in results {
-            try await location.sixHourly?().writeXlsx(into: sheet, utc_offset_seconds: location.utc_offset_seconds, location_id: multiLocation ? location.locationId : nil)
-        }
-        for location in results {
-            try await location.daily?().writeXlsx(into: sheet, utc_offset_seconds: location.utc_offset_seconds, location_id: multiLocation ? location.locationId : nil)
-        }
-
-        let data = sheet.write(timestamp: timestamp)
-        let response = Response(body: .init(buffer: data))
+        }, count: -1))
         response.headers.replaceOrAdd(name: .contentType, value: "application/vnd.openxmlformats-officedocument.spreadsheetml.sheet")
         response.headers.replaceOrAdd(name: .contentDisposition, value: "attachment; filename=\"open-meteo-\(results.first?.results.first?.formatedCoordinatesFilename ?? "").xlsx\"")
         return response
@@ -59,7 +66,7 @@ extension ForecastapiResult {
 }
 
 extension ApiSectionString {
-    fileprivate func writeXlsx(into sheet: XlsxWriter, utc_offset_seconds: Int, location_id: Int?) throws {
+    fileprivate func writeXlsx(into sheet: XlsxWriter, b: inout BufferAndWriter, timestamp: Timestamp, utc_offset_seconds: Int, location_id: Int?) async throws {
         if location_id == nil || location_id == 0 {
             sheet.startRow()
             sheet.endRow()
@@ -89,12 +96,13 @@ extension ApiSectionString {
                 }
             }
             sheet.endRow()
+            try await sheet.flushIfRequired(into: &b, timestamp: timestamp)
         }
     }
 }
 
 extension ApiSectionSingle {
-    fileprivate func writeXlsx(into sheet: XlsxWriter, utc_offset_seconds: Int, location_id: Int?) throws {
+    fileprivate func writeXlsx(into sheet: XlsxWriter, b: inout BufferAndWriter, timestamp: Timestamp, utc_offset_seconds: Int, location_id: Int?) async throws {
         if location_id == nil || location_id == 0 {
             sheet.startRow()
             sheet.endRow()
@@ -118,5 +126,6 @@ extension ApiSectionSingle {
             sheet.write(e.value, significantDigits: e.unit.significantDigits)
         }
         sheet.endRow()
+        try await sheet.flushIfRequired(into: &b, timestamp: timestamp)
     }
 }
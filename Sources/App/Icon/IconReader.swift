@@ -415,53 +415,25 @@ struct IconReader: GenericReaderDerived, GenericReaderProtocol {
         case .surface(let variable):
             switch variable {
             case .wind_speed_10m, .windspeed_10m:
-                let u = try await get(raw: .wind_u_component_10m, time: time).data
-                let v = try await get(raw: .wind_v_component_10m, time: time).data
-                let speed = zip(u, v).map(Meteorology.windspeed)
-                return DataAndUnit(speed, .metrePerSecond)
+                return try await get(kernel: .windSpeed(u: .surface(.wind_u_component_10m), v: .surface(.wind_v_component_10m)), time: time)
             case .wind_direction_10m, .winddirection_10m:
-                let u = try await get(raw: .wind_u_component_10m, time: time).data
-                let v = try await get(raw: .wind_v_component_10m, time: time).data
-                let direction = Meteorology.windirectionFast(u: u, v: v)
-                return DataAndUnit(direction, .degreeDirection)
+                return try await get(kernel: .windDirection(u: .surface(.wind_u_component_10m), v: .surface(.wind_v_component_10m)), time: time)
             case .wind_speed_80m, .windspeed_80m:
-                let u = try await get(raw: .wind_u_component_80m, time: time).data
-                let v = try await get(raw: .wind_v_component_80m, time: time).data
-                let speed = zip(u, v).map(Meteorology.windspeed)
-                return DataAndUnit(speed, .metrePerSecond)
+                return try await get(kernel: .windSpeed(u: .surface(.wind_u_component_80m), v: .surface(.wind_v_component_80m)), time: time)
             case .wind_direction_80m, .winddirection_80m:
-                let u = try await get(raw: .wind_u_component_80m, time: time).data
-                let v = try await get(raw: .wind_v_component_80m, time: time).data
-                let direction = Meteorology.windirectionFast(u: u, v: v)
-                return DataAndUnit(direction, .degreeDirection)
+                return try await get(kernel: .windDirection(u: .surface(.wind_u_component_80m), v: .surface(.wind_v_component_80m)), time: time)
             case .wind_speed_120m, .windspeed_120m:
-                let u = try await get(raw: .wind_u_component_120m, time: time).data
-                let v = try await get(raw: .wind_v_component_120m, time: time).data
-                let speed = zip(u, v).map(Meteorology.windspeed)
-                return DataAndUnit(speed, .metrePerSecond)
+                return try await get(kernel: .windSpeed(u: .surface(.wind_u_component_120m), v: .surface(.wind_v_component_120m)), time: time)
             case .wind_direction_120m, .winddirection_120m:
-                let u = try await get(raw: .wind_u_component_120m, time: time).data
-                let v = try await get(raw: .wind_v_component_120m, time: time).data
-                let direction = Meteorology.windirectionFast(u: u, v: v)
-                return DataAndUnit(direction, .degreeDirection)
+                return try await get(kernel: .windDirection(u: .surface(.wind_u_component_120m), v: .surface(.wind_v_component_120m)), time: time)
             case .wind_speed_180m, .windspeed_180m:
-                let u = try await get(raw: .wind_u_component_180m, time: time).data
-                let v = try await get(raw: .wind_v_component_180m, time: time).data
-                let speed = zip(u, v).map(Meteorology.windspeed)
-                return DataAndUnit(speed, .metrePerSecond)
+                return try await get(kernel: .windSpeed(u: .surface(.wind_u_component_180m), v: .surface(.wind_v_component_180m)), time: time)
             case .wind_direction_180m, .winddirection_180m:
-                let u = try await get(raw: .wind_u_component_180m, time: time).data
-                let v = try await get(raw: .wind_v_component_180m, time: time).data
-                let direction = Meteorology.windirectionFast(u: u, v: v)
-                return DataAndUnit(direction, .degreeDirection)
+                return try await get(kernel: .windDirection(u: .surface(.wind_u_component_180m), v: .surface(.wind_v_component_180m)), time: time)
             case .snow_height:
                 return try await get(raw: .snow_depth, time: time)
             case .apparent_temperature:
-                let windspeed = try await get(derived: .surface(.windspeed_10m), time: time).data
-                let temperature = try await get(raw: .temperature_2m, time: time).data
-                let relhum = try await get(derived: .surface(.relativehumidity_2m), time: time).data
-                let radiation = try await get(derived: .surface(.shortwave_radiation), time: time).data
-                return DataAndUnit(Meteorology.apparentTemperature(temperature_2m: temperature, relativehumidity_2m: relhum, windspeed_10m: windspeed, shortwave_radiation: radiation), .celsius)
+                return try await get(kernel: .apparentTemperature(temperature: .surface(.temperature_2m), relativeHumidity: .surface(.relative_humidity_2m), windU: .surface(.wind_u_component_10m), windV: .surface(.wind_v_component_10m), shortwave: [.surface(.direct_radiation), .surface(.diffuse_radiation)]), time: time)
             case .shortwave_radiation:
                 let direct = try await get(raw: .direct_radiation, time: time).data
                 let diffuse = try await get(raw: .diffuse_radiation, time: time).data
@@ -472,26 +444,14 @@ struct IconReader: GenericReaderDerived, GenericReaderProtocol {
                 let evapotranspiration = latent.map(Meteorology.evapotranspiration)
                 return DataAndUnit(evapotranspiration, .millimetre)
             case .vapour_pressure_deficit, .vapor_pressure_deficit:
-                let temperature = try await get(raw: .temperature_2m, time: time).data
-                let rh = try await get(raw: .relative_humidity_2m, time: time).data
-                let dewpoint = zip(temperature, rh).map(Meteorology.dewpoint)
-                return DataAndUnit(zip(temperature, dewpoint).map(Meteorology.vaporPressureDeficit), .kilopascal)
+                return try await get(kernel: .vapourPressureDeficit(temperature: .surface(.temperature_2m), relativeHumidity: .surface(.relative_humidity_2m)), time: time)
             case .direct_normal_irradiance:
                 let dhi = try await get(raw: .direct_radiation, time: time).data
                 let dni = Zensun.calculateBackwardsDNI(directRadiation: dhi, latitude: reader.modelLat, longitude: reader.modelLon, timerange: time.time)
                 return DataAndUnit(dni, .wattPerSquareMetre)
             case .et0_fao_evapotranspiration:
                 let exrad = Zensun.extraTerrestrialRadiationBackwards(latitude: reader.modelLat, longitude: reader.modelLon, timerange: time.time)
-                let swrad = try await get(derived: .surface(.shortwave_radiation), time: time).data
-                let temperature = try await get(raw: .temperature_2m, time: time).data
-                let windspeed = try await get(derived: .surface(.windspeed_10m), time: time).data
-                let rh = try await get(raw: .relative_humidity_2m, time: time).data
-                let dewpoint = zip(temperature, rh).map(Meteorology.dewpoint)
-
-                let et0 = swrad.indices.map { i in
-                    return Meteorology.et0Evapotranspiration(temperature2mCelsius: temperature[i], windspeed10mMeterPerSecond: windspeed[i], dewpointCelsius: dewpoint[i], shortwaveRadiationWatts: swrad[i], elevation: reader.targetElevation, extraTerrestrialRadiation: exrad[i], dtSeconds: time.dtSeconds)
-                }
-                return DataAndUnit(et0, .millimetre)
+                return try await get(kernel: .et0Evapotranspiration(temperature: .surface(.temperature_2m), relativeHumidity: .surface(.relative_humidity_2m), windU: .surface(.wind_u_component_10m), windV: .surface(.wind_v_component_10m), shortwave: [.surface(.direct_radiation), .surface(.diffuse_radiation)], extraTerrestrialRadiation: exrad, elevation: reader.targetElevation, dtSeconds: time.dtSeconds), time: time)
             case .snowfall:
                 if reader.domain == .iconEps {
                     let precipitation = try await get(raw: .precipitation, time: time).data
@@ -508,9 +468,7 @@ struct IconReader: GenericReaderDerived, GenericReaderProtocol {
             case .relativehumidity_2m:
                 return try await get(raw: .relative_humidity_2m, time: time)
             case .dew_point_2m, .dewpoint_2m:
-                let temperature = try await get(raw: .temperature_2m, time: time)
-                let rh = try await get(raw: .relative_humidity_2m, time: time)
-                return DataAndUnit(zip(temperature.data, rh.data).map(Meteorology.dewpoint), temperature.unit)
+                return try await get(kernel: .dewpoint(temperature: .surface(.temperature_2m), relativeHumidity: .surface(.relative_humidity_2m)), time: time)
             case .surface_pressure:
                 let temperature = try await get(raw: .temperature_2m, time: time).data
                 let pressure = try await get(raw: .pressure_msl, time: time)
@@ -552,9 +510,7 @@ struct IconReader: GenericReaderDerived, GenericReaderProtocol {
             case .soil_moisture_27_81cm:
                 return try await get(raw: .soil_moisture_27_to_81cm, time: time)
             case .wet_bulb_temperature_2m:
-                let temperature = try await get(raw: .temperature_2m, time: time)
-                let rh = try await get(raw: .relative_humidity_2m, time: time).data
-                return DataAndUnit(zip(temperature.data, rh).map(Meteorology.wetBulbTemperature), temperature.unit)
+                return try await get(kernel: .wetBulbTemperature(temperature: .surface(.temperature_2m), relativeHumidity: .surface(.relative_humidity_2m)), time: time)
             case .cloudcover:
                 return try await get(raw: .cloud_cover, time: time)
             case .cloudcover_low:
@@ -174,11 +174,13 @@ struct MeteoSwissDownload: AsyncCommand {
     
     func calculateNNMapping(latitudes: [Float], longitudes: [Float], grid: Gridable) async -> [Int] {
         let count = grid.count
+        let coordinates = grid.getCoordinates(gridpoints: 0..<grid.count)
         return await (0..<grid.count).mapConcurrent(nConcurrent: System.coreCount) { gridIndex in
             if gridIndex % 1000 == 0 {
                 print("\(gridIndex)/\(count)")
             }
-            let (gridLat, gridLon) = grid.getCoordinates(gridpoint: gridIndex)
+            let gridLat = coordinates.latitude[gridIndex]
+            let gridLon = coordinates.longitude[gridIndex]
             return zip(latitudes, longitudes).enumerated().min(by: { a, b in
                 let d1 = pow(a.element.0 - gridLat, 2) + pow(a.element.1 - gridLon, 2)
                 let d2 = pow(b.element.0 - gridLat, 2) + pow(b.element.1 - gridLon, 2)
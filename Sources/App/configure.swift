@@ -28,13 +28,49 @@ enum OpenMeteo {
         return nil
     }()
     
+    /// Remote spatial data directory like `https://openmeteo.s3.amazonaws.com/data_spatial/`
+    static let remoteDataSpatialDirectory: String? = {
+        if let dir = Environment.get("REMOTE_DATA_SPATIAL_DIRECTORY") {
+            guard dir.starts(with: "http") else {
+                fatalError("REMOTE_DATA_SPATIAL_DIRECTORY must start with 'http'")
+            }
+            guard dir.last == "/" else {
+                fatalError("REMOTE_DATA_SPATIAL_DIRECTORY must end with a trailing slash")
+            }
+            return dir
+        }
+        return nil
+    }()
+    
     /// Cache remote data if `REMOTE_DATA_DIRECTORY` is set. Default 10GB stored in `cache.bin` inside the data directory.
+    /// `CACHE_FILE=memory` keeps the cache in memory without persistence.
+    /// `CACHE_HUGE_PAGES=transparent|explicit` backs the cache with huge pages and `CACHE_NUMA=interleave` spreads it across NUMA nodes
     static let dataBlockCache: AtomicCacheCoordinator<MmapFile> = { () -> AtomicCacheCoordinator<MmapFile> in
         let cacheFile = Environment.get("CACHE_FILE") ?? "\(dataDirectory)/cache.bin"
-        let cacheSize = try! ByteSizeParser.parseSizeStringToBytes(Environment.get("CACHE_SIZE") ?? "10GB")
-        let blockSize = try! ByteSizeParser.parseSizeStringToBytes(Environment.get("BLOCK_SIZE") ?? "64KB")
+        guard let cacheSize = try? ByteSizeParser.parseSizeStringToBytes(Environment.get("CACHE_SIZE") ?? "10GB") else {
+            fatalError("CACHE_SIZE must be a size like '10GB'")
+        }
+        guard let blockSize = try? ByteSizeParser.parseSizeStringToBytes(Environment.get("BLOCK_SIZE") ?? "64KB") else {
+            fatalError("BLOCK_SIZE must be a size like '64KB'")
+        }
         let blockCount = cacheSize / (blockSize + 2 * MemoryLayout<Int64>.size)
-        return AtomicCacheCoordinator(cache: try! AtomicBlockCache(file: cacheFile, blockSize: blockSize, blockCount: blockCount))
+        guard let hugePages = AtomicBlockCachePlacement.HugePages(rawValue: Environment.get("CACHE_HUGE_PAGES") ?? "none") else {
+            fatalError("CACHE_HUGE_PAGES must be 'none', 'transparent' or 'explicit'")
+        }
+        let placement = AtomicBlockCachePlacement(hugePages: hugePages, numaInterleave: Environment.get("CACHE_NUMA") == "interleave")
+        if cacheFile == "memory" {
+            do {
+                return AtomicCacheCoordinator(cache: try AtomicBlockCache(blockSize: blockSize, blockCount: blockCount, placement: placement))
+            } catch {
+                Logger(label: "AtomicBlockCache").warning("In memory block cache not available, using \(dataDirectory)/cache.bin: \(error)")
+            }
+        }
+        let file = cacheFile == "memory" ? "\(dataDirectory)/cache.bin" : cacheFile
+        do {
+            return AtomicCacheCoordinator(cache: try AtomicBlockCache(file: file, blockSize: blockSize, blockCount: blockCount, placement: placement))
+        } catch {
+            fatalError("Could not create block cache \(file): \(error)")
+        }
     }()
     
     /// Data directory with trailing slash
@@ -157,8 +193,15 @@ public func configure(_ app: Application) throws {
     app.middleware.use(CORSMiddleware(configuration: corsConfiguration))
     app.middleware.use(ErrorMiddleware.default(environment: try .detect()))
     app.middleware.use(FileMiddleware(publicDirectory: app.directory.publicDirectory))
+    if RequestMetrics.enabled {
+        app.middleware.use(RequestMetricsMiddleware())
+    }
+    if ResponseCompression.enabled {
+        app.middleware.use(ResponseCompressionMiddleware())
+    }
 
-    app.commands.use(BenchmarkCommand(), as: "benchmark")
+    app.asyncCommands.use(BenchmarkCommand(), as: "benchmark")
+    app.asyncCommands.use(BenchmarkReplayCommand(), as: "benchmark-replay")
     app.asyncCommands.use(MigrationCommand(), as: "migration")
     app.asyncCommands.use(DownloadIconCommand(), as: "download")
     app.asyncCommands.use(DownloadCmaCommand(), as: "download-cma")
@@ -187,18 +230,21 @@ public func configure(_ app: Application) throws {
     app.asyncCommands.use(GloFasDownloader(), as: "download-glofas")
     app.asyncCommands.use(GemDownload(), as: "download-gem")
     app.asyncCommands.use(DownloadCmipCommand(), as: "download-cmip6")
+    app.asyncCommands.use(Cmip6QuantileMappingCommand(), as: "generate-cmip6-cdf")
     app.asyncCommands.use(SatelliteDownloadCommand(), as: "download-satellite")
     app.asyncCommands.use(MeteoSwissDownload(), as: "download-meteoswiss")
     app.asyncCommands.use(SyncCommand(), as: "sync")
     app.asyncCommands.use(ExportCommand(), as: "export")
     app.asyncCommands.use(MergeYearlyCommand(), as: "merge-yearly")
     app.asyncCommands.use(ConvertOmCommand(), as: "convert-om")
+    app.asyncCommands.use(SyntheticDataCommand(), as: "generate-synthetic")
 
     app.http.server.configuration.hostname = "0.0.0.0"
 
     // https://github.com/vapor/vapor/pull/2677
     app.http.server.configuration.supportPipelining = false
 
+    // Streamed API responses are compressed off the event loop by `ResponseCompressionMiddleware` and opt out individually
     app.http.server.configuration.responseCompression = .enabled(initialByteBufferCapacity: 4096)
 
     // Higher backlog value to handle more connections
@@ -228,6 +274,8 @@ public func configure(_ app: Application) throws {
         RemoteOmFileManager.instance.backgroundTask
     )
 
+    app.lifecycle.use(S3UploadQueueLifecycle())
+
     app.lifecycle.repeatedTask(
         initialDelay: .seconds(Int64(60 - Timestamp.now().second)),
         delay: .seconds(60)
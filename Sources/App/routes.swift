@@ -6,6 +6,12 @@ func routes(_ app: Application) throws {
     try app.register(collection: ForecastapiController())
 
     try app.register(collection: S3DataController())
+
+    try app.register(collection: MapController())
+
+    if RequestMetrics.enabled {
+        try app.register(collection: MetricsController())
+    }
 }
 
 extension RoutesBuilder {
@@ -11,4 +11,41 @@ void display_mallinfo2(void);
 
 void chelper_malloc_trim(void);
 
+/// Subset of glibc `mallinfo2` statistics. All zero on platforms without `mallinfo2`
+struct chelper_malloc_stats {
+    size_t arena;
+    size_t hblkhd;
+    size_t uordblks;
+    size_t fordblks;
+    size_t keepcost;
+};
+
+void chelper_get_malloc_stats(struct chelper_malloc_stats* stats);
+
+/// Anonymous memory file of `size` bytes. With `huge_pages` it tries explicit huge pages first and sets `huge_pages_used`. Falls back to regular pages if huge pages cannot be mapped. Returns -1 and sets errno on error
+int chelper_memfd_create(const char* name, size_t size, int huge_pages, int* huge_pages_used);
+
+/// Enable transparent huge pages for a memory region. Returns 0 or an errno
+int chelper_madvise_hugepage(void* addr, size_t length);
+
+/// Interleave pages of a memory region across all online NUMA nodes. Returns 0 or an errno. Does nothing on single node systems
+int chelper_mbind_interleave(void* addr, size_t length);
+
+/// Prefetch a cache line for reading
+static inline void chelper_prefetch(const void* addr) {
+    __builtin_prefetch(addr, 0, 3);
+}
+
+/// Format a float like `printf("%.*f", decimals, value)` into `buffer`. Returns the number of bytes written without the terminating zero
+size_t chelper_format_float(char* buffer, size_t size, float value, int decimals);
+
+/// Sun geometry for one location over a time series with polynomial trigonometry. Declination in degrees, equation of time and universal time in hours.
+/// `zz_backwards` is the sine of the sun elevation averaged over the previous `dt_hours` and limited to sun rise/set at parallax `alpha` in degrees. `zz_instant` is the instant sine of the sun elevation.
+/// `daylight_fraction` is the fraction of the interval between sun rise and set. `xx_backwards` and `yy_backwards` are the averaged horizontal components of the sun direction.
+/// All outputs except `zz_backwards` may be NULL.
+void chelper_solar_backwards(const size_t n, const float* declination, const float* eqtime, const float* ut, const float dt_hours, const float latitude, const float longitude, const float alpha, float* zz_backwards, float* zz_instant, float* daylight_fraction, float* xx_backwards, float* yy_backwards);
+
+/// Cosine of the angle of incidence on a tilted plane from averaged sun geometry of `chelper_solar_backwards`. Tilt and azimuth in radians with azimuth 0 south. NaN tilt or azimuth tracks the sun on that axis
+void chelper_solar_incidence(const size_t n, const float* zz, const float* xx, const float* yy, const float tilt, const float azimuth, float* cos_incidence, float* cos_tilt);
+
 #endif // _CHELPER_
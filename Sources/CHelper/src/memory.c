@@ -0,0 +1,112 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include "shim.h"
+
+#if __APPLE__
+int chelper_memfd_create(const char* name, size_t size, int huge_pages, int* huge_pages_used) {
+    *huge_pages_used = 0;
+    errno = ENOSYS;
+    return -1;
+}
+
+int chelper_madvise_hugepage(void* addr, size_t length) {
+    return ENOSYS;
+}
+
+int chelper_mbind_interleave(void* addr, size_t length) {
+    return ENOSYS;
+}
+#else
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/// From `linux/mempolicy.h` which is not always installed
+#define CHELPER_MPOL_INTERLEAVE 3
+
+int chelper_memfd_create(const char* name, size_t size, int huge_pages, int* huge_pages_used) {
+    *huge_pages_used = 0;
+    int fd = -1;
+    if (huge_pages) {
+        fd = memfd_create(name, MFD_CLOEXEC | MFD_HUGETLB);
+        if (fd >= 0 && ftruncate(fd, (off_t)size) != 0) {
+            // Size must be a multiple of the huge page size
+            close(fd);
+            fd = -1;
+        }
+        if (fd >= 0) {
+            // Huge pages are reserved on mmap, not on ftruncate. Without enough reserved pages mmap fails with ENOMEM.
+            // The reservation belongs to the file and is kept for the mapping of the caller after munmap
+            void* addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            if (addr == MAP_FAILED) {
+                close(fd);
+                fd = -1;
+            } else {
+                munmap(addr, size);
+            }
+        }
+        *huge_pages_used = fd >= 0;
+    }
+    if (fd < 0) {
+        fd = memfd_create(name, MFD_CLOEXEC);
+        if (fd < 0) {
+            return -1;
+        }
+        if (ftruncate(fd, (off_t)size) != 0) {
+            int error = errno;
+            close(fd);
+            errno = error;
+            return -1;
+        }
+    }
+    return fd;
+}
+
+int chelper_madvise_hugepage(void* addr, size_t length) {
+    return madvise(addr, length, MADV_HUGEPAGE) == 0 ? 0 : errno;
+}
+
+/// Parse `/sys/devices/system/node/online` like `0-1` or `0,2-3` into a node mask. Returns the number of nodes
+static int chelper_online_nodes(unsigned long* mask) {
+    FILE* file = fopen("/sys/devices/system/node/online", "r");
+    if (!file) {
+        return 0;
+    }
+    char line[256];
+    int count = 0;
+    *mask = 0;
+    if (fgets(line, sizeof(line), file)) {
+        char* token = strtok(line, ",\n");
+        while (token) {
+            int first = 0, last = -1;
+            int n = sscanf(token, "%d-%d", &first, &last);
+            if (n == 1) {
+                last = first;
+            }
+            for (int node = first; n >= 1 && node <= last && node < 64; node++) {
+                *mask |= 1ul << node;
+                count++;
+            }
+            token = strtok(NULL, ",\n");
+        }
+    }
+    fclose(file);
+    return count;
+}
+
+int chelper_mbind_interleave(void* addr, size_t length) {
+    unsigned long mask;
+    int nodes = chelper_online_nodes(&mask);
+    if (nodes <= 1) {
+        // Nothing to interleave
+        return 0;
+    }
+    if (syscall(SYS_mbind, addr, length, CHELPER_MPOL_INTERLEAVE, &mask, sizeof(mask) * 8, 0) != 0) {
+        return errno;
+    }
+    return 0;
+}
+#endif
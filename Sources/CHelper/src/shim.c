@@ -53,6 +53,14 @@ void windirectionFast(const size_t num_points, const float* ys, const float* xs,
 #include <stdlib.h>
 #include <string.h>
 
+size_t chelper_format_float(char* buffer, size_t size, float value, int decimals) {
+    int length = snprintf(buffer, size, "%.*f", decimals, (double)value);
+    if (length < 0) {
+        return 0;
+    }
+    return (size_t)length < size ? (size_t)length : size - 1;
+}
+
 #if __APPLE__
 void display_mallinfo2(void) {
     printf("display_mallinfo2 not supported for macOS\n");
@@ -61,6 +69,10 @@ void display_mallinfo2(void) {
 void chelper_malloc_trim() {
     // not available for macos
 }
+
+void chelper_get_malloc_stats(struct chelper_malloc_stats* stats) {
+    memset(stats, 0, sizeof(struct chelper_malloc_stats));
+}
 #else
 
 #include <malloc.h>
@@ -69,6 +81,15 @@ void chelper_malloc_trim() {
     malloc_trim(0);
 }
 
+void chelper_get_malloc_stats(struct chelper_malloc_stats* stats) {
+    struct mallinfo2 mi = mallinfo2();
+    stats->arena = mi.arena;
+    stats->hblkhd = mi.hblkhd;
+    stats->uordblks = mi.uordblks;
+    stats->fordblks = mi.fordblks;
+    stats->keepcost = mi.keepcost;
+}
+
 void display_mallinfo2(void) {
    struct mallinfo2 mi;
 
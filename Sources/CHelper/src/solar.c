@@ -0,0 +1,145 @@
+#include <math.h>
+#include <string.h>
+#include "shim.h"
+
+/// Number of timesteps evaluated into stack buffers at once. Keeps the inner loop free of output pointer checks, so it can be vectorised
+#define CHELPER_SOLAR_BLOCK 256
+
+static const float pi_f = 3.14159265f;
+static const float pi_2_f = 1.57079633f;
+static const float deg_to_rad = 0.0174532925f;
+
+/// Reduce `x` to `[-pi, pi]` with a two constant Cody-Waite reduction. Adding and subtracting `1.5 * 2^23` rounds to nearest without `rintf`, which does not vectorise on all targets
+static inline float reduce_2pi(float x) {
+  float k = (x * 0.159154943f + 12582912.0f) - 12582912.0f;
+  float r = fmaf(k, -6.28318548f, x);
+  return fmaf(k, 1.74845553e-7f, r);
+}
+
+/// Taylor polynomial for sine in `[-pi/2, pi/2]`. Truncation error is below 6e-8
+static inline float sin_poly(float x) {
+  float x2 = x * x;
+  return x * fmaf(x2, fmaf(x2, fmaf(x2, fmaf(x2, fmaf(x2, -2.50521084e-8f, 2.75573192e-6f), -1.98412698e-4f), 8.33333333e-3f), -1.66666667e-1f), 1.0f);
+}
+
+/// Branch free sine. Absolute error is below 2e-7 for `|x| < 2^20`
+static inline float sin_fast(float x) {
+  float r = reduce_2pi(x);
+  r = r > pi_2_f ? pi_f - r : r;
+  r = r < -pi_2_f ? -pi_f - r : r;
+  return sin_poly(r);
+}
+
+/// Branch free cosine using `cos(x) = sin(pi/2 - |x|)`. Absolute error is below 2e-7 for `|x| < 2^20`
+static inline float cos_fast(float x) {
+  return sin_poly(pi_2_f - fabsf(reduce_2pi(x)));
+}
+
+/// Arc cosine in `[-1, 1]` based on Abramowitz and Stegun 4.4.46. Absolute error is below 2e-7 in single precision
+static inline float acos_fast(float x) {
+  float a = fabsf(x);
+  float p = fmaf(a, fmaf(a, fmaf(a, fmaf(a, fmaf(a, fmaf(a, fmaf(a, -0.0012624911f, 0.0066700901f), -0.0170881256f), 0.0308918810f), -0.0501743046f), 0.0889789874f), -0.2145988016f), 1.5707963050f);
+  float r = sqrtf(1.0f - a) * p;
+  return x < 0 ? pi_f - r : r;
+}
+
+void chelper_solar_backwards(const size_t n, const float* declination, const float* eqtime, const float* ut, const float dt_hours, const float latitude, const float longitude, const float alpha, float* zz_backwards, float* zz_instant, float* daylight_fraction, float* xx_backwards, float* yy_backwards) {
+  /// colatitude of point
+  const float t0 = (90 - latitude) * deg_to_rad;
+  const float st0 = sinf(t0);
+  const float ct0 = cosf(t0);
+  const float sin_alpha = sinf(alpha * deg_to_rad);
+  const float lon = longitude * deg_to_rad;
+
+  float zzb[CHELPER_SOLAR_BLOCK];
+  float zzi[CHELPER_SOLAR_BLOCK];
+  float frac[CHELPER_SOLAR_BLOCK];
+  float xxb[CHELPER_SOLAR_BLOCK];
+  float yyb[CHELPER_SOLAR_BLOCK];
+
+  for (size_t start = 0; start < n; start += CHELPER_SOLAR_BLOCK) {
+    const size_t len = n - start < CHELPER_SOLAR_BLOCK ? n - start : CHELPER_SOLAR_BLOCK;
+    const float* restrict dec = declination + start;
+    const float* restrict eqt = eqtime + start;
+    const float* restrict u = ut + start;
+
+    for (size_t j = 0; j < len; j++) {
+      const float t1 = (90 - dec[j]) * deg_to_rad;
+      const float st1 = sin_fast(t1);
+      const float ct1 = cos_fast(t1);
+
+      /// longitude of sun at the end and start of the interval
+      const float p1 = -15 * (u[j] - 12 + eqt[j]) * deg_to_rad;
+      const float p10 = -15 * (u[j] - dt_hours - 12 + eqt[j]) * deg_to_rad;
+
+      /// longitude of point
+      float p0 = lon;
+      p0 = p0 < p1 - pi_f ? p0 + 2 * pi_f : p0;
+      p0 = p0 > p1 + pi_f ? p0 - 2 * pi_f : p0;
+
+      const float sinsin = st0 * st1;
+      const float coscos = ct0 * ct1;
+
+      // limit p1 and p10 to sunrise/set
+      const float arg = -(sin_alpha + coscos) / sinsin;
+      const float carg = fabsf(arg) > 1 ? pi_f : acos_fast(arg);
+      const float p1_l = fminf(p0 + carg, p10);
+      const float p10_l = fmaxf(p0 - carg, p1);
+
+      // Integral of sun elevation over [p10_l, p1_l] divided by its length
+      // sin(a) - sin(b) = 2 cos((a+b)/2) sin((a-b)/2) avoids cancellation for short intervals
+      const float half = 0.5f * (p1_l - p10_l);
+      const float mid = 0.5f * (p1_l + p10_l) - p0;
+      const float sinc = sin_fast(half) / half;
+      const float cm = cos_fast(mid);
+
+      zzb[j] = coscos + sinsin * cm * sinc;
+      zzi[j] = coscos + sinsin * cos_fast(p1 - p0);
+      frac[j] = fabsf((p1_l - p10_l) / (p10 - p1));
+      xxb[j] = st1 * sin_fast(mid) * sinc;
+      yyb[j] = st0 * ct1 - ct0 * st1 * cm * sinc;
+    }
+
+    memcpy(zz_backwards + start, zzb, len * sizeof(float));
+    if (zz_instant) {
+      memcpy(zz_instant + start, zzi, len * sizeof(float));
+    }
+    if (daylight_fraction) {
+      memcpy(daylight_fraction + start, frac, len * sizeof(float));
+    }
+    if (xx_backwards) {
+      memcpy(xx_backwards + start, xxb, len * sizeof(float));
+    }
+    if (yy_backwards) {
+      memcpy(yy_backwards + start, yyb, len * sizeof(float));
+    }
+  }
+}
+
+void chelper_solar_incidence(const size_t n, const float* restrict zz, const float* restrict xx, const float* restrict yy, const float tilt, const float azimuth, float* restrict cos_incidence, float* restrict cos_tilt) {
+  const int track_tilt = isnan(tilt);
+  const int track_azimuth = isnan(azimuth);
+  const float ct_fixed = cosf(tilt);
+  const float st_fixed = sinf(tilt);
+  const float ca_fixed = cosf(azimuth);
+  const float sa_fixed = sinf(azimuth);
+
+  for (size_t i = 0; i < n; i++) {
+    const float cz = fminf(fmaxf(zz[i], -1), 1);
+    const float sz = sqrtf(1 - cz * cz);
+
+    // Solar azimuth `atan2(xx, yy)` as cosine and sine
+    const float r = sqrtf(xx[i] * xx[i] + yy[i] * yy[i]);
+    const float ca = r > 0 ? yy[i] / r : 1;
+    const float sa = r > 0 ? xx[i] / r : 0;
+
+    // cos(solarAzimuth - pi - arrayAzimuth). Tracking the azimuth keeps the array facing the sun
+    const float cdelta = track_azimuth ? 1 : -(ca * ca_fixed + sa * sa_fixed);
+    // Tracking the tilt sets it to the solar zenith angle
+    const float ct = track_tilt ? cz : ct_fixed;
+    const float st = track_tilt ? sz : st_fixed;
+
+    cos_incidence[i] = fmaxf(cz * ct + sz * st * cdelta, 0);
+    cos_tilt[i] = ct;
+  }
+}
@@ -0,0 +1,6 @@
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <liburing.h>
+
+/// `O_DIRECT` requires `_GNU_SOURCE` and is not exported by Glibc
+static const int CLIBURING_O_DIRECT = O_DIRECT;
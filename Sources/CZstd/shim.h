@@ -0,0 +1 @@
+#include <zstd.h>
\ No newline at end of file
@@ -71,3 +71,75 @@ import VaporTesting
         }
     }
 }
+
+/// Sampling rate is global state
+@Suite(.serialized) struct MetricsTests {
+    @Test func metricsRequireToken() async throws {
+        try await withApp { app in
+            try app.register(collection: MetricsController(token: "secret"))
+            let rateBefore = RequestMetrics.samplingPpm.load(ordering: .relaxed)
+            defer { RequestMetrics.samplingPpm.store(rateBefore, ordering: .relaxed) }
+
+            try await app.testing().test(.GET, "metrics") { res async in
+                #expect(res.status == .unauthorized)
+            }
+            try await app.testing().test(.GET, "metrics", headers: ["Authorization": "Bearer wrong"]) { res async in
+                #expect(res.status == .unauthorized)
+            }
+            try await app.testing().test(.GET, "metrics", headers: ["Authorization": "Bearer secret"]) { res async in
+                #expect(res.status == .ok)
+                #expect(res.headers.contentType?.description.starts(with: "text/plain") == true)
+                let text = res.body.string
+                #expect(text.contains("# TYPE openmeteo_request_stage_seconds histogram"))
+                #expect(text.contains("openmeteo_request_stage_seconds_bucket{stage=\"handler\",le=\"+Inf\"}"))
+                #expect(text.contains("openmeteo_requests_total "))
+            }
+            /// Sampling can only be changed with POST
+            try await app.testing().test(.GET, "metrics/sampling?rate=0.5", headers: ["Authorization": "Bearer secret"]) { res async in
+                #expect(res.status == .notFound)
+            }
+            try await app.testing().test(.POST, "metrics/sampling?rate=0.5") { res async in
+                #expect(res.status == .unauthorized)
+            }
+            try await app.testing().test(.POST, "metrics/sampling?rate=0.5", headers: ["Authorization": "Bearer secret"]) { res async in
+                #expect(res.status == .ok)
+                #expect(res.body.string == "0.5")
+            }
+            try await app.testing().test(.POST, "metrics/sampling?rate=2", headers: ["Authorization": "Bearer secret"]) { res async in
+                #expect(res.status == .badRequest)
+            }
+        }
+    }
+
+    @Test func metricsDisabledWithoutToken() async throws {
+        try await withApp { app in
+            try app.register(collection: MetricsController(token: nil))
+            try await app.testing().test(.GET, "metrics") { res async in
+                #expect(res.status == .notFound)
+            }
+        }
+    }
+
+    @Test func requestMetricsMiddlewareSamples() async throws {
+        try await withApp { app in
+            let rateBefore = RequestMetrics.samplingPpm.load(ordering: .relaxed)
+            defer { RequestMetrics.samplingPpm.store(rateBefore, ordering: .relaxed) }
+            RequestMetrics.samplingPpm.store(1_000_000, ordering: .relaxed)
+
+            let routes = app.grouped(RequestMetricsMiddleware())
+            routes.get("sampled") { _ in
+                return "\(RequestMetrics.isSampled)"
+            }
+            let requestsBefore = RequestMetrics.total(.requests)
+            try await app.testing().test(.GET, "sampled") { res async in
+                #expect(res.body.string == "true")
+            }
+            #expect(RequestMetrics.total(.requests) > requestsBefore)
+
+            RequestMetrics.samplingPpm.store(0, ordering: .relaxed)
+            try await app.testing().test(.GET, "sampled") { res async in
+                #expect(res.body.string == "false")
+            }
+        }
+    }
+}
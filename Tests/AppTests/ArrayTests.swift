@@ -193,6 +193,31 @@ import Testing
 
         // print(zip(solfac,solfac2).map(-))
     }
+
+    /// Table driven interpolation must match per timestep interpolation exactly
+    @Test func timeInterpolationTable() {
+        let timeOld = TimerangeDt(start: Timestamp(2022, 08, 17), nTime: 48, dtSeconds: 3 * 3600)
+        let data = (0..<48).map { Float(sin(Double($0) / 3) * 20 + 15 + Double($0 % 5)) }
+        let solar = (0..<48).map { Float(max(sin(Double($0) / 8 * .pi) * 500, 0)) }
+
+        for dtNew in [3600, 1800, 900] {
+            // Start in the middle of an old timestep and stop before the last one
+            let timeNew = TimerangeDt(start: timeOld.range.lowerBound.add(2 * dtNew), nTime: (timeOld.count - 3) * 10800 / dtNew, dtSeconds: dtNew)
+            let table = TimeInterpolationTable(timeNew: timeNew, dtOld: timeOld.dtSeconds, shift: 0)!
+            let indexOffset = timeOld.range.lowerBound.timeIntervalSince1970 / timeOld.dtSeconds
+            #expect(data.interpolateLinear(table: table, indexOffset: indexOffset, scalefactor: 10) == data.interpolateLinear(timeOld: timeOld, timeNew: timeNew, scalefactor: 10))
+            #expect(data.interpolateHermite(table: table, indexOffset: indexOffset, scalefactor: 10, bounds: 0...30) == data.interpolateHermite(timeOld: timeOld, timeNew: timeNew, scalefactor: 10, bounds: 0...30))
+            #expect(data.interpolateLinearDegrees(table: table, indexOffset: indexOffset, scalefactor: 10) == data.interpolateLinearDegrees(timeOld: timeOld, timeNew: timeNew, scalefactor: 10))
+
+            // Supersampled DNI starts before the first old timestep
+            let timeSolar = timeNew.range.add(-timeOld.dtSeconds).range(dtSeconds: dtNew)
+            let interpolated = solar.interpolate(type: .solar_backwards_averaged, timeOld: timeOld, timeNew: timeSolar, latitude: 47, longitude: 4.5, scalefactor: 10)
+            let grid = RegularGrid(nx: 1, ny: 1, latMin: 47, lonMin: 4.5, dx: 1, dy: 1)
+            let solarLow = Zensun.calculateRadiationBackwardsAveraged(grid: grid, locationRange: 0..<1, timerange: timeOld).data
+            let solarNew = Zensun.calculateRadiationBackwardsAveraged(grid: grid, locationRange: 0..<1, timerange: timeSolar).data
+            #expect(arraysEqual(interpolated, solar.interpolateSolarBackwards(timeOld: timeOld, timeNew: timeSolar, solarLow: solarLow, solar: solarNew, scalefactor: 10), accuracy: 0))
+        }
+    }
 }
 
 /// Predicate for comparing two arrays of Float with accuracy, handling NaN.
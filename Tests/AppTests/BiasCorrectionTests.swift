@@ -29,4 +29,45 @@ import Testing
         let normals2 = normalsCalc2.calculateDailyNormals(values: ArraySlice(data2), time: time)
         #expect(arraysEqual(normals2, [Float](repeating: 10, count: normals2.count), accuracy: 0.001))
     }
+
+    @Test func quantileDeltaMappingIdentity() {
+        let time = TimerangeDt(start: Timestamp(1990, 1, 1), to: Timestamp(2030, 1, 1), dtSeconds: 86400)
+        let data = (0..<time.count).map { sin(Float($0) / 365.25 * 2 * .pi) * 10 + sin(Float($0) * 0.7) * 3 }
+        /// Same reference and control must not change the data before the end of the reference period
+        let corrected = QuantileDeltaMappingBiasCorrection.quantileDeltaMappingMonthly(reference: ArraySlice(data), referenceTime: time, controlAndForecast: ArraySlice(data), controlAndForecastTime: time, type: .absoluteChage(bounds: nil))
+        #expect(arraysEqual(corrected[0..<3650], data[0..<3650], accuracy: 0.001))
+
+        let bins = Bins(min: -5, max: 30, nQuantiles: 20)
+        #expect(bins.lowerBin(for: -6) == -1)
+        #expect(bins.lowerBin(for: -5) == 0)
+        #expect(bins.lowerBin(for: bins[7]) == 7)
+        #expect(bins.lowerBin(for: 30) == 19)
+        #expect(bins.lowerBin(for: 1000) == 19)
+        #expect(QuantileDeltaMappingBiasCorrection.firstIndex(upTo: 10, where: { $0 >= 4 }) == 4)
+        #expect(QuantileDeltaMappingBiasCorrection.firstIndex(upTo: 10, where: { _ in false }) == 10)
+    }
+
+    @Test func quantileMappingTable() {
+        let domain = Cmip6Domain.MRI_AGCM3_2_S
+        let referenceTime = Cmip6QuantileMappingTable.referenceTime
+        let controlTime = Cmip6QuantileMappingTable.controlTime(domain: domain)
+        let reference = (0..<referenceTime.count).map { sin(Float($0) / 365.25 * 2 * .pi) * 10 + sin(Float($0) * 0.7) * 3 }
+        let control = (0..<controlTime.count).map { sin(Float($0) / 365.25 * 2 * .pi) * 12 + sin(Float($0) * 0.3) * 2 + 1 + Float($0) / 10000 }
+        let table = Cmip6QuantileMappingTable(reference: reference, control: control, referenceElevation: 500, domain: domain, type: .absoluteChage(bounds: nil)).table
+        #expect(table.count == Cmip6QuantileMappingTable.count(domain: domain))
+
+        /// A part of the time-series corrected with a restored table must match correcting the full time-series
+        guard let restored = Cmip6QuantileMappingTable(table: table[...], domain: domain) else {
+            Issue.record("Could not restore table")
+            return
+        }
+        #expect(restored.referenceElevation == 500)
+        let expected = QuantileDeltaMappingBiasCorrection.quantileDeltaMappingMonthly(reference: ArraySlice(reference), referenceTime: referenceTime, controlAndForecast: ArraySlice(control), controlAndForecastTime: controlTime, type: .absoluteChage(bounds: nil))
+        let range = 20000..<20400
+        let time = TimerangeDt(start: controlTime.range.lowerBound.add(days: range.lowerBound), nTime: range.count, dtSeconds: controlTime.dtSeconds)
+        let corrected = restored.apply(control[range], time: time, type: .absoluteChage(bounds: nil))
+        #expect(arraysEqual(corrected[...], expected[range], accuracy: 0.0001))
+
+        #expect(Cmip6QuantileMappingTable(table: [Float](repeating: .nan, count: table.count)[...], domain: domain) == nil)
+    }
 }
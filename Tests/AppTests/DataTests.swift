@@ -25,6 +25,17 @@ import Vapor
         #expect(arraysEqual(values2.max(by: 3), [3.0, .nan], accuracy: 0.01))
     }
 
+    @Test func processChunks() {
+        // Full rows aligned to 32 spatial chunk rows
+        #expect(OmFileSplitter.processChunks(ny: 100, nx: 200, chunknLocations: 6, valuesPerLocation: 100) == (96, 200))
+        // Fewer than 32 rows use a divisor of 32
+        #expect(OmFileSplitter.processChunks(ny: 746, nx: 1215, chunknLocations: 25, valuesPerLocation: 100) == (16, 1215))
+        #expect(OmFileSplitter.processChunks(ny: 746, nx: 1215, chunknLocations: 25, valuesPerLocation: 1000) == (1, 1215))
+        // Parts of a row are aligned to output and spatial chunks
+        #expect(OmFileSplitter.processChunks(ny: 1, nx: 2949120, chunknLocations: 12, valuesPerLocation: 256) == (1, 6144))
+        #expect(OmFileSplitter.processChunks(ny: 721, nx: 1440, chunknLocations: 12, valuesPerLocation: 51 * 64) == (1, 576))
+    }
+
     /*func testGribDecode() throws {
         let file = "/Users/patrick/Downloads/_mars-bol-webmars-private-svc-blue-010-7a527896970b09a4fc90fa37bf98d3ff-wvAa7C.grib"
         //let file = "/Users/patrick/Downloads/Z__C_RJTD_20240909060000_MSM_GPV_Rjp_Lsurf_FH00-15_grib2.bin"
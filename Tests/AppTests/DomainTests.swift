@@ -32,4 +32,42 @@ import Testing
         let sub3 = grid.findBox(boundingBox: BoundingBoxWGS84(latitude: 45.0..<45.2, longitude: 9..<9.5))!
         #expect(sub3.map { $0 } == [823068, 823069, 823070, 823071, 825636, 825637, 825638, 825639])
     }
+
+    @Test func elevationIndex() {
+        // 20x20 grid crosses a 16x16 tile border
+        let grid = RegularGrid(nx: 20, ny: 20, latMin: 10, lonMin: 10, dx: 0.1, dy: 0.1)
+        var elevation = (0..<400).map { Float($0) }
+        elevation[15 * 20 + 15] = -999
+        elevation[17 * 20 + 17] = .nan
+        elevation[5 * 20 + 5] = 1234.6
+        let index = ElevationIndex(elevation: elevation, nx: 20, ny: 20)
+
+        #expect(index.readElevation(gridpoint: 5 * 20 + 5).numeric == 1235)
+        #expect(index.readElevation(gridpoint: 15 * 20 + 15).isSea)
+        #expect(index.readElevation(gridpoint: 17 * 20 + 17).hasNoData)
+        #expect(index.readElevation(gridpoint: 16 * 20 + 16).numeric == 336)
+
+        // Center point is within 100 m
+        #expect(index.findPoint(grid: grid, lat: 11.0, lon: 11.0, elevation: 200, mode: .land)?.gridpoint == 210)
+        // Best elevation match in 3x3
+        #expect(index.findPoint(grid: grid, lat: 10.5, lon: 10.6, elevation: 1200, mode: .land)?.gridpoint == 105)
+        // Sea point at the tile border
+        #expect(index.findPoint(grid: grid, lat: 11.6, lon: 11.6, elevation: .nan, mode: .sea)?.gridpoint == 15 * 20 + 15)
+        #expect(index.findPoint(grid: grid, lat: 11.7, lon: 11.7, elevation: .nan, mode: .nearest) == nil)
+        #expect(index.findPoint(grid: grid, lat: 30, lon: 30, elevation: .nan, mode: .land) == nil)
+    }
+
+    @Test func coordinateTable() {
+        let projection = LambertAzimuthalEqualAreaProjection(λ0: -2.5, ϕ1: 54.9, radius: 6371229)
+        let grid = ProjectionGrid(nx: 52, ny: 48, latitudeProjectionOrigion: -1036000, longitudeProjectionOrigion: -1158000, dx: 40000, dy: 40000, projection: projection)
+        let gridpoints = [0, 1, 51, 52, 1000, 52 * 48 - 1]
+        let table = grid.getCoordinates(gridpoints: gridpoints)
+        #expect(table.latitude == gridpoints.map { grid.getCoordinates(gridpoint: $0).latitude })
+        #expect(table.longitude == gridpoints.map { grid.getCoordinates(gridpoint: $0).longitude })
+        #expect(grid.coordinateTable === grid.coordinateTable)
+
+        let trueNorth = grid.getTrueNorthDirection()
+        #expect(trueNorth.count == grid.count)
+        #expect(trueNorth == grid.getTrueNorthDirection())
+    }
 }
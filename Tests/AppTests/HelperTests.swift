@@ -129,4 +129,91 @@ import NIO
         let bytes5 = try ByteSizeParser.parseSizeStringToBytes("3.25MB")
         #expect(bytes5 == Int(3.25 * 1024 * 1024))
     }
+
+    @Test func dailyAggregationPrecomputed() throws {
+        let hourly: [Float] = [1, 2, .nan, 4, .nan, .nan]
+        #expect(DailyAggregationPrecomputed.max.aggregate(hourly[0..<2]) == 2)
+        #expect(DailyAggregationPrecomputed.min.aggregate(hourly[0..<2]) == 1)
+        #expect(DailyAggregationPrecomputed.mean.aggregate(hourly[0..<2]) == 1.5)
+        #expect(DailyAggregationPrecomputed.max.aggregate(hourly[0..<3]).isNaN)
+        #expect(DailyAggregationPrecomputed.sum.aggregate(hourly[3..<6]).isNaN)
+        #expect(try DailyAggregationPrecomputed.load(commaSeparated: "max,sum") == [.max, .sum])
+        #expect(DailyAggregationPrecomputed.max.omFileName("temperature_2m") == "temperature_2m_daily_max")
+        #expect(DailyAggregationPrecomputed.served(variable: "temperature_2m") == [.max, .min, .mean])
+        #expect(DailyAggregationPrecomputed.served(variable: "precipitation") == [.sum])
+    }
+
+    /// Precomputed daily values must be identical to aggregating converted hourly values like the API does
+    @Test func dailyAggregationPrecomputedMatchesHourly() {
+        let nDays = 30
+        let hourly = (0..<nDays * 24).map { Float(sin(Double($0) / 7) * 13.37 + 0.05 * Double($0 % 11)) }
+        let units = [
+            ApiUnits(temperature_unit: .celsius, windspeed_unit: .ms, wind_speed_unit: nil, precipitation_unit: .mm, length_unit: .metric),
+            ApiUnits(temperature_unit: .fahrenheit, windspeed_unit: .mph, wind_speed_unit: nil, precipitation_unit: .inch, length_unit: .imperial)
+        ]
+        for params in units {
+            for unit in [SiUnit.celsius, .metrePerSecond, .millimetre] {
+                let converted = DataAndUnit(hourly, unit).convertAndRound(params: params)
+                for aggregation in DailyAggregationPrecomputed.allCases {
+                    let daily = (0..<nDays).map { aggregation.aggregate(hourly[$0 * 24 ..< $0 * 24 + 24]) }
+                    let precomputed = DataAndUnit(daily, unit).convertAndRound(params: params)
+                    guard aggregation.commutesWithScaling || precomputed.unit == unit else {
+                        // API uses the hourly path
+                        continue
+                    }
+                    #expect(precomputed.unit == converted.unit)
+                    #expect(precomputed.data == aggregation.aggregate(converted.data, by: 24))
+                }
+            }
+        }
+    }
+
+    @Test func syntheticField() {
+        let field = SyntheticField(mean: 0, diurnalAmplitude: 5, seasonalAmplitude: 10, lapseRate: -0.0065, noise: 1, min: -2, max: .infinity, seed: 42)
+        let time = TimerangeDt(start: Timestamp(2022, 1, 1), nTime: 48, dtSeconds: 3600)
+        var a = [Float](repeating: .nan, count: 48)[...]
+        var b = [Float](repeating: .nan, count: 48)[...]
+        field.fill(&a, location: 123, coordinates: (47, 8), elevation: 500, member: 0, time: time)
+        field.fill(&b, location: 123, coordinates: (47, 8), elevation: 500, member: 0, time: time)
+        #expect(a == b)
+        #expect(a.allSatisfy({ $0 >= -2 && $0 < 20 }))
+        field.fill(&b, location: 123, coordinates: (47, 8), elevation: 500, member: 1, time: time)
+        #expect(a != b)
+        for i in 0..<1000 {
+            let random = SyntheticField.random(seed: 1, location: i, member: 0, time: 0)
+            #expect(random >= -1 && random < 1)
+        }
+    }
+
+    @Test func floatBufferPool() {
+        #expect(FloatBufferPool.sizeClass(1) == 16)
+        #expect(FloatBufferPool.sizeClass(384) == 512)
+        #expect(FloatBufferPool.sizeClass(512) == 512)
+
+        let pool = FloatBufferPool()
+        FloatBufferPool.$current.withValue(pool) {
+            var a = [Float].pooled(repeating: .nan, count: 384)
+            a[0] = 1
+            FloatBufferPool.release(&a)
+            #expect(a.isEmpty)
+            let b = [Float].pooled(repeating: 2, count: 300)
+            #expect(b.count == 300)
+            #expect(b.allSatisfy { $0 == 2 })
+        }
+        #expect(pool.allocations == (FloatBufferPool.enabled ? 1 : 2))
+        #expect(pool.reuses == (FloatBufferPool.enabled ? 1 : 0))
+
+        /// Outside of requests arrays are not pooled
+        var c = [Float].pooled(repeating: 0, count: 10)
+        FloatBufferPool.release(&c)
+        #expect(c.count == 10)
+    }
+
+    @Test func contentEncodingNegotiation() {
+        #expect(ContentEncoding.negotiate(acceptEncoding: "gzip, deflate") == .gzip)
+        #expect(ContentEncoding.negotiate(acceptEncoding: "deflate") == nil)
+        #expect(ContentEncoding.negotiate(acceptEncoding: "gzip;q=0, identity") == nil)
+        #expect(ContentEncoding.negotiate(acceptEncoding: "GZIP ; q=0.5") == .gzip)
+        #expect(ContentEncoding.negotiate(acceptEncoding: "gzip, deflate, br, zstd") == ContentEncoding.allCases.first)
+    }
 }
@@ -86,6 +86,34 @@ import Testing
         #expect(Meteorology.vaporPressureDeficit(temperature2mCelsius: 20, dewpointCelsius: -10) == 2.0525706)
     }
 
+    @Test func derivedKernels() {
+        enum Raw: String, RawRepresentableString {
+            case temperature, rh, u, v, direct, diffuse
+        }
+        let n = 37
+        let raw: [String: [Float]] = [
+            "temperature": (0..<n).map { Float($0) - 10 },
+            "rh": (0..<n).map { Float($0) * 2.5 + 5 },
+            "u": (0..<n).map { sin(Float($0)) * 12 },
+            "v": (0..<n).map { cos(Float($0) * 0.7) * 9 },
+            "direct": (0..<n).map { Float($0) * 11 },
+            "diffuse": (0..<n).map { Float($0) * 3 }
+        ]
+        let kernels: [DerivedKernel<Raw>] = [
+            .windSpeed(u: .u, v: .v),
+            .apparentTemperature(temperature: .temperature, relativeHumidity: .rh, windU: .u, windV: .v, shortwave: [.direct, .diffuse]),
+            .vapourPressureDeficit(temperature: .temperature, relativeHumidity: .rh)
+        ]
+        let result = DerivedKernel.evaluate(kernels, raw: raw)
+        let windspeed = zip(raw["u"]!, raw["v"]!).map(Meteorology.windspeed)
+        let swrad = zip(raw["direct"]!, raw["diffuse"]!).map(+)
+        let dewpoint = zip(raw["temperature"]!, raw["rh"]!).map(Meteorology.dewpoint)
+        #expect(result[0].data == windspeed)
+        #expect(result[1].data == Meteorology.apparentTemperature(temperature_2m: raw["temperature"]!, relativehumidity_2m: raw["rh"]!, windspeed_10m: windspeed, shortwave_radiation: swrad))
+        #expect(result[2].data == zip(raw["temperature"]!, dewpoint).map(Meteorology.vaporPressureDeficit))
+        #expect(result[2].unit == .kilopascal)
+    }
+
     @Test func pressure() {
         #expect(Meteorology.sealevelPressure(temperature: [15], pressure: [980], elevation: 1000) == [1101.9026])
         #expect(Meteorology.surfacePressure(temperature: [15], pressure: [1101.9026], elevation: 1000) == [980])
@@ -31,6 +31,87 @@ import OmFileFormat
         #expect(value2.first == 214)
     }
 
+    #if ENABLE_IO_URING
+    @Test func ioUringRead() async throws {
+        guard let ring = IoUring.shared else {
+            return
+        }
+        let file = "io_uring_test.om"
+        try FileManager.default.removeItemIfExists(at: file)
+        defer { try! FileManager.default.removeItem(atPath: file) }
+        let data = (0..<10_000).map { Float($0 % 1000) }
+        let writer = OmFileWriter(fn: try FileHandle.createNewFile(file: file), initialCapacity: 1024)
+        let array = try writer.writeArray(data: data, dimensions: [100, 100], chunkDimensions: [10, 10], compression: .pfor_delta2d_int16, scale_factor: 1, add_offset: 0)
+        try writer.writeTrailer(rootVariable: try writer.write(array: array, name: "", children: []))
+
+        let backend = try OmIoUringReaderBackend(ring: ring, file: file, direct: false)
+        let read = try await OmFileReader(fn: backend).asArray(of: Float.self)!
+        #expect(try await read.read(range: [0..<100, 0..<100]) == data)
+        #expect(try await read.read(range: [42..<43, 17..<19]) == [217, 218])
+        let bytes = try await backend.getData(offset: 3, count: 5)
+        #expect(bytes.count == 5)
+
+        /// Short read at the end of the file
+        let fileData = try Data(contentsOf: URL(fileURLWithPath: file))
+        #expect(try await backend.getData(offset: backend.count - 3, count: 3) == fileData.suffix(3))
+        await #expect(throws: IoUringError.self) {
+            try await backend.getData(offset: backend.count - 3, count: 10)
+        }
+
+        /// More reads than ring entries from concurrent tasks wait for free slots
+        let fd = backend.file.fileDescriptor
+        try await withThrowingTaskGroup(of: Void.self) { group in
+            for _ in 0..<4 {
+                group.addTask {
+                    let buffer = UnsafeMutableRawBufferPointer.allocate(byteCount: 4 * 300, alignment: 4)
+                    defer { buffer.deallocate() }
+                    let results = await ring.submit((0..<300).map {
+                        IoUring.Read(fd: fd, buffer: UnsafeMutableRawBufferPointer(rebasing: buffer[$0 * 4 ..< $0 * 4 + 4]), offset: $0 * 4)
+                    })
+                    #expect(results.allSatisfy { $0 == 4 })
+                    #expect(Data(buffer) == fileData.prefix(4 * 300))
+                }
+            }
+            try await group.waitForAll()
+        }
+    }
+
+    @Test func ioUringDirectBlockCache() async throws {
+        guard let ring = IoUring.shared else {
+            return
+        }
+        let file = "io_uring_direct_test.om"
+        let cacheFile = "io_uring_cache4k50.bin"
+        try FileManager.default.removeItemIfExists(at: file)
+        try FileManager.default.removeItemIfExists(at: cacheFile)
+        defer {
+            try! FileManager.default.removeItem(atPath: file)
+            try! FileManager.default.removeItem(atPath: cacheFile)
+        }
+        let data = (0..<10_000).map { Float($0 % 1000) }
+        let writer = OmFileWriter(fn: try FileHandle.createNewFile(file: file), initialCapacity: 1024)
+        let array = try writer.writeArray(data: data, dimensions: [100, 100], chunkDimensions: [10, 10], compression: .pfor_delta2d_int16, scale_factor: 1, add_offset: 0)
+        try writer.writeTrailer(rootVariable: try writer.write(array: array, name: "", children: []))
+        let fileData = try Data(contentsOf: URL(fileURLWithPath: file))
+
+        /// File systems without `O_DIRECT` support fall back to mmap
+        guard let backend = try OmIoUringReaderBackend.openLocal(ring: ring, file: file, direct: true) else {
+            return
+        }
+        /// Reads are widened to 4096 byte boundaries. The last block is a short read
+        let middle = backend.count / 3
+        #expect(try await backend.getData(offset: middle, count: 100) == fileData[middle ..< middle + 100])
+        #expect(try await backend.getData(offset: backend.count - 3, count: 3) == fileData.suffix(3))
+
+        let cache = try AtomicBlockCache(file: cacheFile, blockSize: 4096, blockCount: 50)
+        let cacheFn = OmReaderBlockCache(backend: backend, cache: AtomicCacheCoordinator(cache: cache), cacheKey: backend.cacheKey)
+        let read = try await OmFileReader(fn: cacheFn).asArray(of: Float.self)!
+        #expect(try await read.read(range: [0..<100, 0..<100]) == data)
+        /// Second read is served from the block cache
+        #expect(try await read.read(range: [42..<43, 17..<19]) == [217, 218])
+    }
+    #endif
+
     @Test func blockCacheConcurrent() async throws {
         let url = "https://openmeteo.s3.amazonaws.com/data/dwd_icon_d2_eps/static/HSURF.om"
         let readFn = try await OmHttpReaderBackend(client: .shared, logger: .init(label: "logger"), url: url)!
@@ -48,6 +129,112 @@ import OmFileFormat
         #expect(value2[123] == 1218)
     }
 
+    @Test func read3DBlock() async throws {
+        let (ny, nx, nTime) = (10, 8, 5)
+        let file = "read3d_block.om"
+        try FileManager.default.removeItemIfExists(at: file)
+        defer { try! FileManager.default.removeItem(atPath: file) }
+        try (0..<ny * nx * nTime).map(Float.init).writeOmFile(file: file, dimensions: [ny, nx, nTime], chunks: [1, 3, nTime], compression: .pfor_delta2d_int16, scalefactor: 1).close()
+        let read = try await OmFileReader(mmapFile: file).asArray(of: Float.self)!
+        let (y, x) = (2..<6, 3..<7)
+        var block = [Float](repeating: .nan, count: y.count * x.count * nTime)
+        try await read.read3D(into: &block, ny: ny, nx: nx, nTime: nTime, nMembers: 1, y: y, x: x, level: 0, timeOffsets: (1..<5, 0..<4))
+        var expected = [Float]()
+        for yy in y {
+            for xx in x {
+                var series = [Float](repeating: .nan, count: nTime)
+                try await read.read3D(into: &series, ny: ny, nx: nx, nTime: nTime, nMembers: 1, location: yy * nx + xx ..< yy * nx + xx + 1, level: 0, timeOffsets: (1..<5, 0..<4))
+                expected.append(contentsOf: series)
+            }
+        }
+        #expect(block.elementsEqual(expected, by: { $0 == $1 || ($0.isNaN && $1.isNaN) }))
+        #expect(block[0..<4] == [Float((2 * nx + 3) * nTime + 1), Float((2 * nx + 3) * nTime + 2), Float((2 * nx + 3) * nTime + 3), Float((2 * nx + 3) * nTime + 4)])
+    }
+
+    @Test func yearlyMergeTile() async throws {
+        let tiles = YearlyMergeTile.tiles(ny: 3, nx: 1000, nt: 8760, xMultiple: 6)
+        #expect(tiles.count == 3 * 5)
+        #expect(tiles.reduce(0, { $0 + $1.count }) == 3 * 1000 * 8760)
+        #expect(tiles.allSatisfy { $0.x.count % 6 == 0 || $0.x.upperBound == 1000 })
+        #expect(zip(tiles, tiles.dropFirst()).allSatisfy { $0.y == $1.y ? $0.x.upperBound == $1.x.lowerBound : $1.x.lowerBound == 0 })
+
+        /// Two chunk files with 4 timesteps each. The merged series starts at the third timestep of the first chunk
+        let (ny, nx, nChunk) = (2, 13, 4)
+        let files = ["merge_tile_0.om", "merge_tile_1.om"]
+        for (i, file) in files.enumerated() {
+            try FileManager.default.removeItemIfExists(at: file)
+            try (0..<ny * nx * nChunk).map { Float($0 + i * 1000) }.writeOmFile(file: file, dimensions: [ny, nx, nChunk], chunks: [1, 6, nChunk], compression: .pfor_delta2d_int16, scalefactor: 1).close()
+        }
+        defer {
+            for file in files {
+                try! FileManager.default.removeItem(atPath: file)
+            }
+        }
+        let time = 2..<8
+        var sources = [YearlyMergeSource]()
+        for (i, file) in files.enumerated() {
+            let reader = try await OmFileReader(mmapFile: file).asArray(of: Float.self)!
+            sources.append(YearlyMergeSource(file: reader, offsets: time.intersect(fileTime: i * nChunk ..< (i + 1) * nChunk)!))
+        }
+        let nt = time.count
+        let mergeTiles = YearlyMergeTile.tiles(ny: UInt64(ny), nx: UInt64(nx), nt: UInt64(nt), xMultiple: 6)
+        var consumed = [Range<UInt64>]()
+        try await YearlyMergeTile.readOrdered(tiles: mergeTiles, sources: sources, nx: UInt64(nx), concurrency: 3) { tile, arena in
+            consumed.append(tile.y)
+            for (ix, x) in tile.x.enumerated() {
+                let location = Int(tile.y.lowerBound) * nx + Int(x)
+                let expected = time.map { t in Float(location * nChunk + t % nChunk + t / nChunk * 1000) }
+                #expect(Array(arena.data[ix * nt ..< (ix + 1) * nt]) == expected)
+            }
+        }
+        #expect(consumed == mergeTiles.map(\.y))
+    }
+
+    @Test func spatialFieldSelection() {
+        let selection = SpatialFieldReader.Selection(y: 3..<10, x: 5..<9, step: 3)
+        #expect(selection.ny == 3)
+        #expect(selection.nx == 2)
+        #expect(Array(selection.rows) == [3, 6, 9])
+        #expect(Array(selection.columns) == [5, 8])
+        #expect(selection.gridpoints(nx: 20) == [65, 68, 125, 128, 185, 188])
+        let full = SpatialFieldReader.Selection(y: 0..<2, x: 0..<3, step: 1)
+        #expect(full.gridpoints(nx: 3) == [0, 1, 2, 3, 4, 5])
+        #expect(SpatialFieldReader.Selection(y: 0..<0, x: 0..<3, step: 2).ny == 0)
+        #expect(SpatialRealm(rawValue: "model-level") == .model_level)
+        #expect(SpatialRealm(rawValue: "../../etc") == nil)
+    }
+
+    /// Rows are read in bands of 32 chunk rows. Steps may skip entire bands
+    @Test func spatialFieldRead() async throws {
+        let (ny, nx) = (100, 21)
+        let file = "spatial_field.om"
+        try FileManager.default.removeItemIfExists(at: file)
+        defer { try! FileManager.default.removeItem(atPath: file) }
+        try (0..<ny * nx).map(Float.init).writeOmFile(file: file, dimensions: [ny, nx], chunks: [SpatialFieldReader.chunkRows, 8], compression: .pfor_delta2d_int16, scalefactor: 1).close()
+        let reader = try await OmFileReader(mmapFile: file).asArray(of: Float.self)!
+
+        for selection in [
+            SpatialFieldReader.Selection(y: 0..<ny, x: 0..<nx, step: 1),
+            SpatialFieldReader.Selection(y: 3..<97, x: 2..<19, step: 5),
+            SpatialFieldReader.Selection(y: 30..<34, x: 0..<nx, step: 1),
+            SpatialFieldReader.Selection(y: 1..<ny, x: 4..<5, step: 40),
+            SpatialFieldReader.Selection(y: 0..<ny, x: 0..<nx, step: 33)
+        ] {
+            let expected = selection.gridpoints(nx: nx).map(Float.init)
+            let values = try await SpatialFieldReader.read(reader: reader, selection: selection)
+            #expect(values.count == selection.ny * selection.nx)
+            #expect(values == expected, "Selection y=\(selection.y) x=\(selection.x) step=\(selection.step)")
+        }
+
+        /// Empty selections and bounding boxes smaller than one grid cell return no values instead of trapping
+        #expect(try await SpatialFieldReader.read(reader: reader, selection: .init(y: 5..<5, x: 0..<nx, step: 1)) == [])
+        let grid = RegularGrid(nx: nx, ny: ny, latMin: 47, lonMin: 8, dx: 0.02, dy: 0.02)
+        let subCell = try #require(grid.findBox(boundingBox: BoundingBoxWGS84(latitude: 47.0..<47.001, longitude: 8.0..<8.001)) as? GridSliceXy)
+        let selection = SpatialFieldReader.Selection(y: subCell.yRange, x: subCell.xRange, step: 2)
+        #expect(selection.nx == 0)
+        #expect(try await SpatialFieldReader.read(reader: reader, selection: selection) == [])
+    }
+
     /*func testRemoteFileManager() async throws {
         let value = try await RemoteOmFileManager.instance.with(file: .staticFile(domain: .dwd_icon_d2_eps, variable: "HSURF", chunk: nil), client: .shared, logger: .init(label: "")) { reader in
             try await reader.asArray(of: Float.self)!.read(range: [250..<251, 420..<421])
@@ -55,6 +242,23 @@ import OmFileFormat
         #expect(value?.first == 214)
     }*/
 
+    #if os(Linux)
+    @Test func keyValueCacheInMemory() throws {
+        let regular = try AtomicBlockCache(blockSize: 64, blockCount: 50, placement: .init(hugePages: .transparent, numaInterleave: true))
+        #expect(regular.data.count == (64 + 16) * 50)
+        regular.set(key: 234923, value: Data(repeating: 123, count: 64))
+        #expect(regular.get(key: 234923)!.data == Data(repeating: 123, count: 64))
+        #expect(regular.get(key: 234924) == nil)
+
+        // Uses regular pages if the host has no huge pages reserved. Always rounded up to one huge page
+        let explicit = try AtomicBlockCache(blockSize: 64, blockCount: 50, placement: .init(hugePages: .explicit))
+        #expect(explicit.data.count == AtomicBlockCachePlacement.hugePageSize)
+        explicit.set(key: 234923, value: Data(repeating: 123, count: 64))
+        #expect(explicit.get(key: 234923)!.data == Data(repeating: 123, count: 64))
+        #expect(explicit.get(key: 234924) == nil)
+    }
+    #endif
+
     @Test func keyValueCache() async throws {
         let data = DataAsClass(data: Data(repeating: 0, count: (64 + 16)*50))
         let cache = AtomicBlockCache(data: data, blockSize: 64)
@@ -85,4 +289,65 @@ import OmFileFormat
         cache.set(key: .max, value: Data(repeating: 123, count: 64))
         #expect(cache.get(key: .max)!.data == Data(repeating: 123, count: 64))
     }
+
+    @Test func manifestInvalidation() throws {
+        let domain = try #require(DomainRegistry.dwd_icon.getDomain())
+        let run = Timestamp(2024, 6, 1, 12)
+        let meta = ModelUpdateMetaJson(last_run_initialisation_time: run.timeIntervalSince1970, last_run_modification_time: run.add(hours: 3).timeIntervalSince1970, last_run_availability_time: run.add(hours: 3).timeIntervalSince1970, temporal_resolution_seconds: 3600, data_end_time: run.add(days: 7).timeIntervalSince1970, update_interval_seconds: 6 * 3600)
+        let runChunk = run.timeIntervalSince1970 / (domain.omFileLength * domain.dtSeconds)
+        func chunk(_ chunk: Int?, _ type: OmFileManagerType = .chunk) -> OmFileManagerReadable {
+            return .domainChunk(domain: .dwd_icon, variable: "temperature_2m", type: type, chunk: chunk, ensembleMember: 0, previousDay: 0)
+        }
+        #expect(chunk(runChunk - 1).isModified(by: meta) == false)
+        #expect(chunk(runChunk).isModified(by: meta) == true)
+        #expect(chunk(runChunk + 1).isModified(by: meta) == true)
+        #expect(chunk(2023, .year).isModified(by: meta) == false)
+        #expect(chunk(2024, .year).isModified(by: meta) == true)
+        #expect(chunk(nil, .linear_bias_seasonal).isModified(by: meta) == false)
+        #expect(OmFileManagerReadable.staticFile(domain: .dwd_icon, variable: "HSURF").isModified(by: meta) == false)
+        #expect(OmFileManagerReadable.run(domain: .dwd_icon, variable: "temperature_2m", run: run).isModified(by: meta) == true)
+        #expect(OmFileManagerReadable.run(domain: .dwd_icon, variable: "temperature_2m", run: run.add(hours: -6)).isModified(by: meta) == false)
+    }
+
+    /// Lookups of open files through the registry and through the cache actor with 64 concurrent tasks. Timings are in `benchmark`
+    @Test func registryContention() async throws {
+        let manager = RemoteOmFileManager()
+        let logger = Logger(label: "registryContention")
+        let files = (0..<20).map { OmFileManagerReadable.staticFile(domain: .dwd_icon, variable: "benchmark\($0)") }
+        for file in files {
+            _ = try await manager.cache.get(key: file, forceNew: false, provider: { nil })
+        }
+        let nTasks = 64
+        let nLookups = 1_000
+
+        try await withThrowingTaskGroup(of: Int.self) { group in
+            for t in 0..<nTasks {
+                group.addTask {
+                    var found = 0
+                    for i in 0..<nLookups {
+                        if try await manager.get(file: files[(t + i) % files.count], client: .shared, logger: logger) == nil {
+                            found += 1
+                        }
+                    }
+                    return found
+                }
+            }
+            #expect(try await group.reduce(0, +) == nTasks * nLookups)
+        }
+
+        try await withThrowingTaskGroup(of: Int.self) { group in
+            for t in 0..<nTasks {
+                group.addTask {
+                    var found = 0
+                    for i in 0..<nLookups {
+                        if try await manager.cache.get(key: files[(t + i) % files.count], forceNew: false, provider: { nil }) == nil {
+                            found += 1
+                        }
+                    }
+                    return found
+                }
+            }
+            #expect(try await group.reduce(0, +) == nTasks * nLookups)
+        }
+    }
 }
@@ -4,6 +4,11 @@ import Foundation
 import Testing
 import VaporTesting
 @preconcurrency import SwiftEccodes
+import CZlib
+#if ENABLE_ZSTD_BROTLI
+import CZstd
+import CBrotli
+#endif
 
 @Suite struct OutputformatTests {
     /*func testBz2Grib() async throws {
@@ -604,6 +609,45 @@ import VaporTesting
         #expect(flatbuffers == "52899e668476fef0cbc11934eedcd8adafd54e2f413fef3e7774abce1c62f73b")
     }
 
+    /// `FlatBuffersEncoder` must produce the same bytes as the SDK `FlatBufferBuilder`
+    @Test func flatbuffersEncoder() async throws {
+        let hourly = ApiSection<ForecastapiResult<MultiDomains>.SurfacePressureAndHeightVariable>(name: "hourly", time: TimerangeDt(start: Timestamp(2022, 7, 12, 0), nTime: 47, dtSeconds: 3600), columns: [
+            ApiColumn(variable: .surface(.init(.temperature_2m, 0)), unit: .celsius, variables: (0..<3).map { member in .float((0..<47).map { Float($0 * member) - 0.5 }) }),
+            ApiColumn(variable: .surface(.init(.windspeed_10m, 1)), unit: .kilometresPerHour, variables: [.float(.init(repeating: .nan, count: 47))]),
+            ApiColumn(variable: .surface(.init(.precipitation_probability, 0)), unit: .percentage, variables: [.float([])])
+        ])
+        let daily = ApiSection<ForecastVariableDaily>(name: "daily", time: TimerangeDt(start: Timestamp(2022, 7, 12, 0), nTime: 3, dtSeconds: 86400), columns: [
+            ApiColumn(variable: .sunrise, unit: .iso8601, variables: [.timestamp([Timestamp(2022, 7, 12, 4, 31), Timestamp(2022, 7, 13, 4, 32), Timestamp(2022, 7, 14, 4, 33)])]),
+            ApiColumn(variable: .temperature_2m_max, unit: .celsius, variables: [.float([21, 22, 23])])
+        ])
+        let current = ApiSectionSingle<ForecastapiResult<MultiDomains>.SurfacePressureAndHeightVariable>(name: "current", time: Timestamp(2022, 7, 12, 1, 15), dtSeconds: 900, columns: [
+            ApiColumnSingle(variable: .surface(.init(.temperature_2m, 0)), unit: .celsius, value: 0),
+            ApiColumnSingle(variable: .surface(.init(.windspeed_10m, 0)), unit: .kilometresPerHour, value: -0.0)
+        ])
+        let res = ForecastapiResult<MultiDomains>.PerModel(
+            model: .icon_seamless,
+            latitude: 52.52,
+            longitude: -13.41,
+            elevation: 38,
+            prefetch: {},
+            current: { current },
+            hourly: { hourly },
+            daily: { daily },
+            sixHourly: nil,
+            minutely15: { hourly }
+        )
+        let timezones = [
+            TimezoneWithOffset(utcOffsetSeconds: 7200, identifier: "Europe/Berlin", abbreviation: "CEST"),
+            TimezoneWithOffset(utcOffsetSeconds: 0, identifier: "GMT", abbreviation: "GMT")
+        ]
+        for timezone in timezones {
+            let sdk = try await res.encodeFlatbufferSdk(timezone: timezone, fixedGenerationTime: 12, locationId: 3)
+            var buffer = ByteBufferAllocator().buffer(capacity: 0)
+            try await res.writeToFlatbuffer(&buffer, timezone: timezone, fixedGenerationTime: 12, locationId: 3)
+            #expect(Array(buffer.readableBytesView) == sdk)
+        }
+    }
+
     @Test func xlsxWriter() throws {
         let xlsx = try XlsxWriter()
         xlsx.startRow()
@@ -617,6 +661,43 @@ import VaporTesting
         #expect(data.readData(length: data.writerIndex)!.sha256 == "987fff4d1b6ba45e799e204c55ca03a53794e6479c5c497c0c4fa279f0f6c0f6")
     }
 
+    @Test func zipStreamWriter() throws {
+        let hello = try GzipStream(level: 6, chunkCapacity: 512)
+        hello.write("Hello")
+        let world = try GzipStream(level: 6, chunkCapacity: 512)
+        world.write("World ")
+        var head = world.drain()
+        world.write(42.125, decimals: 2)
+        let tail = world.finish()
+        let crc: UInt32 = tail.getInteger(at: tail.writerIndex - 8, endianness: .little)!
+        let size: UInt32 = tail.getInteger(at: tail.writerIndex - 4, endianness: .little)!
+        #expect(size == 11)
+
+        var out = ByteBufferAllocator().buffer(capacity: 1024)
+        var zip = ZipStreamWriter(timestamp: Timestamp(2000, 1, 1))
+        zip.write(path: "hello.txt", compressed: hello.finish(), into: &out)
+        let streamStart = out.writerIndex
+        zip.startStream(path: "world.txt", into: &out)
+        head.moveReaderIndex(forwardBy: 10)
+        let compressedSize = head.readableBytes + tail.writerIndex - 8
+        zip.writeStream(&head, into: &out)
+        var payload = tail.getSlice(at: 0, length: tail.writerIndex - 8)!
+        zip.writeStream(&payload, into: &out)
+        let descriptor = out.writerIndex
+        zip.endStream(crc: crc, uncompressedSize: size, into: &out)
+        let centralDirectory = out.writerIndex
+        zip.finish(into: &out)
+
+        #expect(zip.offset == out.writerIndex)
+        // Streamed local header has bit 3 set and no sizes
+        #expect(out.getInteger(at: streamStart + 6, endianness: .little, as: UInt16.self) == 0x0008)
+        #expect(out.getInteger(at: streamStart + 18, endianness: .little, as: UInt32.self) == 0)
+        #expect(out.getInteger(at: descriptor, endianness: .little, as: UInt32.self) == 0x08074b50)
+        #expect(out.getInteger(at: descriptor + 8, endianness: .little, as: UInt32.self) == UInt32(compressedSize))
+        #expect(out.getInteger(at: centralDirectory, endianness: .little, as: UInt32.self) == 0x02014b50)
+        #expect(out.getInteger(at: out.writerIndex - 6, endianness: .little, as: UInt32.self) == UInt32(centralDirectory))
+    }
+
     @Test func gzipStream() throws {
         let hello = try GzipStream(level: 6, chunkCapacity: 512)
         hello.write("Hello")
@@ -629,4 +710,93 @@ import VaporTesting
 
         #expect(zip.readData(length: zip.writerIndex)!.sha256 == "443f2602754152053754ff14b49218858bd555e74b5d8dc8d5e16fc85c7cdcce")
     }
+
+    /// Compress 1.5 MB in uneven writes with every encoding and decompress it again. Covers multiple 256 KB blocks, dictionary priming and sync flushes for gzip and concatenated zstd frames
+    @Test func compressingBodyStreamWriterRoundTrip() async throws {
+        let text = (0..<100_000).map { "\($0 % 977),\(Float($0) * 0.37)\n" }.joined()
+        let input = [UInt8](text.utf8)
+        #expect(input.count > 4 * CompressingBodyStreamWriter.blockSize)
+        let eventLoop = MultiThreadedEventLoopGroup.singleton.next()
+
+        for encoding in ContentEncoding.allCases {
+            let downstream = CollectingBodyStreamWriter(eventLoop: eventLoop)
+            let writer = CompressingBodyStreamWriter(downstream: downstream, encoding: encoding)
+            var offset = 0
+            var size = 1000
+            while offset < input.count {
+                let end = min(offset + size, input.count)
+                try await writer.write(.buffer(ByteBuffer(bytes: input[offset ..< end]))).get()
+                offset = end
+                size = (size * 7 + 3331) % 90_000 + 1
+            }
+            try await writer.write(.end).get()
+            let compressed = try await eventLoop.submit { downstream.ended ? Array(downstream.buffer.readableBytesView) : [] }.get()
+            #expect(compressed.count > 0 && compressed.count < input.count / 2)
+
+            let decompressed: [UInt8]
+            switch encoding {
+            case .gzip:
+                decompressed = Self.gunzip(compressed, capacity: input.count + 1)
+            #if ENABLE_ZSTD_BROTLI
+            case .zstd:
+                var out = [UInt8](repeating: 0, count: input.count + 1)
+                let count = ZSTD_decompress(&out, out.count, compressed, compressed.count)
+                #expect(ZSTD_isError(count) == 0)
+                decompressed = Array(out[0 ..< (ZSTD_isError(count) == 0 ? count : 0)])
+            case .br:
+                var out = [UInt8](repeating: 0, count: input.count + 1)
+                var count = out.count
+                #expect(BrotliDecoderDecompress(compressed.count, compressed, &count, &out) == BROTLI_DECODER_RESULT_SUCCESS)
+                decompressed = Array(out[0 ..< count])
+            #endif
+            }
+            #expect(decompressed == input, "Round trip failed for \(encoding)")
+        }
+    }
+
+    /// Inflate a gzip stream including header and CRC check
+    static func gunzip(_ data: [UInt8], capacity: Int) -> [UInt8] {
+        let zstream = UnsafeMutablePointer<z_stream>.allocate(capacity: 1)
+        defer { zstream.deallocate() }
+        zstream.initialize(to: z_stream())
+        #expect(inflateInit2_(zstream, 16 + 15, ZLIB_VERSION, Int32(MemoryLayout<z_stream>.size)) == Z_OK)
+        defer { inflateEnd(zstream) }
+        var out = [UInt8](repeating: 0, count: capacity)
+        var input = data
+        let ret = input.withUnsafeMutableBufferPointer { input in
+            out.withUnsafeMutableBufferPointer { output in
+                zstream.pointee.next_in = input.baseAddress
+                zstream.pointee.avail_in = uInt(input.count)
+                zstream.pointee.next_out = output.baseAddress
+                zstream.pointee.avail_out = uInt(output.count)
+                return inflate(zstream, Z_FINISH)
+            }
+        }
+        #expect(ret == Z_STREAM_END)
+        return Array(out[0 ..< Int(zstream.pointee.total_out)])
+    }
+}
+
+/// Collects all data written to a response body. Only accessed on `eventLoop`
+final class CollectingBodyStreamWriter: BodyStreamWriter, @unchecked Sendable {
+    let eventLoop: any EventLoop
+    var buffer = ByteBuffer()
+    var ended = false
+
+    init(eventLoop: any EventLoop) {
+        self.eventLoop = eventLoop
+    }
+
+    func write(_ result: BodyStreamResult, promise: EventLoopPromise<Void>?) {
+        switch result {
+        case .buffer(var data):
+            buffer.writeBuffer(&data)
+        case .end:
+            ended = true
+        case .error(let error):
+            promise?.fail(error)
+            return
+        }
+        promise?.succeed(())
+    }
 }
@@ -94,4 +94,23 @@ import Testing
         #expect(date.minute == 0)
         #expect(date.second == 0)
     }
+
+    @Test func timezoneCache() throws {
+        let cache = TimezoneCache(capacity: 10)
+        #expect(TimezoneCache.key(latitude: 52.52, longitude: 13.41) == TimezoneCache.key(latitude: 52.5202, longitude: 13.4098))
+        #expect(TimezoneCache.key(latitude: 52.52, longitude: 13.41) != TimezoneCache.key(latitude: 13.41, longitude: 52.52))
+        #expect(TimezoneCache.key(latitude: -33.9, longitude: -70.6) != TimezoneCache.key(latitude: -33.9, longitude: 70.6))
+
+        // Summer time offset is cached until the transition to winter time
+        let summer = Date(timeIntervalSince1970: TimeInterval(Timestamp(2024, 7, 1).timeIntervalSince1970))
+        let cest = try cache.offset(identifier: "Europe/Berlin", now: summer)
+        #expect(cest.utcOffsetSeconds == 7200)
+        #expect(cest.identifier == "Europe/Berlin")
+        let winter = Date(timeIntervalSince1970: TimeInterval(Timestamp(2024, 11, 1).timeIntervalSince1970))
+        #expect(try cache.offset(identifier: "Europe/Berlin", now: winter).utcOffsetSeconds == 3600)
+        #expect(cache.offset(timezone: TimeZone(identifier: "Asia/Tokyo")!, now: winter).utcOffsetSeconds == 32400)
+        #expect(throws: ForecastapiError.self) {
+            try cache.offset(identifier: "Mars/Olympus_Mons", now: winter)
+        }
+    }
 }
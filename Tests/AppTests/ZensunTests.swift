@@ -201,6 +201,62 @@ import Testing
         #expect(arraysEqual(dni2, [0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 75.31125, 525.6262, 730.035, 838.7038, 889.7469, 908.00757, 911.16675, 843.0275, 749.2078, 665.61414, 414.24997, 34.339397, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0], accuracy: 0.01))
     }
 
+    /// Compare the vectorised kernel with the scalar libm implementation it replaced
+    @Test func solarGeometryBackwardsAccuracy() {
+        let time = TimerangeDt(start: Timestamp(2024, 1, 1), nTime: 366 * 24, dtSeconds: 3600)
+        let alpha = Float(0.83333 - 5)
+        var maxError: (zzBackwards: Float, zzInstant: Float, fraction: Float, incidence: Float) = (0, 0, 0, 0)
+        for latitude in stride(from: Float(-85), through: 85, by: 17) {
+            for longitude in stride(from: Float(-180), through: 180, by: 45) {
+                let geometry = SolarGeometryBackwards(timerange: time, latitude: latitude, longitude: longitude, alpha: alpha, withDaylightFraction: true, withAzimuth: true)
+                let (cosIncidence, _) = geometry.incidence(tilt: 30, azimuth: -45)
+                for (t, timestamp) in time.enumerated() {
+                    let t1 = (90 - timestamp.getSunDeclination()).degreesToRadians
+                    let eqtime = timestamp.getSunEquationOfTime()
+                    let ut = timestamp.hourWithFraction
+                    let p1 = (-15.0 * (ut - 12.0 + eqtime)).degreesToRadians
+                    let p10 = (-15.0 * (ut - 1 - 12.0 + eqtime)).degreesToRadians
+                    let t0 = (90 - latitude).degreesToRadians
+                    var p0 = longitude.degreesToRadians
+                    if p0 < p1 - .pi {
+                        p0 += 2 * .pi
+                    }
+                    if p0 > p1 + .pi {
+                        p0 -= 2 * .pi
+                    }
+                    let arg = -(sin(alpha.degreesToRadians) + cos(t0) * cos(t1)) / (sin(t0) * sin(t1))
+                    let carg = arg > 1 || arg < -1 ? .pi : acos(arg)
+                    let p1_l = min(p0 + carg, p10)
+                    let p10_l = max(p0 - carg, p1)
+                    let zzInstant = cos(t0) * cos(t1) + sin(t0) * sin(t1) * cos(p1 - p0)
+                    maxError.zzInstant = max(maxError.zzInstant, abs(zzInstant - geometry.zzInstant[t]))
+                    // Intervals ending close to sun rise/set suffer from cancellation in the scalar implementation
+                    guard abs(p1_l - p10_l) > 0.01 else {
+                        continue
+                    }
+                    let left = sin(t0) * sin(t1) * sin(p1_l - p0) + p1_l * cos(t0) * cos(t1)
+                    let right = sin(t0) * sin(t1) * sin(p10_l - p0) + p10_l * cos(t0) * cos(t1)
+                    let zzBackwards = (left - right) / (p1_l - p10_l)
+                    let xxBackwards = (sin(t1) * (-cos(p1_l - p0)) - sin(t1) * (-cos(p10_l - p0))) / (p1_l - p10_l)
+                    let yyLeft = p1_l * sin(t0) * cos(t1) - cos(t0) * sin(t1) * sin(p1_l - p0)
+                    let yyRight = p10_l * sin(t0) * cos(t1) - cos(t0) * sin(t1) * sin(p10_l - p0)
+                    let yyBackwards = (yyLeft - yyRight) / (p1_l - p10_l)
+                    let zenith = acos(zzBackwards)
+                    let azimuth = atan2(xxBackwards, yyBackwards)
+                    let tilt = Float(30).degreesToRadians
+                    let incidence = max(cos(zenith) * cos(tilt) + sin(zenith) * sin(tilt) * cos(azimuth - .pi - Float(-45).degreesToRadians), 0)
+                    maxError.zzBackwards = max(maxError.zzBackwards, abs(zzBackwards - geometry.zzBackwards[t]))
+                    maxError.fraction = max(maxError.fraction, abs(abs((p1_l - p10_l) / (p10 - p1)) - geometry.daylightFraction[t]))
+                    maxError.incidence = max(maxError.incidence, abs(incidence - cosIncidence[t]))
+                }
+            }
+        }
+        #expect(maxError.zzBackwards < 1e-4)
+        #expect(maxError.zzInstant < 1e-5)
+        #expect(maxError.fraction < 1e-3)
+        #expect(maxError.incidence < 1e-3)
+    }
+
     @Test func gTI() {
         let directRadiation = [Float(0.0), 0.0, 0.0, 0.0, 0.0, 0.0, 7.0, 116.0, 305.0, 485.0, 615.0, 680.0, 681.0, 579.0, 428.0, 272.0, 87.0, 3.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0]
         let diffuseRadiation = [Float(0.0), 0.0, 0.0, 0.0, 0.0, 0.0, 2.0, 130.0, 118.0, 224.0, 315.0, 316.0, 318.0, 280.0, 215.0, 139.0, 40.0, 1.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0]